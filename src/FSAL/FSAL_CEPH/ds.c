@@ -43,8 +43,11 @@
 #include "fsal_api.h"
 #include "FSAL/fsal_commonlib.h"
 #include "fsal_up.h"
+#include "fridgethr.h"
 #include "internal.h"
 #include "pnfs_utils.h"
+#include "nfs_core.h"
+#include "server_stats.h"
 
 #define min(a, b) ({				\
 	typeof(a) _a = (a);			\
@@ -69,6 +72,250 @@ static inline void local_invalidate(struct ds *ds, struct fsal_export *export)
 	return;
 }
 
+/* Most stripe units one DS request is split into */
+#define DS_MAX_STRIPES 16
+
+/**
+ * @brief I/O on one stripe unit of a DS request
+ */
+
+struct ds_stripe_io {
+	struct export *export;
+	struct ds *ds;
+	uint64_t stripe;	/*< Stripe unit (block) number */
+	uint64_t internal_offset;	/*< Offset within the block */
+	uint64_t length;
+	char *buffer;		/*< Where in the caller's buffer */
+	bool write;
+	bool sync;
+	int64_t result;		/*< Bytes moved or negative error */
+	struct ds_io_batch *batch;
+};
+
+/**
+ * @brief The stripe I/Os of one request still running
+ */
+
+struct ds_io_batch {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	uint32_t pending;
+};
+
+/* Threads issuing stripe I/Os beyond the first of each request */
+static struct fridgethr *ds_io_fridge;
+
+/**
+ * @brief Start the DS stripe I/O threads
+ *
+ * @return 0 or an errno.
+ */
+
+int ds_io_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 4 * DS_MAX_STRIPES;
+	frp.thr_min = 0;
+	frp.thread_delay = 60;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_fail;
+
+	rc = fridgethr_init(&ds_io_fridge, "Ceph_DS_IO", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_PNFS,
+			 "Unable to initialize DS I/O fridge, error code %d.",
+			 rc);
+		ds_io_fridge = NULL;
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Stop the DS stripe I/O threads
+ */
+
+void ds_io_pkgshutdown(void)
+{
+	int rc;
+
+	if (ds_io_fridge == NULL)
+		return;
+
+	rc = fridgethr_sync_command(ds_io_fridge, fridgethr_comm_stop, 120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_PNFS,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(ds_io_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_PNFS,
+			 "Failed shutting down DS I/O fridge: %d", rc);
+	}
+
+	fridgethr_destroy(ds_io_fridge);
+	ds_io_fridge = NULL;
+}
+
+/**
+ * @brief Split a DS request into stripe units on this OSD
+ *
+ * Consecutive stripe units are taken from the offset until the
+ * length is covered, a unit lives on another OSD, or DS_MAX_STRIPES
+ * is reached.
+ *
+ * @param[in]  export The export
+ * @param[in]  ds     The DS handle
+ * @param[in]  offset Start of the request
+ * @param[in]  length Length of the request
+ * @param[in]  buffer The caller's buffer
+ * @param[out] ios    The stripe I/Os, DS_MAX_STRIPES long
+ *
+ * @return Number of stripe I/Os, 0 if the first unit is not local,
+ *         or a negative error.
+ */
+
+static int ds_split(struct export *export, struct ds *ds, uint64_t offset,
+		    uint64_t length, char *buffer, struct ds_stripe_io *ios)
+{
+	/* The OSD number for this machine */
+	int local_OSD = 0;
+	/* Width of a stripe in the file */
+	uint32_t stripe_width = ds->wire.layout.fl_stripe_unit;
+	/* Number of the stripe being read */
+	uint64_t stripe = offset / stripe_width;
+	/* Internal offset within the stripe */
+	uint64_t internal_offset = offset - stripe * stripe_width;
+	int n = 0;
+
+	/* Find out what my OSD ID is, so we can avoid talking to
+	   other OSDs. */
+
+	local_OSD = ceph_get_local_osd(export->cmount);
+	if (local_OSD < 0)
+		return local_OSD;
+
+	while (length > 0 && n < DS_MAX_STRIPES) {
+		if (local_OSD !=
+		    ceph_ll_get_stripe_osd(export->cmount, ds->wire.wire.vi,
+					   stripe, &(ds->wire.layout)))
+			break;
+
+		memset(&ios[n], 0, sizeof(ios[n]));
+		ios[n].export = export;
+		ios[n].ds = ds;
+		ios[n].stripe = stripe;
+		ios[n].internal_offset = internal_offset;
+		ios[n].length = min(stripe_width - internal_offset, length);
+		ios[n].buffer = buffer;
+
+		buffer += ios[n].length;
+		length -= ios[n].length;
+		internal_offset = 0;
+		stripe++;
+		n++;
+	}
+
+	return n;
+}
+
+static void ds_stripe_run(struct ds_stripe_io *io)
+{
+	struct ceph_mount_info *cmount = io->export->cmount;
+	struct ds_wire *wire = &io->ds->wire;
+
+	if (io->write)
+		io->result = ceph_ll_write_block(cmount, wire->wire.vi,
+						 io->stripe, io->buffer,
+						 io->internal_offset,
+						 io->length, &wire->layout,
+						 wire->snapseq, io->sync);
+	else
+		io->result = ceph_ll_read_block(cmount, wire->wire.vi,
+						io->stripe, io->buffer,
+						io->internal_offset,
+						io->length, &wire->layout);
+}
+
+static void ds_stripe_thread(struct fridgethr_context *ctx)
+{
+	struct ds_stripe_io *io = ctx->arg;
+	struct ds_io_batch *batch = io->batch;
+
+	ds_stripe_run(io);
+
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	if (--batch->pending == 0)
+		pthread_cond_signal(&batch->cv);
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+}
+
+/**
+ * @brief Run the stripe I/Os of a request concurrently
+ *
+ * The first runs on the calling thread, the others on the DS I/O
+ * fridge, or inline if it is busy.  Their buffers are disjoint parts
+ * of the caller's, so data land in place.
+ *
+ * @param[in,out] ios Stripe I/Os
+ * @param[in]     n   Number of them
+ *
+ * @return Bytes moved up to the first short or failed I/O, or a
+ *         negative error if the first failed.
+ */
+
+static int64_t ds_run(struct ds_stripe_io *ios, int n)
+{
+	struct ds_io_batch batch;
+	int64_t total = 0;
+	int i;
+
+	if (n > 1 && ds_io_fridge != NULL) {
+		pthread_mutex_init(&batch.mtx, NULL);
+		pthread_cond_init(&batch.cv, NULL);
+		batch.pending = 0;
+
+		for (i = 1; i < n; i++) {
+			ios[i].batch = &batch;
+			PTHREAD_MUTEX_lock(&batch.mtx);
+			batch.pending++;
+			PTHREAD_MUTEX_unlock(&batch.mtx);
+			if (fridgethr_submit(ds_io_fridge, ds_stripe_thread,
+					     &ios[i]) != 0) {
+				PTHREAD_MUTEX_lock(&batch.mtx);
+				batch.pending--;
+				PTHREAD_MUTEX_unlock(&batch.mtx);
+				ds_stripe_run(&ios[i]);
+			}
+		}
+
+		ds_stripe_run(&ios[0]);
+
+		PTHREAD_MUTEX_lock(&batch.mtx);
+		while (batch.pending != 0)
+			pthread_cond_wait(&batch.cv, &batch.mtx);
+		PTHREAD_MUTEX_unlock(&batch.mtx);
+
+		pthread_cond_destroy(&batch.cv);
+		pthread_mutex_destroy(&batch.mtx);
+	} else {
+		for (i = 0; i < n; i++)
+			ds_stripe_run(&ios[i]);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (ios[i].result < 0)
+			return i == 0 ? ios[i].result : total;
+		total += ios[i].result;
+		if (ios[i].result < ios[i].length)
+			break;
+	}
+
+	return total;
+}
+
 /**
  * @brief Release a DS object
  *
@@ -93,6 +340,9 @@ static void release(struct fsal_ds_handle *const ds_pub)
  * structure) and do not get loaded into cache_inode or processed the
  * normal way.
  *
+ * A read covering several stripe units stored on this OSD reads them
+ * concurrently.
+ *
  * @param[in]  ds_pub           FSAL DS handle
  * @param[in]  req_ctx          Credentials
  * @param[in]  stateid          The stateid supplied with the READ operation,
@@ -117,48 +367,30 @@ static nfsstat4 ds_read(struct fsal_ds_handle *const ds_pub,
 	    container_of(req_ctx->fsal_export, struct export, export);
 	/* The private 'full' DS handle */
 	struct ds *ds = container_of(ds_pub, struct ds, ds);
-	/* The OSD number for this machine */
-	int local_OSD = 0;
-	/* Width of a stripe in the file */
-	uint32_t stripe_width = 0;
-	/* Beginning of a block */
-	uint64_t block_start = 0;
-	/* Number of the stripe being read */
-	uint32_t stripe = 0;
-	/* Internal offset within the stripe */
-	uint32_t internal_offset = 0;
+	/* The stripe units to read */
+	struct ds_stripe_io ios[DS_MAX_STRIPES];
+	/* Number of stripe units */
+	int n = 0;
 	/* The amount actually read */
-	int amount_read = 0;
+	int64_t amount_read = 0;
+	/* When the read started and ended */
+	struct timespec start, end;
 
-	/* Find out what my OSD ID is, so we can avoid talking to
-	   other OSDs. */
-
-	local_OSD = ceph_get_local_osd(export->cmount);
-	if (local_OSD < 0)
-		return posix2nfs4_error(-local_OSD);
-
-	/* Find out what stripe we're writing to and where within the
-	   stripe. */
-
-	stripe_width = ds->wire.layout.fl_stripe_unit;
-	stripe = offset / stripe_width;
-	block_start = stripe * stripe_width;
-	internal_offset = offset - block_start;
+	now(&start);
 
-	if (local_OSD !=
-	    ceph_ll_get_stripe_osd(export->cmount, ds->wire.wire.vi, stripe,
-				   &(ds->wire.layout))) {
+	n = ds_split(export, ds, offset, requested_length, buffer, ios);
+	if (n < 0)
+		return posix2nfs4_error(-n);
+	if (n == 0)
 		return NFS4ERR_PNFS_IO_HOLE;
-	}
 
-	amount_read =
-	    ceph_ll_read_block(export->cmount, ds->wire.wire.vi, stripe, buffer,
-			       internal_offset,
-			       min((stripe_width - internal_offset),
-				   requested_length), &(ds->wire.layout));
+	amount_read = ds_run(ios, n);
 	if (amount_read < 0)
 		return posix2nfs4_error(-amount_read);
 
+	now(&end);
+	server_stats_ds_io(false, n, amount_read, timespec_diff(&start, &end));
+
 	*supplied_length = amount_read;
 
 	*end_of_file = false;
@@ -172,7 +404,8 @@ static nfsstat4 ds_read(struct fsal_ds_handle *const ds_pub,
  *
  * This performs a DS write not going through the data server unless
  * FILE_SYNC4 is specified, in which case it connects the filehandle
- * and performs an MDS write.
+ * and performs an MDS write.  Otherwise stripe units stored on this
+ * OSD are written concurrently.
  *
  * @param[in]  ds_pub           FSAL DS handle
  * @param[in]  req_ctx          Credentials
@@ -203,45 +436,32 @@ static nfsstat4 ds_write(struct fsal_ds_handle *const ds_pub,
 	    container_of(req_ctx->fsal_export, struct export, export);
 	/* The private 'full' DS handle */
 	struct ds *ds = container_of(ds_pub, struct ds, ds);
-	/* The OSD number for this host */
-	int local_OSD = 0;
-	/* Width of a stripe in the file */
-	uint32_t stripe_width = 0;
-	/* Beginning of a block */
-	uint64_t block_start = 0;
-	/* Number of the stripe being written */
-	uint32_t stripe = 0;
-	/* Internal offset within the stripe */
-	uint32_t internal_offset = 0;
+	/* The stripe units to write */
+	struct ds_stripe_io ios[DS_MAX_STRIPES];
+	/* Number of stripe units */
+	int n = 0;
 	/* The amount actually written */
-	int32_t amount_written = 0;
-	/* The adjusted write length, confined to one object */
-	uint32_t adjusted_write = 0;
+	int64_t amount_written = 0;
+	/* The adjusted write length, confined to objects on this OSD */
+	uint64_t adjusted_write = 0;
 	/* Return code from ceph calls */
 	int ceph_status = 0;
+	/* When the write started and ended */
+	struct timespec start, end;
+	int i;
 
 	memset(*writeverf, 0, NFS4_VERIFIER_SIZE);
 
-	/* Find out what my OSD ID is, so we can avoid talking to
-	   other OSDs. */
-
-	local_OSD = ceph_get_local_osd(export->cmount);
-
-	/* Find out what stripe we're writing to and where within the
-	   stripe. */
+	now(&start);
 
-	stripe_width = ds->wire.layout.fl_stripe_unit;
-	stripe = offset / stripe_width;
-	block_start = stripe * stripe_width;
-	internal_offset = offset - block_start;
-
-	if (local_OSD !=
-	    ceph_ll_get_stripe_osd(export->cmount, ds->wire.wire.vi, stripe,
-				   &(ds->wire.layout))) {
+	n = ds_split(export, ds, offset, write_length, (char *)buffer, ios);
+	if (n < 0)
+		return posix2nfs4_error(-n);
+	if (n == 0)
 		return NFS4ERR_PNFS_IO_HOLE;
-	}
 
-	adjusted_write = min((stripe_width - internal_offset), write_length);
+	for (i = 0; i < n; i++)
+		adjusted_write += ios[i].length;
 
 	/* If the client specifies FILE_SYNC4, then we have to connect
 	   the filehandle and use the MDS to update size and access
@@ -279,15 +499,15 @@ static nfsstat4 ds_write(struct fsal_ds_handle *const ds_pub,
 
 		if (amount_written < 0) {
 			LogMajor(COMPONENT_FSAL,
-				 "Write failed with: %d", amount_written);
+				 "Write failed with: %"PRId64, amount_written);
 			ceph_ll_close(export->cmount, descriptor);
 			return posix2nfs4_error(-amount_written);
 		}
 
 		ceph_status = ceph_ll_fsync(export->cmount, descriptor, 0);
 		if (ceph_status < 0) {
-			LogMajor(COMPONENT_FSAL
-				"fsync failed with: %d", ceph_status);
+			LogMajor(COMPONENT_FSAL,
+				 "fsync failed with: %d", ceph_status);
 			ceph_ll_close(export->cmount, descriptor);
 			return posix2nfs4_error(-ceph_status);
 		}
@@ -309,12 +529,12 @@ static nfsstat4 ds_write(struct fsal_ds_handle *const ds_pub,
 		/* FILE_SYNC4 wasn't specified, so we don't have to
 		   bother with the MDS. */
 
-		amount_written =
-		    ceph_ll_write_block(export->cmount, ds->wire.wire.vi,
-					stripe, (char *)buffer, internal_offset,
-					adjusted_write, &(ds->wire.layout),
-					ds->wire.snapseq,
-					(stability_wanted == DATA_SYNC4));
+		for (i = 0; i < n; i++) {
+			ios[i].write = true;
+			ios[i].sync = (stability_wanted == DATA_SYNC4);
+		}
+
+		amount_written = ds_run(ios, n);
 		if (amount_written < 0)
 			return posix2nfs4_error(-amount_written);
 
@@ -322,6 +542,10 @@ static nfsstat4 ds_write(struct fsal_ds_handle *const ds_pub,
 		*stability_got = stability_wanted;
 	}
 
+	now(&end);
+	server_stats_ds_io(true, n, *written_length,
+			   timespec_diff(&start, &end));
+
 	return NFS4_OK;
 }
 
@@ -102,13 +102,50 @@ static fsal_status_t lookup(struct fsal_obj_handle *dir_pub,
 	return fsalstat(0, 0);
 }
 
+/**
+ * @brief Make a handle for an entry returned by ceph_readdirplus_r
+ *
+ * readdirplus has already brought the inode into the client cache
+ * and given us its attributes, so no lookup is needed.
+ *
+ * @param[in] export The export the directory is in
+ * @param[in] st     Attributes of the entry
+ * @param[in] stmask Which of them are valid
+ *
+ * @return The handle, or NULL to have the caller look the entry up.
+ */
+
+static struct fsal_obj_handle *readdir_handle(struct export *export,
+					      struct stat *st, int stmask)
+{
+	struct handle *obj = NULL;
+	struct Inode *i = NULL;
+	vinodeno_t vi;
+
+	if ((stmask & CEPH_STAT_CAP_INODE_ALL) != CEPH_STAT_CAP_INODE_ALL)
+		return NULL;
+
+	vi.ino.val = st->st_ino;
+	vi.snapid.val = st->st_dev;
+	i = ceph_ll_get_inode(export->cmount, vi);
+	if (i == NULL)
+		return NULL;
+
+	if (construct_handle(st, i, export, &obj) < 0) {
+		ceph_ll_put(export->cmount, i);
+		return NULL;
+	}
+
+	return &obj->handle;
+}
+
 /**
  * @brief Read a directory
  *
  * This function reads the contents of a directory (excluding . and
  * .., which is ironic since the Ceph readdir call synthesizes them
  * out of nothing) and passes dirent information to the supplied
- * callback.
+ * callback, along with a handle built from the readdirplus results.
  *
  * @param[in]  dir_pub     The directory to read
  * @param[in]  whence      The cookie indicating resumption, NULL to start
@@ -163,7 +200,8 @@ static fsal_status_t fsal_readdir(struct fsal_obj_handle *dir_pub,
 				continue;
 			}
 
-			if (!cb(de.d_name, dir_state, de.d_off))
+			if (!cb(de.d_name, readdir_handle(export, &st, stmask),
+				dir_state, de.d_off))
 				goto closedir;
 
 		} else if (rc == 0) {
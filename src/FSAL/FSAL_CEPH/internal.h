@@ -125,6 +125,8 @@ void export_ops_init(struct export_ops *ops);
 void handle_ops_init(struct fsal_obj_ops *ops);
 #ifdef CEPH_PNFS
 void ds_ops_init(struct fsal_ds_ops *ops);
+int ds_io_pkginit(void);
+void ds_io_pkgshutdown(void);
 void export_ops_pnfs(struct export_ops *ops);
 void handle_ops_pnfs(struct fsal_obj_ops *ops);
 #endif				/* CEPH_PNFS */
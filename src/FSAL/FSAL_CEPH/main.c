@@ -229,6 +229,10 @@ MODULE_INIT void init(void)
 
 	/* Set up module operations */
 	module->ops->create_export = create_export;
+
+#ifdef CEPH_PNFS
+	ds_io_pkginit();
+#endif				/* CEPH_PNFS */
 }
 
 /**
@@ -241,6 +245,10 @@ MODULE_INIT void init(void)
 
 MODULE_FINI void finish(void)
 {
+#ifdef CEPH_PNFS
+	ds_io_pkgshutdown();
+#endif				/* CEPH_PNFS */
+
 	if (unregister_fsal(module) != 0) {
 		LogCrit(COMPONENT_FSAL,
 			"Unable to unload FSAL.  Dying with extreme "
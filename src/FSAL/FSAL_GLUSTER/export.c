@@ -59,6 +59,7 @@ static void export_release(struct fsal_export *exp_hdl)
 	glfs_export->export.ops = NULL;
 
 	/* Gluster and memory cleanup */
+	glusterfs_stop_up_thread(glfs_export);
 	glfs_fini(glfs_export->gl_fs);
 	glfs_export->gl_fs = NULL;
 	gsh_free(glfs_export->export_path);
@@ -519,6 +520,7 @@ struct glexport_params {
 	char *glhostname;
 	char *glvolpath;
 	char *glfs_log;
+	uint32_t up_poll_usec;
 };
 
 static struct config_item export_params[] = {
@@ -531,6 +533,8 @@ static struct config_item export_params[] = {
 		      glexport_params, glvolpath),
 	CONF_ITEM_PATH("glfs_log", 1, MAXPATHLEN, "/tmp/gfapi.log",
 		       glexport_params, glfs_log),
+	CONF_ITEM_UI32("up_poll_usec", 0, 1000000, 10000,
+		       glexport_params, up_poll_usec),
 	CONFIG_EOL
 };
 
@@ -655,6 +659,13 @@ fsal_status_t glusterfs_create_export(struct fsal_module *fsal_hdl,
 	glfsexport->acl_enable =
 		((op_ctx->export->export_perms.options &
 		  EXPORT_OPTION_DISABLE_ACL) ? 0 : 1);
+	glfsexport->up_poll_usec = params.up_poll_usec;
+
+	rc = glusterfs_start_up_thread(glfsexport);
+	if (rc != 0)
+		LogWarn(COMPONENT_FSAL,
+			"Unable to poll upcalls, error %d. Export: %s",
+			rc, op_ctx->export->fullpath);
 
 	op_ctx->fsal_export = &glfsexport->export;
 
@@ -0,0 +1,303 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * -------------
+ */
+
+/**
+ * @file  fsal_up.c
+ *
+ * @brief GLUSTERFS FSAL upcalls
+ *
+ * With features.cache-invalidation set on the volume, gfapi queues a
+ * notice whenever another client changes an inode we hold.  A thread
+ * per export polls for these and passes them up as attribute updates
+ * or invalidations, so that cache entries stay correct with long
+ * expiry times.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fsal.h"
+#include "fsal_up.h"
+#include "fridgethr.h"
+#include "abstract_atomic.h"
+#include "gluster_internal.h"
+
+#ifdef HAVE_GLFS_UPCALL
+
+/**
+ * @brief Build the cache key of a gfapi object
+ */
+
+static int upcall_key(struct glusterfs_export *glexport,
+		      struct glfs_object *object, unsigned char *globjhdl,
+		      struct gsh_buffdesc *key)
+{
+	int rc;
+
+	memcpy(globjhdl, glexport->vol_uuid, GLAPI_UUID_LENGTH);
+	rc = glfs_h_extract_handle(object, globjhdl + GLAPI_UUID_LENGTH,
+				   GFAPI_HANDLE_LENGTH);
+	if (rc < 0)
+		return rc;
+
+	key->addr = globjhdl;
+	key->len = GLAPI_HANDLE_LENGTH;
+	return 0;
+}
+
+static void upcall_invalidate(struct glusterfs_export *glexport,
+			      struct glfs_object *object)
+{
+	unsigned char globjhdl[GLAPI_HANDLE_LENGTH];
+	struct gsh_buffdesc key;
+	int rc;
+
+	if (object == NULL)
+		return;
+
+	if (upcall_key(glexport, object, globjhdl, &key) != 0) {
+		LogDebug(COMPONENT_FSAL_UP,
+			 "Could not extract handle, errno %d", errno);
+		return;
+	}
+
+	rc = up_async_invalidate(general_fridge, glexport->export.up_ops,
+				 glexport->export.fsal, &key,
+				 CACHE_INODE_INVALIDATE_ATTRS |
+				 CACHE_INODE_INVALIDATE_CONTENT, NULL, NULL);
+	if (rc != 0)
+		LogWarn(COMPONENT_FSAL_UP,
+			"Could not queue invalidate, rc %d", rc);
+}
+
+/**
+ * @brief Pass an inode upcall up
+ *
+ * Changes gfapi describes fully (size, mode, owner, times, links)
+ * update the cached attributes from the stat it sent.  Anything else
+ * invalidates the entry.  Parent directories had entries added or
+ * removed and are always invalidated.
+ */
+
+static void upcall_inode(struct glusterfs_export *glexport,
+			 struct callback_inode_arg *arg)
+{
+	unsigned char globjhdl[GLAPI_HANDLE_LENGTH];
+	struct gsh_buffdesc key;
+	struct attrlist attr;
+	attrmask_t mask = 0;
+	uint32_t upflags = 0;
+	int flags = arg->flags;
+	int rc;
+
+	LogMidDebug(COMPONENT_FSAL_UP,
+		    "inode upcall: flags:%x ino %ld",
+		    flags, (long)arg->buf.st_ino);
+
+	if (glexport->acl_enable && (flags & (GFAPI_UP_MODE | GFAPI_UP_OWN)))
+		flags |= GFAPI_UP_PERM;	/* The ACL must be read again */
+
+	if (arg->object == NULL ||
+	    (flags & GFAPI_INODE_UPDATE_FLAGS) == 0 ||
+	    (flags & ~GFAPI_INODE_UPDATE_FLAGS & ~GFAPI_UP_PARENT_TIMES)) {
+		upcall_invalidate(glexport, arg->object);
+		goto parents;
+	}
+
+	if (upcall_key(glexport, arg->object, globjhdl, &key) != 0) {
+		LogDebug(COMPONENT_FSAL_UP,
+			 "Could not extract handle, errno %d", errno);
+		goto parents;
+	}
+
+	stat2fsal_attributes(&arg->buf, &attr);
+
+	if (flags & GFAPI_UP_SIZE)
+		mask |= ATTR_CHGTIME | ATTR_CHANGE | ATTR_SIZE |
+			ATTR_SPACEUSED;
+	if (flags & GFAPI_UP_MODE)
+		mask |= ATTR_CHGTIME | ATTR_CHANGE | ATTR_MODE;
+	if (flags & GFAPI_UP_OWN)
+		mask |= ATTR_CHGTIME | ATTR_CHANGE | ATTR_OWNER | ATTR_GROUP;
+	if (flags & GFAPI_UP_TIMES)
+		mask |= ATTR_CHGTIME | ATTR_CHANGE | ATTR_ATIME | ATTR_CTIME |
+			ATTR_MTIME;
+	if (flags & GFAPI_UP_ATIME)
+		mask |= ATTR_ATIME;
+	if (flags & GFAPI_UP_NLINK) {
+		mask |= ATTR_CHGTIME | ATTR_CHANGE | ATTR_NUMLINKS;
+		upflags |= fsal_up_nlink;
+	}
+
+	attr.mask = mask;
+	attr.expire_time_attr = arg->expire_time_attr;
+
+	rc = up_async_update(general_fridge, glexport->export.up_ops,
+			     glexport->export.fsal, &key, &attr, upflags,
+			     NULL, NULL);
+	if (rc != 0)
+		LogWarn(COMPONENT_FSAL_UP,
+			"Could not queue update, rc %d", rc);
+
+ parents:
+	upcall_invalidate(glexport, arg->p_object);
+	upcall_invalidate(glexport, arg->oldp_object);
+}
+
+static void *GLUSTERFSAL_UP_Thread(void *arg)
+{
+	struct glusterfs_export *glexport = arg;
+	struct callback_arg callback;
+	struct callback_inode_arg *cbk_inode_arg;
+	int rc;
+
+	SetNameFunction("gl_upcall");
+
+	LogFullDebug(COMPONENT_FSAL_UP,
+		     "Polling upcalls for export %s", glexport->mount_path);
+
+	while (atomic_fetch_uint32_t(&glexport->up_stop) == 0) {
+		memset(&callback, 0, sizeof(callback));
+		callback.fs = glexport->gl_fs;
+
+		rc = glfs_h_poll_upcall(glexport->gl_fs, &callback);
+		if (rc != 0) {
+			if (errno == ENOTSUP) {
+				LogWarn(COMPONENT_FSAL_UP,
+					"Upcalls not supported by the volume of export %s",
+					glexport->mount_path);
+				break;
+			}
+			LogDebug(COMPONENT_FSAL_UP,
+				 "glfs_h_poll_upcall failed, errno %d", errno);
+			usleep(glexport->up_poll_usec);
+			continue;
+		}
+
+		switch (callback.reason) {
+		case GFAPI_INODE_INVALIDATE:
+			cbk_inode_arg = callback.event_arg;
+			if (cbk_inode_arg == NULL)
+				break;
+			upcall_inode(glexport, cbk_inode_arg);
+			if (cbk_inode_arg->object)
+				glfs_h_close(cbk_inode_arg->object);
+			if (cbk_inode_arg->p_object)
+				glfs_h_close(cbk_inode_arg->p_object);
+			if (cbk_inode_arg->oldp_object)
+				glfs_h_close(cbk_inode_arg->oldp_object);
+			free(cbk_inode_arg);
+			/* There may be more queued */
+			continue;
+
+		case GFAPI_CBK_EVENT_NULL:
+			break;
+
+		default:
+			LogWarn(COMPONENT_FSAL_UP, "Unknown event: %d",
+				callback.reason);
+			free(callback.event_arg);
+			break;
+		}
+
+		usleep(glexport->up_poll_usec);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Start polling for upcalls on an export
+ *
+ * Does nothing if up_poll_usec is 0.
+ *
+ * @param[in] glexport The export, with its volume initialized
+ *
+ * @return 0 or an errno.
+ */
+
+int glusterfs_start_up_thread(struct glusterfs_export *glexport)
+{
+	pthread_attr_t attr_thr;
+	int rc;
+
+	if (glexport->up_poll_usec == 0)
+		return 0;
+
+	rc = glfs_get_volumeid(glexport->gl_fs, glexport->vol_uuid,
+			       GLAPI_UUID_LENGTH);
+	if (rc < 0)
+		return errno;
+
+	pthread_attr_init(&attr_thr);
+	pthread_attr_setdetachstate(&attr_thr, PTHREAD_CREATE_JOINABLE);
+
+	rc = pthread_create(&glexport->up_thread, &attr_thr,
+			    GLUSTERFSAL_UP_Thread, glexport);
+	pthread_attr_destroy(&attr_thr);
+	if (rc != 0) {
+		LogCrit(COMPONENT_THREAD,
+			"Could not create GLUSTERFSAL_UP_Thread, error = %d (%s)",
+			rc, strerror(rc));
+		return rc;
+	}
+
+	glexport->up_running = true;
+	return 0;
+}
+
+/**
+ * @brief Stop polling for upcalls on an export
+ *
+ * Must be called before the volume is finalized.
+ *
+ * @param[in] glexport The export
+ */
+
+void glusterfs_stop_up_thread(struct glusterfs_export *glexport)
+{
+	if (!glexport->up_running)
+		return;
+
+	atomic_store_uint32_t(&glexport->up_stop, 1);
+	pthread_join(glexport->up_thread, NULL);
+	glexport->up_running = false;
+}
+
+#else				/* HAVE_GLFS_UPCALL */
+
+int glusterfs_start_up_thread(struct glusterfs_export *glexport)
+{
+	if (glexport->up_poll_usec != 0)
+		LogInfo(COMPONENT_FSAL_UP,
+			"This gfapi has no upcalls, export %s relies on attribute expiry",
+			glexport->mount_path);
+	return 0;
+}
+
+void glusterfs_stop_up_thread(struct glusterfs_export *glexport)
+{
+}
+
+#endif				/* HAVE_GLFS_UPCALL */
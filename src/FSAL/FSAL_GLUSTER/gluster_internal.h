@@ -344,6 +344,11 @@ struct glusterfs_export {
 	gid_t savedgid;
 	struct fsal_export export;
 	bool acl_enable;
+	uint32_t up_poll_usec;	/*< Upcall poll interval, 0 for none */
+	char vol_uuid[GLAPI_UUID_LENGTH];
+	pthread_t up_thread;
+	bool up_running;
+	uint32_t up_stop;
 };
 
 struct glusterfs_handle {
@@ -438,6 +443,9 @@ fsal_status_t glusterfs_create_export(struct fsal_module *fsal_hdl,
 
 void gluster_cleanup_vars(struct glfs_object *glhandle);
 
+int glusterfs_start_up_thread(struct glusterfs_export *glexport);
+void glusterfs_stop_up_thread(struct glusterfs_export *glexport);
+
 bool fs_specific_has(const char *fs_specific, const char *key, char *val,
 		     int *max_val_bytes);
 
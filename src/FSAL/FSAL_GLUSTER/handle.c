@@ -189,7 +189,8 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 				continue;
 			}
 
-			if (!cb(de.d_name, dir_state, glfs_telldir(glfd))) {
+			if (!cb(de.d_name, NULL, dir_state,
+				glfs_telldir(glfd))) {
 				goto out;
 			}
 		} else if (rc == 0 && pde == NULL) {
@@ -485,7 +485,7 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 				goto skip;	/* must skip '.' and '..' */
 
 			/* callback to cache inode */
-			if (!cb(dentry->d_name, dir_state,
+			if (!cb(dentry->d_name, NULL, dir_state,
 				(fsal_cookie_t) dentry->d_off)) {
 				goto done;
 			}
@@ -830,6 +830,7 @@ static fsal_status_t lustre_read_dirents(struct fsal_obj_handle *dir_hdl,
 
 			/* callback to cache inode */
 			if (!cb(dentry->d_name,
+				NULL,
 				dir_state,
 				(fsal_cookie_t) dentry->d_off))
 					goto done;
@@ -248,11 +248,21 @@ static struct bitmap4 pxy_bitmap_getattr = {
 	.bitmap4_len = 2
 };
 
-/* Until readdir callback can take more information do not ask for more then
- * just type */
+/* Readdir asks for the handle and the attributes getattr would, so the
+ * entries come back ready to be cached without a lookup each */
 static struct bitmap4 pxy_bitmap_readdir = {
-	.map[0] = PXY_ATTR_BIT(FATTR4_TYPE),
-	.bitmap4_len = 1
+	.map[0] =
+	    (PXY_ATTR_BIT(FATTR4_TYPE) | PXY_ATTR_BIT(FATTR4_CHANGE) |
+	     PXY_ATTR_BIT(FATTR4_SIZE) | PXY_ATTR_BIT(FATTR4_FSID) |
+	     PXY_ATTR_BIT(FATTR4_FILEHANDLE) | PXY_ATTR_BIT(FATTR4_FILEID)),
+	.map[1] =
+	    (PXY_ATTR_BIT2(FATTR4_MODE) | PXY_ATTR_BIT2(FATTR4_NUMLINKS) |
+	     PXY_ATTR_BIT2(FATTR4_OWNER) | PXY_ATTR_BIT2(FATTR4_OWNER_GROUP) |
+	     PXY_ATTR_BIT2(FATTR4_SPACE_USED) |
+	     PXY_ATTR_BIT2(FATTR4_TIME_ACCESS) |
+	     PXY_ATTR_BIT2(FATTR4_TIME_METADATA) |
+	     PXY_ATTR_BIT2(FATTR4_TIME_MODIFY) | PXY_ATTR_BIT2(FATTR4_RAWDEV)),
+	.bitmap4_len = 2
 };
 
 static struct bitmap4 pxy_bitmap_fsinfo = {
@@ -1565,19 +1575,33 @@ static fsal_status_t pxy_do_readdir(struct pxy_obj_handle *ph,
 	for (e4 = rdok->reply.entries; e4; e4 = e4->nextentry) {
 		struct attrlist attr;
 		char name[MAXNAMLEN + 1];
+		char padfilehandle[NFS4_FHSIZE];
+		nfs_fh4 fh4 = { .nfs_fh4_len = 0,
+				 .nfs_fh4_val = padfilehandle };
+		struct pxy_obj_handle *entry = NULL;
 
 		/* UTF8 name does not include trailing 0 */
-		if (e4->name.utf8string_len > sizeof(name) - 1)
-			return fsalstat(ERR_FSAL_SERVERFAULT, E2BIG);
+		if (e4->name.utf8string_len > sizeof(name) - 1) {
+			st = fsalstat(ERR_FSAL_SERVERFAULT, E2BIG);
+			break;
+		}
 		memcpy(name, e4->name.utf8string_val, e4->name.utf8string_len);
 		name[e4->name.utf8string_len] = '\0';
 
-		if (nfs4_Fattr_To_FSAL_attr(&attr, &e4->attrs, NULL))
-			return fsalstat(ERR_FSAL_FAULT, 0);
+		if (nfs4_Fattr_To_FSAL_attr_fh(&attr, &e4->attrs, &fh4)) {
+			st = fsalstat(ERR_FSAL_FAULT, 0);
+			break;
+		}
+
+		/* A server that did not send the handle gets a lookup */
+		if (fh4.nfs_fh4_len != 0)
+			entry = pxy_alloc_handle(op_ctx->fsal_export, &fh4,
+						 &attr);
 
 		*cookie = e4->cookie;
 
-		if (!cb(name, cbarg, e4->cookie))
+		if (!cb(name, entry != NULL ? &entry->obj : NULL, cbarg,
+			e4->cookie))
 			break;
 	}
 	xdr_free((xdrproc_t) xdr_readdirres, resoparray);
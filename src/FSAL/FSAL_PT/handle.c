@@ -463,6 +463,7 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 
 		/* callback to cache inode */
 		if (!cb(fsi_dname,
+			NULL,
 			dir_state,
 			entry_cookie->data.cookie)) {
 				FSI_TRACE(FSI_DEBUG, "callback failed\n");
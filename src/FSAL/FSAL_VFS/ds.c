@@ -0,0 +1,379 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   ds.c
+ *
+ * @brief pNFS DS operations for VFS
+ *
+ * The wire handle of a DS handle is the VFS handle the MDS put in
+ * the layout.  It is checked against our filesystems when the handle
+ * is created, so PUTFH fails with STALE for a filesystem we do not
+ * export, and opened by handle on the first read or write.
+ *
+ * A DS need not be the MDS and has no layout state to check the
+ * stateid against.  Since the file is opened by handle with the
+ * server's credentials, each read and write checks the caller's
+ * credentials against the file's mode instead, as the MDS does for
+ * I/O without an open.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "FSAL/fsal_commonlib.h"
+#include "vfs_methods.h"
+
+#include "fsal_up.h"
+#include "pnfs_utils.h"
+#include "nfs_core.h"
+#include "nfs_exports.h"
+
+/**
+ * @brief Create a FSAL data server handle from a wire handle
+ *
+ * @param[in]  export_pub The export in which to create the handle
+ * @param[in]  desc       Buffer from which to create the handle
+ * @param[out] ds_pub     FSAL data server handle
+ *
+ * @return NFSv4.1 error codes.
+ */
+
+nfsstat4 vfs_create_ds_handle(struct fsal_export *const export_pub,
+			      const struct gsh_buffdesc *const desc,
+			      struct fsal_ds_handle **const ds_pub)
+{
+	struct vfs_ds *ds;
+	struct fsal_filesystem *fs;
+	struct gsh_buffdesc fh_desc = *desc;
+	fsal_status_t status;
+	bool dummy;
+
+	*ds_pub = NULL;
+
+	ds = gsh_calloc(1, sizeof(struct vfs_ds));
+	if (ds == NULL)
+		return NFS4ERR_SERVERFAULT;
+
+	status = vfs_check_handle(export_pub, &fh_desc, &fs, &ds->wire,
+				  &dummy);
+	if (FSAL_IS_ERROR(status) || dummy) {
+		gsh_free(ds);
+		return status.major == ERR_FSAL_STALE ? NFS4ERR_STALE
+						      : NFS4ERR_BADHANDLE;
+	}
+
+	ds->export = export_pub;
+	ds->vfs_fs = fs->private;
+	ds->fd = -1;
+
+	fsal_ds_handle_init(&ds->ds, export_pub->ds_ops, export_pub->fsal);
+
+	*ds_pub = &ds->ds;
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Release a DS handle
+ *
+ * @param[in] ds_pub The object to release
+ */
+
+static void
+vfs_ds_release(struct fsal_ds_handle *const ds_pub)
+{
+	struct vfs_ds *ds = container_of(ds_pub, struct vfs_ds, ds);
+
+	if (ds->fd >= 0)
+		close(ds->fd);
+
+	fsal_ds_handle_uninit(&ds->ds);
+
+	gsh_free(ds);
+}
+
+/**
+ * @brief Make sure the DS handle's file is open
+ *
+ * A file opened read-only for a READ or COMMIT is reopened
+ * read-write for a later WRITE in the same compound.
+ *
+ * @param[in] ds        The DS handle
+ * @param[in] openflags O_RDONLY or O_RDWR
+ *
+ * @return An NFSv4.1 status code.
+ */
+
+static nfsstat4
+vfs_ds_open(struct vfs_ds *ds, int openflags)
+{
+	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
+	int fd;
+
+	if (ds->fd >= 0 &&
+	    (ds->openflags == O_RDWR || ds->openflags == openflags))
+		return NFS4_OK;
+
+	/* Opening by handle needs the server's identity, which a write
+	 * may have left released.
+	 */
+	fsal_restore_ganesha_credentials();
+	fd = vfs_open_by_handle(ds->vfs_fs, &ds->wire, openflags, &fsal_error);
+	if (fd < 0)
+		return posix2nfs4_error(-fd);
+
+	if (ds->fd >= 0)
+		close(ds->fd);
+	ds->fd = fd;
+	ds->openflags = openflags;
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Check that the caller may do I/O on the DS handle's file
+ *
+ * The owner may always, as on the MDS.  Reading is also allowed with
+ * only execute permission.
+ *
+ * @param[in] ds          The DS handle, open
+ * @param[in] req_ctx     Credentials
+ * @param[in] access_type FSAL_READ_ACCESS or FSAL_WRITE_ACCESS
+ *
+ * @return An NFSv4.1 status code.
+ */
+
+static nfsstat4
+vfs_ds_access(struct vfs_ds *ds, struct req_op_context *const req_ctx,
+	      fsal_accessflags_t access_type)
+{
+	struct stat st;
+	struct attrlist attrs;
+	fsal_status_t status;
+
+	if (fstat(ds->fd, &st) < 0)
+		return posix2nfs4_error(errno);
+
+	if (st.st_uid == req_ctx->creds->caller_uid)
+		return NFS4_OK;
+
+	memset(&attrs, 0, sizeof(attrs));
+	posix2fsal_attributes(&st, &attrs);
+
+	status = fsal_test_access_attrs(req_ctx->creds, &attrs, access_type);
+	if (FSAL_IS_ERROR(status) && access_type == FSAL_READ_ACCESS)
+		status = fsal_test_access_attrs(req_ctx->creds, &attrs,
+						FSAL_MODE_MASK_SET(FSAL_X_OK) |
+						FSAL_ACE4_MASK_SET
+						(FSAL_ACE_PERM_EXECUTE));
+
+	return FSAL_IS_ERROR(status) ? NFS4ERR_ACCESS : NFS4_OK;
+}
+
+/**
+ * @brief Read from a data-server handle.
+ *
+ * @param[in]  ds_pub           FSAL DS handle
+ * @param[in]  req_ctx          Credentials
+ * @param[in]  stateid          The stateid supplied with the READ operation,
+ *                              for validation
+ * @param[in]  offset           The offset at which to read
+ * @param[in]  requested_length Length of read requested (and size of buffer)
+ * @param[out] buffer           The buffer to which to store read data
+ * @param[out] supplied_length  Length of data read
+ * @param[out] end_of_file      True on end of file
+ *
+ * @return An NFSv4.1 status code.
+ */
+
+static nfsstat4
+vfs_ds_read(struct fsal_ds_handle *const ds_pub,
+	    struct req_op_context *const req_ctx,
+	    const stateid4 *stateid,
+	    const offset4 offset,
+	    const count4 requested_length,
+	    void *const buffer,
+	    count4 *const supplied_length,
+	    bool *const end_of_file)
+{
+	struct vfs_ds *ds = container_of(ds_pub, struct vfs_ds, ds);
+	ssize_t amount_read;
+	nfsstat4 nfs_status;
+
+	nfs_status = vfs_ds_open(ds, O_RDONLY);
+	if (nfs_status != NFS4_OK)
+		return nfs_status;
+
+	nfs_status = vfs_ds_access(ds, req_ctx, FSAL_READ_ACCESS);
+	if (nfs_status != NFS4_OK)
+		return nfs_status;
+
+	amount_read = pread(ds->fd, buffer, requested_length, offset);
+	if (amount_read < 0)
+		return posix2nfs4_error(errno);
+
+	*supplied_length = amount_read;
+	/* A regular file only reads short at its end */
+	*end_of_file = amount_read < requested_length;
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Write to a data-server handle.
+ *
+ * UNSTABLE4 writes are left to a later COMMIT.  Anything stronger is
+ * synced before we reply.  The verifier is the server's, the same
+ * one MDS writes and commits return.
+ *
+ * @param[in]  ds_pub           FSAL DS handle
+ * @param[in]  req_ctx          Credentials
+ * @param[in]  stateid          The stateid supplied with the READ operation,
+ *                              for validation
+ * @param[in]  offset           The offset at which to read
+ * @param[in]  write_length     Length of write requested (and size of buffer)
+ * @param[out] buffer           The buffer to which to store read data
+ * @param[in]  stability wanted Stability of write
+ * @param[out] written_length   Length of data written
+ * @param[out] writeverf        Write verifier
+ * @param[out] stability_got    Stability used for write (must be as
+ *                              or more stable than request)
+ *
+ * @return An NFSv4.1 status code.
+ */
+
+static nfsstat4
+vfs_ds_write(struct fsal_ds_handle *const ds_pub,
+	     struct req_op_context *const req_ctx,
+	     const stateid4 *stateid,
+	     const offset4 offset,
+	     const count4 write_length,
+	     const void *buffer,
+	     const stable_how4 stability_wanted,
+	     count4 *const written_length,
+	     verifier4 *const writeverf,
+	     stable_how4 *const stability_got)
+{
+	struct vfs_ds *ds = container_of(ds_pub, struct vfs_ds, ds);
+	struct gsh_buffdesc key;
+	ssize_t amount_written;
+	nfsstat4 nfs_status;
+	bool as_user;
+	int retval = 0;
+
+	/* The layout doesn't outlive a change to the export's access,
+	 * and a client could send a DS handle without any layout.
+	 */
+	if (!(req_ctx->export_perms->options & EXPORT_OPTION_WRITE_ACCESS))
+		return NFS4ERR_ACCESS;
+
+	nfs_status = vfs_ds_open(ds, O_RDWR);
+	if (nfs_status != NFS4_OK)
+		return nfs_status;
+
+	nfs_status = vfs_ds_access(ds, req_ctx, FSAL_WRITE_ACCESS);
+	if (nfs_status != NFS4_OK)
+		return nfs_status;
+
+	/* As for vfs_write, only charge quota to the caller */
+	as_user = vfs_staticinfo(ds->export->fsal)->write_as_user;
+	if (as_user)
+		fsal_set_credentials(req_ctx->creds);
+
+	amount_written = pwrite(ds->fd, buffer, write_length, offset);
+	if (amount_written < 0)
+		retval = errno;
+	else if (stability_wanted == DATA_SYNC4 &&
+		 fdatasync(ds->fd) < 0)
+		retval = errno;
+	else if (stability_wanted == FILE_SYNC4 &&
+		 fsync(ds->fd) < 0)
+		retval = errno;
+
+	if (as_user)
+		fsal_release_credentials(ds->export);
+
+	if (retval != 0)
+		return posix2nfs4_error(retval);
+
+	/* If this server is the MDS too, its cached attributes are stale */
+	key.addr = ds->wire.handle_data;
+	key.len = ds->wire.handle_len;
+	fsal_invalidate(ds->ds.fsal, &key, CACHE_INODE_INVALIDATE_ATTRS);
+
+	memcpy(writeverf, NFS4_write_verifier, NFS4_VERIFIER_SIZE);
+	*written_length = amount_written;
+	*stability_got = stability_wanted;
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Commit a byte range to a DS handle.
+ *
+ * @param[in]  ds_pub    FSAL DS handle
+ * @param[in]  req_ctx   Credentials
+ * @param[in]  offset    Start of commit window
+ * @param[in]  count     Length of commit window
+ * @param[out] writeverf Write verifier
+ *
+ * @return An NFSv4.1 status code.
+ */
+
+static nfsstat4
+vfs_ds_commit(struct fsal_ds_handle *const ds_pub,
+	      struct req_op_context *const req_ctx,
+	      const offset4 offset,
+	      const count4 count,
+	      verifier4 *const writeverf)
+{
+	struct vfs_ds *ds = container_of(ds_pub, struct vfs_ds, ds);
+	nfsstat4 nfs_status;
+
+	/* Nothing to commit for a client that may not write */
+	if (!(req_ctx->export_perms->options & EXPORT_OPTION_WRITE_ACCESS))
+		return NFS4ERR_ACCESS;
+
+	/* fsync does not need a writable descriptor */
+	nfs_status = vfs_ds_open(ds, O_RDONLY);
+	if (nfs_status != NFS4_OK)
+		return nfs_status;
+
+	if (fsync(ds->fd) < 0)
+		return posix2nfs4_error(errno);
+
+	memcpy(writeverf, NFS4_write_verifier, NFS4_VERIFIER_SIZE);
+
+	return NFS4_OK;
+}
+
+void
+vfs_ds_ops_init(struct fsal_ds_ops *ops)
+{
+	ops->release = vfs_ds_release;
+	ops->read = vfs_ds_read;
+	ops->write = vfs_ds_write;
+	ops->commit = vfs_ds_commit;
+}
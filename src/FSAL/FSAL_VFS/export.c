@@ -55,8 +55,6 @@
 /* helpers to/from other VFS objects
  */
 
-struct fsal_staticfsinfo_t *vfs_staticinfo(struct fsal_module *hdl);
-
 int vfs_get_root_fd(struct fsal_export *exp_hdl)
 {
 	struct vfs_fsal_export *myself;
@@ -127,8 +125,15 @@ static fsal_status_t get_dynamic_info(struct fsal_export *exp_hdl,
 static bool fs_supports(struct fsal_export *exp_hdl,
 			fsal_fsinfo_options_t option)
 {
+	struct vfs_fsal_export *myself;
 	struct fsal_staticfsinfo_t *info;
 
+	/* Each export decides whether it serves pNFS DS I/O */
+	if (option == fso_pnfs_ds_supported) {
+		myself = container_of(exp_hdl, struct vfs_fsal_export, export);
+		return myself->pnfs_file_enabled;
+	}
+
 	info = vfs_staticinfo(exp_hdl->fsal);
 	return fsal_supports(info, option);
 }
@@ -417,6 +422,8 @@ static struct config_item export_params[] = {
 	CONF_ITEM_NOOP("name"),
 	CONF_ITEM_BOOL("pnfs", false,
 		       vfs_fsal_export, pnfs_panfs_enabled),
+	CONF_ITEM_BOOL("pnfs_file", false,
+		       vfs_fsal_export, pnfs_file_enabled),
 	CONF_ITEM_ENUM("fsid_type", -1,
 		       fsid_types,
 		       vfs_fsal_export, fsid_type),
@@ -154,6 +154,7 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 	ssize_t nb_written;
 	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
 	int retval = 0;
+	bool as_user;
 
 	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
 
@@ -169,7 +170,13 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 	assert(myself->u.file.fd >= 0
 	       && myself->u.file.openflags != FSAL_O_CLOSED);
 
-	fsal_set_credentials(op_ctx->creds);
+	/* cache_inode already checked the caller may write; becoming
+	 * the user only matters for quota accounting and for the kernel
+	 * clearing setuid/setgid bits, which write_as_user = false forgoes.
+	 */
+	as_user = vfs_staticinfo(obj_hdl->fsal)->write_as_user;
+	if (as_user)
+		fsal_set_credentials(op_ctx->creds);
 	nb_written = pwrite(myself->u.file.fd, buffer, buffer_size, offset);
 
 	if (offset == -1 || nb_written == -1) {
@@ -191,7 +198,11 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 	}
 
  out:
-	fsal_restore_ganesha_credentials();
+	/* Nothing left here needs the server's identity, so keep the
+	 * caller's for a following write by the same user.
+	 */
+	if (as_user)
+		fsal_release_credentials(op_ctx->fsal_export);
 	return fsalstat(fsal_error, retval);
 }
 
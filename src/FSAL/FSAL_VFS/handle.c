@@ -53,6 +53,10 @@ int vfs_fsal_open(struct vfs_fsal_obj_handle *hdl,
 {
 	struct vfs_filesystem *vfs_fs = hdl->obj_handle.fs->private;
 
+	/* A write may have left the caller's identity installed, see
+	 * fsal_release_credentials(); opening by handle needs ours.
+	 */
+	fsal_restore_ganesha_credentials();
 	return vfs_open_by_handle(vfs_fs, hdl->handle, openflags, fsal_error);
 }
 
@@ -833,6 +837,46 @@ static fsal_status_t linkfile(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(fsal_error, retval);
 }
 
+/**
+ * readdir_handle
+ * make a handle for an entry of the directory being read, from the
+ * open directory.  That costs a fstatat and a name_to_handle_at
+ * where a lookup would also open the directory.  Entries on another
+ * file system are left to lookup.
+ * @param dir [IN] the directory being read
+ * @param dirfd [IN] fd open on it
+ * @param name [IN] name of the entry
+ * @return the handle, NULL if the entry should be looked up
+ */
+
+static struct fsal_obj_handle *readdir_handle(struct vfs_fsal_obj_handle *dir,
+					      int dirfd, const char *name)
+{
+	struct vfs_fsal_obj_handle *hdl;
+	struct stat stat;
+	vfs_file_handle_t *fh = NULL;
+	fsal_dev_t dev;
+
+	vfs_alloc_handle(fh);
+
+	if (fstatat(dirfd, name, &stat, AT_SYMLINK_NOFOLLOW) < 0)
+		return NULL;
+
+	dev = posix2fsal_devt(stat.st_dev);
+	if ((dev.minor != dir->dev.minor) ||
+	    (dev.major != dir->dev.major))
+		return NULL;
+
+	if (vfs_name_to_handle(dirfd, dir->obj_handle.fs, name, fh) < 0)
+		return NULL;
+
+	hdl = alloc_handle(dirfd, fh, dir->obj_handle.fs, &stat, dir->handle,
+			   name, op_ctx->fsal_export);
+	if (hdl == NULL)
+		return NULL;
+	return &hdl->obj_handle;
+}
+
 #define BUF_SIZE 1024
 /**
  * read_dirents
@@ -903,7 +947,10 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 				goto skip;	/* must skip '.' and '..' */
 
 			/* callback to cache inode */
-			if (!cb(dentryp->vd_name, dir_state,
+			if (!cb(dentryp->vd_name,
+				readdir_handle(myself, dirfd,
+					       dentryp->vd_name),
+				dir_state,
 				(fsal_cookie_t) dentryp->vd_offset)) {
 				goto done;
 			}
@@ -43,6 +43,8 @@
 #include "vfs_methods.h"
 #include <os/subr.h>
 #include "pnfs_panfs/mds.h"
+#include "nfs_exports.h"
+#include "export_mgr.h"
 
 int vfs_readlink(struct vfs_fsal_obj_handle *myself,
 		 fsal_errors_t *fsal_error)
@@ -172,6 +174,20 @@ int vfs_init_export_pnfs(struct vfs_fsal_export *myself)
 				"vfs export_ops_pnfs failed => %d [%s]",
 				retval, strerror(retval));
 		}
+	} else if (myself->pnfs_file_enabled) {
+		/* Only exports that ask for it serve DS I/O.  Of those,
+		 * only a server with data servers configured grants file
+		 * layouts.
+		 */
+		LogInfo(COMPONENT_FSAL,
+			"pnfs_file was enabled for [%s], %"PRIu32" data servers",
+			op_ctx->export->fullpath, vfs_pnfs_param.num_ds);
+		myself->export.ops->create_ds_handle = vfs_create_ds_handle;
+		vfs_ds_ops_init(myself->export.ds_ops);
+		if (vfs_pnfs_param.num_ds != 0) {
+			vfs_export_ops_pnfs(myself->export.ops);
+			vfs_handle_ops_pnfs(myself->export.obj_ops);
+		}
 	}
 
 	return retval;
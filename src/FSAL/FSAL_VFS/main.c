@@ -32,6 +32,7 @@
 #include "config.h"
 
 #include "fsal.h"
+#include <assert.h>
 #include <libgen.h>		/* used for 'dirname' */
 #include <pthread.h>
 #include <string.h>
@@ -39,6 +40,7 @@
 #include <sys/types.h>
 #include "ganesha_list.h"
 #include "FSAL/fsal_init.h"
+#include "vfs_methods.h"
 
 /* VFS FSAL module private storage
  */
@@ -60,6 +62,9 @@ struct vfs_fsal_module {
 
 const char myname[] = "VFS";
 
+/* Data servers this server hands out in file layouts */
+struct vfs_pnfs_parameter vfs_pnfs_param;
+
 /* filesystem info for VFS */
 static struct fsal_staticfsinfo_t default_posix_info = {
 	.maxfilesize = UINT64_MAX,
@@ -81,8 +86,90 @@ static struct fsal_staticfsinfo_t default_posix_info = {
 	.supported_attrs = VFS_SUPPORTED_ATTRIBUTES,
 	.maxread = FSAL_MAXIOSIZE,
 	.maxwrite = FSAL_MAXIOSIZE,
+	.write_as_user = true,
+};
+
+static struct config_item ds_params[] = {
+	CONF_ITEM_IPV4_ADDR("DS_Addr", "127.0.0.1",
+			    vfs_pnfs_ds_parameter, ipaddr),
+	CONF_ITEM_INET_PORT("DS_Port", 1, UINT16_MAX, 2049,
+			    vfs_pnfs_ds_parameter, ipport),
+	CONFIG_EOL
 };
 
+static void *dataserver_init(void *link_mem, void *self_struct)
+{
+	struct vfs_pnfs_ds_parameter *ds = self_struct;
+
+	assert(link_mem != NULL || self_struct != NULL);
+
+	if (link_mem == NULL) {
+		struct glist_head *dslist = self_struct;
+
+		glist_init(dslist);
+		return self_struct;
+	} else if (self_struct == NULL) {
+		ds = gsh_calloc(1, sizeof(struct vfs_pnfs_ds_parameter));
+		if (ds != NULL)
+			glist_init(&ds->ds_list);
+		return ds;
+	} else {
+		gsh_free(ds);
+		return NULL;
+	}
+}
+
+static int dataserver_commit(void *node, void *link_mem, void *self_struct,
+			     struct config_error_type *err_type)
+{
+	struct glist_head *ds_head = link_mem;
+	struct vfs_pnfs_ds_parameter *ds = self_struct;
+
+	glist_add_tail(ds_head, &ds->ds_list);
+	return 0;
+}
+
+static struct config_item pnfs_params[] = {
+	CONF_ITEM_UI32("Stripe_Unit", 4096, 1024*1024*1024, 1024*1024,
+		       vfs_pnfs_parameter, stripe_unit),
+	CONF_ITEM_BLOCK("DataServer", ds_params,
+			dataserver_init, dataserver_commit,
+			vfs_pnfs_parameter, ds_list),
+	CONFIG_EOL
+};
+
+/* There is only the one pnfs block, so hand back the static
+ * parameters.  Linkage to the VFS block is a NOP.
+ */
+
+static void *pnfs_init(void *link_mem, void *self_struct)
+{
+	assert(link_mem != NULL || self_struct != NULL);
+
+	if (link_mem == NULL)
+		return self_struct; /* NOP */
+	else if (self_struct == NULL)
+		return &vfs_pnfs_param;
+	else
+		return NULL;
+}
+
+static int pnfs_commit(void *node, void *link_mem, void *self_struct,
+		       struct config_error_type *err_type)
+{
+	struct vfs_pnfs_parameter *param = self_struct;
+
+	if (param->stripe_unit & ~NFL4_UFLG_STRIPE_UNIT_SIZE_MASK) {
+		LogCrit(COMPONENT_CONFIG,
+			"Stripe_Unit (%"PRIu32") must be a multiple of 64",
+			param->stripe_unit);
+		err_type->validate = true;
+		return 1;
+	}
+	param->num_ds = glist_length(&param->ds_list);
+	return 0;
+}
+
 static struct config_item vfs_params[] = {
 	CONF_ITEM_BOOL("link_support", true,
 		       fsal_staticfsinfo_t, link_support),
@@ -100,6 +187,11 @@ static struct config_item vfs_params[] = {
 		       fsal_staticfsinfo_t, auth_exportpath_xdev),
 	CONF_ITEM_MODE("xattr_access_rights", 0, 0777, 0400,
 		       fsal_staticfsinfo_t, xattr_access_rights),
+	CONF_ITEM_BOOL("write_as_user", true,
+		       fsal_staticfsinfo_t, write_as_user),
+	CONF_ITEM_BLOCK("pnfs", pnfs_params,
+			pnfs_init, pnfs_commit,
+			fsal_staticfsinfo_t, pnfs_file),
 	CONFIG_EOL
 };
 
@@ -138,6 +230,8 @@ static fsal_status_t init_config(struct fsal_module *fsal_hdl,
 	struct config_error_type err_type;
 
 	vfs_me->fs_info = default_posix_info;	/* copy the consts */
+	memset(&vfs_pnfs_param, 0, sizeof(vfs_pnfs_param));
+	glist_init(&vfs_pnfs_param.ds_list);
 	(void) load_config_from_parse(config_struct,
 				      &vfs_param,
 				      &vfs_me->fs_info,
@@ -191,6 +285,8 @@ MODULE_INIT void vfs_init(void)
 	}
 	myself->ops->create_export = vfs_create_export;
 	myself->ops->init_config = init_config;
+	myself->ops->getdeviceinfo = vfs_getdeviceinfo;
+	myself->ops->fs_da_addr_size = vfs_fs_da_addr_size;
 }
 
 MODULE_FINI void vfs_unload(void)
@@ -0,0 +1,402 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   mds.c
+ *
+ * @brief pNFS MDS operations for VFS
+ *
+ * VFS has no notion of where data lives, so the layouts are generic:
+ * every file is striped over all the configured data servers, one
+ * Stripe_Unit at a time, with a sparse pattern.  The data servers
+ * are other Ganesha instances exporting the same filesystem with the
+ * same Export_Id, so the DS file handle is simply the VFS handle.
+ */
+
+#include "config.h"
+
+#include <arpa/inet.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "FSAL/fsal_commonlib.h"
+#include "vfs_methods.h"
+
+#include "pnfs_utils.h"
+#include "nfs_exports.h"
+#include "export_mgr.h"
+
+/**
+ * @brief Get layout types supported by export
+ *
+ * @param[in]  export_pub Public export handle
+ * @param[out] count      Number of layout types in array
+ * @param[out] types      Static array of layout types that must not be
+ *                        freed or modified and must not be dereferenced
+ *                        after export reference is relinquished
+ */
+
+static void
+vfs_fs_layouttypes(struct fsal_export *export_pub,
+		   int32_t *count,
+		   const layouttype4 **types)
+{
+	static const layouttype4 supported_layout_type = LAYOUT4_NFSV4_1_FILES;
+
+	*types = &supported_layout_type;
+	*count = 1;
+}
+
+/**
+ * @brief Get layout block size for export
+ *
+ * @param[in] export_pub Public export handle
+ *
+ * @return The configured stripe unit.
+ */
+
+static uint32_t
+vfs_fs_layout_blocksize(struct fsal_export *export_pub)
+{
+	return vfs_pnfs_param.stripe_unit;
+}
+
+/**
+ * @brief Maximum number of segments we will use
+ *
+ * Since current clients only support 1, that's what we'll use.
+ *
+ * @param[in] export_pub Public export handle
+ *
+ * @return 1
+ */
+
+static uint32_t
+vfs_fs_maximum_segments(struct fsal_export *export_pub)
+{
+	return 1;
+}
+
+/**
+ * @brief Size of the buffer needed for a loc_body
+ *
+ * Just a handle plus a bit.
+ *
+ * @param[in] export_pub Public export handle
+ *
+ * @return Size of the buffer needed for a loc_body
+ */
+
+static size_t
+vfs_fs_loc_body_size(struct fsal_export *export_pub)
+{
+	return 0x100;
+}
+
+/**
+ * @brief Size of the buffer needed for a ds_addr
+ *
+ * A stripe index and a single-host multipath list per data server.
+ * An IPv4 netaddr4 fits in 48 bytes.
+ *
+ * @param[in] fsal_hdl FSAL module
+ *
+ * @return Size of the buffer needed for a ds_addr
+ */
+
+size_t vfs_fs_da_addr_size(struct fsal_module *fsal_hdl)
+{
+	return 2 * sizeof(uint32_t) + vfs_pnfs_param.num_ds * 64;
+}
+
+/**
+ * @brief Describe the data servers
+ *
+ * There is one device.  Its stripe indices are just 0 to n - 1, each
+ * naming the data server configured in that position.
+ *
+ * @param[in]  fsal_hdl     FSAL module
+ * @param[out] da_addr_body Stream we write the result to
+ * @param[in]  type         Type of layout that gave the device
+ * @param[in]  deviceid     The device to look up
+ *
+ * @return Valid error codes in RFC 5661, p. 365.
+ */
+
+nfsstat4 vfs_getdeviceinfo(struct fsal_module *fsal_hdl,
+			   XDR *da_addr_body,
+			   const layouttype4 type,
+			   const struct pnfs_deviceid *deviceid)
+{
+	uint32_t num_ds = vfs_pnfs_param.num_ds;
+	uint32_t stripe;
+	struct glist_head *entry;
+	struct vfs_pnfs_ds_parameter *ds;
+	nfsstat4 nfs_status;
+
+	if (type != LAYOUT4_NFSV4_1_FILES) {
+		LogCrit(COMPONENT_PNFS,
+			"Unsupported layout type: %x",
+			type);
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+	}
+
+	if (deviceid->devid != VFS_PNFS_DEVID || num_ds == 0) {
+		LogDebug(COMPONENT_PNFS,
+			 "No such device %"PRIu64, deviceid->devid);
+		return NFS4ERR_NOENT;
+	}
+
+	/* The stripe_indices array */
+	if (!inline_xdr_u_int32_t(da_addr_body, &num_ds)) {
+		LogCrit(COMPONENT_PNFS,
+			"Failed to encode length of stripe_indices array: %"
+			PRIu32 ".", num_ds);
+		return NFS4ERR_SERVERFAULT;
+	}
+
+	for (stripe = 0; stripe < num_ds; stripe++) {
+		if (!inline_xdr_u_int32_t(da_addr_body, &stripe)) {
+			LogCrit(COMPONENT_PNFS,
+				"Failed to encode stripe index %"PRIu32".",
+				stripe);
+			return NFS4ERR_SERVERFAULT;
+		}
+	}
+
+	/* The multipath_ds_list array, one host per entry */
+	if (!inline_xdr_u_int32_t(da_addr_body, &num_ds)) {
+		LogCrit(COMPONENT_PNFS,
+			"Failed to encode length of multipath_ds_list array: %"
+			PRIu32 ".", num_ds);
+		return NFS4ERR_SERVERFAULT;
+	}
+
+	glist_for_each(entry, &vfs_pnfs_param.ds_list) {
+		fsal_multipath_member_t host;
+		struct sockaddr_in *sock;
+
+		ds = glist_entry(entry, struct vfs_pnfs_ds_parameter, ds_list);
+		sock = (struct sockaddr_in *)&ds->ipaddr;
+
+		memset(&host, 0, sizeof(fsal_multipath_member_t));
+		host.proto = IPPROTO_TCP;
+		host.addr = ntohl(sock->sin_addr.s_addr);
+		host.port = ntohs(ds->ipport);
+
+		nfs_status = FSAL_encode_v4_multipath(da_addr_body, 1, &host);
+		if (nfs_status != NFS4_OK)
+			return nfs_status;
+	}
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Get list of available devices
+ *
+ * We do not support listing devices and just set EOF without doing
+ * anything.
+ *
+ * @param[in]     export_pub Export handle
+ * @param[in]     type       Type of layout to get devices for
+ * @param[in]     cb         Function taking device ID halves
+ * @param[in,out] res        In/out and output arguments of the function
+ *
+ * @return Valid error codes in RFC 5661, pp. 365-6.
+ */
+
+static nfsstat4
+vfs_getdevicelist(struct fsal_export *export_pub,
+		  layouttype4 type,
+		  void *opaque,
+		  bool (*cb)(void *opaque,
+			     const uint64_t id),
+		  struct fsal_getdevicelist_res *res)
+{
+	res->eof = true;
+	return NFS4_OK;
+}
+
+void
+vfs_export_ops_pnfs(struct export_ops *ops)
+{
+	ops->getdevicelist = vfs_getdevicelist;
+	ops->fs_layouttypes = vfs_fs_layouttypes;
+	ops->fs_layout_blocksize = vfs_fs_layout_blocksize;
+	ops->fs_maximum_segments = vfs_fs_maximum_segments;
+	ops->fs_loc_body_size = vfs_fs_loc_body_size;
+}
+
+/**
+ * @brief Grant a layout segment.
+ *
+ * Always grant the whole file, whatever range was asked for, since
+ * Linux ignores anything less.  The first stripe index is rotated by
+ * fileid so that small files do not all land on the first data
+ * server.
+ *
+ * @param[in]     obj_hdl  Public object handle
+ * @param[in]     req_ctx  Request context
+ * @param[out]    loc_body An XDR stream to which the FSAL must encode
+ *                         the layout specific portion of the granted
+ *                         layout segment.
+ * @param[in]     arg      Input arguments of the function
+ * @param[in,out] res      In/out and output arguments of the function
+ *
+ * @return Valid error codes in RFC 5661, pp. 366-7.
+ */
+
+static nfsstat4
+vfs_layoutget(struct fsal_obj_handle *obj_hdl,
+	      struct req_op_context *req_ctx,
+	      XDR *loc_body,
+	      const struct fsal_layoutget_arg *arg,
+	      struct fsal_layoutget_res *res)
+{
+	struct vfs_fsal_obj_handle *myself;
+	struct pnfs_deviceid deviceid = DEVICE_ID_INIT_ZERO(FSAL_ID_VFS);
+	struct gsh_buffdesc ds_desc;
+	nfl_util4 util;
+	uint32_t first_idx;
+	nfsstat4 nfs_status;
+
+	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+
+	if (arg->type != LAYOUT4_NFSV4_1_FILES) {
+		LogCrit(COMPONENT_PNFS,
+			"Unsupported layout type: %x",
+			arg->type);
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+	}
+
+	if (obj_hdl->type != REGULAR_FILE || vfs_pnfs_param.num_ds == 0)
+		return NFS4ERR_LAYOUTUNAVAILABLE;
+
+	/* One segment for the whole file, returned on close */
+	res->return_on_close = true;
+	res->last_segment = true;
+	res->segment.offset = 0;
+	res->segment.length = NFS4_UINT64_MAX;
+
+	/* Sparse, committed through the data servers */
+	util = vfs_pnfs_param.stripe_unit;
+	first_idx = obj_hdl->attributes.fileid % vfs_pnfs_param.num_ds;
+	deviceid.devid = VFS_PNFS_DEVID;
+
+	ds_desc.addr = myself->handle->handle_data;
+	ds_desc.len = myself->handle->handle_len;
+
+	LogDebug(COMPONENT_PNFS,
+		 "fileid %"PRIu64" stripe unit %"PRIu32" first index %"PRIu32
+		 " of %"PRIu32,
+		 obj_hdl->attributes.fileid, util, first_idx,
+		 vfs_pnfs_param.num_ds);
+
+	nfs_status = FSAL_encode_file_layout(loc_body,
+					     &deviceid,
+					     util,
+					     first_idx,
+					     0,
+					     req_ctx->export->export_id,
+					     1,
+					     &ds_desc);
+	if (nfs_status != NFS4_OK)
+		LogCrit(COMPONENT_PNFS,
+			"Failed to encode nfsv4_1_file_layout.");
+
+	return nfs_status;
+}
+
+/**
+ * @brief Potentially return one layout segment
+ *
+ * Nothing is reserved when a layout is granted, so there is nothing
+ * to release.
+ *
+ * @param[in] obj_hdl  Public object handle
+ * @param[in] req_ctx  Request context
+ * @param[in] lrf_body Nothing for us
+ * @param[in] arg      Input arguments of the function
+ *
+ * @return Valid error codes in RFC 5661, p. 367.
+ */
+
+static nfsstat4
+vfs_layoutreturn(struct fsal_obj_handle *obj_hdl,
+		 struct req_op_context *req_ctx,
+		 XDR *lrf_body,
+		 const struct fsal_layoutreturn_arg *arg)
+{
+	if (arg->lo_type != LAYOUT4_NFSV4_1_FILES) {
+		LogCrit(COMPONENT_PNFS,
+			"Unsupported layout type: %x",
+			arg->lo_type);
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+	}
+
+	return NFS4_OK;
+}
+
+/**
+ * @brief Commit a segment of a layout
+ *
+ * The data servers wrote straight into the shared filesystem, so the
+ * size is already right there.  Only the cached attributes are out
+ * of date, and nfs4_op_layoutcommit invalidates them.
+ *
+ * @param[in]     obj_hdl  Public object handle
+ * @param[in]     req_ctx  Request context
+ * @param[in]     lou_body An XDR stream containing the layout
+ *                         type-specific portion of the LAYOUTCOMMIT
+ *                         arguments.
+ * @param[in]     arg      Input arguments of the function
+ * @param[in,out] res      In/out and output arguments of the function
+ *
+ * @return Valid error codes in RFC 5661, p. 366.
+ */
+
+static nfsstat4
+vfs_layoutcommit(struct fsal_obj_handle *obj_hdl,
+		 struct req_op_context *req_ctx,
+		 XDR *lou_body,
+		 const struct fsal_layoutcommit_arg *arg,
+		 struct fsal_layoutcommit_res *res)
+{
+	if (arg->type != LAYOUT4_NFSV4_1_FILES) {
+		LogCrit(COMPONENT_PNFS,
+			"Unsupported layout type: %x",
+			arg->type);
+		return NFS4ERR_UNKNOWN_LAYOUTTYPE;
+	}
+
+	res->size_supplied = false;
+	res->commit_done = true;
+
+	return NFS4_OK;
+}
+
+void
+vfs_handle_ops_pnfs(struct fsal_obj_ops *ops)
+{
+	ops->layoutget = vfs_layoutget;
+	ops->layoutreturn = vfs_layoutreturn;
+	ops->layoutcommit = vfs_layoutcommit;
+}
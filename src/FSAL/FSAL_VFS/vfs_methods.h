@@ -40,6 +40,7 @@ struct vfs_filesystem;
 struct vfs_fsal_export {
 	struct fsal_export export;
 	bool pnfs_panfs_enabled;
+	bool pnfs_file_enabled;	/*< Serves DS I/O for file layouts */
 	void *pnfs_data;
 	struct fsal_filesystem *root_fs;
 	struct glist_head filesystems;
@@ -74,6 +75,7 @@ void vfs_unexport_filesystems(struct vfs_fsal_export *exp);
 void vfs_handle_ops_init(struct fsal_obj_ops *ops);
 
 int vfs_get_root_fd(struct fsal_export *exp_hdl);
+struct fsal_staticfsinfo_t *vfs_staticinfo(struct fsal_module *hdl);
 
 /* method proto linkage to handle.c for export
  */
@@ -167,6 +169,55 @@ void vfs_init_export_ops(struct vfs_fsal_export *myself,
 
 int vfs_init_export_pnfs(struct vfs_fsal_export *myself);
 
+/*
+ * pNFS file layouts (VFS only, not XFS)
+ */
+
+/* A data server handed out in file layouts */
+struct vfs_pnfs_ds_parameter {
+	struct glist_head ds_list;
+	struct sockaddr_storage ipaddr;
+	uint16_t ipport;	/* network byte order */
+};
+
+struct vfs_pnfs_parameter {
+	uint32_t stripe_unit;
+	uint32_t num_ds;
+	struct glist_head ds_list;
+};
+
+extern struct vfs_pnfs_parameter vfs_pnfs_param;
+
+/* Only one device: every data server, in configuration order */
+#define VFS_PNFS_DEVID 1
+
+/*
+ * VFS internal DS handle
+ * The wire handle is the file's VFS handle, opened by handle on
+ * first I/O and closed on release.
+ */
+struct vfs_ds {
+	struct fsal_ds_handle ds;	/*< Public DS handle */
+	struct fsal_export *export;	/*< Export the handle arrived on */
+	struct vfs_filesystem *vfs_fs;	/*< Filesystem the file is on */
+	vfs_file_handle_t wire;		/*< Wire data */
+	int fd;				/*< Open file or -1 */
+	int openflags;			/*< Flags fd was opened with */
+};
+
+void vfs_export_ops_pnfs(struct export_ops *ops);
+void vfs_handle_ops_pnfs(struct fsal_obj_ops *ops);
+void vfs_ds_ops_init(struct fsal_ds_ops *ops);
+
+nfsstat4 vfs_create_ds_handle(struct fsal_export *const export_pub,
+			      const struct gsh_buffdesc *const desc,
+			      struct fsal_ds_handle **const ds_pub);
+nfsstat4 vfs_getdeviceinfo(struct fsal_module *fsal_hdl,
+			   XDR *da_addr_body,
+			   const layouttype4 type,
+			   const struct pnfs_deviceid *deviceid);
+size_t vfs_fs_da_addr_size(struct fsal_module *fsal_hdl);
+
 /*
  * VFS structure to tell subfunctions wether they should close the
  * returned fd or not
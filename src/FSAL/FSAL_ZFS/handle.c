@@ -621,6 +621,7 @@ static fsal_status_t tank_readdir(struct fsal_obj_handle *dir_hdl,
 
 			/* callback to cache inode */
 			if (!cb(dirents[index].psz_filename,
+				NULL,
 				dir_state,
 				(fsal_cookie_t) index))
 				goto done;
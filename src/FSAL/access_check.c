@@ -20,6 +20,8 @@
 #include <grp.h>
 #include <sys/types.h>
 #include <os/subr.h>
+#include "nfs4_acls.h"
+#include "city.h"
 
 static bool fsal_check_ace_owner(uid_t uid, struct user_cred *creds)
 {
@@ -298,6 +300,174 @@ static void fsal_print_access_by_acl(int naces, int ace_number,
 	LogFullDebug(COMPONENT_NFS_V4_ACL, "%s", str);
 }
 
+static int fsal_acl_gid_cmp(const void *a, const void *b)
+{
+	gid_t ga = *(const gid_t *)a;
+	gid_t gb = *(const gid_t *)b;
+
+	return ga < gb ? -1 : ga > gb ? 1 : 0;
+}
+
+/**
+ * @brief Mark the compiled ACL's group ids the caller belongs to
+ *
+ * @param[in]  cacl   Compiled ACL
+ * @param[in]  gid    Group id of the caller
+ * @param[out] member Bitmap indexed like cacl->gids
+ */
+static void fsal_acl_member(struct fsal_acl_compiled *cacl, gid_t gid,
+			    uint64_t *member)
+{
+	gid_t *found;
+
+	found = bsearch(&gid, cacl->gids, cacl->ngids, sizeof(gid_t),
+			fsal_acl_gid_cmp);
+	if (found != NULL)
+		member[(found - cacl->gids) / 64] |=
+		    1ULL << ((found - cacl->gids) % 64);
+}
+
+/**
+ * @brief Evaluate a compiled ACL for a caller
+ *
+ * Each permission is decided by the first applicable ACE naming it.
+ *
+ * @param[in] cacl     Compiled ACL
+ * @param[in] creds    Caller credentials
+ * @param[in] is_dir   Object is a directory
+ * @param[in] is_owner Caller owns the object
+ * @param[in] is_group Caller is in the object's group
+ *
+ * @return The permissions first decided by an ALLOW entry.
+ */
+static fsal_aceperm_t fsal_acl_evaluate(struct fsal_acl_compiled *cacl,
+					struct user_cred *creds,
+					bool is_dir, bool is_owner,
+					bool is_group)
+{
+	uint64_t member[FSAL_ACL_COMPILED_MAX_GIDS / 64];
+	struct fsal_acl_cace *cace, *end;
+	fsal_aceperm_t decided = 0, allowed = 0;
+	bool match;
+	int i;
+
+	if (cacl->ngids != 0) {
+		memset(member, 0, sizeof(member));
+		fsal_acl_member(cacl, creds->caller_gid, member);
+		for (i = 0; i < creds->caller_glen; i++)
+			fsal_acl_member(cacl, creds->caller_garray[i], member);
+	}
+
+	cace = cacl->aces[is_dir];
+	end = cace + cacl->naces[is_dir];
+
+	for (; cace < end && decided != cacl->perms[is_dir]; cace++) {
+		switch (cace->who) {
+		case FSAL_ACL_WHO_OWNER:
+			match = is_owner;
+			break;
+		case FSAL_ACL_WHO_GROUP:
+			match = is_group;
+			break;
+		case FSAL_ACL_WHO_EVERYONE:
+			match = true;
+			break;
+		case FSAL_ACL_WHO_UID:
+			match = creds->caller_uid == cace->id;
+			break;
+		default:
+			match = (member[cace->id / 64] &
+				 (1ULL << (cace->id % 64))) != 0;
+			break;
+		}
+
+		if (!match)
+			continue;
+
+		if (cace->allow)
+			allowed |= cace->perm & ~decided;
+		decided |= cace->perm;
+	}
+
+	return allowed;
+}
+
+/**
+ * @brief Check whether an ACL grants a set of permissions
+ *
+ * Looks the caller up in the compiled ACL's recent decisions first,
+ * evaluating and remembering the ACL on a miss.  Only a full grant is
+ * answered here; anything else is left to the ACE walk, which works
+ * out the exact error and denied mask.
+ *
+ * @param[in] pacl     The ACL
+ * @param[in] creds    Caller credentials
+ * @param[in] is_dir   Object is a directory
+ * @param[in] is_owner Caller owns the object
+ * @param[in] is_group Caller is in the object's group
+ * @param[in] wanted   Permissions to check
+ *
+ * @return true if every permission in @c wanted is granted.
+ */
+static bool fsal_acl_grants(fsal_acl_t *pacl, struct user_cred *creds,
+			    bool is_dir, bool is_owner, bool is_group,
+			    fsal_aceperm_t wanted)
+{
+	struct fsal_acl_compiled *cacl;
+	struct fsal_acl_decision *dec;
+	fsal_aceperm_t allowed = 0;
+	uint64_t ghash = 0;
+	uint32_t flags;
+	bool found = false;
+
+	cacl = nfs4_acl_compiled(pacl);
+	if (cacl == NULL)
+		return false;
+
+	flags = FSAL_ACL_DECISION_VALID |
+		(is_dir ? FSAL_ACL_DECISION_DIR : 0) |
+		(is_owner ? FSAL_ACL_DECISION_OWNER : 0) |
+		(is_group ? FSAL_ACL_DECISION_GROUP : 0);
+	if (creds->caller_glen != 0)
+		ghash = CityHash64((char *)creds->caller_garray,
+				   creds->caller_glen * sizeof(gid_t));
+
+	PTHREAD_RWLOCK_rdlock(&cacl->lock);
+	for (dec = cacl->decisions;
+	     dec < cacl->decisions + FSAL_ACL_DECISIONS; dec++) {
+		if (dec->flags == flags && dec->uid == creds->caller_uid &&
+		    dec->gid == creds->caller_gid &&
+		    dec->glen == creds->caller_glen && dec->ghash == ghash) {
+			allowed = dec->allowed;
+			found = true;
+			break;
+		}
+	}
+	PTHREAD_RWLOCK_unlock(&cacl->lock);
+
+	if (!found) {
+		allowed = fsal_acl_evaluate(cacl, creds, is_dir, is_owner,
+					    is_group);
+
+		PTHREAD_RWLOCK_wrlock(&cacl->lock);
+		dec = &cacl->decisions[cacl->next];
+		cacl->next = (cacl->next + 1) % FSAL_ACL_DECISIONS;
+		dec->uid = creds->caller_uid;
+		dec->gid = creds->caller_gid;
+		dec->glen = creds->caller_glen;
+		dec->ghash = ghash;
+		dec->flags = flags;
+		dec->allowed = allowed;
+		PTHREAD_RWLOCK_unlock(&cacl->lock);
+	}
+
+	LogFullDebug(COMPONENT_NFS_V4_ACL,
+		     "compiled ACL %s: allowed 0x%X wanted 0x%X",
+		     found ? "hit" : "miss", allowed, wanted);
+
+	return (wanted & ~allowed) == 0;
+}
+
 /**
  * @brief Check access using v4 ACL list
  *
@@ -413,6 +583,15 @@ static fsal_status_t fsal_check_access_acl(struct user_cred *creds,
 	}
 	/** @TODO@ Even if user is admin, audit/alarm checks should be done. */
 
+	if (!is_root &&
+	    fsal_acl_grants(pacl, creds, is_dir, is_owner, is_group,
+			    missing_access)) {
+		if (allowed != NULL)
+			*allowed |= v4mask & ~FSAL_ACE4_PERM_CONTINUE;
+		LogFullDebug(COMPONENT_NFS_V4_ACL, "access granted");
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+	}
+
 	for (pace = pacl->aces; pace < pacl->aces + pacl->naces; pace++) {
 		ace_number += 1;
 
@@ -679,64 +858,23 @@ fsal_status_t fsal_test_access(struct fsal_obj_handle *obj_hdl,
 	}
 }
 
-uid_t ganesha_uid;
-gid_t ganesha_gid;
-int ganesha_ngroups;
-gid_t *ganesha_groups = NULL;
-
-void fsal_set_credentials(const struct user_cred *creds)
-{
-	if (set_threadgroups(creds->caller_glen, creds->caller_garray) != 0)
-		LogFatal(COMPONENT_FSAL, "Could not set Context credentials");
-	setgroup(creds->caller_gid);
-	setuser(creds->caller_uid);
-}
-
-void fsal_save_ganesha_credentials()
-{
-	int i;
-	char buffer[1024], *p = buffer;
-	ganesha_uid = setuser(0);
-	setuser(ganesha_uid);
-	ganesha_gid = setgroup(0);
-	setgroup(ganesha_gid);
-	ganesha_ngroups = getgroups(0, NULL);
-	if (ganesha_ngroups > 0) {
-		ganesha_groups = gsh_malloc(ganesha_ngroups * sizeof(gid_t));
-		if (ganesha_groups == NULL) {
-			LogFatal(COMPONENT_FSAL,
-				 "Could not allocate memory for Ganesha group list");
-		}
-		if (getgroups(ganesha_ngroups, ganesha_groups) !=
-		    ganesha_ngroups) {
-			LogFatal(COMPONENT_FSAL,
-				 "Could not get list of ganesha groups");
-		}
-	}
-
-	p += sprintf(p, "Ganesha uid=%d gid=%d ngroups=%d", (int)ganesha_uid,
-		     (int)ganesha_gid, ganesha_ngroups);
-	if (ganesha_ngroups != 0)
-		p += sprintf(p, " (");
-	for (i = 0; i < ganesha_ngroups; i++) {
-		if ((p - buffer) < (sizeof(buffer) - 10)) {
-			if (i == 0)
-				p += sprintf(p, "%d", (int)ganesha_groups[i]);
-			else
-				p += sprintf(p, " %d", (int)ganesha_groups[i]);
-		}
-	}
-	if (ganesha_ngroups != 0)
-		p += sprintf(p, ")");
-	LogInfo(COMPONENT_FSAL, "%s", buffer);
-}
+/* test_access_attrs
+ * the same check as fsal_test_access, from attributes and credentials
+ * rather than an object handle and the op context.
+ */
 
-void fsal_restore_ganesha_credentials()
+fsal_status_t fsal_test_access_attrs(struct user_cred *creds,
+				     struct attrlist *attribs,
+				     fsal_accessflags_t access_type)
 {
-	setuser(ganesha_uid);
-	setgroup(ganesha_gid);
-	if (set_threadgroups(ganesha_ngroups, ganesha_groups) != 0)
-		LogFatal(COMPONENT_FSAL, "Could not set Ganesha credentials");
+	if (attribs->acl && IS_FSAL_ACE4_MASK_VALID(access_type))
+		return fsal_check_access_acl(creds,
+					     FSAL_ACE4_MASK(access_type),
+					     NULL, NULL, attribs);
+	else
+		return fsal_check_access_no_acl(creds,
+						FSAL_MODE_MASK(access_type),
+						NULL, NULL, attribs);
 }
 
 /** @} */
@@ -63,6 +63,8 @@
 #include "FSAL/fsal_commonlib.h"
 #include "fsal_private.h"
 #include "fsal_convert.h"
+#include "nfs_core.h"
+#include "export_mgr.h"
 
 /* fsal_module to fsal_export helpers
  */
@@ -77,7 +79,9 @@ int fsal_attach_export(struct fsal_module *fsal_hdl,
 	int retval = 0;
 
 	if (atomic_fetch_int32_t(&fsal_hdl->refcount) > 0) {
+		PTHREAD_RWLOCK_wrlock(&fsal_hdl->lock);
 		glist_add(&fsal_hdl->exports, obj_link);
+		PTHREAD_RWLOCK_unlock(&fsal_hdl->lock);
 	} else {
 		LogCrit(COMPONENT_CONFIG,
 			"Attaching export with out holding a reference!. hdl= = 0x%p",
@@ -93,12 +97,17 @@ int fsal_attach_export(struct fsal_module *fsal_hdl,
  * kept the fsal "busy".
  */
 
+static void forget_pending_export(struct fsal_export *exp);
+
 void fsal_detach_export(struct fsal_module *fsal_hdl,
 			struct glist_head *obj_link)
 {
 	PTHREAD_RWLOCK_wrlock(&fsal_hdl->lock);
 	glist_del(obj_link);
 	PTHREAD_RWLOCK_unlock(&fsal_hdl->lock);
+
+	forget_pending_export(container_of(obj_link, struct fsal_export,
+					   exports));
 }
 
 /* fsal_export to fsal_obj_handle helpers
@@ -393,6 +402,8 @@ void display_fsinfo(struct fsal_staticfsinfo_t *info)
 		 info->share_support_owner);
 	LogDebug(COMPONENT_FSAL, "  delegations = %d  ",
 		 info->delegations);
+	LogDebug(COMPONENT_FSAL, "  write_as_user = %d  ",
+		 info->write_as_user);
 	LogDebug(COMPONENT_FSAL, "  pnfs_file = %d  ",
 		 info->pnfs_file);
 	LogDebug(COMPONENT_FSAL, "  fsal_trace = %d  ",
@@ -844,6 +855,7 @@ static bool posix_get_fsid(struct fsal_filesystem *fs)
 #ifdef USE_BLKID
 	char *dev_name = NULL, *uuid_str;
 	static struct blkid_struct_cache *cache;
+	static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 	struct blkid_struct_dev *dev;
 #endif
 
@@ -876,6 +888,11 @@ static bool posix_get_fsid(struct fsal_filesystem *fs)
 		goto no_uuid_no_dev_name;
 	}
 
+	/* The file systems are probed in parallel, the blkid cache
+	 * is not thread safe.
+	 */
+	PTHREAD_MUTEX_lock(&cache_mutex);
+
 	if (cache == NULL && blkid_get_cache(&cache, NULL) != 0) {
 		LogInfo(COMPONENT_FSAL,
 			"blkid_get_cache of %s failed",
@@ -911,12 +928,14 @@ static bool posix_get_fsid(struct fsal_filesystem *fs)
 	}
 
 	fs->fsid_type = FSID_TWO_UINT64;
+	PTHREAD_MUTEX_unlock(&cache_mutex);
 	free(dev_name);
 
 	return true;
 
  no_uuid:
 
+	PTHREAD_MUTEX_unlock(&cache_mutex);
 	free(dev_name);
 
  no_uuid_no_dev_name:
@@ -935,17 +954,16 @@ static bool posix_get_fsid(struct fsal_filesystem *fs)
 	return true;
 }
 
-static void posix_create_file_system(struct mntent *mnt)
+static struct fsal_filesystem *posix_new_file_system(struct mntent *mnt)
 {
 	struct fsal_filesystem *fs;
-	struct avltree_node *node;
 
 	if (strncasecmp(mnt->mnt_type, "nfs", 3) == 0) {
 		LogDebug(COMPONENT_FSAL,
 			 "Ignoring %s because type %s",
 			 mnt->mnt_dir,
 			 mnt->mnt_type);
-		return;
+		return NULL;
 	}
 
 	fs = gsh_calloc(1, sizeof(*fs));
@@ -966,12 +984,72 @@ static void posix_create_file_system(struct mntent *mnt)
 			 mnt->mnt_dir);
 	}
 
-	if (!posix_get_fsid(fs)) {
-		free_fs(fs);
-		return;
+	fs->pathlen = strlen(mnt->mnt_dir);
+
+	return fs;
+}
+
+/**
+ * @brief File systems of the mount table being probed
+ */
+
+struct posix_probe_work {
+	struct fsal_filesystem **fs;	/*< In mount table order */
+	bool *valid;			/*< posix_get_fsid succeeded */
+	uint32_t count;
+	uint32_t next;			/*< Next one to probe */
+};
+
+static void *posix_probe_thread(void *arg)
+{
+	struct posix_probe_work *work = arg;
+	uint32_t i;
+
+	while ((i = atomic_postinc_uint32_t(&work->next)) < work->count)
+		work->valid[i] = posix_get_fsid(work->fs[i]);
+
+	return NULL;
+}
+
+/**
+ * @brief Probe the file systems of the mount table
+ *
+ * statfs, stat and blkid may each block on a slow device, so with
+ * many mounts they are run from up to Export_Init_Threads threads.
+ * The results are then indexed in mount table order by the caller.
+ */
+
+static void posix_probe_file_systems(struct posix_probe_work *work)
+{
+	int nthreads = nfs_param.core_param.export_init_threads;
+	pthread_t *threads = NULL;
+	int i, started = 0;
+
+	if (nthreads > (int)work->count)
+		nthreads = work->count;
+	if (nthreads > 1)
+		threads = gsh_calloc(nthreads - 1, sizeof(pthread_t));
+
+	for (i = 0; threads != NULL && i < nthreads - 1; i++) {
+		if (pthread_create(&threads[i], NULL,
+				   posix_probe_thread, work) != 0)
+			break;
+		started++;
 	}
 
-	fs->pathlen = strlen(mnt->mnt_dir);
+	/* Take a share of the work ourselves */
+	(void) posix_probe_thread(work);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	if (threads != NULL)
+		gsh_free(threads);
+}
+
+static void posix_add_file_system(struct fsal_filesystem *fs)
+{
+	struct avltree_node *node;
 
 	node = avltree_insert(&fs->avl_fsid, &avl_fsid);
 
@@ -1128,6 +1206,10 @@ int populate_posix_file_systems(void)
 	int retval = 0;
 	struct glist_head *glist;
 	struct fsal_filesystem *fs;
+	struct posix_probe_work work;
+	uint32_t i, size = 0;
+
+	memset(&work, 0, sizeof(work));
 
 	PTHREAD_RWLOCK_wrlock(&fs_lock);
 
@@ -1151,11 +1233,49 @@ int populate_posix_file_systems(void)
 		if (mnt->mnt_dir == NULL)
 			continue;
 
-		posix_create_file_system(mnt);
+		fs = posix_new_file_system(mnt);
+		if (fs == NULL)
+			continue;
+
+		if (work.count == size) {
+			size = size == 0 ? 64 : size * 2;
+			work.fs = gsh_realloc(work.fs, size * sizeof(fs));
+			if (work.fs == NULL) {
+				LogFatal(COMPONENT_FSAL,
+					 "mem alloc for %s failed",
+					 mnt->mnt_dir);
+			}
+		}
+		work.fs[work.count++] = fs;
 	}
 
 	endmntent(fp);
 
+	if (work.count != 0) {
+		work.valid = gsh_calloc(work.count, sizeof(bool));
+		if (work.valid == NULL) {
+			LogFatal(COMPONENT_FSAL,
+				 "mem alloc for %u file systems failed",
+				 work.count);
+		}
+		posix_probe_file_systems(&work);
+	}
+
+	/* Index them in mount table order, so duplicates resolve as
+	 * they always did.
+	 */
+	for (i = 0; i < work.count; i++) {
+		if (work.valid[i])
+			posix_add_file_system(work.fs[i]);
+		else
+			free_fs(work.fs[i]);
+	}
+
+	if (work.fs != NULL)
+		gsh_free(work.fs);
+	if (work.valid != NULL)
+		gsh_free(work.valid);
+
 	/* build tree of POSIX file systems */
 	glist_for_each(glist, &posix_file_systems) {
 		posix_find_parent(glist_entry(glist,
@@ -1217,32 +1337,160 @@ struct fsal_filesystem *lookup_dev_locked(struct fsal_dev__ *dev)
 	return avltree_inline_dev_lookup(&key.avl_dev);
 }
 
+int process_claim(const char *path,
+		  int pathlen,
+		  struct fsal_filesystem *this,
+		  struct fsal_module *fsal,
+		  struct fsal_export *exp,
+		  claim_filesystem_cb claim,
+		  unclaim_filesystem_cb unclaim);
+
+/**
+ * @brief Whether a file system waits to be claimed by the current export
+ *
+ * The export that deferred the claim may always complete it.  Another
+ * export of the same FSAL may only if its tree holds the mount point,
+ * so it reached the file system through a parent it exports.
+ *
+ * Called with fs_lock held.
+ */
+static bool claim_is_pending(struct fsal_filesystem *fs)
+{
+	const char *path;
+	int pathlen;
+
+	if (fs == NULL || fs->fsal != NULL || fs->pending_fsal == NULL ||
+	    op_ctx == NULL || op_ctx->fsal_export == NULL ||
+	    op_ctx->fsal_export->fsal != fs->pending_fsal)
+		return false;
+
+	if (op_ctx->fsal_export == fs->pending_export)
+		return true;
+
+	if (op_ctx->export == NULL || fs->parent == NULL ||
+	    fs->parent->fsal != fs->pending_fsal)
+		return false;
+
+	path = op_ctx->export->fullpath;
+	pathlen = strlen(path);
+
+	if (pathlen == 1 && path[0] == '/')
+		return true;
+
+	return fs->pathlen > pathlen &&
+	       strncmp(fs->path, path, pathlen) == 0 &&
+	       fs->path[pathlen] == '/';
+}
+
+/**
+ * @brief Claim a sub-mounted file system on its first use
+ *
+ * Called without fs_lock.  The file system is claimed for the export
+ * of the current operation, which reached it through its parent.
+ * File systems are only freed at shutdown, so it stays valid across
+ * the relock.
+ */
+static void claim_pending_fs(struct fsal_filesystem *fs)
+{
+	PTHREAD_RWLOCK_wrlock(&fs_lock);
+
+	if (claim_is_pending(fs)) {
+		(void) process_claim(NULL, 0, fs, fs->pending_fsal,
+				     op_ctx->fsal_export, fs->pending_claim,
+				     fs->pending_unclaim);
+
+		/* Don't retry a file system the FSAL can't export */
+		if (fs->fsal == NULL) {
+			fs->pending_fsal = NULL;
+			fs->pending_export = NULL;
+			fs->pending_claim = NULL;
+			fs->pending_unclaim = NULL;
+		}
+	}
+
+	PTHREAD_RWLOCK_unlock(&fs_lock);
+}
+
 struct fsal_filesystem *lookup_fsid(struct fsal_fsid__ *fsid,
 				    enum fsid_type fsid_type)
 {
 	struct fsal_filesystem *fs;
+	bool pending;
 
 	PTHREAD_RWLOCK_rdlock(&fs_lock);
 
 	fs = lookup_fsid_locked(fsid, fsid_type);
+	pending = claim_is_pending(fs);
 
 	PTHREAD_RWLOCK_unlock(&fs_lock);
+
+	if (pending)
+		claim_pending_fs(fs);
+
 	return fs;
 }
 
 struct fsal_filesystem *lookup_dev(struct fsal_dev__ *dev)
 {
 	struct fsal_filesystem *fs;
+	bool pending;
 
 	PTHREAD_RWLOCK_rdlock(&fs_lock);
 
 	fs = lookup_dev_locked(dev);
+	pending = claim_is_pending(fs);
 
 	PTHREAD_RWLOCK_unlock(&fs_lock);
 
+	if (pending)
+		claim_pending_fs(fs);
+
 	return fs;
 }
 
+/**
+ * @brief Forget the pending claims below an unclaimed file system
+ *
+ * Nothing exported reaches them any more.
+ */
+static void drop_pending_claims(struct fsal_filesystem *this)
+{
+	struct glist_head *glist;
+	struct fsal_filesystem *fs;
+
+	glist_for_each(glist, &this->children) {
+		fs = glist_entry(glist, struct fsal_filesystem, siblings);
+		if (fs->fsal != NULL || fs->pending_fsal == NULL)
+			continue;
+		fs->pending_fsal = NULL;
+		fs->pending_export = NULL;
+		fs->pending_claim = NULL;
+		fs->pending_unclaim = NULL;
+		drop_pending_claims(fs);
+	}
+}
+
+/**
+ * @brief Stop recognizing a released export as a deferred claimer
+ *
+ * The claims stay pending for other exports that cover them.
+ */
+static void forget_pending_export(struct fsal_export *exp)
+{
+	struct glist_head *glist;
+	struct fsal_filesystem *fs;
+
+	PTHREAD_RWLOCK_wrlock(&fs_lock);
+
+	glist_for_each(glist, &posix_file_systems) {
+		fs = glist_entry(glist, struct fsal_filesystem, filesystems);
+		if (fs->pending_export == exp)
+			fs->pending_export = NULL;
+	}
+
+	PTHREAD_RWLOCK_unlock(&fs_lock);
+}
+
 void unclaim_fs(struct fsal_filesystem *this)
 {
 	/* One call to unclaim resolves all claims to the filesystem */
@@ -1256,6 +1504,8 @@ void unclaim_fs(struct fsal_filesystem *this)
 	this->fsal = NULL;
 	this->unclaim = NULL;
 	this->exported = false;
+
+	drop_pending_claims(this);
 }
 
 int process_claim(const char *path,
@@ -1348,6 +1598,21 @@ int process_claim(const char *path,
 		if (fs->exported)
 			continue;
 
+		/* A child nobody claimed yet is claimed the first time a
+		 * handle or lookup of ours reaches it, so exporting a tree
+		 * with many mounts doesn't open every one of them.
+		 */
+		if (fs->fsal == NULL) {
+			LogDebug(COMPONENT_FSAL,
+				 "FSAL %s will claim %s on first use",
+				 fsal->name, fs->path);
+			fs->pending_fsal = fsal;
+			fs->pending_export = exp;
+			fs->pending_claim = claim;
+			fs->pending_unclaim = unclaim;
+			continue;
+		}
+
 		/* Try to claim this child */
 		retval = process_claim(NULL, 0, fs, fsal,
 				       exp, claim, unclaim);
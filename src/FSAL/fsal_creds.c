@@ -0,0 +1,303 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup FSAL
+ * @{
+ */
+
+/**
+ * @file fsal_creds.c
+ * @brief Switching the filesystem identity of worker threads
+ *
+ * Kept apart from the access checks so src/test/test_creds_switch.c
+ * can link it on its own.
+ */
+
+#include "config.h"
+
+#include "fsal.h"
+#include "FSAL/access_check.h"
+#include <stdbool.h>
+#include <unistd.h>
+#include <grp.h>
+#include <sys/types.h>
+#include <os/subr.h>
+#include "server_stats.h"
+
+uid_t ganesha_uid;
+gid_t ganesha_gid;
+int ganesha_ngroups;
+gid_t *ganesha_groups = NULL;
+
+/**
+ * @brief Identity last installed on this thread
+ *
+ * Worker threads commonly serve the same user for many consecutive
+ * operations, so remember what the last switch installed and only issue
+ * the syscalls for components that actually change.  Group lists longer
+ * than FSAL_CACHED_GROUPS are always installed.
+ *
+ * A write released with fsal_release_credentials() leaves the caller's
+ * identity installed for the next write through the same export; any
+ * other operation gets the server's identity back from
+ * fsal_operation_credentials() before it starts.
+ */
+#define FSAL_CACHED_GROUPS 32
+
+struct fsal_thread_creds {
+	bool uid_valid;		/*< uid is installed */
+	bool gid_valid;		/*< gid is installed */
+	bool groups_valid;	/*< groups is installed */
+	bool borrowed;		/*< a caller's identity is installed */
+	const struct fsal_export *kept_for; /*< export it is kept for */
+	uid_t uid;
+	gid_t gid;
+	int ngroups;
+	gid_t groups[FSAL_CACHED_GROUPS];
+};
+
+static __thread struct fsal_thread_creds thread_creds;
+
+/**
+ * @brief Install a filesystem user id unless already installed
+ *
+ * @param[in] uid User id to install
+ *
+ * @return Number of syscalls issued.
+ */
+static int fsal_switch_user(uid_t uid)
+{
+	struct fsal_thread_creds *tc = &thread_creds;
+
+	if (tc->uid_valid && tc->uid == uid)
+		return 0;
+
+	/* A privileged server can trust setfsuid to succeed, so a known
+	 * previous id saves the read back.
+	 */
+	if (tc->uid_valid && ganesha_uid == 0) {
+		tc->uid_valid = setuser_fast(uid, tc->uid);
+		tc->uid = uid;
+		if (tc->uid_valid)
+			return 1;
+		LogDebug(COMPONENT_FSAL,
+			 "Thread credential cache out of sync (uid)");
+	}
+
+	(void)setuser(uid);
+	tc->uid = uid;
+	tc->uid_valid = true;
+	return 2;
+}
+
+/**
+ * @brief Install a filesystem group id unless already installed
+ *
+ * @param[in] gid Group id to install
+ *
+ * @return Number of syscalls issued.
+ */
+static int fsal_switch_group(gid_t gid)
+{
+	struct fsal_thread_creds *tc = &thread_creds;
+
+	if (tc->gid_valid && tc->gid == gid)
+		return 0;
+
+	if (tc->gid_valid && ganesha_uid == 0) {
+		tc->gid_valid = setgroup_fast(gid, tc->gid);
+		tc->gid = gid;
+		if (tc->gid_valid)
+			return 1;
+		LogDebug(COMPONENT_FSAL,
+			 "Thread credential cache out of sync (gid)");
+	}
+
+	(void)setgroup(gid);
+	tc->gid = gid;
+	tc->gid_valid = true;
+	return 2;
+}
+
+/**
+ * @brief Install a supplementary group list unless already installed
+ *
+ * @param[in] ngroups Number of groups
+ * @param[in] groups  Group list
+ *
+ * @return Number of syscalls issued, -1 on failure.
+ */
+static int fsal_switch_groups(int ngroups, const gid_t *groups)
+{
+	struct fsal_thread_creds *tc = &thread_creds;
+
+	if (tc->groups_valid && tc->ngroups == ngroups &&
+	    (ngroups == 0 ||
+	     memcmp(tc->groups, groups, ngroups * sizeof(gid_t)) == 0))
+		return 0;
+
+	if (set_threadgroups(ngroups, groups) != 0) {
+		tc->groups_valid = false;
+		return -1;
+	}
+
+	tc->groups_valid = ngroups <= FSAL_CACHED_GROUPS;
+	if (tc->groups_valid) {
+		tc->ngroups = ngroups;
+		if (ngroups != 0)
+			memcpy(tc->groups, groups, ngroups * sizeof(gid_t));
+	}
+	return 1;
+}
+
+void fsal_set_credentials(const struct user_cred *creds)
+{
+	struct fsal_thread_creds *tc = &thread_creds;
+	int syscalls;
+
+	syscalls = fsal_switch_groups(creds->caller_glen,
+				      creds->caller_garray);
+	if (syscalls < 0)
+		LogFatal(COMPONENT_FSAL, "Could not set Context credentials");
+	syscalls += fsal_switch_group(creds->caller_gid);
+	syscalls += fsal_switch_user(creds->caller_uid);
+
+	tc->borrowed = true;
+	tc->kept_for = NULL;
+
+	server_stats_creds_switch(false, syscalls);
+}
+
+void fsal_save_ganesha_credentials()
+{
+	int i;
+	char buffer[1024], *p = buffer;
+	ganesha_uid = setuser(0);
+	setuser(ganesha_uid);
+	ganesha_gid = setgroup(0);
+	setgroup(ganesha_gid);
+	ganesha_ngroups = getgroups(0, NULL);
+	if (ganesha_ngroups > 0) {
+		ganesha_groups = gsh_malloc(ganesha_ngroups * sizeof(gid_t));
+		if (ganesha_groups == NULL) {
+			LogFatal(COMPONENT_FSAL,
+				 "Could not allocate memory for Ganesha group list");
+		}
+		if (getgroups(ganesha_ngroups, ganesha_groups) !=
+		    ganesha_ngroups) {
+			LogFatal(COMPONENT_FSAL,
+				 "Could not get list of ganesha groups");
+		}
+	}
+
+	p += sprintf(p, "Ganesha uid=%d gid=%d ngroups=%d", (int)ganesha_uid,
+		     (int)ganesha_gid, ganesha_ngroups);
+	if (ganesha_ngroups != 0)
+		p += sprintf(p, " (");
+	for (i = 0; i < ganesha_ngroups; i++) {
+		if ((p - buffer) < (sizeof(buffer) - 10)) {
+			if (i == 0)
+				p += sprintf(p, "%d", (int)ganesha_groups[i]);
+			else
+				p += sprintf(p, " %d", (int)ganesha_groups[i]);
+		}
+	}
+	if (ganesha_ngroups != 0)
+		p += sprintf(p, ")");
+	LogInfo(COMPONENT_FSAL, "%s", buffer);
+}
+
+void fsal_restore_ganesha_credentials()
+{
+	struct fsal_thread_creds *tc = &thread_creds;
+	int syscalls, rc;
+
+	if (!tc->borrowed)
+		return;
+
+	syscalls = fsal_switch_user(ganesha_uid);
+	syscalls += fsal_switch_group(ganesha_gid);
+
+	/* With fsuid 0 the supplementary groups never decide an access
+	 * check, so a root server leaves the caller's list installed for
+	 * the next switch, which is likely on behalf of the same user.
+	 */
+	if (ganesha_uid != 0) {
+		rc = fsal_switch_groups(ganesha_ngroups, ganesha_groups);
+		if (rc < 0)
+			LogFatal(COMPONENT_FSAL,
+				 "Could not set Ganesha credentials");
+		syscalls += rc;
+	}
+
+	tc->borrowed = false;
+	tc->kept_for = NULL;
+
+	server_stats_creds_switch(true, syscalls);
+}
+
+/**
+ * @brief Finish a write done as the caller without switching back
+ *
+ * The caller's identity stays installed, so a following write by the
+ * same user through @a exp issues no syscalls at all.  Only use this
+ * where nothing after it in the operation needs the server's identity.
+ *
+ * @param[in] exp Export the write went through
+ */
+
+void fsal_release_credentials(const struct fsal_export *exp)
+{
+	struct fsal_thread_creds *tc = &thread_creds;
+
+	if (exp == NULL) {
+		fsal_restore_ganesha_credentials();
+		return;
+	}
+
+	if (tc->borrowed)
+		tc->kept_for = exp;
+}
+
+/**
+ * @brief Install the identity an operation expects to start with
+ *
+ * Called by the protocol layers before each operation.  A caller's
+ * identity left by fsal_release_credentials() is only kept for a write
+ * through the same export; everything else runs as the server.
+ *
+ * @param[in] exp   Export the operation works on, may be NULL
+ * @param[in] write Whether the operation is a write
+ */
+
+void fsal_operation_credentials(const struct fsal_export *exp, bool write)
+{
+	struct fsal_thread_creds *tc = &thread_creds;
+
+	if (!tc->borrowed)
+		return;
+
+	if (!write || exp == NULL || exp != tc->kept_for)
+		fsal_restore_ganesha_credentials();
+}
+
+/** @} */
@@ -48,6 +48,9 @@
  * returns it after execution.
  *
  * Every async call returns 0 on success and a POSIX error code on error.
+ *
+ * Invalidates and updates without a callback go through the
+ * coalescing queue in fsal_up_queue.c instead, when it is enabled.
  */
 
 #include "config.h"
@@ -99,6 +102,9 @@ int up_async_invalidate(struct fridgethr *fr,
 	struct invalidate_args *args = NULL;
 	int rc = 0;
 
+	if (cb == NULL && up_queue_enabled())
+		return up_queue_event(fr, up_ops, fsal, obj, flags, NULL, 0);
+
 	args = gsh_malloc(sizeof(struct invalidate_args) + obj->len);
 	if (!args) {
 		rc = ENOMEM;
@@ -160,6 +166,9 @@ int up_async_update(struct fridgethr *fr,
 	struct update_args *args = NULL;
 	int rc = 0;
 
+	if (cb == NULL && up_queue_enabled())
+		return up_queue_event(fr, up_ops, fsal, obj, 0, attr, flags);
+
 	args = gsh_malloc(sizeof(struct update_args) + obj->len);
 	if (!args) {
 		rc = ENOMEM;
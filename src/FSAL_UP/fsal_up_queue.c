@@ -0,0 +1,455 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup fsal_up
+ * @{
+ */
+
+/**
+ * @file fsal_up_queue.c
+ * @brief Coalescing queue for invalidate and update upcalls
+ *
+ * An FSAL that reports every change it sees can send the same inode
+ * thousands of times a second.  Asynchronous invalidates and updates
+ * with no callback are therefore held here instead of each taking a
+ * thread fridge slot.  An event for an object that already has one
+ * pending is folded into it: invalidate flags are or-ed, attribute
+ * updates merged field by field.
+ *
+ * Pending events are spread over lanes by the cache partition their
+ * key hashes to, and a lane is drained by one fridge job at a time,
+ * in batches sorted by partition.  When a lane holds its share of
+ * Upcall_Queue_Depth, the FSAL thread adding a new object waits for
+ * it to drain a little.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "log.h"
+#include "fsal.h"
+#include "cache_inode.h"
+#include "cache_inode_hash.h"
+#include "fsal_up.h"
+#include "abstract_atomic.h"
+#include "common_utils.h"
+
+/* Lanes of pending events */
+#define UP_QUEUE_LANES 16
+
+/* Hash chains per lane */
+#define UP_QUEUE_BUCKETS 1021
+
+/* Most events handled by one pass of a drain job */
+#define UP_QUEUE_BATCH 64
+
+/* Longest an FSAL thread is held back, in seconds */
+#define UP_QUEUE_WAIT 1
+
+/**
+ * @brief A pending event for one object
+ */
+
+struct up_event {
+	struct glist_head q;		/*< In the lane's queue */
+	struct up_event *next;		/*< In the hash chain */
+	uint64_t hk;			/*< Hash of the key */
+	const struct fsal_up_vector *up_ops;
+	struct fsal_module *fsal;
+	struct gsh_buffdesc obj;
+	uint32_t inval_flags;		/*< Invalidation, 0 for none */
+	bool update;			/*< attr is to be applied */
+	struct attrlist attr;
+	uint32_t update_flags;
+	struct timespec queued;		/*< First event folded in */
+	char key[];
+};
+
+struct up_lane {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;		/*< Signalled as the lane drains */
+	struct glist_head queue;
+	struct up_event *buckets[UP_QUEUE_BUCKETS];
+	uint32_t depth;
+	bool scheduled;			/*< A drain job is queued or running */
+};
+
+static struct up_lane *up_lanes;
+static uint32_t up_lane_max;
+
+static struct up_queue_stats up_queue_st;
+
+/**
+ * @brief Set up the upcall queue
+ *
+ * FSALs may already send upcalls for exports created earlier, so the
+ * lanes are only published once they are ready.
+ *
+ * @return 0 or an errno.
+ */
+
+int up_queue_pkginit(void)
+{
+	struct up_lane *lanes;
+	int i;
+
+	if (!cache_param.upcall_coalesce)
+		return 0;
+
+	lanes = gsh_calloc(UP_QUEUE_LANES, sizeof(struct up_lane));
+	if (lanes == NULL)
+		return ENOMEM;
+
+	for (i = 0; i < UP_QUEUE_LANES; i++) {
+		pthread_mutex_init(&lanes[i].mtx, NULL);
+		pthread_cond_init(&lanes[i].cv, NULL);
+		glist_init(&lanes[i].queue);
+	}
+
+	up_lane_max = cache_param.upcall_queue_depth / UP_QUEUE_LANES;
+	if (up_lane_max == 0)
+		up_lane_max = 1;
+
+	atomic_store_voidptr((void **)&up_lanes, lanes);
+
+	return 0;
+}
+
+/**
+ * @brief Whether async upcalls without callback are coalesced
+ */
+
+bool up_queue_enabled(void)
+{
+	return atomic_fetch_voidptr((void **)&up_lanes) != NULL;
+}
+
+static inline uint32_t up_partition(uint64_t hk)
+{
+	return cih_fhcache.npart != 0 ? hk % cih_fhcache.npart : 0;
+}
+
+static struct up_event *up_find(struct up_lane *lane, uint64_t hk,
+				const struct fsal_up_vector *up_ops,
+				struct fsal_module *fsal,
+				struct gsh_buffdesc *obj)
+{
+	struct up_event *ev;
+
+	for (ev = lane->buckets[hk % UP_QUEUE_BUCKETS]; ev; ev = ev->next)
+		if (ev->hk == hk && ev->up_ops == up_ops &&
+		    ev->fsal == fsal && ev->obj.len == obj->len &&
+		    memcmp(ev->key, obj->addr, obj->len) == 0)
+			return ev;
+
+	return NULL;
+}
+
+static void up_unhash(struct up_lane *lane, struct up_event *ev)
+{
+	struct up_event **pp = &lane->buckets[ev->hk % UP_QUEUE_BUCKETS];
+
+	while (*pp != ev)
+		pp = &(*pp)->next;
+	*pp = ev->next;
+}
+
+/**
+ * @brief Fold a newer attribute update into a pending one
+ *
+ * Only plain updates fold.  With *_inc flags or ACLs the outcome
+ * would depend on what is cached in between, so such pairs become an
+ * invalidation of the attributes instead.
+ *
+ * @return false if the update could not be folded.
+ */
+
+static bool up_fold_update(struct up_event *ev, const struct attrlist *attr,
+			   uint32_t flags)
+{
+	attrmask_t mask = attr->mask;
+
+	if (ev->update_flags != flags || (flags & ~fsal_up_nlink) != 0 ||
+	    FSAL_TEST_MASK(ev->attr.mask | mask, ATTR_ACL))
+		return false;
+
+	if (FSAL_TEST_MASK(mask, ATTR_SIZE))
+		ev->attr.filesize = attr->filesize;
+	if (FSAL_TEST_MASK(mask, ATTR_SPACEUSED))
+		ev->attr.spaceused = attr->spaceused;
+	if (FSAL_TEST_MASK(mask, ATTR_MODE))
+		ev->attr.mode = attr->mode;
+	if (FSAL_TEST_MASK(mask, ATTR_NUMLINKS))
+		ev->attr.numlinks = attr->numlinks;
+	if (FSAL_TEST_MASK(mask, ATTR_OWNER))
+		ev->attr.owner = attr->owner;
+	if (FSAL_TEST_MASK(mask, ATTR_GROUP))
+		ev->attr.group = attr->group;
+	if (FSAL_TEST_MASK(mask, ATTR_ATIME))
+		ev->attr.atime = attr->atime;
+	if (FSAL_TEST_MASK(mask, ATTR_CREATION))
+		ev->attr.creation = attr->creation;
+	if (FSAL_TEST_MASK(mask, ATTR_CTIME))
+		ev->attr.ctime = attr->ctime;
+	if (FSAL_TEST_MASK(mask, ATTR_MTIME))
+		ev->attr.mtime = attr->mtime;
+	if (FSAL_TEST_MASK(mask, ATTR_CHGTIME))
+		ev->attr.chgtime = attr->chgtime;
+	if (FSAL_TEST_MASK(mask, ATTR_CHANGE))
+		ev->attr.change = attr->change;
+	if (attr->expire_time_attr != 0)
+		ev->attr.expire_time_attr = attr->expire_time_attr;
+	ev->attr.mask |= mask;
+
+	return true;
+}
+
+/**
+ * @brief Fold an event into a pending one for the same object
+ */
+
+static void up_fold(struct up_event *ev, uint32_t inval_flags,
+		    const struct attrlist *attr, uint32_t update_flags)
+{
+	ev->inval_flags |= inval_flags;
+
+	if (attr != NULL) {
+		if (!ev->update) {
+			ev->update = true;
+			ev->attr = *attr;
+			ev->update_flags = update_flags;
+		} else if (!up_fold_update(ev, attr, update_flags)) {
+			ev->inval_flags |= CACHE_INODE_INVALIDATE_ATTRS;
+			if (update_flags & fsal_up_nlink) {
+				ev->update_flags |= fsal_up_nlink;
+				ev->attr.numlinks = attr->numlinks;
+			}
+		}
+	}
+
+	/* Attributes are fetched again anyway, unless the update
+	   also carries a link count of zero. */
+	if (ev->update && (ev->inval_flags & CACHE_INODE_INVALIDATE_ATTRS)) {
+		ev->attr.mask = 0;
+		if (!(ev->update_flags & fsal_up_nlink))
+			ev->update = false;
+	}
+}
+
+static int up_partition_cmp(const void *a, const void *b)
+{
+	uint32_t pa = up_partition((*(struct up_event * const *)a)->hk);
+	uint32_t pb = up_partition((*(struct up_event * const *)b)->hk);
+
+	return pa < pb ? -1 : pa > pb ? 1 : 0;
+}
+
+static void up_deliver(struct up_event *ev)
+{
+	cache_inode_status_t status = CACHE_INODE_SUCCESS;
+	struct timespec done;
+	nsecs_elapsed_t lat;
+	uint64_t max;
+
+	if (ev->inval_flags != 0)
+		status = ev->up_ops->invalidate(ev->fsal, &ev->obj,
+						ev->inval_flags);
+	if (ev->update && status != CACHE_INODE_NOT_FOUND)
+		status = ev->up_ops->update(ev->fsal, &ev->obj, &ev->attr,
+					    ev->update_flags);
+
+	if (status != CACHE_INODE_SUCCESS && status != CACHE_INODE_NOT_FOUND)
+		LogDebug(COMPONENT_FSAL_UP,
+			 "Queued upcall failed: %s",
+			 cache_inode_err_str(status));
+
+	now(&done);
+	lat = timespec_diff(&ev->queued, &done);
+	(void)atomic_inc_uint64_t(&up_queue_st.delivered);
+	(void)atomic_add_uint64_t(&up_queue_st.latency, lat);
+	max = atomic_fetch_uint64_t(&up_queue_st.max_latency);
+	while (lat > max &&
+	       !atomic_cas_uint64_t(&up_queue_st.max_latency, max, lat))
+		max = atomic_fetch_uint64_t(&up_queue_st.max_latency);
+
+	gsh_free(ev);
+}
+
+/**
+ * @brief Deliver the pending events of a lane
+ *
+ * Runs until the lane is empty, in batches of UP_QUEUE_BATCH taken
+ * off the queue together and delivered grouped by cache partition.
+ */
+
+static void up_drain(struct up_lane *lane)
+{
+	struct up_event *batch[UP_QUEUE_BATCH];
+	struct up_event *ev;
+	int n, i;
+
+	PTHREAD_MUTEX_lock(&lane->mtx);
+
+	while (!glist_empty(&lane->queue)) {
+		for (n = 0; n < UP_QUEUE_BATCH; n++) {
+			ev = glist_first_entry(&lane->queue, struct up_event,
+					       q);
+			if (ev == NULL)
+				break;
+			glist_del(&ev->q);
+			up_unhash(lane, ev);
+			batch[n] = ev;
+		}
+		lane->depth -= n;
+		(void)atomic_sub_uint64_t(&up_queue_st.depth, n);
+		pthread_cond_broadcast(&lane->cv);
+		PTHREAD_MUTEX_unlock(&lane->mtx);
+
+		qsort(batch, n, sizeof(batch[0]), up_partition_cmp);
+		for (i = 0; i < n; i++)
+			up_deliver(batch[i]);
+		(void)atomic_inc_uint64_t(&up_queue_st.batches);
+
+		PTHREAD_MUTEX_lock(&lane->mtx);
+	}
+
+	lane->scheduled = false;
+	PTHREAD_MUTEX_unlock(&lane->mtx);
+}
+
+static void up_drain_job(struct fridgethr_context *ctx)
+{
+	up_drain(ctx->arg);
+}
+
+/**
+ * @brief Queue an invalidate and/or update for an object
+ *
+ * @param[in] fr          Fridge to drain the lane on
+ * @param[in] up_ops      Upcall vector
+ * @param[in] fsal        FSAL module
+ * @param[in] obj         Key of the object
+ * @param[in] inval_flags Invalidation flags, 0 for none
+ * @param[in] attr        Attributes to update, NULL for none
+ * @param[in] update_flags Update flags
+ *
+ * @return 0 or an errno.
+ */
+
+int up_queue_event(struct fridgethr *fr,
+		   const struct fsal_up_vector *up_ops,
+		   struct fsal_module *fsal,
+		   struct gsh_buffdesc *obj, uint32_t inval_flags,
+		   const struct attrlist *attr, uint32_t update_flags)
+{
+	uint64_t hk = CityHash64WithSeed(obj->addr, obj->len, 557);
+	struct up_lane *lanes = atomic_fetch_voidptr((void **)&up_lanes);
+	struct up_lane *lane = &lanes[up_partition(hk) % UP_QUEUE_LANES];
+	struct up_event *ev;
+	struct timespec deadline;
+	bool schedule = false;
+
+	(void)atomic_inc_uint64_t(&up_queue_st.events);
+
+	PTHREAD_MUTEX_lock(&lane->mtx);
+
+	ev = up_find(lane, hk, up_ops, fsal, obj);
+	if (ev != NULL) {
+		up_fold(ev, inval_flags, attr, update_flags);
+		PTHREAD_MUTEX_unlock(&lane->mtx);
+		(void)atomic_inc_uint64_t(&up_queue_st.merged);
+		return 0;
+	}
+
+	if (lane->depth >= up_lane_max && lane->scheduled) {
+		(void)atomic_inc_uint64_t(&up_queue_st.waits);
+		now(&deadline);
+		deadline.tv_sec += UP_QUEUE_WAIT;
+		while (lane->depth >= up_lane_max && lane->scheduled &&
+		       pthread_cond_timedwait(&lane->cv, &lane->mtx,
+					      &deadline) == 0)
+			;
+
+		/* Someone may have queued the object meanwhile */
+		ev = up_find(lane, hk, up_ops, fsal, obj);
+		if (ev != NULL) {
+			up_fold(ev, inval_flags, attr, update_flags);
+			PTHREAD_MUTEX_unlock(&lane->mtx);
+			(void)atomic_inc_uint64_t(&up_queue_st.merged);
+			return 0;
+		}
+	}
+
+	ev = gsh_calloc(1, sizeof(struct up_event) + obj->len);
+	if (ev == NULL) {
+		PTHREAD_MUTEX_unlock(&lane->mtx);
+		return ENOMEM;
+	}
+
+	ev->hk = hk;
+	ev->up_ops = up_ops;
+	ev->fsal = fsal;
+	memcpy(ev->key, obj->addr, obj->len);
+	ev->obj.addr = ev->key;
+	ev->obj.len = obj->len;
+	now(&ev->queued);
+	up_fold(ev, inval_flags, attr, update_flags);
+
+	glist_add_tail(&lane->queue, &ev->q);
+	ev->next = lane->buckets[hk % UP_QUEUE_BUCKETS];
+	lane->buckets[hk % UP_QUEUE_BUCKETS] = ev;
+	lane->depth++;
+	(void)atomic_inc_uint64_t(&up_queue_st.depth);
+
+	if (!lane->scheduled) {
+		lane->scheduled = true;
+		schedule = true;
+	}
+
+	PTHREAD_MUTEX_unlock(&lane->mtx);
+
+	if (schedule && fridgethr_submit(fr, up_drain_job, lane) != 0) {
+		/* No thread to spare, deliver them ourselves */
+		up_drain(lane);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Report the upcall queue counters
+ *
+ * @param[out] stats Filled in
+ */
+
+void up_queue_get_stats(struct up_queue_stats *stats)
+{
+	stats->depth = atomic_fetch_uint64_t(&up_queue_st.depth);
+	stats->events = atomic_fetch_uint64_t(&up_queue_st.events);
+	stats->merged = atomic_fetch_uint64_t(&up_queue_st.merged);
+	stats->delivered = atomic_fetch_uint64_t(&up_queue_st.delivered);
+	stats->batches = atomic_fetch_uint64_t(&up_queue_st.batches);
+	stats->waits = atomic_fetch_uint64_t(&up_queue_st.waits);
+	stats->latency = atomic_fetch_uint64_t(&up_queue_st.latency);
+	stats->max_latency = atomic_fetch_uint64_t(&up_queue_st.max_latency);
+}
+
+/** @} */
@@ -48,6 +48,8 @@
 #include "nfs_convert.h"
 #include "delayed_exec.h"
 #include "export_mgr.h"
+#include "fridgethr.h"
+#include "abstract_atomic.h"
 
 /**
  * @brief Invalidate a cached entry
@@ -281,6 +283,9 @@ static cache_inode_status_t update(struct fsal_module *fsal,
 			cache_inode_invalidate(entry,
 					       CACHE_INODE_INVALIDATE_CONTENT |
 					       CACHE_INODE_INVALIDATE_GOT_LOCK);
+		/* Nor cached file data. */
+		else if (entry->type == REGULAR_FILE)
+			cache_inode_data_invalidate(entry);
 	} else {
 		cache_inode_invalidate(entry,
 				       CACHE_INODE_INVALIDATE_ATTRS |
@@ -508,13 +513,24 @@ static state_status_t create_file_recall(cache_entry_t *entry,
 	return rc;
 }
 
-static void layoutrecall_one_call(void *arg);
+/* Most operations past CB_SEQUENCE in one recall compound */
+#define RECALL_BATCH_MAX 16
+
+/* Hash chains of clients with recalls pending */
+#define RECALL_BUCKETS 127
+
+/* Threads sending recalls */
+#define RECALL_THREADS 4
+
+/* Wait before trying again to start a sender */
+#define RECALL_RETRY_DELAY (100 * NS_PER_MSEC)
 
 /**
  * @brief Data used to handle the response to CB_LAYOUTRECALL
  */
 
 struct layoutrecall_cb_data {
+	struct glist_head link;	/*< On the client's pending list */
 	char stateid_other[OTHERSIZE];	/*< "Other" part of state id */
 	struct pnfs_segment segment;	/*< Segment to recall */
 	nfs_cb_argop4 arg;	/*< So we don't free */
@@ -524,130 +540,70 @@ struct layoutrecall_cb_data {
 };
 
 /**
- * @brief Initiate layout recall
- *
- * This function validates the recall, creates the recall object, and
- * sends out CB_LAYOUTRECALL messages.
- *
- * @param[in] handle      Handle on which the layout is held
- * @param[in] layout_type The type of layout to recall
- * @param[in] changed     Whether the layout has changed and the
- *                        client ought to finish writes through MDS
- * @param[in] segment     Segment to recall
- * @param[in] cookie      A cookie returned with the return that
- *                        completely satisfies a recall
- * @param[in] spec        Lets us be fussy about what clients we send
- *                        to. May be NULL.
- *
- * @retval STATE_SUCCESS if scheduled.
- * @retval STATE_NOT_FOUND if no matching layouts exist.
- * @retval STATE_INVALID_ARGUMENT if a nonsensical layout recall has
- *         been specified.
- * @retval STATE_MALLOC_ERROR if there was insufficient memory to construct the
- *         recall state.
+ * @brief A device notification waiting to be sent
  */
-state_status_t layoutrecall(struct fsal_module *fsal,
-			    struct gsh_buffdesc *handle,
-			    layouttype4 layout_type, bool changed,
-			    const struct pnfs_segment *segment, void *cookie,
-			    struct layoutrecall_spec *spec)
-{
-	/* Return code */
-	state_status_t rc = STATE_SUCCESS;
-	/* Cache entry on which to operate */
-	cache_entry_t *entry = NULL;
-	/* The recall object */
-	struct state_layout_recall_file *recall = NULL;
-	/* Iterator over the work list */
-	struct glist_head *wi = NULL;
 
-	rc = cache_inode_status_to_state_status(up_get(fsal, handle, &entry));
-	if (rc != STATE_SUCCESS)
-		return rc;
+struct devnotify_pending {
+	struct glist_head link;	/*< On the client's pending list */
+	notify_deviceid_type4 notify_type;
+	layouttype4 layout_type;
+	struct pnfs_deviceid devid;
+};
 
-	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
-	/* We build up the list before consuming it so that we have
-	   every state on the list before we start executing returns. */
-	rc = create_file_recall(entry, layout_type, segment, cookie, spec,
-				&recall);
-	PTHREAD_RWLOCK_unlock(&entry->state_lock);
-	if (rc != STATE_SUCCESS)
-		goto out;
+/**
+ * @brief Recalls and notifications waiting for one client
+ *
+ * An entry is hashed and on the send queue from when it is created
+ * until a sender takes it, so whatever is added meanwhile goes out
+ * in the same compounds.
+ */
 
-	/**
-	 * @todo This leaves us open to a race if a return comes in
-	 * while we're traversing the work list.
-	 */
-	glist_for_each(wi, &recall->state_list) {
-		/* The current entry in the queue */
-		struct recall_state_list *g = glist_entry(wi,
-							  struct
-							  recall_state_list,
-							  link);
-		struct state_t *s = g->state;
-		struct layoutrecall_cb_data *cb_data;
-		struct gsh_export *exp = s->state_export;
-		cache_entry_t *entry = s->state_entry;
-		nfs_cb_argop4 *arg;
-		CB_LAYOUTRECALL4args *cb_layoutrec;
+struct recall_client {
+	struct recall_client *next;	/*< In the hash chain */
+	struct glist_head q;	/*< In the send queue */
+	nfs_client_id_t *client;	/*< Referenced */
+	struct glist_head recalls;	/*< Of layoutrecall_cb_data */
+	struct glist_head notifies;	/*< Of devnotify_pending */
+};
 
-		cb_data = gsh_malloc(sizeof(struct layoutrecall_cb_data));
-		if (cb_data == NULL) {
-			rc = STATE_MALLOC_ERROR;
-			goto out;
-		}
-		arg = &cb_data->arg;
-		arg->argop = NFS4_OP_CB_LAYOUTRECALL;
-		cb_layoutrec = &arg->nfs_cb_argop4_u.opcblayoutrecall;
-		PTHREAD_RWLOCK_wrlock(&entry->state_lock);
-		cb_layoutrec->clora_type = layout_type;
-		cb_layoutrec->clora_iomode = segment->io_mode;
-		cb_layoutrec->clora_changed = changed;
-		cb_layoutrec->clora_recall.lor_recalltype = LAYOUTRECALL4_FILE;
-		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.
-		    lor_offset = segment->offset;
-		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.
-		    lor_length = segment->length;
-		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.lor_fh.
-		    nfs_fh4_len = sizeof(struct alloc_file_handle_v4);
-		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.lor_fh.
-		    nfs_fh4_val =
-		    gsh_malloc(sizeof(struct alloc_file_handle_v4));
-		if (cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.
-				lor_fh.nfs_fh4_val == NULL) {
-			PTHREAD_RWLOCK_unlock(&entry->state_lock);
-			gsh_free(cb_data);
-			rc = STATE_MALLOC_ERROR;
-			goto out;
-		}
-		if (!nfs4_FSALToFhandle(
-				&cb_layoutrec->clora_recall.layoutrecall4_u
-				.lor_layout.lor_fh,
-				entry->obj_handle,
-				exp)) {
-			PTHREAD_RWLOCK_unlock(&entry->state_lock);
-			gsh_free(cb_data);
-			gsh_free(cb_layoutrec->clora_recall.layoutrecall4_u.
-						lor_layout.lor_fh.nfs_fh4_val);
-			rc = STATE_MALLOC_ERROR;
-			goto out;
-		}
-		update_stateid(s,
-			       &cb_layoutrec->clora_recall.layoutrecall4_u.
-			       lor_layout.lor_stateid, NULL, "LAYOUTRECALL");
-		memcpy(cb_data->stateid_other, s->stateid_other, OTHERSIZE);
-		cb_data->segment = *segment;
-		cb_data->client =
-		    s->state_owner->so_owner.so_nfs4_owner.so_clientrec;
-		cb_data->attempts = 0;
-		PTHREAD_RWLOCK_unlock(&entry->state_lock);
-		layoutrecall_one_call(cb_data);
-	}
+/**
+ * @brief One CB_COMPOUND of device notifications and layout recalls
+ *
+ * The notifications, if any, travel as one CB_NOTIFY_DEVICEID right
+ * after the CB_SEQUENCE, the recalls follow it.
+ */
 
- out:
-	cache_inode_put(entry);
-	return rc;
-}
+struct recall_batch {
+	nfs_client_id_t *client;	/*< Referenced */
+	uint32_t n_notifies;
+	uint32_t n_recalls;
+	nfs_cb_argop4 notify_arg;
+	struct notify4 notify[RECALL_BATCH_MAX];
+	struct notify_deviceid_delete4 notify_del[RECALL_BATCH_MAX];
+	struct layoutrecall_cb_data *recalls[RECALL_BATCH_MAX];
+};
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;	/*< Signalled as compounds complete */
+	struct recall_client *buckets[RECALL_BUCKETS];
+	struct glist_head queue;	/*< Clients with something to send */
+	uint32_t senders;	/*< Send jobs queued or running */
+	uint32_t inflight;	/*< Compounds awaiting their reply */
+	bool retry;		/*< recall_retry is scheduled */
+} recall;
+
+static struct fridgethr *recall_fridge;
+
+static struct layoutrecall_stats recall_st;
+
+static const nsecs_elapsed_t
+recall_latency_bounds[LAYOUTRECALL_LATENCY_BUCKETS - 1] = {
+	NS_PER_MSEC,
+	10 * NS_PER_MSEC,
+	100 * NS_PER_MSEC,
+	NS_PER_SEC
+};
 
 /**
  * @brief Free a CB_LAYOUTRECALL
@@ -661,123 +617,72 @@ static void free_layoutrec(nfs_cb_argop4 *op)
 		 layoutrecall4_u.lor_layout.lor_fh.nfs_fh4_val);
 }
 
+static void recall_free(struct layoutrecall_cb_data *cb_data)
+{
+	free_layoutrec(&cb_data->arg);
+	dec_client_id_ref(cb_data->client);
+	gsh_free(cb_data);
+}
+
 /**
- * @brief Complete a CB_LAYOUTRECALL
+ * @brief Count a recall that has run its course
  *
- * This function handles the client response to a layoutrecall.  In
- * the event of success it does nothing.  In the case of most errors,
- * it revokes the layout.
+ * @param[in] cb_data The recall
+ * @param[in] outcome Counter of its outcome
+ */
+
+static void recall_account(struct layoutrecall_cb_data *cb_data,
+			   uint64_t *outcome)
+{
+	struct timespec current;
+	nsecs_elapsed_t lat;
+	uint64_t max;
+	int b;
+
+	now(&current);
+	lat = timespec_diff(&cb_data->first_recall, &current);
+
+	for (b = 0; b < LAYOUTRECALL_LATENCY_BUCKETS - 1; b++)
+		if (lat < recall_latency_bounds[b])
+			break;
+
+	(void)atomic_inc_uint64_t(outcome);
+	(void)atomic_inc_uint64_t(&recall_st.latency_hist[b]);
+	(void)atomic_add_uint64_t(&recall_st.latency, lat);
+	max = atomic_fetch_uint64_t(&recall_st.max_latency);
+	while (lat > max &&
+	       !atomic_cas_uint64_t(&recall_st.max_latency, max, lat))
+		max = atomic_fetch_uint64_t(&recall_st.max_latency);
+}
+
+/**
+ * @brief Return or revoke a recalled layout
  *
  * For NOMATCHINGLAYOUT, under the agreed-upon interpretation of the
- * forgetful model, it acts as if the client had returned a layout
- * exactly matching the recall.
+ * forgetful model, we act as if the client had returned a layout
+ * exactly matching the recall.  That is only safe because every
+ * recall carries the call that handed out the layout in its referring
+ * call lists, so a client that has not seen the LAYOUTGET reply yet
+ * answers DELAY instead (RFC 5661 2.10.6.3).  Otherwise the layout is
+ * revoked.  Frees the recall.
  *
- * For DELAY, it backs off in plateaus, then revokes the layout if the
- * period of delay has surpassed the lease period.
- *
- * @param[in] call  The RPC call being completed
- * @param[in] hook  The hook itself
- * @param[in] arg   Supplied argument (the callback data)
- * @param[in] flags There are no flags.
- *
- * @return 0, constantly.
+ * @param[in] cb_data      The recall
+ * @param[in] circumstance circumstance_client or circumstance_revoke
  */
 
-static int32_t layoutrec_completion(rpc_call_t *call, rpc_call_hook hook,
-				    void *arg, uint32_t flags)
+static void recall_return(struct layoutrecall_cb_data *cb_data,
+			  enum fsal_layoutreturn_circumstance circumstance)
 {
-	struct layoutrecall_cb_data *cb_data = arg;
-	bool deleted = false;
 	state_t *state = NULL;
+	bool deleted = false;
 	struct root_op_context root_op_context;
 
 	/* Initialize req_ctx */
 	init_root_op_context(&root_op_context, NULL, NULL,
 			     0, 0, UNKNOWN_REQUEST);
 
-	LogFullDebug(COMPONENT_NFS_CB, "status %d cb_data %p",
-		     call->cbt.v_u.v4.res.status, cb_data);
-
-	/* Get this out of the way up front */
-	if (hook != RPC_CALL_COMPLETE)
-		goto revoke;
-
-	if (call->cbt.v_u.v4.res.status == NFS4_OK) {
-		/**
-		 * @todo This is where you would record that a
-		 * recall was acknowledged and that a layoutreturn
-		 * will be sent later.
-		 * The number of times we retried the call is
-		 * specified in cb_data->attempts and the time we
-		 * specified the first call is in
-		 * cb_data->first_recall.
-		 * We don't have the clientid here.  If you want it,
-		 * we could either move the stateid look up to be
-		 * above this point in the function, or we could stash
-		 * the clientid in cb_data.
-		 */
-		free_layoutrec(&call->cbt.v_u.v4.args.argarray.argarray_val[1]);
-		nfs41_complete_single(call, hook, cb_data, flags);
-		gsh_free(cb_data);
-		goto out;
-	} else if (call->cbt.v_u.v4.res.status == NFS4ERR_DELAY) {
-		struct timespec current;
-		nsecs_elapsed_t delay;
-
-		now(&current);
-		if (timespec_diff(&cb_data->first_recall, &current) >
-		    (nfs_param.nfsv4_param.lease_lifetime * NS_PER_SEC)) {
-			goto revoke;
-		}
-		if (cb_data->attempts < 5)
-			delay = 0;
-		else if (cb_data->attempts < 10)
-			delay = 1 * NS_PER_MSEC;
-		else if (cb_data->attempts < 20)
-			delay = 10 * NS_PER_MSEC;
-		else if (cb_data->attempts < 30)
-			delay = 100 * NS_PER_MSEC;
-		else
-			delay = 1 * NS_PER_SEC;
-
-		/* We don't free the argument here, because we'll be
-		   re-using that to make the queued call. */
-		nfs41_complete_single(call, hook, cb_data, flags);
-		delayed_submit(layoutrecall_one_call, cb_data, delay);
-		goto out;
-	}
-
-	/**
-	 * @todo Better error handling later when we have more
-	 * session/revocation infrastructure.
-	 */
-
- revoke:
 	/* If we don't find the state, there's nothing to return. */
 	if (nfs4_State_Get_Pointer(cb_data->stateid_other, &state)) {
-		enum fsal_layoutreturn_circumstance circumstance;
-
-		if (hook == RPC_CALL_COMPLETE &&
-		    call->cbt.v_u.v4.res.status ==
-		    NFS4ERR_NOMATCHING_LAYOUT)
-			circumstance = circumstance_client;
-		else
-			circumstance = circumstance_revoke;
-
-		/**
-		 * @todo This is where you would record that a
-		 * recall was completed, one way or the other.
-		 * The clientid is specified in
-		 * state->state_owner->so_owner.so_nfs4_owner.so_clientid
-		 * The number of times we retried the call is
-		 * specified in cb_data->attempts and the time we
-		 * specified the first call is in
-		 * cb_data->first_recall.  If
-		 * call->cbt.v_u.v4.res.status is
-		 * NFS4ERR_NOMATCHING_LAYOUT it was a successful
-		 * return, otherwise we count it as an error.
-		 */
-
 		PTHREAD_RWLOCK_wrlock(&state->state_entry->state_lock);
 
 		root_op_context.req_ctx.clientid = &state->state_owner
@@ -792,172 +697,688 @@ static int32_t layoutrec_completion(rpc_call_t *call, rpc_call_hook hook,
 				      &deleted, true);
 		PTHREAD_RWLOCK_unlock(&state->state_entry->state_lock);
 	}
-	free_layoutrec(&call->cbt.v_u.v4.args.argarray.argarray_val[1]);
-	nfs41_complete_single(call, hook, cb_data, flags);
-	gsh_free(cb_data);
-
-out:
 	release_root_op_context();
+
+	recall_account(cb_data, circumstance == circumstance_client ?
+		       &recall_st.nomatching : &recall_st.revoked);
+	recall_free(cb_data);
+}
+
+/**
+ * @brief Revoke a layout from delayed_exec
+ *
+ * Used where we may not call into the FSAL's layoutreturn, because
+ * its layoutrecall function may be holding locks.
+ *
+ * @param[in] arg The recall
+ */
+
+static void recall_revoke_async(void *arg)
+{
+	recall_return(arg, circumstance_revoke);
+}
+
+static void recall_sender(struct fridgethr_context *ctx);
+static void recall_retry(void *arg);
+
+/**
+ * @brief Make sure enough senders run for the send queue
+ *
+ * If no sender can be started and none runs, the queue would sit
+ * until the next recall, so starting one is retried from
+ * delayed_exec.  It can't be run here: our callers hold recall.mtx
+ * and often the entry's state_lock.
+ *
+ * Call with recall.mtx held.
+ */
+
+static void recall_schedule(void)
+{
+	int rc;
+
+	if (recall.senders >= RECALL_THREADS)
+		return;
+
+	rc = fridgethr_submit(recall_fridge, recall_sender, NULL);
+	if (rc == 0) {
+		recall.senders++;
+		return;
+	}
+
+	if (recall.senders != 0 || recall.retry)
+		return;
+
+	rc = delayed_submit(recall_retry, NULL, RECALL_RETRY_DELAY);
+	if (rc != 0) {
+		LogCrit(COMPONENT_NFS_CB,
+			"Unable to start or retry recall sender: %d", rc);
+		return;
+	}
+
+	LogMajor(COMPONENT_NFS_CB,
+		 "Unable to start recall sender, retrying");
+	recall.retry = true;
+}
+
+/**
+ * @brief Try again to start a sender for the send queue
+ *
+ * @param[in] arg Unused
+ */
+
+static void recall_retry(void *arg)
+{
+	PTHREAD_MUTEX_lock(&recall.mtx);
+	recall.retry = false;
+	if (!glist_empty(&recall.queue))
+		recall_schedule();
+	PTHREAD_MUTEX_unlock(&recall.mtx);
+}
+
+/**
+ * @brief Find or create the pending entry of a client
+ *
+ * Call with recall.mtx held.
+ *
+ * @param[in] client The client
+ *
+ * @return The entry or NULL if out of memory.
+ */
+
+static struct recall_client *recall_client_get(nfs_client_id_t *client)
+{
+	struct recall_client **pp =
+	    &recall.buckets[client->cid_clientid % RECALL_BUCKETS];
+	struct recall_client *rc;
+
+	for (rc = *pp; rc != NULL; rc = rc->next)
+		if (rc->client == client)
+			return rc;
+
+	rc = gsh_malloc(sizeof(struct recall_client));
+	if (rc == NULL)
+		return NULL;
+
+	rc->client = client;
+	inc_client_id_ref(client);
+	glist_init(&rc->recalls);
+	glist_init(&rc->notifies);
+	rc->next = *pp;
+	*pp = rc;
+	glist_add_tail(&recall.queue, &rc->q);
+	recall_schedule();
+
+	return rc;
+}
+
+/**
+ * @brief Take a client's pending entry off the hash and send queue
+ *
+ * Call with recall.mtx held.
+ */
+
+static void recall_client_take(struct recall_client *rc)
+{
+	struct recall_client **pp =
+	    &recall.buckets[rc->client->cid_clientid % RECALL_BUCKETS];
+
+	while (*pp != rc)
+		pp = &(*pp)->next;
+	*pp = rc->next;
+	glist_del(&rc->q);
+}
+
+/**
+ * @brief Revoke everything still pending in a taken entry and free it
+ */
+
+static void recall_client_fail(struct recall_client *rc)
+{
+	struct glist_head *glist, *glistn;
+
+	glist_for_each_safe(glist, glistn, &rc->recalls) {
+		struct layoutrecall_cb_data *cb_data =
+		    glist_entry(glist, struct layoutrecall_cb_data, link);
+
+		glist_del(&cb_data->link);
+		recall_return(cb_data, circumstance_revoke);
+	}
+
+	glist_for_each_safe(glist, glistn, &rc->notifies) {
+		struct devnotify_pending *dn =
+		    glist_entry(glist, struct devnotify_pending, link);
+
+		glist_del(&dn->link);
+		gsh_free(dn);
+	}
+
+	dec_client_id_ref(rc->client);
+	gsh_free(rc);
+}
+
+/**
+ * @brief Queue a layout recall to be sent
+ *
+ * @param[in] cb_data The recall
+ */
+
+static void recall_enqueue(struct layoutrecall_cb_data *cb_data)
+{
+	struct recall_client *rc;
+
+	PTHREAD_MUTEX_lock(&recall.mtx);
+	rc = recall_client_get(cb_data->client);
+	if (rc != NULL)
+		glist_add_tail(&rc->recalls, &cb_data->link);
+	PTHREAD_MUTEX_unlock(&recall.mtx);
+
+	if (rc == NULL) {
+		LogCrit(COMPONENT_NFS_CB,
+			"Unable to queue recall, revoking layout");
+		if (delayed_submit(recall_revoke_async, cb_data, 0) != 0)
+			recall_free(cb_data);
+	}
+}
+
+static void recall_requeue(void *arg)
+{
+	recall_enqueue(arg);
+}
+
+/**
+ * @brief Wait for room in the window of outstanding compounds
+ */
+
+static void recall_window_enter(void)
+{
+	PTHREAD_MUTEX_lock(&recall.mtx);
+	while (recall.inflight >= nfs_param.nfsv4_param.layout_recall_window) {
+		recall_st.waits++;
+		pthread_cond_wait(&recall.cv, &recall.mtx);
+	}
+	recall.inflight++;
+	if (recall.inflight > recall_st.max_inflight)
+		recall_st.max_inflight = recall.inflight;
+	PTHREAD_MUTEX_unlock(&recall.mtx);
+}
+
+static void recall_window_exit(void)
+{
+	PTHREAD_MUTEX_lock(&recall.mtx);
+	recall.inflight--;
+	pthread_cond_signal(&recall.cv);
+	PTHREAD_MUTEX_unlock(&recall.mtx);
+}
+
+/**
+ * @brief Send a recall again after NFS4ERR_DELAY
+ *
+ * Backs off in plateaus, then revokes the layout if the period of
+ * delay has surpassed the lease period.
+ *
+ * @param[in] cb_data The recall
+ */
+
+static void recall_delay(struct layoutrecall_cb_data *cb_data)
+{
+	struct timespec current;
+	nsecs_elapsed_t delay;
+
+	now(&current);
+	if (timespec_diff(&cb_data->first_recall, &current) >
+	    (nfs_param.nfsv4_param.lease_lifetime * NS_PER_SEC)) {
+		recall_return(cb_data, circumstance_revoke);
+		return;
+	}
+	if (cb_data->attempts < 5)
+		delay = 0;
+	else if (cb_data->attempts < 10)
+		delay = 1 * NS_PER_MSEC;
+	else if (cb_data->attempts < 20)
+		delay = 10 * NS_PER_MSEC;
+	else if (cb_data->attempts < 30)
+		delay = 100 * NS_PER_MSEC;
+	else
+		delay = 1 * NS_PER_SEC;
+
+	if (delayed_submit(recall_requeue, cb_data, delay) != 0)
+		recall_return(cb_data, circumstance_revoke);
+}
+
+/**
+ * @brief Complete a compound of recalls and notifications
+ *
+ * Each CB_LAYOUTRECALL is judged by its own result.  On success the
+ * client will send LAYOUTRETURN and we do nothing more.  Operations
+ * the client did not reach because an earlier one failed, and those
+ * answered with DELAY, are queued to be sent again.  Recalls that
+ * did not fit the session's back channel are queued without delay.
+ * NOMATCHINGLAYOUT is taken as a return and any other error revokes.
+ *
+ * If the client did not answer at all, the back channel is gone.
+ * Every layout in the compound, and every recall still waiting for
+ * the client, is revoked at once instead of each waiting out its own
+ * timeout.
+ *
+ * @param[in] call  The RPC call being completed
+ * @param[in] hook  The hook itself
+ * @param[in] arg   Supplied argument (the batch)
+ * @param[in] flags There are no flags.
+ *
+ * @return 0, constantly.
+ */
+
+static int32_t recall_completion(rpc_call_t *call, rpc_call_hook hook,
+				 void *arg, uint32_t flags)
+{
+	struct recall_batch *batch = arg;
+	CB_COMPOUND4res *res = &call->cbt.v_u.v4.res;
+	uint32_t n_args = call->cbt.v_u.v4.args.argarray.argarray_len;
+	uint32_t first = batch->n_notifies != 0 ? 2 : 1;
+	struct recall_client *rc = NULL;
+	uint32_t i;
+
+	LogFullDebug(COMPONENT_NFS_CB, "status %d batch %p",
+		     res->status, batch);
+
+	recall_window_exit();
+
+	if (hook != RPC_CALL_COMPLETE) {
+		(void)atomic_inc_uint64_t(&recall_st.timeouts);
+		LogInfo(COMPONENT_NFS_CB,
+			"No answer from client %" PRIx64
+			", revoking its recalled layouts",
+			batch->client->cid_clientid);
+
+		for (i = 0; i < batch->n_recalls; i++)
+			recall_return(batch->recalls[i], circumstance_revoke);
+
+		PTHREAD_MUTEX_lock(&recall.mtx);
+		for (rc = recall.buckets[batch->client->cid_clientid %
+					 RECALL_BUCKETS];
+		     rc != NULL; rc = rc->next)
+			if (rc->client == batch->client)
+				break;
+		if (rc != NULL)
+			recall_client_take(rc);
+		PTHREAD_MUTEX_unlock(&recall.mtx);
+
+		if (rc != NULL)
+			recall_client_fail(rc);
+		goto out;
+	}
+
+	if (batch->n_notifies != 0 && res->resarray.resarray_len > 1 &&
+	    res->resarray.resarray_val[1].nfs_cb_resop4_u.
+	    opcbnotify_deviceid.cndr_status != NFS4_OK)
+		LogDebug(COMPONENT_NFS_CB,
+			 "CB_NOTIFY_DEVICEID to client %" PRIx64
+			 " failed: %d", batch->client->cid_clientid,
+			 res->resarray.resarray_val[1].nfs_cb_resop4_u.
+			 opcbnotify_deviceid.cndr_status);
+
+	for (i = 0; i < batch->n_recalls; i++) {
+		struct layoutrecall_cb_data *cb_data = batch->recalls[i];
+		nfsstat4 status;
+
+		if (first + i >= n_args) {
+			/* Did not fit in the compound */
+			--cb_data->attempts;
+			recall_enqueue(cb_data);
+			continue;
+		}
+
+		if (first + i < res->resarray.resarray_len)
+			status = res->resarray.resarray_val[first + i].
+			    nfs_cb_resop4_u.opcblayoutrecall.clorr_status;
+		else if (res->resarray.resarray_len > 1)
+			status = NFS4ERR_DELAY;	/* Not reached */
+		else
+			status = res->status;	/* CB_SEQUENCE failed */
+
+		switch (status) {
+		case NFS4_OK:
+			recall_account(cb_data, &recall_st.acked);
+			recall_free(cb_data);
+			break;
+
+		case NFS4ERR_DELAY:
+			recall_delay(cb_data);
+			break;
+
+		case NFS4ERR_NOMATCHING_LAYOUT:
+			recall_return(cb_data, circumstance_client);
+			break;
+
+		default:
+			/**
+			 * @todo Better error handling later when we
+			 * have more session/revocation infrastructure.
+			 */
+			recall_return(cb_data, circumstance_revoke);
+			break;
+		}
+	}
+
+ out:
+	nfs41_complete_single(call, hook, batch, flags);
+	dec_client_id_ref(batch->client);
+	gsh_free(batch);
 	return 0;
 }
 
 /**
- * @brief Return one layout on error
+ * @brief Add a device notification to a batch
+ */
+
+static void recall_add_notify(struct recall_batch *batch,
+			      struct devnotify_pending *dn)
+{
+	struct notify4 *notify = &batch->notify[batch->n_notifies];
+	struct notify_deviceid_delete4 *del =
+	    &batch->notify_del[batch->n_notifies];
+
+	notify->notify_mask.bitmap4_len = 1;
+	notify->notify_mask.map[0] = dn->notify_type;
+	notify->notify_vals.notifylist4_len =
+	    sizeof(struct notify_deviceid_delete4);
+	notify->notify_vals.notifylist4_val = (char *)del;
+	del->ndd_layouttype = dn->layout_type;
+	memcpy(del->ndd_deviceid, &dn->devid, sizeof(del->ndd_deviceid));
+	batch->n_notifies++;
+}
+
+/**
+ * @brief Send everything pending for one client
  *
- * This is only invoked in the case of a send error on the first
- * attempt to issue a CB_LAYOUTRECALL, so that we don't call into the
- * FSAL's layoutreturn function while its layoutrecall function may be
- * holding locks.
+ * Notifications and recalls go out Layout_Recall_Batch operations to
+ * a compound, each compound waiting for room in the window.  If the
+ * client has no usable back channel, every layout recalled from it
+ * is revoked.
  *
- * @param[in] arg Structure holding all arguments, so we can queue
- *                this function in delayed_exec.
+ * @param[in] rc The client's taken entry
  */
 
-static void return_one_async(void *arg)
+static void recall_send_client(struct recall_client *rc)
 {
-	struct layoutrecall_cb_data *cb_data = arg;
-	state_t *s;
-	bool deleted = false;
-	struct root_op_context root_op_context;
+	uint32_t max = nfs_param.nfsv4_param.layout_recall_batch;
+
+	while (!glist_empty(&rc->notifies) || !glist_empty(&rc->recalls)) {
+		nfs_cb_argop4 ops[RECALL_BATCH_MAX];
+		struct state_refer refer[RECALL_BATCH_MAX];
+		struct state_refer *refers[RECALL_BATCH_MAX];
+		struct recall_batch *batch;
+		uint32_t n_ops = 0;
+		uint32_t sent;
+		uint32_t i;
+		state_t *s = NULL;
+		int code;
+
+		batch = gsh_calloc(1, sizeof(struct recall_batch));
+		if (batch == NULL) {
+			LogCrit(COMPONENT_NFS_CB,
+				"Out of memory, revoking layouts of client %"
+				PRIx64, rc->client->cid_clientid);
+			recall_client_fail(rc);
+			return;
+		}
+		batch->client = rc->client;
+		inc_client_id_ref(batch->client);
+
+		while (batch->n_notifies < max &&
+		       !glist_empty(&rc->notifies)) {
+			struct devnotify_pending *dn =
+			    glist_first_entry(&rc->notifies,
+					      struct devnotify_pending, link);
+
+			glist_del(&dn->link);
+			recall_add_notify(batch, dn);
+			gsh_free(dn);
+		}
+		if (batch->n_notifies != 0) {
+			CB_NOTIFY_DEVICEID4args *cb_notify_dev =
+			    &batch->notify_arg.nfs_cb_argop4_u.
+			    opcbnotify_deviceid;
+
+			batch->notify_arg.argop = NFS4_OP_CB_NOTIFY_DEVICEID;
+			cb_notify_dev->cnda_changes.cnda_changes_len =
+			    batch->n_notifies;
+			cb_notify_dev->cnda_changes.cnda_changes_val =
+			    batch->notify;
+			refers[n_ops] = NULL;
+			ops[n_ops++] = batch->notify_arg;
+		}
 
-	/* Initialize req_ctx */
-	init_root_op_context(&root_op_context, NULL, NULL,
-			     0, 0, UNKNOWN_REQUEST);
+		while (n_ops < max && !glist_empty(&rc->recalls)) {
+			struct layoutrecall_cb_data *cb_data =
+			    glist_first_entry(&rc->recalls,
+					      struct layoutrecall_cb_data,
+					      link);
 
-	if (nfs4_State_Get_Pointer(cb_data->stateid_other, &s)) {
-		PTHREAD_RWLOCK_wrlock(&s->state_entry->state_lock);
+			glist_del(&cb_data->link);
+			if (!nfs4_State_Get_Pointer(cb_data->stateid_other,
+						    &s)) {
+				/* Returned meanwhile */
+				recall_free(cb_data);
+				continue;
+			}
+			if (cb_data->attempts++ != 0)
+				(void)atomic_inc_uint64_t(&recall_st.retries);
 
-		root_op_context.req_ctx.clientid = &s->state_owner
-			->so_owner.so_nfs4_owner.so_clientid;
-		root_op_context.req_ctx.export = s->state_export;
-		root_op_context.req_ctx.fsal_export =
-			root_op_context.req_ctx.export->fsal_export;
+			/* Each recall refers to the call that got its
+			 * layout, so the client can tell it raced with
+			 * the LAYOUTGET reply.
+			 */
+			PTHREAD_RWLOCK_rdlock(&s->state_entry->state_lock);
+			refer[n_ops] = s->state_refer;
+			PTHREAD_RWLOCK_unlock(&s->state_entry->state_lock);
+			refers[n_ops] = &refer[n_ops];
+
+			batch->recalls[batch->n_recalls++] = cb_data;
+			ops[n_ops++] = cb_data->arg;
+		}
+
+		if (n_ops == 0) {
+			dec_client_id_ref(batch->client);
+			gsh_free(batch);
+			continue;
+		}
+
+		recall_window_enter();
+
+		sent = n_ops;
+		code = nfs_rpc_v41_multi(rc->client, ops, &sent, refers,
+					 recall_completion, batch);
+
+		if (code == 0) {
+			/* batch belongs to the completion now */
+			(void)atomic_inc_uint64_t(&recall_st.compounds);
+			(void)atomic_add_uint64_t(&recall_st.ops, sent);
+			continue;
+		}
 
-		nfs4_return_one_state(s->state_entry,
-				      LAYOUTRETURN4_FILE, circumstance_revoke,
-				      s, cb_data->segment, 0, NULL, &deleted,
-				      true);
-		PTHREAD_RWLOCK_unlock(&s->state_entry->state_lock);
+		/**
+		 * @todo On failure to submit a callback, we ought to
+		 * give the client at least one lease period to
+		 * establish a back channel before we start revoking
+		 * state.  We don't have the infrastructure to
+		 * properly handle layout revocation, however.
+		 *
+		 * At present we just assume the client has gone
+		 * completely out to lunch and fake a return of
+		 * everything recalled from it.
+		 */
+		recall_window_exit();
+		(void)atomic_inc_uint64_t(&recall_st.timeouts);
+		LogInfo(COMPONENT_NFS_CB,
+			"No back channel to client %" PRIx64
+			", revoking its recalled layouts: %d",
+			rc->client->cid_clientid, code);
+
+		for (i = 0; i < batch->n_recalls; i++)
+			recall_return(batch->recalls[i], circumstance_revoke);
+		dec_client_id_ref(batch->client);
+		gsh_free(batch);
+		recall_client_fail(rc);
+		return;
 	}
-	release_root_op_context();
-	gsh_free(cb_data);
+
+	dec_client_id_ref(rc->client);
+	gsh_free(rc);
 }
 
 /**
- * @brief Send one layoutrecall to one client
+ * @brief Drain the send queue
  *
- * @param[in] arg Structure holding all arguments, so we can queue
- *                this function in delayed_exec for retry on NFS4ERR_DELAY.
+ * @param[in] ctx Thread context
  */
 
-static void layoutrecall_one_call(void *arg)
+static void recall_sender(struct fridgethr_context *ctx)
 {
-	struct layoutrecall_cb_data *cb_data = arg;
-	state_t *s;
-	int code;
-	struct root_op_context root_op_context;
+	struct recall_client *rc;
 
-	/* Initialize req_ctx */
-	init_root_op_context(&root_op_context, NULL, NULL,
-			     0, 0, UNKNOWN_REQUEST);
+	PTHREAD_MUTEX_lock(&recall.mtx);
+	while (!glist_empty(&recall.queue)) {
+		rc = glist_first_entry(&recall.queue, struct recall_client, q);
+		recall_client_take(rc);
+		PTHREAD_MUTEX_unlock(&recall.mtx);
+
+		recall_send_client(rc);
+
+		PTHREAD_MUTEX_lock(&recall.mtx);
+	}
+	recall.senders--;
+	PTHREAD_MUTEX_unlock(&recall.mtx);
+}
+
+/**
+ * @brief Initiate layout recall
+ *
+ * This function validates the recall, creates the recall object, and
+ * queues CB_LAYOUTRECALL messages.  They are sent from the recall
+ * fridge, batched with whatever else is pending for each client.
+ *
+ * @param[in] handle      Handle on which the layout is held
+ * @param[in] layout_type The type of layout to recall
+ * @param[in] changed     Whether the layout has changed and the
+ *                        client ought to finish writes through MDS
+ * @param[in] segment     Segment to recall
+ * @param[in] cookie      A cookie returned with the return that
+ *                        completely satisfies a recall
+ * @param[in] spec        Lets us be fussy about what clients we send
+ *                        to. May be NULL.
+ *
+ * @retval STATE_SUCCESS if scheduled.
+ * @retval STATE_NOT_FOUND if no matching layouts exist.
+ * @retval STATE_INVALID_ARGUMENT if a nonsensical layout recall has
+ *         been specified.
+ * @retval STATE_MALLOC_ERROR if there was insufficient memory to construct the
+ *         recall state.
+ */
+state_status_t layoutrecall(struct fsal_module *fsal,
+			    struct gsh_buffdesc *handle,
+			    layouttype4 layout_type, bool changed,
+			    const struct pnfs_segment *segment, void *cookie,
+			    struct layoutrecall_spec *spec)
+{
+	/* Return code */
+	state_status_t rc = STATE_SUCCESS;
+	/* Cache entry on which to operate */
+	cache_entry_t *entry = NULL;
+	/* The recall object */
+	struct state_layout_recall_file *recall = NULL;
+	/* Iterator over the work list */
+	struct glist_head *wi = NULL;
 
-	if (cb_data->attempts == 0)
-		now(&cb_data->first_recall);
+	rc = cache_inode_status_to_state_status(up_get(fsal, handle, &entry));
+	if (rc != STATE_SUCCESS)
+		return rc;
 
-	if (nfs4_State_Get_Pointer(cb_data->stateid_other, &s)) {
-		PTHREAD_RWLOCK_wrlock(&s->state_entry->state_lock);
-		code =
-		    nfs_rpc_v41_single(cb_data->client, &cb_data->arg,
-				       &s->state_refer, layoutrec_completion,
-				       cb_data, free_layoutrec);
-		if (code != 0) {
-			/**
-			 * @todo On failure to submit a callback, we
-			 * ought to give the client at least one lease
-			 * period to establish a back channel before
-			 * we start revoking state.  We don't have the
-			 * infrasturcture to properly handle layout
-			 * revocation, however.  Once we get the
-			 * capability to revoke layouts we should
-			 * queue requests on the clientid, obey the
-			 * retransmission rule, and provide a callback
-			 * to dispose of a call and revoke state after
-			 * some number of lease periods.
-			 *
-			 * At present we just assume the client has
-			 * gone completely out to lunch and fake a
-			 * return.
-			 */
+	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
+	/* We build up the list before consuming it so that we have
+	   every state on the list before we start executing returns. */
+	rc = create_file_recall(entry, layout_type, segment, cookie, spec,
+				&recall);
+	PTHREAD_RWLOCK_unlock(&entry->state_lock);
+	if (rc != STATE_SUCCESS)
+		goto out;
 
-			/**
-			 * @todo This is where you would record that a
-			 * recall failed.  (It indicates a transport error.)
-			 * The clientid is specified in
-			 * s->state_owner->so_owner.so_nfs4_owner.so_clientid
-			 * The number of times we retried the call is
-			 * specified in cb_data->attempts and the time
-			 * we specified the first call is in
-			 * cb_data->first_recall.
-			 */
-			if (cb_data->attempts == 0) {
-				delayed_submit(return_one_async, cb_data, 0);
-			} else {
-				bool deleted = false;
-
-				root_op_context.req_ctx.clientid =
-					&s->state_owner->so_owner.so_nfs4_owner
-					.so_clientid;
-				root_op_context.req_ctx.export =
-					s->state_export;
-				root_op_context.req_ctx.fsal_export =
-				    root_op_context.req_ctx.export->fsal_export;
-
-				nfs4_return_one_state(s->state_entry,
-						      LAYOUTRETURN4_FILE,
-						      circumstance_revoke, s,
-						      cb_data->segment, 0, NULL,
-						      &deleted, true);
-				gsh_free(cb_data);
-			}
-		} else {
-			++cb_data->attempts;
+	/**
+	 * @todo This leaves us open to a race if a return comes in
+	 * while we're traversing the work list.
+	 */
+	glist_for_each(wi, &recall->state_list) {
+		/* The current entry in the queue */
+		struct recall_state_list *g = glist_entry(wi,
+							  struct
+							  recall_state_list,
+							  link);
+		struct state_t *s = g->state;
+		struct layoutrecall_cb_data *cb_data;
+		struct gsh_export *exp = s->state_export;
+		cache_entry_t *entry = s->state_entry;
+		nfs_cb_argop4 *arg;
+		CB_LAYOUTRECALL4args *cb_layoutrec;
+
+		cb_data = gsh_malloc(sizeof(struct layoutrecall_cb_data));
+		if (cb_data == NULL) {
+			rc = STATE_MALLOC_ERROR;
+			goto out;
 		}
-		PTHREAD_RWLOCK_unlock(&s->state_entry->state_lock);
-	} else {
-		gsh_free(cb_data);
+		arg = &cb_data->arg;
+		arg->argop = NFS4_OP_CB_LAYOUTRECALL;
+		cb_layoutrec = &arg->nfs_cb_argop4_u.opcblayoutrecall;
+		PTHREAD_RWLOCK_wrlock(&entry->state_lock);
+		cb_layoutrec->clora_type = layout_type;
+		cb_layoutrec->clora_iomode = segment->io_mode;
+		cb_layoutrec->clora_changed = changed;
+		cb_layoutrec->clora_recall.lor_recalltype = LAYOUTRECALL4_FILE;
+		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.
+		    lor_offset = segment->offset;
+		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.
+		    lor_length = segment->length;
+		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.lor_fh.
+		    nfs_fh4_len = sizeof(struct alloc_file_handle_v4);
+		cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.lor_fh.
+		    nfs_fh4_val =
+		    gsh_malloc(sizeof(struct alloc_file_handle_v4));
+		if (cb_layoutrec->clora_recall.layoutrecall4_u.lor_layout.
+				lor_fh.nfs_fh4_val == NULL) {
+			PTHREAD_RWLOCK_unlock(&entry->state_lock);
+			gsh_free(cb_data);
+			rc = STATE_MALLOC_ERROR;
+			goto out;
+		}
+		if (!nfs4_FSALToFhandle(
+				&cb_layoutrec->clora_recall.layoutrecall4_u
+				.lor_layout.lor_fh,
+				entry->obj_handle,
+				exp)) {
+			PTHREAD_RWLOCK_unlock(&entry->state_lock);
+			gsh_free(cb_layoutrec->clora_recall.layoutrecall4_u.
+						lor_layout.lor_fh.nfs_fh4_val);
+			gsh_free(cb_data);
+			rc = STATE_MALLOC_ERROR;
+			goto out;
+		}
+		update_stateid(s,
+			       &cb_layoutrec->clora_recall.layoutrecall4_u.
+			       lor_layout.lor_stateid, NULL, "LAYOUTRECALL");
+		memcpy(cb_data->stateid_other, s->stateid_other, OTHERSIZE);
+		cb_data->segment = *segment;
+		cb_data->client =
+		    s->state_owner->so_owner.so_nfs4_owner.so_clientrec;
+		inc_client_id_ref(cb_data->client);
+		cb_data->attempts = 0;
+		now(&cb_data->first_recall);
+		PTHREAD_RWLOCK_unlock(&entry->state_lock);
+		(void)atomic_inc_uint64_t(&recall_st.recalls);
+		recall_enqueue(cb_data);
 	}
-	release_root_op_context();
-}
-
-/**
- * @brief Data for CB_NOTIFY and CB_NOTIFY_DEVICEID response handler
- */
-
-struct cb_notify {
-	nfs_cb_argop4 arg;	/*< Arguments (so we can free them) */
-	struct notify4 notify;	/*< For notify response */
-	struct notify_deviceid_delete4 notify_del;	/*< For notify_deviceid
-							   response. */
-};
-
-/**
- * @brief Handle CB_NOTIFY_DEVICE response
- *
- * @param[in] call  The RPC call being completed
- * @param[in] hook  The hook itself
- * @param[in] arg   Supplied argument (the callback data)
- * @param[in] flags There are no flags.
- *
- * @return 0, constantly.
- */
 
-static int32_t notifydev_completion(rpc_call_t *call, rpc_call_hook hook,
-				    void *arg, uint32_t flags)
-{
-	LogFullDebug(COMPONENT_NFS_CB, "status %d arg %p",
-		     call->cbt.v_u.v4.res.status, arg);
-	gsh_free(arg);
-	return 0;
+ out:
+	cache_inode_put(entry);
+	return rc;
 }
 
 /**
@@ -971,7 +1392,11 @@ struct devnotify_cb_data {
 };
 
 /**
- * @brief Send a single notifydev to a single client
+ * @brief Queue a notifydev to a single client
+ *
+ * Runs with the client table locked, so it only queues.  The
+ * notification goes out with whatever else is pending for the
+ * client.
  *
  * @param[in] clientid  The client record
  * @param[in] devnotify The device notify args
@@ -982,47 +1407,34 @@ struct devnotify_cb_data {
 static bool devnotify_client_callback(nfs_client_id_t *clientid,
 				      void *devnotify)
 {
-	int code = 0;
-	CB_NOTIFY_DEVICEID4args *cb_notify_dev;
-	struct cb_notify *arg;
 	struct devnotify_cb_data *devicenotify = devnotify;
+	struct devnotify_pending *dn;
+	struct recall_client *rc;
 
-	if (clientid) {
-		LogFullDebug(COMPONENT_NFS_CB,
-			     "CliP %p ClientID=%" PRIx64 " ver %d", clientid,
-			     clientid->cid_clientid,
-			     clientid->cid_minorversion);
-	} else {
-		return false;
-	}
+	LogFullDebug(COMPONENT_NFS_CB,
+		     "CliP %p ClientID=%" PRIx64 " ver %d", clientid,
+		     clientid->cid_clientid, clientid->cid_minorversion);
 
-	/* free in notifydev_completion */
-	arg = gsh_malloc(sizeof(struct cb_notify));
-	if (arg == NULL)
+	dn = gsh_malloc(sizeof(struct devnotify_pending));
+	if (dn == NULL)
 		return false;
 
-	cb_notify_dev = &arg->arg.nfs_cb_argop4_u.opcbnotify_deviceid;
+	dn->notify_type = devicenotify->notify_type;
+	dn->layout_type = devicenotify->layout_type;
+	dn->devid = devicenotify->devid;
 
-	arg->arg.argop = NFS4_OP_CB_NOTIFY_DEVICEID;
+	PTHREAD_MUTEX_lock(&recall.mtx);
+	rc = recall_client_get(clientid);
+	if (rc != NULL)
+		glist_add_tail(&rc->notifies, &dn->link);
+	PTHREAD_MUTEX_unlock(&recall.mtx);
 
-	cb_notify_dev->cnda_changes.cnda_changes_len = 1;
-	cb_notify_dev->cnda_changes.cnda_changes_val = &arg->notify;
-	arg->notify.notify_mask.bitmap4_len = 1;
-	arg->notify.notify_mask.map[0] = devicenotify->notify_type;
-	arg->notify.notify_vals.notifylist4_len =
-	    sizeof(struct notify_deviceid_delete4);
-
-	arg->notify.notify_vals.notifylist4_val = (char *)&arg->notify_del;
-	arg->notify_del.ndd_layouttype = devicenotify->layout_type;
-	memcpy(arg->notify_del.ndd_deviceid,
-	       &devicenotify->devid,
-	       sizeof(arg->notify_del.ndd_deviceid));
-	code =
-	    nfs_rpc_v41_single(clientid, &arg->arg, NULL, notifydev_completion,
-			       &arg->arg, NULL);
-	if (code != 0)
-		gsh_free(arg);
+	if (rc == NULL) {
+		gsh_free(dn);
+		return false;
+	}
 
+	(void)atomic_inc_uint64_t(&recall_st.notifies);
 	return true;
 }
 
@@ -1051,11 +1463,87 @@ state_status_t notify_device(notify_deviceid_type4 notify_type,
 		.devid = devid
 	};
 
-	nfs41_foreach_client_callback(devnotify_client_callback, &cb_data);
+	nfs41_foreach_client(devnotify_client_callback, &cb_data);
 
 	return STATE_SUCCESS;
 }
 
+/**
+ * @brief Start the fridge sending layout recalls
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
+int layoutrecall_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	pthread_mutex_init(&recall.mtx, NULL);
+	pthread_cond_init(&recall.cv, NULL);
+	glist_init(&recall.queue);
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = RECALL_THREADS;
+	frp.thr_min = 0;
+	frp.thread_delay = 60;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_fail;
+
+	rc = fridgethr_init(&recall_fridge, "Recall", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_NFS_CB,
+			 "Unable to initialize recall fridge, error code %d.",
+			 rc);
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Stop the fridge sending layout recalls
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
+int layoutrecall_pkgshutdown(void)
+{
+	int rc;
+
+	if (recall_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(recall_fridge,
+				    fridgethr_comm_stop,
+				    120);
+
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_NFS_CB,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(recall_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_NFS_CB,
+			 "Failed shutting down recall fridge: %d", rc);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Read the layout recall counters
+ *
+ * @param[out] stats Filled in
+ */
+
+void layoutrecall_get_stats(struct layoutrecall_stats *stats)
+{
+	PTHREAD_MUTEX_lock(&recall.mtx);
+	*stats = recall_st;
+	stats->inflight = recall.inflight;
+	PTHREAD_MUTEX_unlock(&recall.mtx);
+}
+
 /**
  * @brief Handle the reply to a DELEGRECALL
  *
@@ -1228,6 +1716,12 @@ state_status_t delegrecall(cache_entry_t *entry, bool rwlocked)
 		    found_entry->sle_state == NULL)
 			continue;
 
+		/* Conflicting accesses retry until the delegation is
+		 * returned, don't recall it again for each of them.
+		 */
+		if (found_entry->sle_state->state_data.deleg.sd_recall_pending)
+			continue;
+
 		LogDebug(COMPONENT_NFS_CB, "found_entry %p", found_entry);
 
 		clfl_stats =
@@ -1235,15 +1729,15 @@ state_status_t delegrecall(cache_entry_t *entry, bool rwlocked)
 		cl_stats = &clfl_stats->clientid->deleg_heuristics;
 		clfl_stats->num_recalls++;
 		cl_stats->tot_recalls++;
+		entry->object.file.deleg_heuristics.last_recall = time(NULL);
 
 		switch (delegrecall_one(found_entry, entry)) {
 		case NFS_CB_CALL_FINISHED:
-			break;
 		case NFS_CB_CALL_NONE:
-			break;
 		case NFS_CB_CALL_QUEUED:
-			break;
 		case NFS_CB_CALL_DISPATCH:
+			found_entry->sle_state->state_data.deleg.
+				sd_recall_pending = true;
 			break;
 		case NFS_CB_CALL_ABORTED:
 			LogCrit(COMPONENT_NFS_CB, "Failed to recall, aborted!");
@@ -1268,6 +1762,215 @@ state_status_t delegrecall(cache_entry_t *entry, bool rwlocked)
 	return rc;
 }
 
+/**
+ * @brief Context for an outstanding CB_GETATTR
+ */
+
+struct cbgetattr_cb_data {
+	cache_entry_t *entry;	/*< File being queried, referenced */
+	nfs_client_id_t *clid;	/*< Delegation holder, referenced */
+};
+
+/**
+ * @brief Handle the reply to a CB_GETATTR
+ *
+ * The size and change attribute reported by the write delegation
+ * holder are kept with the delegation statistics of the file, where
+ * GETATTR from other clients merges them into its reply.  They are not
+ * written into the cached attributes, which the next refresh from the
+ * FSAL would overwrite.  If the holder cannot be reached, the
+ * delegation is recalled.
+ *
+ * @param[in] call  The RPC call being completed
+ * @param[in] hook  The hook itself
+ * @param[in] arg   Supplied argument (the callback data)
+ * @param[in] flags There are no flags.
+ *
+ * @return 0, constantly.
+ */
+
+static int32_t delegcbgetattr_completion_func(rpc_call_t *call,
+					      rpc_call_hook hook, void *arg,
+					      uint32_t flags)
+{
+	struct cbgetattr_cb_data *cb_data = arg;
+	cache_entry_t *entry = cb_data->entry;
+	nfs_client_id_t *clid = cb_data->clid;
+	struct file_deleg_heuristics *statistics =
+		&entry->object.file.deleg_heuristics;
+	CB_GETATTR4res *res = NULL;
+	struct attrlist attrs;
+	bool recall = true;
+
+	memset(&attrs, 0, sizeof(attrs));
+
+	LogDebug(COMPONENT_NFS_CB, "%p %s", call,
+		 (hook ==
+		  RPC_CALL_ABORT) ? "RPC_CALL_ABORT" : "RPC_CALL_COMPLETE");
+
+	if (hook == RPC_CALL_COMPLETE && call->stat == RPC_SUCCESS &&
+	    call->cbt.v_u.v4.res.resarray.resarray_len > 0)
+		res = &call->cbt.v_u.v4.res.resarray.resarray_val->
+			nfs_cb_resop4_u.opcbgetattr;
+
+	if (res != NULL && res->status == NFS4_OK) {
+		if (nfs4_Fattr_To_FSAL_attr(&attrs,
+					    &res->CB_GETATTR4res_u.resok4.
+					    obj_attributes,
+					    NULL) == NFS4_OK)
+			recall = false;
+		nfs4_Fattr_Free(&res->CB_GETATTR4res_u.resok4.obj_attributes);
+	} else if (hook == RPC_CALL_COMPLETE && call->stat != RPC_SUCCESS) {
+		/* Mark the channel down if the rpc call failed */
+		pthread_mutex_lock(&clid->cid_mutex);
+		clid->cb_chan_down = true;
+		pthread_mutex_unlock(&clid->cid_mutex);
+	}
+
+	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
+	statistics->cbgetattr_pending = false;
+	statistics->cbgetattr_time = time(NULL);
+	if (recall) {
+		statistics->cbgetattr_mask = 0;
+		LogDebug(COMPONENT_NFS_CB,
+			 "CB_GETATTR failed on entry %p, recalling", entry);
+		delegrecall(entry, true);
+	} else {
+		statistics->cbgetattr_mask =
+			attrs.mask & (ATTR_SIZE | ATTR_CHANGE);
+		statistics->cbgetattr_size = attrs.filesize;
+		statistics->cbgetattr_change = attrs.change;
+	}
+	PTHREAD_RWLOCK_unlock(&entry->state_lock);
+
+	gsh_free(call->cbt.v_u.v4.args.argarray.argarray_val->
+		 nfs_cb_argop4_u.opcbgetattr.fh.nfs_fh4_val);
+	cb_compound_free(&call->cbt);
+	dec_client_id_ref(clid);
+	cache_inode_put(entry);
+	gsh_free(cb_data);
+	return 0;
+}
+
+/**
+ * @brief Ask the write delegation holder for size and change
+ *
+ * Send CB_GETATTR to the client holding a write delegation on the
+ * file.  The reply is processed asynchronously and the caller is
+ * expected to have the requester retry.
+ * Note: Entry state_lock must be held for write.
+ *
+ * @param[in] entry File on which a write delegation is held
+ *
+ * @return STATE_SUCCESS if the callback was sent, errors otherwise.
+ */
+state_status_t delegcbgetattr(cache_entry_t *entry)
+{
+	struct glist_head *glist;
+	state_lock_entry_t *found_entry = NULL;
+	struct file_deleg_heuristics *statistics =
+		&entry->object.file.deleg_heuristics;
+	struct gsh_export *exp;
+	nfs_client_id_t *clid = NULL;
+	rpc_call_channel_t *chan;
+	rpc_call_t *call;
+	nfs_cb_argop4 argop[1];
+	struct cbgetattr_cb_data *cb_data;
+	char *maxfh;
+	int32_t code;
+
+	if (statistics->cbgetattr_pending)
+		return STATE_SUCCESS;
+
+	glist_for_each(glist, &entry->object.file.deleg_list) {
+		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+		if (found_entry->sle_type == LEASE_LOCK &&
+		    found_entry->sle_state != NULL &&
+		    found_entry->sle_state->state_data.deleg.sd_type ==
+		    OPEN_DELEGATE_WRITE)
+			break;
+		found_entry = NULL;
+	}
+
+	if (found_entry == NULL)
+		return STATE_NOT_FOUND;
+
+	exp = found_entry->sle_state->state_export;
+
+	code =
+	    nfs_client_id_get_confirmed(found_entry->sle_owner->so_owner.
+					so_nfs4_owner.so_clientid, &clid);
+	if (code != CLIENT_ID_SUCCESS) {
+		LogCrit(COMPONENT_NFS_CB, "No clid record  code %d", code);
+		return STATE_NOT_FOUND;
+	}
+
+	pthread_mutex_lock(&clid->cid_mutex);
+	if (clid->cb_chan_down) {
+		pthread_mutex_unlock(&clid->cid_mutex);
+		LogDebug(COMPONENT_NFS_CB,
+			 "Call back channel down, not issuing CB_GETATTR");
+		dec_client_id_ref(clid);
+		return STATE_SIGNAL_ERROR;
+	}
+	pthread_mutex_unlock(&clid->cid_mutex);
+
+	chan = nfs_rpc_get_chan(clid, NFS_RPC_FLAG_NONE);
+	if (!chan || !chan->clnt) {
+		LogCrit(COMPONENT_NFS_CB, "nfs_rpc_get_chan failed");
+		pthread_mutex_lock(&clid->cid_mutex);
+		clid->cb_chan_down = true;
+		pthread_mutex_unlock(&clid->cid_mutex);
+		dec_client_id_ref(clid);
+		return STATE_SIGNAL_ERROR;
+	}
+
+	cb_data = gsh_malloc(sizeof(*cb_data));
+	maxfh = gsh_malloc(NFS4_FHSIZE); /* free in completion func */
+	if (cb_data == NULL || maxfh == NULL) {
+		gsh_free(cb_data);
+		gsh_free(maxfh);
+		dec_client_id_ref(clid);
+		return STATE_MALLOC_ERROR;
+	}
+
+	memset(argop, 0, sizeof(nfs_cb_argop4));
+	argop->argop = NFS4_OP_CB_GETATTR;
+	argop->nfs_cb_argop4_u.opcbgetattr.fh.nfs_fh4_len = 0;
+	argop->nfs_cb_argop4_u.opcbgetattr.fh.nfs_fh4_val = maxfh;
+	set_attribute_in_bitmap(&argop->nfs_cb_argop4_u.opcbgetattr.
+				attr_request, FATTR4_CHANGE);
+	set_attribute_in_bitmap(&argop->nfs_cb_argop4_u.opcbgetattr.
+				attr_request, FATTR4_SIZE);
+
+	if (!nfs4_FSALToFhandle(&argop->nfs_cb_argop4_u.opcbgetattr.fh,
+				entry->obj_handle, exp)) {
+		gsh_free(cb_data);
+		gsh_free(maxfh);
+		dec_client_id_ref(clid);
+		return STATE_SIGNAL_ERROR;
+	}
+
+	/* allocate a new call--freed in completion hook */
+	call = alloc_rpc_call();
+	call->chan = chan;
+
+	cb_compound_init_v4(&call->cbt, 1, 0,
+			    clid->cid_cb.v40.cb_callback_ident, "getattr",
+			    7);
+	cb_compound_add_op(&call->cbt, argop);
+	call->call_hook = delegcbgetattr_completion_func;
+
+	/* Hold the entry until the reply comes back */
+	cache_inode_lru_ref(entry, LRU_FLAG_NONE);
+	cb_data->entry = entry;
+	cb_data->clid = clid;
+	statistics->cbgetattr_pending = true;
+
+	nfs_rpc_submit_call(call, cb_data, NFS_RPC_FLAG_NONE);
+	return STATE_SUCCESS;
+}
+
 /**
  * @brief Recall a delegation
  *
@@ -59,6 +59,7 @@
 #include "client_mgr.h"
 #include "server_stats.h"
 #include "9p.h"
+#include "gsh_bufpool.h"
 #include <stdbool.h>
 
 #define P_FAMILY AF_INET6
@@ -149,8 +150,14 @@ void *_9p_socket_thread(void *Arg)
 	}
 	atomic_store_uint32_t(&_9p_conn.refcount, 0);
 
-	/* Init the fids pointers array */
-	memset(&_9p_conn.fids, 0, _9P_FID_PER_CONN * sizeof(struct _9p_fid *));
+	/* Init the fid table */
+	if (_9p_init_fids(&_9p_conn, _9p_param._9p_max_fids) != 0) {
+		LogCrit(COMPONENT_9P,
+			"Could not allocate fid table for socket %ld",
+			tcp_sock);
+		close(tcp_sock);
+		pthread_exit(NULL);
+	}
 
 	/* Set initial msize.
 	 * Client may request a lower value during TVERSION */
@@ -232,7 +239,7 @@ void *_9p_socket_thread(void *Arg)
 			continue;
 
 		/* Prepare to read the message */
-		_9pmsg = gsh_malloc(_9p_conn.msize);
+		_9pmsg = gsh_buf_alloc(_9p_conn.msize);
 		if (_9pmsg == NULL) {
 			LogCrit(COMPONENT_9P,
 				"Could not allocate 9pmsg buffer for client %s on socket %lu",
@@ -333,7 +340,7 @@ end:
 	/* Free buffer if we encountered an error
 	 * before we could give it to a worker */
 	if (_9pmsg)
-		gsh_free(_9pmsg);
+		gsh_buf_free(_9pmsg);
 
 	while (atomic_fetch_uint32_t(&_9p_conn.refcount)) {
 		LogEvent(COMPONENT_9P, "Waiting for workers to release pconn");
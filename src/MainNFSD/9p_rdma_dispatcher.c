@@ -81,10 +81,10 @@ static void *_9p_rdma_cleanup_conn_thread(void *arg)
 			 trans);
 
 		if (priv->pconn) {
+			_9p_cleanup_fids(priv->pconn);
+
 			if (priv->pconn->client != NULL)
 				put_gsh_client(priv->pconn->client);
-
-			_9p_cleanup_fids(priv->pconn);
 		}
 
 		if (priv->pconn)
@@ -162,10 +162,12 @@ void *_9p_rdma_thread(void *Arg)
 	p_9p_conn->client =
 		get_gsh_client((sockaddr_t *)msk_get_dst_addr(trans), false);
 
-	/* Init the fids pointers array */
-	memset(&p_9p_conn->fids,
-	       0,
-	       _9P_FID_PER_CONN * sizeof(struct _9p_fid *));
+	/* Init the fid table */
+	if (_9p_init_fids(p_9p_conn, _9p_param._9p_max_fids) != 0) {
+		LogMajor(COMPONENT_9P,
+			 "9P/RDMA: could not allocate fid table");
+		goto error;
+	}
 
 	/* Set initial msize.
 	 * Client may request a lower value during TVERSION */
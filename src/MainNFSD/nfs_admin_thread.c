@@ -41,6 +41,10 @@
 #include "idmapper.h"
 #include "delayed_exec.h"
 #include "export_mgr.h"
+#include "nfs_exports.h"
+#include "config_parsing.h"
+#include "nfs_proto_functions.h"
+#include "fsal_up.h"
 #ifdef USE_DBUS
 #include "ganesha_dbus.h"
 #endif
@@ -67,6 +71,7 @@ static pthread_cond_t admin_control_cv = PTHREAD_COND_INITIALIZER;
 typedef enum {
 	admin_none_pending,	/*< No command.  The admin thread sets this on
 				   startup and after */
+	admin_reload_exports,	/*< Reload exports from the config file */
 	admin_shutdown		/*< Shut down Ganesha */
 } admin_command_t;
 
@@ -224,10 +229,48 @@ static struct gsh_dbus_method method_purge_gids = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief Dbus method for reloading the exports
+ *
+ * @param[in]  args  Unused
+ * @param[out] reply Unused
+ */
+
+static bool admin_dbus_reload(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	char *errormsg = "Export reload started";
+	bool success = true;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args != NULL) {
+		errormsg = "Reload takes no arguments.";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+
+	admin_replace_exports();
+
+ out:
+	dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_reload = {
+	.name = "reload",
+	.method = admin_dbus_reload,
+	.args = {STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *admin_methods[] = {
 	&method_shutdown,
 	&method_grace_period,
 	&method_purge_gids,
+	&method_reload,
 	NULL
 };
 
@@ -278,12 +321,12 @@ static void admin_issue_command(admin_command_t command)
 }
 
 /**
- * @brief Signal the admin thread to replace the exports
+ * @brief Signal the admin thread to reload the exports
  */
 
 void admin_replace_exports(void)
 {
-	admin_issue_command(admin_command);
+	admin_issue_command(admin_reload_exports);
 }
 
 /**
@@ -338,6 +381,16 @@ static void do_shutdown(void)
 		LogEvent(COMPONENT_THREAD, "Request threads shut down.");
 	}
 
+	/* Recall senders wait on replies handled by the workers */
+	rc = layoutrecall_pkgshutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down recall fridge: %d", rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "Recall fridge shut down.");
+	}
+
 	LogEvent(COMPONENT_MAIN, "Stopping worker threads");
 
 	rc = worker_shutdown();
@@ -355,6 +408,15 @@ static void do_shutdown(void)
 	Clean_RPC(); /* we MUST do this first */
 	(void)svc_shutdown(SVC_SHUTDOWN_FLAG_NONE);
 
+	rc = nfs4_compound_pkgshutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down compound fridge: %d", rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "Compound fridge shut down.");
+	}
+
 	rc = general_fridge_shutdown();
 	if (rc != 0) {
 		LogMajor(COMPONENT_THREAD,
@@ -364,6 +426,15 @@ static void do_shutdown(void)
 		LogEvent(COMPONENT_THREAD, "General fridge shut down.");
 	}
 
+	rc = cache_inode_data_pkgshutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down readahead fridge: %d", rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "Readahead fridge shut down.");
+	}
+
 	rc = reaper_shutdown();
 	if (rc != 0) {
 		LogMajor(COMPONENT_THREAD,
@@ -408,12 +479,55 @@ static void do_shutdown(void)
 	unlink(pidfile_path);
 }
 
+/**
+ * @brief Reparse the config file and apply the export changes
+ */
+
+static void do_reload_exports(void)
+{
+	config_file_t config_struct;
+	struct config_error_type err_type;
+	int rc;
+
+	LogEvent(COMPONENT_MAIN, "Reloading exports from %s", config_path);
+
+	config_struct = config_ParseFile(config_path, &err_type);
+	if (!config_error_is_harmless(&err_type)) {
+		char *errstr = err_type_str(&err_type);
+
+		LogCrit(COMPONENT_MAIN,
+			"Error %s while parsing (%s), exports not reloaded",
+			errstr != NULL ? errstr : "unknown", config_path);
+		if (errstr != NULL)
+			gsh_free(errstr);
+		if (config_struct != NULL)
+			config_Free(config_struct);
+		return;
+	}
+
+	rc = ReloadExports(config_struct, &err_type);
+	if (rc < 0 || !config_error_is_harmless(&err_type))
+		LogCrit(COMPONENT_MAIN,
+			"Errors while reloading exports from %s",
+			config_path);
+
+	config_Free(config_struct);
+}
+
 void *admin_thread(void *UnusedArg)
 {
 	SetNameFunction("Admin");
 
 	pthread_mutex_lock(&admin_control_mtx);
 	while (admin_command != admin_shutdown) {
+		if (admin_command == admin_reload_exports) {
+			admin_command = admin_none_pending;
+			pthread_cond_broadcast(&admin_control_cv);
+			pthread_mutex_unlock(&admin_control_mtx);
+			do_reload_exports();
+			pthread_mutex_lock(&admin_control_mtx);
+			continue;
+		}
 		if (admin_command != admin_none_pending)
 			continue;
 		pthread_cond_wait(&admin_control_cv, &admin_control_mtx);
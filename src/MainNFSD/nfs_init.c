@@ -64,10 +64,12 @@
 #include "nsm.h"
 #include "sal_functions.h"
 #include "fridgethr.h"
+#include "fsal_up.h"
 #include "idmapper.h"
 #include "delayed_exec.h"
 #include "client_mgr.h"
 #include "export_mgr.h"
+#include "gsh_bufpool.h"
 #ifdef USE_CAPS
 #include <sys/capability.h>	/* For capget/capset */
 #endif
@@ -466,6 +468,22 @@ static void nfs_Start_threads(void)
 	}
 	LogEvent(COMPONENT_THREAD, "General fridge was started successfully");
 
+	/* Starting the parallel compound fridge */
+	rc = nfs4_compound_pkginit();
+	if (rc != 0) {
+		LogFatal(COMPONENT_THREAD,
+			 "Could not create compound fridge, error = %d (%s)",
+			 rc, strerror(rc));
+	}
+
+	/* Starting the layout recall fridge */
+	rc = layoutrecall_pkginit();
+	if (rc != 0) {
+		LogFatal(COMPONENT_THREAD,
+			 "Could not create recall fridge, error = %d (%s)",
+			 rc, strerror(rc));
+	}
+
 }
 
 /**
@@ -474,6 +492,36 @@ static void nfs_Start_threads(void)
  * @param[in] p_start_info Unused
  */
 
+/* End of the last startup phase logged by nfs_startup_mark */
+static struct timespec startup_last;
+
+/**
+ * @brief Log the end of a startup phase
+ *
+ * Logs how long the phase took and the time elapsed since the server
+ * started, so a slow start can be pinned on configuration parsing,
+ * export creation, root lookups or one of the subsystems.
+ *
+ * @param[in] phase What was just finished
+ */
+
+void nfs_startup_mark(const char *phase)
+{
+	struct timespec ts;
+	nsecs_elapsed_t since_last;
+
+	now(&ts);
+	if (startup_last.tv_sec == 0 && startup_last.tv_nsec == 0)
+		startup_last = ServerBootTime;
+	since_last = timespec_diff(&startup_last, &ts);
+	startup_last = ts;
+
+	LogEvent(COMPONENT_INIT,
+		 "Startup: %s in %" PRIu64 " ms (%" PRIu64 " ms since start)",
+		 phase, since_last / NS_PER_MSEC,
+		 timespec_diff(&ServerBootTime, &ts) / NS_PER_MSEC);
+}
+
 static void nfs_Init(const nfs_start_info_t *p_start_info)
 {
 	int rc = 0;
@@ -490,6 +538,12 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	dbus_client_init();
 #endif
 
+	rc = gsh_bufpool_pkginit();
+	if (rc != 0) {
+		LogFatal(COMPONENT_INIT,
+			 "Unable to initialize buffer pool: %d.", rc);
+	}
+
 	/* Cache Inode LRU (call this here, rather than as part of
 	   cache_inode_init() so the GC policy has been set */
 	rc = cache_inode_lru_pkginit();
@@ -498,15 +552,29 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 			 "Unable to initialize LRU subsystem: %d.", rc);
 	}
 
+	rc = cache_inode_data_pkginit();
+	if (rc != 0) {
+		LogFatal(COMPONENT_INIT,
+			 "Unable to initialize data cache: %d.", rc);
+	}
+
+	rc = up_queue_pkginit();
+	if (rc != 0) {
+		LogFatal(COMPONENT_INIT,
+			 "Unable to initialize upcall queue: %d.", rc);
+	}
+
 	/* acls cache may be needed by exports_pkginit */
 	LogDebug(COMPONENT_INIT, "Now building NFSv4 ACL cache");
 	if (nfs4_acls_init() != 0)
 		LogFatal(COMPONENT_INIT, "Error while initializing NFSv4 ACLs");
 	LogInfo(COMPONENT_INIT, "NFSv4 ACL cache successfully initialized");
+	nfs_startup_mark("caches set up");
 
 	/* finish the job with exports by caching the root entries
 	 */
 	exports_pkginit();
+	nfs_startup_mark("export roots looked up");
 
 	nfs41_session_pool =
 	    pool_init("NFSv4.1 session pool", sizeof(nfs41_session_t),
@@ -604,6 +672,7 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* RPC Initialisation - exits on failure */
 	nfs_Init_svc();
 	LogInfo(COMPONENT_INIT, "RPC ressources successfully initialized");
+	nfs_startup_mark("RPC set up");
 
 	/* Admin initialisation */
 	nfs_Init_admin_thread();
@@ -695,7 +764,7 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* Create stable storage directory, this needs to be done before
 	 * starting the recovery thread.
 	 */
-	nfs4_create_recov_dir();
+	nfs4_recovery_init();
 
 	/* initialize grace and read in the client IDs */
 	nfs4_init_grace();
@@ -821,9 +890,11 @@ void nfs_start(nfs_start_info_t *p_start_info)
 
 	/* Initialize all layers and service threads */
 	nfs_Init(p_start_info);
+	nfs_startup_mark("subsystems initialized");
 
 	/* Spawns service threads */
 	nfs_Start_threads();
+	nfs_startup_mark("service threads started");
 
 	if (nfs_param.core_param.enable_NLM) {
 		/* NSM Unmonitor all */
@@ -845,7 +916,9 @@ void nfs_start(nfs_start_info_t *p_start_info)
 
 	/* if not in grace period, clean up the old state directory */
 	if (!nfs_in_grace())
-		nfs4_clean_old_recov_dir(v4_old_dir);
+		nfs4_clean_old_recov_dir();
+
+	nfs4_recovery_shutdown();
 
 	Cleanup();
 
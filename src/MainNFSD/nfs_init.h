@@ -67,4 +67,10 @@ int init_server_pkgs(void);
  */
 void nfs_start(nfs_start_info_t *p_start_info);
 
+/**
+ * nfs_startup_mark:
+ * Log how long a startup phase took.
+ */
+void nfs_startup_mark(const char *phase);
+
 #endif				/* !NFS_INIT_H */
@@ -391,10 +391,13 @@ int main(int argc, char *argv[])
 	if (read_log_config(config_struct) < 0)
 		LogFatal(COMPONENT_INIT,
 			 "Error while parsing log configuration");
+	nfs_startup_mark("configuration parsed");
+
 	/* We need all the fsal modules loaded so we can have
 	 * the list available at exports parsing time.
 	 */
 	start_fsals();
+	nfs_startup_mark("FSALs loaded");
 
 	/* parse configuration file */
 
@@ -407,6 +410,7 @@ int main(int argc, char *argv[])
 	if (init_server_pkgs() != 0)
 		LogFatal(COMPONENT_INIT,
 			 "Failed to initialize server packages");
+	nfs_startup_mark("server packages initialized");
 
 	/* Load export entries from parsed file
 	 * returns the number of export entries.
@@ -418,6 +422,7 @@ int main(int argc, char *argv[])
 	else if (rc == 0)
 		LogWarn(COMPONENT_INIT,
 			"No export entries found in configuration file !!!");
+	nfs_startup_mark("exports created");
 
 	/* freeing syntax tree : */
 
@@ -1057,33 +1057,137 @@ int32_t nfs_rpc_abort_call(rpc_call_t *call)
 	return 0;
 }
 
+/**
+ * @brief Free the referring call lists of a CB_SEQUENCE
+ *
+ * @param[in] sequence The CB_SEQUENCE arguments
+ */
+static void free_referring_calls(CB_SEQUENCE4args *sequence)
+{
+	referring_call_list4 *lists =
+	    sequence->csa_referring_call_lists.csa_referring_call_lists_val;
+	uint32_t i;
+
+	if (lists == NULL)
+		return;
+
+	for (i = 0;
+	     i < sequence->csa_referring_call_lists.
+	     csa_referring_call_lists_len; i++)
+		gsh_free(lists[i].rcl_referring_calls.rcl_referring_calls_val);
+	gsh_free(lists);
+}
+
+/**
+ * @brief Build the referring call lists of a CB_SEQUENCE
+ *
+ * The calls are grouped in one list per session, as RFC 5661
+ * 20.9.3 requires.
+ *
+ * @param[out] sequence The CB_SEQUENCE arguments
+ * @param[in]  refers   Referral data, one per operation, entries may
+ *                      be NULL
+ * @param[in]  n_refers Number of entries in refers
+ *
+ * @return false if out of memory.
+ */
+static bool build_referring_calls(CB_SEQUENCE4args *sequence,
+				  struct state_refer **refers,
+				  uint32_t n_refers)
+{
+	referring_call_list4 *lists;
+	referring_call_list4 *list;
+	referring_call4 *calls;
+	uint32_t n_lists = 0, n_calls;
+	uint32_t i, j, k;
+
+	sequence->csa_referring_call_lists.csa_referring_call_lists_len = 0;
+	sequence->csa_referring_call_lists.csa_referring_call_lists_val = NULL;
+
+	for (i = 0; i < n_refers; i++)
+		if (refers[i] != NULL)
+			break;
+	if (i == n_refers)
+		return true;
+
+	lists = gsh_calloc(n_refers, sizeof(referring_call_list4));
+	if (lists == NULL)
+		return false;
+	sequence->csa_referring_call_lists.csa_referring_call_lists_val = lists;
+
+	for (i = 0; i < n_refers; i++) {
+		if (refers[i] == NULL)
+			continue;
+
+		for (j = 0; j < n_lists; j++)
+			if (memcmp(lists[j].rcl_sessionid, refers[i]->session,
+				   NFS4_SESSIONID_SIZE) == 0)
+				break;
+
+		list = &lists[j];
+		if (j == n_lists) {
+			list->rcl_referring_calls.rcl_referring_calls_val =
+			    gsh_malloc(n_refers * sizeof(referring_call4));
+			if (list->rcl_referring_calls.rcl_referring_calls_val ==
+			    NULL) {
+				free_referring_calls(sequence);
+				sequence->csa_referring_call_lists.
+				    csa_referring_call_lists_val = NULL;
+				return false;
+			}
+			memcpy(list->rcl_sessionid, refers[i]->session,
+			       NFS4_SESSIONID_SIZE);
+			sequence->csa_referring_call_lists.
+			    csa_referring_call_lists_len = ++n_lists;
+		}
+
+		/* Recalls of several layouts may refer to the same call */
+		calls = list->rcl_referring_calls.rcl_referring_calls_val;
+		n_calls = list->rcl_referring_calls.rcl_referring_calls_len;
+		for (k = 0; k < n_calls; k++)
+			if (calls[k].rc_sequenceid == refers[i]->sequence &&
+			    calls[k].rc_slotid == refers[i]->slot)
+				break;
+		if (k < n_calls)
+			continue;
+
+		calls[k].rc_sequenceid = refers[i]->sequence;
+		calls[k].rc_slotid = refers[i]->slot;
+		list->rcl_referring_calls.rcl_referring_calls_len++;
+	}
+
+	return true;
+}
+
 /**
  * @brief Construct a CB_COMPOUND for v41
  *
- * This function constructs a compound with a CB_SEQUENCE and one
- * other operation.
+ * This function constructs a compound with a CB_SEQUENCE and the
+ * supplied operations.
  *
  * @param[in] session Session on whose back channel we make the call
- * @param[in] op      The operation to add
- * @param[in] refer   Referral data, NULL if none
+ * @param[in] ops     The operations to add
+ * @param[in] n_ops   Number of operations
+ * @param[in] refers  Referral data of each operation, NULL if none
  * @param[in] slot    Slot number to use
  *
  * @return The constructed call or NULL.
  */
-static rpc_call_t *construct_single_call(nfs41_session_t *session,
-					 nfs_cb_argop4 *op,
-					 struct state_refer *refer,
-					 slotid4 slot, slotid4 highest_slot)
+static rpc_call_t *construct_v41_call(nfs41_session_t *session,
+				      nfs_cb_argop4 *ops, uint32_t n_ops,
+				      struct state_refer **refers,
+				      slotid4 slot, slotid4 highest_slot)
 {
 	rpc_call_t *call = alloc_rpc_call();
 	nfs_cb_argop4 sequenceop;
 	CB_SEQUENCE4args *sequence = &sequenceop.nfs_cb_argop4_u.opcbsequence;
+	uint32_t i;
 
 	if (!call)
 		return NULL;
 
 	call->chan = &session->cb_chan;
-	cb_compound_init_v4(&call->cbt, 2,
+	cb_compound_init_v4(&call->cbt, n_ops + 1,
 			    session->clientid_record->cid_minorversion, 0, NULL,
 			    0);
 	memset(sequence, 0, sizeof(CB_SEQUENCE4args));
@@ -1095,39 +1199,14 @@ static rpc_call_t *construct_single_call(nfs41_session_t *session,
 	sequence->csa_slotid = slot;
 	sequence->csa_highest_slotid = highest_slot;
 	sequence->csa_cachethis = false;
-	if (refer) {
-		referring_call_list4 *list =
-		    gsh_calloc(1, sizeof(referring_call_list4));
-		referring_call4 *ref_call = NULL;
-		if (!list) {
-			free_rpc_call(call);
-			return NULL;
-		}
-		ref_call = gsh_malloc(sizeof(referring_call4));
-		if (!ref_call) {
-			gsh_free(list);
-			free_rpc_call(call);
-			return NULL;
-		}
-		sequence->
-		    csa_referring_call_lists.csa_referring_call_lists_len = 1;
-		sequence->
-		    csa_referring_call_lists.csa_referring_call_lists_val =
-		    list;
-		memcpy(list->rcl_sessionid, refer->session,
-		       sizeof(NFS4_SESSIONID_SIZE));
-		list->rcl_referring_calls.rcl_referring_calls_len = 1;
-		list->rcl_referring_calls.rcl_referring_calls_val = ref_call;
-		ref_call->rc_sequenceid = refer->sequence;
-		ref_call->rc_slotid = refer->slot;
-	} else {
-		sequence->csa_referring_call_lists.
-		    csa_referring_call_lists_len = 0;
-		sequence->csa_referring_call_lists.
-		    csa_referring_call_lists_val = NULL;
+	if (refers != NULL &&
+	    !build_referring_calls(sequence, refers, n_ops)) {
+		free_rpc_call(call);
+		return NULL;
 	}
 	cb_compound_add_op(&call->cbt, &sequenceop);
-	cb_compound_add_op(&call->cbt, op);
+	for (i = 0; i < n_ops; i++)
+		cb_compound_add_op(&call->cbt, &ops[i]);
 
 	return call;
 }
@@ -1144,18 +1223,8 @@ static void free_single_call(rpc_call_t *call)
 	CB_SEQUENCE4args *sequence =
 	    (&call->cbt.v_u.v4.args.argarray.argarray_val[0].nfs_cb_argop4_u.
 	     opcbsequence);
-	if (sequence->csa_referring_call_lists.csa_referring_call_lists_val) {
-		if (sequence->csa_referring_call_lists.
-		    csa_referring_call_lists_val->
-		    rcl_referring_calls.rcl_referring_calls_val) {
-			gsh_free(sequence->csa_referring_call_lists.
-				 csa_referring_call_lists_val->
-				 rcl_referring_calls.
-				 rcl_referring_calls_val);
-		}
-		gsh_free(sequence->csa_referring_call_lists.
-			 csa_referring_call_lists_val);
-	}
+
+	free_referring_calls(sequence);
 	free_rpc_call(call);
 }
 
@@ -1271,6 +1340,41 @@ int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 					     void *arg, uint32_t flags),
 		       void *completion_arg,
 		       void (*free_op) (nfs_cb_argop4 *op))
+{
+	uint32_t n_ops = 1;
+
+	return nfs_rpc_v41_multi(clientid, op, &n_ops,
+				 refer != NULL ? &refer : NULL, completion,
+				 completion_arg);
+}
+
+/**
+ * @brief Send v4.1 CB_COMPOUND with several operations
+ *
+ * Like nfs_rpc_v41_single, but the compound carries a CB_SEQUENCE
+ * followed by all of the supplied operations, or as many of them as
+ * the chosen session's back channel accepts.  The operations are
+ * copied shallowly into the call, so whatever they point to must
+ * live until the completion has run.  Complete the call with
+ * nfs41_complete_single.
+ *
+ * @param[in]     clientid       Client record
+ * @param[in]     ops            The operations to perform
+ * @param[in,out] n_ops          Number of operations; lowered to the
+ *                               number actually sent
+ * @param[in]     refers         Referral tracking info of each
+ *                               operation, entries may be NULL (or
+ *                               NULL)
+ * @param[in]     completion     Completion function for the compound
+ * @param[in]     completion_arg Argument provided to completion hook
+ *
+ * @return POSIX error codes.
+ */
+int nfs_rpc_v41_multi(nfs_client_id_t *clientid, nfs_cb_argop4 *ops,
+		      uint32_t *n_ops, struct state_refer **refers,
+		      int32_t(*completion) (rpc_call_t *, rpc_call_hook,
+					    void *arg, uint32_t flags),
+		      void *completion_arg)
 {
 	int scan = 0;
 	bool sent = false;
@@ -1291,15 +1395,24 @@ int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 			slotid4 slot = 0;
 			slotid4 highest_slot = 0;
 			rpc_call_t *call = NULL;
+			uint32_t max_ops =
+			    session->back_channel_attrs.ca_maxoperations;
+			uint32_t n = *n_ops;
 			int code = 0;
+
+			/* One operation always goes, as it always has */
+			if (max_ops > 1 && n > max_ops - 1)
+				n = max_ops - 1;
+			else if (max_ops <= 1)
+				n = 1;
 			if (!
 			    (find_cb_slot
 			     (session, scan == 1, &slot, &highest_slot))) {
 				continue;
 			}
 			call =
-			    construct_single_call(session, op, refer, slot,
-						  highest_slot);
+			    construct_v41_call(session, ops, n, refers, slot,
+					       highest_slot);
 			if (!call) {
 				release_cb_slot(session, slot, false);
 				return ENOMEM;
@@ -1317,6 +1430,7 @@ int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 				session->flags &= ~session_bc_up;
 				pthread_mutex_unlock(&chan->mtx);
 			} else {
+				*n_ops = n;
 				sent = true;
 				goto out;
 			}
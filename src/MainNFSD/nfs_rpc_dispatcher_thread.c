@@ -31,6 +31,7 @@
 #include "config.h"
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <sys/file.h>		/* for having FNDELAY */
@@ -53,9 +54,12 @@
 #include "nfs_exports.h"
 #include "nfs_proto_functions.h"
 #include "nfs_req_queue.h"
+#include "nfs_rpc_qos.h"
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "fridgethr.h"
+#include "client_mgr.h"
+#include "server_stats.h"
 
 /**
  * TI-RPC event channels.  Each channel is a thread servicing an event
@@ -65,16 +69,32 @@
 struct rpc_evchan {
 	uint32_t chan_id;	/*< Channel ID */
 	pthread_t thread_id;	/*< POSIX thread ID */
+	uint32_t xprts;		/*< Transports registered on the channel */
+	/* Written by the channel thread only */
+	uint64_t events;	/*< Events handled */
+	uint64_t busy;		/*< Nanoseconds spent handling them */
+	struct timespec start;	/*< When the channel thread started */
+	struct timespec window;	/*< Start of the current rate window */
+	uint64_t window_events;	/*< events at the start of the window */
+	uint64_t rate;		/*< Events per second, last window */
+	time_t rate_time;	/*< When rate was computed */
+	int64_t last_move;	/*< Last time a transport was moved off */
 };
 
-#define N_TCP_EVENT_CHAN  3	/*< We don't really want to have too many,
-				   relative to the number of available cores. */
 #define UDP_EVENT_CHAN    0	/*< Put UDP on a dedicated channel */
 #define TCP_RDVS_CHAN     1	/*< Accepts new tcp connections */
 #define TCP_EVCHAN_0      2
-#define N_EVENT_CHAN (N_TCP_EVENT_CHAN + 2)
-
-static struct rpc_evchan rpc_evchan[N_EVENT_CHAN];
+/** Bounds on the TCP channels when sized to the CPUs.  We don't
+    really want to have too many, relative to the number of cores. */
+#define N_TCP_EVENT_CHAN_MIN 3
+#define N_TCP_EVENT_CHAN_MAX 64
+/** Events per second a channel may be ahead of twice the least busy
+    one before transports are moved off it */
+#define EVCHAN_REBALANCE_SLACK 100
+
+static struct rpc_evchan *rpc_evchan;
+static uint32_t n_event_chan;
+static __thread struct rpc_evchan *cur_evchan;
 
 struct fridgethr *req_fridge;	/*< Decoder thread pool */
 struct nfs_req_st nfs_req_st;	/*< Shared request queues */
@@ -231,6 +251,9 @@ void Create_udp(protos prot)
 
 	/* bind xprt to channel--unregister it from the global event
 	 * channel (if applicable) */
+	((gsh_xprt_private_t *) udp_xprt[prot]->xp_u1)->evchan =
+		UDP_EVENT_CHAN;
+	atomic_inc_uint32_t(&rpc_evchan[UDP_EVENT_CHAN].xprts);
 	(void)svc_rqst_evchan_reg(rpc_evchan[UDP_EVENT_CHAN].chan_id,
 				  udp_xprt[prot], SVC_RQST_FLAG_XPRT_UREG);
 }
@@ -265,6 +288,9 @@ void Create_tcp(protos prot)
 	(tcp_xprt[prot])->xp_u1 =
 		alloc_gsh_xprt_private(tcp_xprt[prot],
 				       XPRT_PRIVATE_FLAG_NONE);
+	((gsh_xprt_private_t *) tcp_xprt[prot]->xp_u1)->evchan =
+		TCP_RDVS_CHAN;
+	atomic_inc_uint32_t(&rpc_evchan[TCP_RDVS_CHAN].xprts);
 }
 
 /**
@@ -418,6 +444,26 @@ void Register_program(protos prot, int flag, int vers)
  * Perform all the required initialization for the RPC subsystem and event
  * channels.
  */
+/**
+ * @brief Number of TCP event channels to run
+ *
+ * RPC_Event_Channels if set, otherwise one per four CPUs within
+ * N_TCP_EVENT_CHAN_MIN and N_TCP_EVENT_CHAN_MAX.
+ */
+static uint32_t nfs_rpc_n_tcp_evchan(void)
+{
+	long ncpu;
+
+	if (nfs_param.core_param.rpc.event_channels != 0)
+		return nfs_param.core_param.rpc.event_channels;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1)
+		ncpu = 1;
+
+	return MIN(MAX(ncpu / 4, N_TCP_EVENT_CHAN_MIN), N_TCP_EVENT_CHAN_MAX);
+}
+
 void nfs_Init_svc()
 {
 	protos p;
@@ -473,7 +519,14 @@ void nfs_Init_svc()
 		LogCrit(COMPONENT_INIT, "Failed redirecting TI-RPC __free");
 #endif				/* TIRPC_SET_ALLOCATORS */
 
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	n_event_chan = TCP_EVCHAN_0 + nfs_rpc_n_tcp_evchan();
+	rpc_evchan = gsh_calloc(n_event_chan, sizeof(struct rpc_evchan));
+	if (rpc_evchan == NULL)
+		LogFatal(COMPONENT_DISPATCH,
+			 "Cannot allocate %u TI-RPC event channels",
+			 n_event_chan);
+
+	for (ix = 0; ix < n_event_chan; ++ix) {
 		rpc_evchan[ix].chan_id = 0;
 		code = svc_rqst_new_evchan(&rpc_evchan[ix].chan_id,
 					   NULL /* u_data */,
@@ -657,37 +710,80 @@ void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr)
 	int ix, code = 0;
 
 	/* Start event channel service threads */
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	for (ix = 0; ix < n_event_chan; ++ix) {
 		code = pthread_create(&rpc_evchan[ix].thread_id, attr_thr,
 				      rpc_dispatcher_thread,
-				      (void *)&rpc_evchan[ix].chan_id);
+				      (void *)&rpc_evchan[ix]);
 		if (code != 0)
 			LogFatal(COMPONENT_THREAD,
 				 "Could not create rpc_dispatcher_thread #%u, error = %d (%s)",
 				 ix, errno, strerror(errno));
 	}
 	LogInfo(COMPONENT_THREAD,
-		"%d rpc dispatcher threads were started successfully",
-		N_EVENT_CHAN);
+		"%u rpc dispatcher threads were started successfully",
+		n_event_chan);
 }
 
 void nfs_rpc_dispatch_stop(void)
 {
 	int ix;
 
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	for (ix = 0; ix < n_event_chan; ++ix) {
 		svc_rqst_thrd_signal(rpc_evchan[ix].chan_id,
 				     SVC_RQST_SIGNAL_SHUTDOWN);
 	}
 }
 
+/**
+ * @brief Events per second a channel handled lately
+ *
+ * A channel that has not computed its rate for a while has been idle.
+ */
+static inline uint64_t nfs_rpc_evchan_rate(struct rpc_evchan *chan,
+					   time_t t)
+{
+	return (t - chan->rate_time > 2) ? 0 : chan->rate;
+}
+
+/**
+ * @brief Find the least loaded TCP event channel
+ *
+ * @param[in] by_rate Compare event rates first and connections to break
+ *                    ties, rather than the other way round
+ *
+ * @return Index of the channel.
+ */
+static uint32_t nfs_rpc_evchan_lightest(bool by_rate)
+{
+	time_t t = time(NULL);
+	uint32_t best = TCP_EVCHAN_0;
+	uint64_t best_rate = nfs_rpc_evchan_rate(&rpc_evchan[best], t);
+	uint32_t best_xprts = rpc_evchan[best].xprts;
+	uint64_t rate;
+	uint32_t xprts, ix;
+
+	for (ix = TCP_EVCHAN_0 + 1; ix < n_event_chan; ++ix) {
+		rate = nfs_rpc_evchan_rate(&rpc_evchan[ix], t);
+		xprts = rpc_evchan[ix].xprts;
+		if (by_rate ? (rate < best_rate
+			       || (rate == best_rate && xprts < best_xprts))
+			    : (xprts < best_xprts
+			       || (xprts == best_xprts && rate < best_rate))) {
+			best = ix;
+			best_rate = rate;
+			best_xprts = xprts;
+		}
+	}
+
+	return best;
+}
+
 /**
  * @brief Rendezvous callout.  This routine will be called by TI-RPC
  *        after newxprt has been accepted.
  *
- * Register newxprt on a TCP event channel.  Balancing events/channels
- * could become involved.  To start with, just cycle through them as
- * new connections are accepted.
+ * Register newxprt on the TCP event channel with the fewest
+ * connections, the least busy of those if several tie.
  *
  * @param[in] xprt    Transport
  * @param[in] newxprt Newly created transport
@@ -699,32 +795,122 @@ void nfs_rpc_dispatch_stop(void)
 static u_int nfs_rpc_rdvs(SVCXPRT *xprt, SVCXPRT *newxprt, const u_int flags,
 			  void *u_data)
 {
-	static uint32_t next_chan = TCP_EVCHAN_0;
 	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	gsh_xprt_private_t *xu;
 	uint32_t tchan;
 
-	pthread_mutex_lock(&mtx);
-
-	tchan = next_chan;
-	assert((next_chan >= TCP_EVCHAN_0) && (next_chan < N_EVENT_CHAN));
-	if (++next_chan >= N_EVENT_CHAN)
-		next_chan = TCP_EVCHAN_0;
-
 	/* setup private data (freed when xprt is destroyed) */
-	newxprt->xp_u1 =
-	    alloc_gsh_xprt_private(newxprt, XPRT_PRIVATE_FLAG_NONE);
+	xu = alloc_gsh_xprt_private(newxprt, XPRT_PRIVATE_FLAG_NONE);
+	newxprt->xp_u1 = xu;
 
 	/* NB: xu->drc is allocated on first request--we need shared
 	 * TCP DRC for v3, but per-connection for v4 */
 
+	pthread_mutex_lock(&mtx);
+	tchan = nfs_rpc_evchan_lightest(false);
+	atomic_inc_uint32_t(&rpc_evchan[tchan].xprts);
 	pthread_mutex_unlock(&mtx);
 
+	xu->evchan = tchan;
+
 	(void)svc_rqst_evchan_reg(rpc_evchan[tchan].chan_id, newxprt,
 				  SVC_RQST_FLAG_NONE);
 
 	return 0;
 }
 
+/**
+ * @brief Move a busy transport off an overloaded event channel
+ *
+ * Called with RPC_Event_Rebalance set when a decoder is done with
+ * xprt, in place of rearming it.  A transport is moved when its
+ * channel handles more than twice the events per second of the least
+ * busy one, at most one transport per channel per second.  The
+ * transports that get here are the ones with traffic, so it is the
+ * busy ones that move.
+ *
+ * @param[in] xprt The transport
+ *
+ * @return true if xprt was registered, and armed, on another channel.
+ */
+static bool nfs_rpc_evchan_rebalance(SVCXPRT *xprt)
+{
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+	struct rpc_evchan *from, *to;
+	time_t t;
+	int64_t last;
+	uint32_t tchan;
+
+	if (!nfs_param.core_param.rpc.event_rebalance
+	    || xu->evchan < TCP_EVCHAN_0
+	    || n_event_chan < TCP_EVCHAN_0 + 2)
+		return false;
+
+	t = time(NULL);
+	from = &rpc_evchan[xu->evchan];
+	last = atomic_fetch_int64_t(&from->last_move);
+	if (last == t)
+		return false;
+
+	tchan = nfs_rpc_evchan_lightest(true);
+	to = &rpc_evchan[tchan];
+	if (to == from
+	    || nfs_rpc_evchan_rate(from, t) <=
+	    2 * nfs_rpc_evchan_rate(to, t) + EVCHAN_REBALANCE_SLACK)
+		return false;
+
+	/* Decoders of several transports on the channel may get here
+	 * in the same second, only the one that claims it moves.
+	 */
+	if (!atomic_cas_int64_t(&from->last_move, last, t))
+		return false;
+
+	LogDebug(COMPONENT_DISPATCH,
+		 "moving xprt %p from event channel %u (%" PRIu64
+		 " events/s) to %u (%" PRIu64 " events/s)",
+		 xprt, xu->evchan, from->rate, tchan, to->rate);
+
+	atomic_dec_uint32_t(&from->xprts);
+	atomic_inc_uint32_t(&to->xprts);
+	xu->evchan = tchan;
+
+	(void)svc_rqst_evchan_reg(to->chan_id, xprt,
+				  SVC_RQST_FLAG_XPRT_UREG);
+
+	return true;
+}
+
+/**
+ * @brief Report on every event channel
+ *
+ * @param[in] cb  Called for each channel
+ * @param[in] arg Passed to cb
+ */
+void nfs_rpc_evchan_foreach(void (*cb)(const struct nfs_rpc_evchan_stats *,
+				       void *),
+			    void *arg)
+{
+	struct nfs_rpc_evchan_stats stats;
+	struct rpc_evchan *chan;
+	struct timespec ts;
+	uint32_t ix;
+
+	now(&ts);
+
+	for (ix = 0; ix < n_event_chan; ++ix) {
+		chan = &rpc_evchan[ix];
+		stats.id = ix;
+		stats.kind = ix == UDP_EVENT_CHAN ? "udp"
+			     : ix == TCP_RDVS_CHAN ? "rendezvous" : "tcp";
+		stats.xprts = chan->xprts;
+		stats.events = chan->events;
+		stats.busy = chan->busy;
+		stats.elapsed = chan->start.tv_sec == 0
+				? 0 : timespec_diff(&chan->start, &ts);
+		cb(&stats, arg);
+	}
+}
+
 /**
  * @brief xprt destructor callout
  *
@@ -732,6 +918,10 @@ static u_int nfs_rpc_rdvs(SVCXPRT *xprt, SVCXPRT *newxprt, const u_int flags,
  */
 static void nfs_rpc_free_xprt(SVCXPRT *xprt)
 {
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+
+	if (xu != NULL)
+		atomic_dec_uint32_t(&rpc_evchan[xu->evchan].xprts);
 	free_gsh_xprt_private(xprt);
 }
 
@@ -775,60 +965,63 @@ uint32_t nfs_rpc_outstanding_reqs_est(void)
 
 static inline bool stallq_should_unstall(gsh_xprt_private_t *xu)
 {
-	return ((xu->req_cnt < nfs_param.core_param.dispatch_max_reqs_xprt / 2)
+	return ((xu->req_cnt <
+		 (nfs_param.core_param.dispatch_max_reqs_xprt + 1) / 2)
 		|| (xu->xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED));
 }
 
-void thr_stallq(struct fridgethr_context *thr_ctx)
+/**
+ * @brief Unstall a transport once enough of its requests are done
+ *
+ * Called by gsh_xprt_unref, with the transport locked, as each request
+ * on a stalled transport completes.  A transport is only stalled with
+ * requests in flight, so the completion that takes it under the low
+ * water mark always comes and no polling is needed.
+ *
+ * @param[in] xprt The stalled transport
+ *
+ * @return true if the transport was unstalled, the caller then drops
+ *         the reference the stall queue held.
+ */
+bool nfs_rpc_unstall_xprt(SVCXPRT *xprt)
 {
-	gsh_xprt_private_t *xu;
-	struct glist_head *l;
-	SVCXPRT *xprt;
-
-	while (1) {
-		thread_delay_ms(1000);
-		pthread_mutex_lock(&nfs_req_st.stallq.mtx);
- restart:
-		if (nfs_req_st.stallq.stalled == 0) {
-			nfs_req_st.stallq.active = FALSE;
-			pthread_mutex_unlock(&nfs_req_st.stallq.mtx);
-			break;
-		}
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+	struct gsh_client *client = NULL;
+	nsecs_elapsed_t stalled;
+	struct timespec ts;
+	sockaddr_t addr;
 
-		glist_for_each(l, &nfs_req_st.stallq.q) {
-			xu = glist_entry(l, gsh_xprt_private_t, stallq);
-			/* handle stalled xprts that idle out */
-			if (stallq_should_unstall(xu)) {
-				xprt = xu->xprt;
-				/* lock ordering
-				 * (cf. nfs_rpc_cond_stall_xprt) */
-				pthread_mutex_unlock(&nfs_req_st.stallq.mtx);
-				/* !LOCKED */
-				LogDebug(COMPONENT_DISPATCH,
-					 "unstalling stalled xprt %p", xprt);
-				pthread_mutex_lock(&xprt->xp_lock);
-				pthread_mutex_lock(&nfs_req_st.stallq.mtx);
-				glist_del(&xu->stallq);
-				--(nfs_req_st.stallq.stalled);
-				xu->flags &= ~XPRT_PRIVATE_FLAG_STALLED;
-				(void)svc_rqst_rearm_events(
-					xprt, SVC_RQST_FLAG_NONE);
-				/* drop stallq ref */
-				gsh_xprt_unref(xprt, XPRT_PRIVATE_FLAG_LOCKED,
-					       __func__, __LINE__);
-				goto restart;
-			}
-		}
-		pthread_mutex_unlock(&nfs_req_st.stallq.mtx);
-	}
+	if (!stallq_should_unstall(xu))
+		return false;
+
+	/* lock ordering (cf. nfs_rpc_cond_stall_xprt) */
+	pthread_mutex_lock(&nfs_req_st.stallq.mtx);
+	glist_del(&xu->stallq);
+	--(nfs_req_st.stallq.stalled);
+	pthread_mutex_unlock(&nfs_req_st.stallq.mtx);
+	xu->flags &= ~XPRT_PRIVATE_FLAG_STALLED;
+
+	now(&ts);
+	stalled = timespec_diff(&xu->stall_start, &ts);
+
+	LogDebug(COMPONENT_DISPATCH,
+		 "unstalling xprt %p with %u reqs after %" PRIu64 " nsecs",
+		 xprt, xu->req_cnt, stalled);
 
-	LogDebug(COMPONENT_DISPATCH, "stallq idle, thread exit");
+	if (copy_xprt_addr(&addr, xprt))
+		client = get_gsh_client(&addr, true);
+	server_stats_xprt_stall(client, stalled);
+	if (client != NULL)
+		put_gsh_client(client);
+
+	(void)svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
+
+	return true;
 }
 
 static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 {
 	gsh_xprt_private_t *xu;
-	bool activate = FALSE;
 	uint32_t nreqs;
 
 	pthread_mutex_lock(&xprt->xp_lock);
@@ -863,27 +1056,12 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 
 	glist_add_tail(&nfs_req_st.stallq.q, &xu->stallq);
 	++(nfs_req_st.stallq.stalled);
+	pthread_mutex_unlock(&nfs_req_st.stallq.mtx);
 	xu->flags |= XPRT_PRIVATE_FLAG_STALLED;
+	now(&xu->stall_start);
 	pthread_mutex_unlock(&xprt->xp_lock);
 
-	/* if no thread is servicing the stallq, start one */
-	if (!nfs_req_st.stallq.active) {
-		nfs_req_st.stallq.active = TRUE;
-		activate = TRUE;
-	}
-	pthread_mutex_unlock(&nfs_req_st.stallq.mtx);
-
-	if (activate) {
-		int rc = 0;
-		LogDebug(COMPONENT_DISPATCH, "starting stallq service thread");
-		rc = fridgethr_submit(req_fridge, thr_stallq,
-				      NULL /* no arg */);
-		if (rc != 0)
-			LogCrit(COMPONENT_DISPATCH,
-				"Failed to start stallq: %d", rc);
-	}
-
-	/* stalled */
+	/* stalled, nfs_rpc_unstall_xprt rearms it as requests complete */
 	return TRUE;
 }
 
@@ -929,8 +1107,9 @@ void nfs_rpc_queue_init(void)
 	/* stallq */
 	gsh_mutex_init(&nfs_req_st.stallq.mtx, NULL);
 	glist_init(&nfs_req_st.stallq.q);
-	nfs_req_st.stallq.active = FALSE;
 	nfs_req_st.stallq.stalled = 0;
+
+	nfs_rpc_qos_init();
 }
 
 static uint32_t enqueued_reqs;
@@ -977,6 +1156,17 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 	/* this one is real, timestamp it
 	 */
 	now(&req->time_queued);
+
+	if (qpair != &nfs_request_q->qset[REQ_Q_MOUNT]
+	    && qpair != &nfs_request_q->qset[REQ_Q_CALL]
+	    && nfs_rpc_qos_enqueue(req)) {
+		atomic_inc_uint32_t(&enqueued_reqs);
+		LogDebug(COMPONENT_DISPATCH,
+			 "enqueued req on QoS flow (enq %u deq %u)",
+			 enqueued_reqs, dequeued_reqs);
+		goto wakeup;
+	}
+
 	/* always append to producer queue */
 	q = &qpair->producer;
 	pthread_spin_lock(&q->sp);
@@ -992,6 +1182,7 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 		 enqueued_reqs, dequeued_reqs);
 
 	/* potentially wakeup some thread */
+ wakeup:
 
 	/* global waitq */
 	{
@@ -1004,8 +1195,8 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 						wait_q_entry_t, waitq);
 
 			LogFullDebug(COMPONENT_DISPATCH,
-				     "nfs_req_st.reqs.waiters %u signal wqe %p (for q %p)",
-				     nfs_req_st.reqs.waiters, wqe, q);
+				     "nfs_req_st.reqs.waiters %u signal wqe %p (for qpair %s)",
+				     nfs_req_st.reqs.waiters, wqe, qpair->s);
 
 			/* release 1 waiter */
 			glist_del(&wqe->waitq);
@@ -1087,6 +1278,34 @@ request_data_t *nfs_rpc_consume_req(struct req_q_pair *qpair)
 	return nfsreq;
 }
 
+/**
+ * @brief Take a waiting worker off the global waitq
+ *
+ * Called with the wqe mutex held, if nobody signalled the worker it
+ * is still queued and must not be left behind.
+ *
+ * @param[in] wqe The worker's wait queue entry
+ *
+ * @return false if a signaller already took it off.
+ */
+static bool nfs_rpc_wqe_unqueue(wait_q_entry_t *wqe)
+{
+	bool queued;
+
+	pthread_spin_lock(&nfs_req_st.reqs.sp);
+	queued = wqe->waitq.next != NULL || wqe->waitq.prev != NULL;
+	if (queued) {
+		/* Element is still in wqitq, remove it */
+		glist_del(&wqe->waitq);
+		--(nfs_req_st.reqs.waiters);
+		--(wqe->waiters);
+		wqe->flags &= ~(Wqe_LFlag_WaitSync | Wqe_LFlag_SyncDone);
+	}
+	pthread_spin_unlock(&nfs_req_st.reqs.sp);
+
+	return queued;
+}
+
 request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 {
 	request_data_t *nfsreq = NULL;
@@ -1094,6 +1313,8 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 	struct req_q_pair *qpair;
 	uint32_t ix, slot;
 	struct timespec timeout;
+	nsecs_elapsed_t delay;
+	int rc;
 
 	/* XXX: the following stands in for a more robust/flexible
 	 * weighting function */
@@ -1129,8 +1350,13 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 			     "dequeue_req try qpair %s %p:%p", qpair->s,
 			     &qpair->producer, &qpair->consumer);
 
-		/* anything? */
-		nfsreq = nfs_rpc_consume_req(qpair);
+		/* anything? LL and HL requests are on QoS flows if
+		 * it is enabled */
+		nfsreq = NULL;
+		if (slot >= 2)
+			nfsreq = nfs_rpc_qos_dequeue();
+		if (!nfsreq)
+			nfsreq = nfs_rpc_consume_req(qpair);
 		if (nfsreq) {
 			atomic_inc_uint32_t(&dequeued_reqs);
 			break;
@@ -1154,29 +1380,31 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 		++(nfs_req_st.reqs.waiters);
 		pthread_spin_unlock(&nfs_req_st.reqs.sp);
 		while (!(wqe->flags & Wqe_LFlag_SyncDone)) {
-			timeout.tv_sec = time(NULL) + 5;
-			timeout.tv_nsec = 0;
-			pthread_cond_timedwait(&wqe->lwe.cv, &wqe->lwe.mtx,
-					       &timeout);
+			/* If QoS is holding requests back, look again
+			 * once the first of them may run */
+			delay = nfs_rpc_qos_delay();
+			if (delay != 0) {
+				now(&timeout);
+				timespec_add_nsecs(delay, &timeout);
+			} else {
+				timeout.tv_sec = time(NULL) + 5;
+				timeout.tv_nsec = 0;
+			}
+			rc = pthread_cond_timedwait(&wqe->lwe.cv,
+						    &wqe->lwe.mtx, &timeout);
 			if (fridgethr_you_should_break(worker->ctx)) {
 				/* We are returning;
 				 * so take us out of the waitq */
-				pthread_spin_lock(&nfs_req_st.reqs.sp);
-				if (wqe->waitq.next != NULL
-				    || wqe->waitq.prev != NULL) {
-					/* Element is still in wqitq,
-					 * remove it */
-					glist_del(&wqe->waitq);
-					--(nfs_req_st.reqs.waiters);
-					--(wqe->waiters);
-					wqe->flags &=
-					    ~(Wqe_LFlag_WaitSync |
-					      Wqe_LFlag_SyncDone);
-				}
-				pthread_spin_unlock(&nfs_req_st.reqs.sp);
+				nfs_rpc_wqe_unqueue(wqe);
 				pthread_mutex_unlock(&wqe->lwe.mtx);
 				return NULL;
 			}
+			/* A signal already on its way is waited for */
+			if (delay != 0 && rc == ETIMEDOUT
+			    && nfs_rpc_wqe_unqueue(wqe)) {
+				pthread_mutex_unlock(&wqe->lwe.mtx);
+				goto retry_deq;
+			}
 		}
 
 		/* XXX wqe was removed from nfs_req_st.waitq
@@ -1635,15 +1863,41 @@ void thr_decode_rpc_requests(struct fridgethr_context *thr_ctx)
 
 	/* order MUST be SVC_DESTROY, gsh_xprt_unref
 	 * (current refcnt balancing) */
-	if (stat != XPRT_DIED)
-		(void)svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
-	else
+	if (stat == XPRT_DIED)
 		SVC_DESTROY(xprt);
+	else if (!nfs_rpc_evchan_rebalance(xprt))
+		(void)svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
 
 	/* update accounting, clear decoding flag */
 	gsh_xprt_unref(xprt, XPRT_PRIVATE_FLAG_DECODING, __func__, __LINE__);
 }
 
+/**
+ * @brief Account an event to the channel thread that handled it
+ *
+ * @param[in] chan  The calling thread's channel
+ * @param[in] start When handling the event started
+ */
+static void nfs_rpc_evchan_account(struct rpc_evchan *chan,
+				   struct timespec *start)
+{
+	struct timespec ts;
+	nsecs_elapsed_t window;
+
+	now(&ts);
+	chan->events++;
+	chan->busy += timespec_diff(start, &ts);
+
+	window = timespec_diff(&chan->window, &ts);
+	if (window >= NS_PER_SEC) {
+		chan->rate = (chan->events - chan->window_events) *
+		    NS_PER_SEC / window;
+		chan->rate_time = ts.tv_sec;
+		chan->window = ts;
+		chan->window_events = chan->events;
+	}
+}
+
 static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 {
 	/* Ok, in the new world, TI-RPC's job is merely to tell us there is
@@ -1688,6 +1942,9 @@ static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 	int code = 0;
 	int rpc_fd = xprt->xp_fd;
 	uint32_t nreqs;
+	struct timespec start;
+
+	now(&start);
 
 	LogFullDebug(COMPONENT_RPC, "enter xprt=%p", xprt);
 
@@ -1791,30 +2048,36 @@ static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 	LogFullDebug(COMPONENT_DISPATCH, "after fridgethr_get");
 
  out:
+	if (cur_evchan != NULL)
+		nfs_rpc_evchan_account(cur_evchan, &start);
 	return TRUE;
 }
 
 /**
  * @brief Thread used to service an (epoll, etc) event channel.
  *
- * @param[in] arg Poitner to ID of the associated event channel
+ * @param[in] arg Pointer to the associated event channel
  *
  * @return Pointer to the result (but this function will mostly loop forever).
  *
  */
 void *rpc_dispatcher_thread(void *arg)
 {
-	int32_t chan_id = *((int32_t *) arg);
+	struct rpc_evchan *chan = arg;
 
 	SetNameFunction("disp");
 
+	cur_evchan = chan;
+	now(&chan->start);
+	chan->window = chan->start;
+
 	/* Calling dispatcher main loop */
 	LogInfo(COMPONENT_DISPATCH, "Entering nfs/rpc dispatcher");
 
 	LogDebug(COMPONENT_DISPATCH, "My pthread id is %p",
 		 (caddr_t) pthread_self());
 
-	svc_rqst_thrd_run(chan_id, SVC_RQST_FLAG_NONE);
+	svc_rqst_thrd_run(chan->chan_id, SVC_RQST_FLAG_NONE);
 
 	return NULL;
 }				/* rpc_dispatcher_thread */
@@ -0,0 +1,679 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs_rpc_qos.c
+ * @brief Fair scheduling of NFS requests across clients and exports
+ *
+ * Every NFS request is put on the queue of its flow, the pair of the
+ * client it came from and the export its first file handle names.
+ * Flows with queued requests sit on an active list that workers walk
+ * by deficit round robin: each visit credits a flow QoS_Quantum times
+ * its export's QoS_Weight, and a flow is served while its credit
+ * covers the cost of its next request (one unit plus one per 64KiB of
+ * READ or WRITE payload).
+ *
+ * Clients and exports (the tenants) also have token buckets holding
+ * up to one second of their operation and byte rates.  A flow whose
+ * client or export bucket is empty is passed over until it refills;
+ * nfs_rpc_qos_delay tells idle workers how long that will be.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "log.h"
+#include "common_utils.h"
+#include "abstract_mem.h"
+#include "ganesha_list.h"
+#include "ganesha_rpc.h"
+#include "nfs23.h"
+#include "nfs4.h"
+#include "nfs_core.h"
+#include "nfs_proto_functions.h"
+#include "nfs_file_handle.h"
+#include "client_mgr.h"
+#include "export_mgr.h"
+#include "nfs_rpc_qos.h"
+
+#define QOS_FLOW_HASH 256
+/** Payload bytes worth one extra cost unit */
+#define QOS_COST_BYTES (64 * 1024)
+/** How often an export tenant re-reads its limits */
+#define QOS_CONF_INTERVAL NS_PER_SEC
+/** Idle flows and tenants older than this are freed */
+#define QOS_IDLE_EXPIRE (600 * NS_PER_SEC)
+/** How often we look for idle flows */
+#define QOS_PRUNE_INTERVAL (60 * NS_PER_SEC)
+
+/**
+ * @brief A token bucket
+ *
+ * Holds at most one second's worth of each rate.  Tokens may go
+ * negative, a large WRITE is let through as soon as the bucket is
+ * positive and the debt is paid off before the next one.
+ */
+
+struct qos_bucket {
+	uint64_t ops_rate;	/*< Operations per second, 0 for no limit */
+	uint64_t bytes_rate;	/*< Bytes per second, 0 for no limit */
+	double ops;		/*< Operation tokens */
+	double bytes;		/*< Byte tokens */
+	struct timespec last;	/*< When the tokens were last topped up */
+};
+
+/**
+ * @brief A client or an export
+ */
+
+struct qos_tenant {
+	struct glist_head link;		/*< On qos.clients or qos.exports */
+	struct gsh_client *client;	/*< Client tenant, NULL for exports */
+	int export_id;			/*< Export tenant, -1 for clients */
+	uint32_t weight;		/*< QoS_Weight of the export */
+	uint32_t flows;			/*< Flows referring to us */
+	struct qos_bucket bucket;
+	struct timespec conf_time;	/*< When the export limits were read */
+	struct nfs_rpc_qos_stats stats;
+};
+
+/**
+ * @brief The requests of one client on one export
+ */
+
+struct qos_flow {
+	struct glist_head hash_link;	/*< On a qos.hash chain */
+	struct glist_head active_link;	/*< On qos.active while queued */
+	struct glist_head q;		/*< Queued requests */
+	struct qos_tenant *client;
+	struct qos_tenant *export;
+	uint32_t depth;			/*< Requests on q */
+	int64_t deficit;		/*< DRR credit, in cost units */
+	struct timespec last_used;
+};
+
+static struct {
+	pthread_mutex_t mtx;
+	struct glist_head hash[QOS_FLOW_HASH];
+	struct glist_head active;	/*< Flows with queued requests */
+	struct glist_head clients;	/*< Client tenants */
+	struct glist_head exports;	/*< Export tenants */
+	uint32_t active_count;
+	struct timespec last_prune;
+	/** Set when the last dequeue found every active flow held back
+	    by a limit, with the time until the first refills */
+	bool throttled;
+	nsecs_elapsed_t delay;
+} qos;
+
+/**
+ * @brief Work out the export and payload of an NFS request
+ *
+ * The export is taken from the NFSv3 file handle or the first PUTFH
+ * of an NFSv4 compound.  Handles that fail the basic checks are left
+ * for the worker to reject.
+ *
+ * @param[in]  reqnfs The decoded request
+ * @param[out] bytes  READ and WRITE payload
+ *
+ * @return The export id, -1 if there is none.
+ */
+
+static int qos_classify(nfs_request_data_t *reqnfs, uint64_t *bytes)
+{
+	struct svc_req *req = &reqnfs->req;
+	nfs_arg_t *arg = &reqnfs->arg_nfs;
+	COMPOUND4args *args;
+	file_handle_v4_t *fh;
+	nfs_fh4 *object;
+	int export_id = -1;
+	int ix;
+
+	*bytes = 0;
+
+	if (req->rq_prog != nfs_param.core_param.program[P_NFS])
+		return -1;
+
+	switch (req->rq_vers) {
+	case NFS_V3:
+		if (req->rq_proc == NFSPROC3_NULL)
+			return -1;
+		if (req->rq_proc == NFSPROC3_READ)
+			*bytes = arg->arg_read3.count;
+		else if (req->rq_proc == NFSPROC3_WRITE)
+			*bytes = arg->arg_write3.count;
+		return nfs3_FhandleToExportId((nfs_fh3 *) arg);
+	case NFS_V4:
+		if (req->rq_proc != NFSPROC4_COMPOUND)
+			return -1;
+		args = &arg->arg_compound4;
+		for (ix = 0; ix < (int)args->argarray.argarray_len; ix++) {
+			nfs_argop4 *op = &args->argarray.argarray_val[ix];
+
+			switch (op->argop) {
+			case NFS4_OP_PUTFH:
+				if (export_id >= 0)
+					break;
+				object = &op->nfs_argop4_u.opputfh.object;
+				fh = (file_handle_v4_t *) object->nfs_fh4_val;
+				if (fh != NULL
+				    && object->nfs_fh4_len >=
+				    offsetof(struct file_handle_v4, fsopaque)
+				    && fh->fhversion == GANESHA_FH_VERSION)
+					export_id = fh->exportid;
+				break;
+			case NFS4_OP_READ:
+				*bytes += op->nfs_argop4_u.opread.count;
+				break;
+			case NFS4_OP_WRITE:
+				*bytes += op->nfs_argop4_u.opwrite.data.data_len;
+				break;
+			default:
+				break;
+			}
+		}
+		return export_id;
+	default:
+		return -1;
+	}
+}
+
+static inline uint64_t qos_cost(request_data_t *req)
+{
+	return 1 + req->qos_bytes / QOS_COST_BYTES;
+}
+
+/**
+ * @brief Set the rates of a bucket
+ *
+ * A bucket going from unlimited to limited starts full.
+ */
+
+static void qos_bucket_set(struct qos_bucket *b, uint64_t ops_rate,
+			   uint64_t bytes_rate)
+{
+	if (ops_rate != b->ops_rate) {
+		if (b->ops_rate == 0 || b->ops > ops_rate)
+			b->ops = ops_rate;
+		b->ops_rate = ops_rate;
+	}
+	if (bytes_rate != b->bytes_rate) {
+		if (b->bytes_rate == 0 || b->bytes > bytes_rate)
+			b->bytes = bytes_rate;
+		b->bytes_rate = bytes_rate;
+	}
+}
+
+/**
+ * @brief Top up a bucket and see whether it has tokens
+ *
+ * @param[in]     b    The bucket
+ * @param[in]     ts   The time now
+ * @param[in,out] wait Lowered to the time until the bucket is usable
+ *
+ * @return true if a request may be charged to the bucket.
+ */
+
+static bool qos_bucket_ready(struct qos_bucket *b, struct timespec *ts,
+			     nsecs_elapsed_t *wait)
+{
+	double secs = (double)timespec_diff(&b->last, ts) / NS_PER_SEC;
+	double need = 0;
+
+	b->last = *ts;
+
+	if (b->ops_rate != 0) {
+		b->ops += secs * b->ops_rate;
+		if (b->ops > b->ops_rate)
+			b->ops = b->ops_rate;
+		if (b->ops <= 0)
+			need = (1 - b->ops) / b->ops_rate;
+	}
+	if (b->bytes_rate != 0) {
+		b->bytes += secs * b->bytes_rate;
+		if (b->bytes > b->bytes_rate)
+			b->bytes = b->bytes_rate;
+		if (b->bytes <= 0 && (1 - b->bytes) / b->bytes_rate > need)
+			need = (1 - b->bytes) / b->bytes_rate;
+	}
+
+	if (need == 0)
+		return true;
+
+	if ((nsecs_elapsed_t) (need * NS_PER_SEC) < *wait)
+		*wait = need * NS_PER_SEC;
+	return false;
+}
+
+static inline void qos_bucket_charge(struct qos_bucket *b, uint64_t bytes)
+{
+	if (b->ops_rate != 0)
+		b->ops -= 1;
+	if (b->bytes_rate != 0)
+		b->bytes -= bytes;
+}
+
+/**
+ * @brief Re-read the limits of an export tenant
+ *
+ * Done at most once a second so that reloaded EXPORT blocks take
+ * effect without a lookup on every request.
+ */
+
+static void qos_export_conf(struct qos_tenant *tenant, struct timespec *ts)
+{
+	struct gsh_export *export;
+
+	if (tenant->conf_time.tv_sec != 0
+	    && timespec_diff(&tenant->conf_time, ts) < QOS_CONF_INTERVAL)
+		return;
+
+	tenant->conf_time = *ts;
+
+	export = tenant->export_id < 0 ? NULL
+				       : get_gsh_export(tenant->export_id);
+	if (export == NULL) {
+		tenant->weight = 1;
+		qos_bucket_set(&tenant->bucket, 0, 0);
+		return;
+	}
+
+	tenant->weight = export->qos_weight != 0 ? export->qos_weight : 1;
+	qos_bucket_set(&tenant->bucket, export->qos_ops_limit,
+		       export->qos_bytes_limit);
+	put_gsh_export(export);
+}
+
+/**
+ * @brief Find or create a tenant and count a flow against it
+ *
+ * A new client tenant takes over the caller's reference to the client
+ * and clears *client so that the caller does not drop it.
+ *
+ * @param[in,out] client    Client of a client tenant, NULL for an export
+ * @param[in]     export_id Export of an export tenant, -1 for a client
+ * @param[in]     ts        The time now
+ */
+
+static struct qos_tenant *qos_tenant_get(struct gsh_client **client,
+					 int export_id, struct timespec *ts)
+{
+	struct gsh_client *cl = client != NULL ? *client : NULL;
+	struct glist_head *list = client != NULL ? &qos.clients
+						 : &qos.exports;
+	struct glist_head *glist;
+	struct qos_tenant *tenant;
+
+	glist_for_each(glist, list) {
+		tenant = glist_entry(glist, struct qos_tenant, link);
+		if (tenant->client == cl && tenant->export_id == export_id)
+			goto out;
+	}
+
+	tenant = gsh_calloc(1, sizeof(struct qos_tenant));
+	if (tenant == NULL)
+		return NULL;
+
+	tenant->client = cl;
+	if (client != NULL)
+		*client = NULL;
+	tenant->export_id = export_id;
+	tenant->weight = 1;
+	tenant->bucket.last = *ts;
+	glist_add_tail(list, &tenant->link);
+
+ out:
+	tenant->flows++;
+	return tenant;
+}
+
+static void qos_tenant_put(struct qos_tenant *tenant)
+{
+	if (--tenant->flows != 0)
+		return;
+
+	glist_del(&tenant->link);
+	if (tenant->client != NULL)
+		put_gsh_client(tenant->client);
+	gsh_free(tenant);
+}
+
+/**
+ * @brief Free flows that have been idle for a long time
+ *
+ * Clients come and go, their flows should not pile up forever.
+ */
+
+static void qos_prune(struct timespec *ts)
+{
+	struct glist_head *glist, *glistn;
+	struct qos_flow *flow;
+	int ix;
+
+	if (timespec_diff(&qos.last_prune, ts) < QOS_PRUNE_INTERVAL)
+		return;
+
+	qos.last_prune = *ts;
+
+	for (ix = 0; ix < QOS_FLOW_HASH; ix++) {
+		glist_for_each_safe(glist, glistn, &qos.hash[ix]) {
+			flow = glist_entry(glist, struct qos_flow, hash_link);
+			if (flow->depth != 0
+			    || timespec_diff(&flow->last_used, ts) <
+			    QOS_IDLE_EXPIRE)
+				continue;
+			glist_del(&flow->hash_link);
+			qos_tenant_put(flow->client);
+			qos_tenant_put(flow->export);
+			gsh_free(flow);
+		}
+	}
+}
+
+static struct qos_flow *qos_flow_get(struct gsh_client **client,
+				     int export_id, struct timespec *ts)
+{
+	uint32_t h = ((uintptr_t) *client >> 6) ^ (export_id * 2654435761U);
+	struct glist_head *chain = &qos.hash[h % QOS_FLOW_HASH];
+	struct glist_head *glist;
+	struct qos_flow *flow;
+
+	glist_for_each(glist, chain) {
+		flow = glist_entry(glist, struct qos_flow, hash_link);
+		if (flow->client->client == *client
+		    && flow->export->export_id == export_id)
+			return flow;
+	}
+
+	qos_prune(ts);
+
+	flow = gsh_calloc(1, sizeof(struct qos_flow));
+	if (flow == NULL)
+		return NULL;
+
+	flow->client = qos_tenant_get(client, -1, ts);
+	flow->export = qos_tenant_get(NULL, export_id, ts);
+	if (flow->client == NULL || flow->export == NULL) {
+		if (flow->client != NULL)
+			qos_tenant_put(flow->client);
+		if (flow->export != NULL)
+			qos_tenant_put(flow->export);
+		gsh_free(flow);
+		return NULL;
+	}
+
+	glist_init(&flow->q);
+	glist_add_tail(chain, &flow->hash_link);
+
+	return flow;
+}
+
+/**
+ * @brief Set up the QoS scheduler
+ */
+
+void nfs_rpc_qos_init(void)
+{
+	int ix;
+
+	memset(&qos, 0, sizeof(qos));
+	pthread_mutex_init(&qos.mtx, NULL);
+	for (ix = 0; ix < QOS_FLOW_HASH; ix++)
+		glist_init(&qos.hash[ix]);
+	glist_init(&qos.active);
+	glist_init(&qos.clients);
+	glist_init(&qos.exports);
+	now(&qos.last_prune);
+
+	if (nfs_param.core_param.enable_qos)
+		LogEvent(COMPONENT_DISPATCH,
+			 "QoS scheduling enabled, quantum %"PRIu32
+			 " client limits %"PRIu64" ops/s %"PRIu64" bytes/s",
+			 nfs_param.core_param.qos_quantum,
+			 nfs_param.core_param.qos_client_ops_limit,
+			 nfs_param.core_param.qos_client_bytes_limit);
+}
+
+/**
+ * @brief Queue a request on its flow
+ *
+ * The caller has timestamped the request and wakes a worker after.
+ *
+ * @param[in] req The request
+ *
+ * @return true if queued, false if the request is not scheduled by
+ *         QoS and should go on the ordinary queues.
+ */
+
+bool nfs_rpc_qos_enqueue(request_data_t *req)
+{
+	struct gsh_client *client = NULL;
+	struct qos_flow *flow;
+	struct timespec ts;
+	sockaddr_t addr;
+	int export_id;
+
+	if (!nfs_param.core_param.enable_qos || req->rtype != NFS_REQUEST)
+		return false;
+
+	export_id = qos_classify(req->r_u.nfs, &req->qos_bytes);
+	if (copy_xprt_addr(&addr, req->r_u.nfs->xprt))
+		client = get_gsh_client(&addr, false);
+
+	now(&ts);
+
+	pthread_mutex_lock(&qos.mtx);
+
+	flow = qos_flow_get(&client, export_id, &ts);
+	if (flow == NULL) {
+		pthread_mutex_unlock(&qos.mtx);
+		if (client != NULL)
+			put_gsh_client(client);
+		return false;
+	}
+
+	qos_export_conf(flow->export, &ts);
+	qos_bucket_set(&flow->client->bucket,
+		       nfs_param.core_param.qos_client_ops_limit,
+		       nfs_param.core_param.qos_client_bytes_limit);
+
+	glist_add_tail(&flow->q, &req->req_q);
+	if (flow->depth++ == 0) {
+		glist_add_tail(&qos.active, &flow->active_link);
+		qos.active_count++;
+		/* A new flow may well be eligible */
+		qos.throttled = false;
+	}
+	flow->last_used = ts;
+	flow->client->stats.depth++;
+	flow->client->stats.enqueued++;
+	flow->export->stats.depth++;
+	flow->export->stats.enqueued++;
+
+	pthread_mutex_unlock(&qos.mtx);
+
+	if (client != NULL)
+		put_gsh_client(client);
+
+	return true;
+}
+
+static inline void qos_rotate(struct qos_flow *flow)
+{
+	glist_del(&flow->active_link);
+	glist_add_tail(&qos.active, &flow->active_link);
+}
+
+static void qos_served(struct qos_tenant *tenant, nsecs_elapsed_t wait,
+		       uint64_t bytes)
+{
+	qos_bucket_charge(&tenant->bucket, bytes);
+	tenant->stats.depth--;
+	tenant->stats.dequeued++;
+	tenant->stats.wait_total += wait;
+	if (wait > tenant->stats.wait_max)
+		tenant->stats.wait_max = wait;
+}
+
+/**
+ * @brief Pick the next request to run
+ *
+ * @return A request, or NULL if nothing is queued or every queued
+ *         flow is held back by a limit.
+ */
+
+request_data_t *nfs_rpc_qos_dequeue(void)
+{
+	request_data_t *req;
+	struct qos_flow *flow;
+	struct timespec ts;
+	nsecs_elapsed_t wait = NS_PER_SEC;
+	nsecs_elapsed_t queued;
+	uint32_t held = 0;
+	uint64_t cost;
+	bool ready;
+
+	if (!nfs_param.core_param.enable_qos || qos.active_count == 0)
+		return NULL;
+
+	now(&ts);
+
+	pthread_mutex_lock(&qos.mtx);
+
+	while (qos.active_count != 0 && held < qos.active_count) {
+		flow = glist_first_entry(&qos.active, struct qos_flow,
+					 active_link);
+		ready = qos_bucket_ready(&flow->client->bucket, &ts, &wait);
+		ready = qos_bucket_ready(&flow->export->bucket, &ts, &wait)
+			&& ready;
+		if (!ready) {
+			flow->client->stats.throttled++;
+			flow->export->stats.throttled++;
+			qos_rotate(flow);
+			held++;
+			continue;
+		}
+		held = 0;
+
+		req = glist_first_entry(&flow->q, request_data_t, req_q);
+		cost = qos_cost(req);
+		if (flow->deficit < cost) {
+			flow->deficit += (int64_t) nfs_param.core_param.
+			    qos_quantum * flow->export->weight;
+			if (flow->deficit < cost) {
+				qos_rotate(flow);
+				continue;
+			}
+		}
+
+		glist_del(&req->req_q);
+		flow->deficit -= cost;
+		queued = timespec_diff(&req->time_queued, &ts);
+		qos_served(flow->client, queued, req->qos_bytes);
+		qos_served(flow->export, queued, req->qos_bytes);
+
+		if (--flow->depth == 0) {
+			/* An emptied flow does not bank its credit */
+			glist_del(&flow->active_link);
+			qos.active_count--;
+			flow->deficit = 0;
+		} else if (flow->deficit <
+			   qos_cost(glist_first_entry(&flow->q,
+						      request_data_t,
+						      req_q))) {
+			qos_rotate(flow);
+		}
+
+		qos.throttled = false;
+		pthread_mutex_unlock(&qos.mtx);
+		return req;
+	}
+
+	if (qos.active_count != 0) {
+		qos.throttled = true;
+		qos.delay = wait;
+	}
+
+	pthread_mutex_unlock(&qos.mtx);
+
+	return NULL;
+}
+
+/**
+ * @brief How long an idle worker should sleep
+ *
+ * @return Nanoseconds until a held back flow may run, 0 if no flow is
+ *         held back and the worker should wait to be woken.
+ */
+
+nsecs_elapsed_t nfs_rpc_qos_delay(void)
+{
+	nsecs_elapsed_t delay;
+
+	if (!nfs_param.core_param.enable_qos || !qos.throttled)
+		return 0;
+
+	delay = atomic_fetch_uint64_t(&qos.delay);
+	if (delay < NS_PER_MSEC)
+		delay = NS_PER_MSEC;
+
+	return delay;
+}
+
+/**
+ * @brief Report on every client and export tenant
+ *
+ * @param[in] cb  Called with "client" or "export", the tenant's name
+ *                and its counters, under the scheduler lock
+ * @param[in] arg Passed to cb
+ */
+
+void nfs_rpc_qos_foreach(void (*cb)(const char *kind, const char *name,
+				    const struct nfs_rpc_qos_stats *stats,
+				    void *arg),
+			 void *arg)
+{
+	struct glist_head *glist;
+	struct qos_tenant *tenant;
+	char name[32];
+
+	pthread_mutex_lock(&qos.mtx);
+
+	glist_for_each(glist, &qos.clients) {
+		tenant = glist_entry(glist, struct qos_tenant, link);
+		cb("client",
+		   tenant->client != NULL ? tenant->client->hostaddr_str
+					  : "unknown",
+		   &tenant->stats, arg);
+	}
+
+	glist_for_each(glist, &qos.exports) {
+		tenant = glist_entry(glist, struct qos_tenant, link);
+		if (tenant->export_id < 0)
+			strcpy(name, "none");
+		else
+			snprintf(name, sizeof(name), "%d", tenant->export_id);
+		cb("export", name, &tenant->stats, arg);
+	}
+
+	pthread_mutex_unlock(&qos.mtx);
+}
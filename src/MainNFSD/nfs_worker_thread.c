@@ -64,6 +64,7 @@
 #include "export_mgr.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "gsh_bufpool.h"
 
 pool_t *request_pool;
 pool_t *request_data_pool;
@@ -1253,6 +1254,14 @@ static void nfs_rpc_execute(request_data_t *req,
 		}
 #endif
 
+		/* NFSv4 does this per operation in nfs4_Compound() */
+		if (svcreq->rq_prog != nfs_param.core_param.program[P_NFS]
+		    || svcreq->rq_vers != NFS_V4)
+			fsal_operation_credentials(op_ctx->fsal_export,
+				svcreq->rq_prog ==
+					nfs_param.core_param.program[P_NFS]
+				&& svcreq->rq_proc == NFSPROC3_WRITE);
+
  null_op:
 		rc = reqnfs->funcdesc->service_function(arg_nfs,
 							worker_data, svcreq,
@@ -1406,7 +1415,7 @@ static void _9p_execute(request_data_t *req, nfs_worker_data_t *worker_data)
 static void _9p_free_reqdata(struct _9p_request_data *req9p)
 {
 	if (req9p->pconn->trans_type == _9P_TCP)
-		gsh_free(req9p->_9pmsg);
+		gsh_buf_free(req9p->_9pmsg);
 
 	/* decrease connection refcount */
 	atomic_dec_uint32_t(&req9p->pconn->refcount);
@@ -97,7 +97,7 @@ int _9p_attach(struct _9p_request_data *req9p, void *worker_data,
 		goto errout;
 	}
 
-	if (*fid >= _9P_FID_PER_CONN) {
+	if (*fid >= req9p->pconn->fids.max_fids) {
 		err = ERANGE;
 		goto errout;
 	}
@@ -110,7 +110,6 @@ int _9p_attach(struct _9p_request_data *req9p, void *worker_data,
 	}
 
 	pfid->fid = *fid;
-	req9p->pconn->fids[*fid] = pfid;
 
 	/* Is user name provided as a string or as an uid ? */
 	if (*n_uname != _9P_NONUNAME) {
@@ -163,6 +162,11 @@ int _9p_attach(struct _9p_request_data *req9p, void *worker_data,
 				 * to stay synchronous with the server */
 	pfid->qid.path = fileid;
 
+	/* Only publish the fid once it is complete */
+	err = _9p_setfid(req9p->pconn, *fid, pfid);
+	if (err != 0)
+		goto errout;
+
 	/* Build the reply */
 	_9p_setinitptr(cursor, preply, _9P_RATTACH);
 	_9p_setptr(cursor, msgtag, u16);
@@ -69,7 +69,7 @@ int _9p_auth(struct _9p_request_data *req9p, void *worker_data,
 		 (u32) *msgtag, *afid, (int) *uname_len, uname_str,
 		 (int) *aname_len, aname_str, *n_aname);
 
-	if (*afid >= _9P_FID_PER_CONN)
+	if (*afid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
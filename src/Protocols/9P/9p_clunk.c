@@ -59,11 +59,11 @@ int _9p_clunk(struct _9p_request_data *req9p, void *worker_data,
 
 	LogDebug(COMPONENT_9P, "TCLUNK: tag=%u fid=%u", (u32) *msgtag, *fid);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 
 	/* Check that it is a valid fid */
 	if (pfid == NULL || pfid->pentry == NULL) {
@@ -73,7 +73,7 @@ int _9p_clunk(struct _9p_request_data *req9p, void *worker_data,
 	}
 
 	rc = _9p_tools_clunk(pfid);
-	req9p->pconn->fids[*fid] = NULL;
+	(void)_9p_setfid(req9p->pconn, *fid, NULL);
 
 	if (rc) {
 		return _9p_rerror(req9p, worker_data, msgtag, rc,
@@ -42,6 +42,7 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "server_stats.h"
+#include "gsh_bufpool.h"
 
 /* opcode to function array */
 const struct _9p_function_desc _9pfuncdesc[] = {
@@ -123,7 +124,17 @@ void _9p_tcp_process_request(struct _9p_request_data *req9p,
 {
 	u32 outdatalen = 0;
 	int rc = 0;
-	char replydata[_9P_MSG_SIZE];
+	char *replydata;
+
+	/* Replies can be as large as the negotiated msize */
+	replydata = gsh_buf_alloc(req9p->pconn->msize);
+	if (replydata == NULL) {
+		LogCrit(COMPONENT_9P,
+			"Could not allocate 9P reply buffer on socket #%lu",
+			req9p->pconn->trans_data.sockfd);
+		_9p_DiscardFlushHook(req9p);
+		return;
+	}
 
 	rc = _9p_process_buffer(req9p, worker_data, replydata, &outdatalen);
 	if (rc != 1) {
@@ -137,6 +148,7 @@ void _9p_tcp_process_request(struct _9p_request_data *req9p,
 				 "Could not send 9P/TCP reply correclty on socket #%lu",
 				 req9p->pconn->trans_data.sockfd);
 	}
+	gsh_buf_free(replydata);
 	_9p_DiscardFlushHook(req9p);
 	return;
 }				/* _9p_process_request */
@@ -174,6 +186,9 @@ int _9p_process_buffer(struct _9p_request_data *req9p,
 	 */
 	*poutlen = req9p->pconn->msize;
 
+	/* 9P writes always switch back, see fsal_operation_credentials() */
+	fsal_operation_credentials(NULL, false);
+
 	/* Call the 9P service function */
 	rc = _9pfuncdesc[msgtype].service_function(req9p,
 						   (void *)worker_data,
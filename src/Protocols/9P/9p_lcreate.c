@@ -81,11 +81,11 @@ int _9p_lcreate(struct _9p_request_data *req9p, void *worker_data,
 		 (u32) *msgtag, *fid, *name_len, name_str, *flags, *mode,
 		 *gid);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 
 	/* Check that it is a valid fid */
 	if (pfid == NULL || pfid->pentry == NULL) {
@@ -69,11 +69,11 @@ int _9p_link(struct _9p_request_data *req9p, void *worker_data,
 	LogDebug(COMPONENT_9P, "TLINK: tag=%u dfid=%u targetfid=%u name=%.*s",
 		 (u32) *msgtag, *dfid, *targetfid, *name_len, name_str);
 
-	if (*dfid >= _9P_FID_PER_CONN)
+	if (*dfid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pdfid = req9p->pconn->fids[*dfid];
+	pdfid = _9p_getfid(req9p->pconn, *dfid);
 	/* Check that it is a valid fid */
 	if (pdfid == NULL || pdfid->pentry == NULL) {
 		LogDebug(COMPONENT_9P, "request on invalid dfid=%u", *dfid);
@@ -83,11 +83,11 @@ int _9p_link(struct _9p_request_data *req9p, void *worker_data,
 
 	op_ctx = &pdfid->op_context;
 
-	if (*targetfid >= _9P_FID_PER_CONN)
+	if (*targetfid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	ptargetfid = req9p->pconn->fids[*targetfid];
+	ptargetfid = _9p_getfid(req9p->pconn, *targetfid);
 	/* Check that it is a valid fid */
 	if (ptargetfid == NULL || ptargetfid->pentry == NULL) {
 		LogDebug(COMPONENT_9P, "request on invalid targetfid=%u",
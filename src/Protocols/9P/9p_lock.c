@@ -111,11 +111,11 @@ int _9p_lock(struct _9p_request_data *req9p, void *worker_data,
 		 (unsigned long long)*start, (unsigned long long)*length,
 		 *proc_id, *client_id_len, client_id_str);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 
 	/* Check that it is a valid fid */
 	if (pfid == NULL || pfid->pentry == NULL) {
@@ -45,6 +45,7 @@
 #include "idmapper.h"
 #include "uid2grp.h"
 #include "export_mgr.h"
+#include "server_stats.h"
 
 int _9p_init(void)
 {
@@ -308,13 +309,124 @@ int _9p_tools_clunk(struct _9p_fid *pfid)
 	return 0;
 }
 
+/**
+ * @brief Set up the fid table of a new connection
+ *
+ * Only the directory of leaves is allocated here, leaves come as
+ * fids are set.
+ *
+ * @param[in,out] conn     The connection
+ * @param[in]     max_fids Fids used on the connection are below this
+ *
+ * @return 0 or ENOMEM.
+ */
+int _9p_init_fids(struct _9p_conn *conn, uint32_t max_fids)
+{
+	uint32_t nleaves =
+		(max_fids + _9P_FID_LEAF_MASK) >> _9P_FID_LEAF_SHIFT;
+
+	conn->fids.leaves = gsh_calloc(nleaves, sizeof(struct _9p_fid **));
+	if (conn->fids.leaves == NULL)
+		return ENOMEM;
+
+	conn->fids.max_fids = max_fids;
+	conn->fids.nb_fids = 0;
+	conn->fids.hwmark = 0;
+	pthread_mutex_init(&conn->fids.lock, NULL);
+
+	return 0;
+}
+
+/**
+ * @brief Set or clear a fid in a connection's fid table
+ *
+ * @param[in,out] conn The connection
+ * @param[in]     fid  The fid, below conn->fids.max_fids
+ * @param[in]     pfid The fid data, NULL to clear the fid
+ *
+ * @return 0 or ENOMEM.
+ */
+int _9p_setfid(struct _9p_conn *conn, u32 fid, struct _9p_fid *pfid)
+{
+	struct _9p_fid **leaf;
+	struct _9p_fid *old;
+	int32_t delta = 0;
+
+	PTHREAD_MUTEX_lock(&conn->fids.lock);
+
+	leaf = conn->fids.leaves[fid >> _9P_FID_LEAF_SHIFT];
+	if (leaf == NULL) {
+		if (pfid == NULL) {
+			PTHREAD_MUTEX_unlock(&conn->fids.lock);
+			return 0;
+		}
+
+		leaf = gsh_calloc(_9P_FID_LEAF_SIZE, sizeof(struct _9p_fid *));
+		if (leaf == NULL) {
+			PTHREAD_MUTEX_unlock(&conn->fids.lock);
+			return ENOMEM;
+		}
+
+		/* Publish the leaf, lookups don't take the lock */
+		atomic_store_voidptr(
+			(void **)&conn->fids.leaves[fid >> _9P_FID_LEAF_SHIFT],
+			leaf);
+	}
+
+	old = leaf[fid & _9P_FID_LEAF_MASK];
+	atomic_store_voidptr((void **)&leaf[fid & _9P_FID_LEAF_MASK], pfid);
+
+	if (old == NULL && pfid != NULL)
+		delta = 1;
+	else if (old != NULL && pfid == NULL)
+		delta = -1;
+
+	conn->fids.nb_fids += delta;
+	if (conn->fids.nb_fids > conn->fids.hwmark)
+		conn->fids.hwmark = conn->fids.nb_fids;
+
+	PTHREAD_MUTEX_unlock(&conn->fids.lock);
+
+	if (delta != 0 && conn->client != NULL)
+		server_stats_9p_fids(conn->client, delta);
+
+	return 0;
+}
+
 void _9p_cleanup_fids(struct _9p_conn *conn)
 {
-	int i;
-	for (i = 0; i < _9P_FID_PER_CONN; i++) {
-		if (conn->fids[i]) {
-			_9p_tools_clunk(conn->fids[i]);
-			conn->fids[i] = NULL;	/* poison the entry */
+	uint32_t nleaves =
+		(conn->fids.max_fids + _9P_FID_LEAF_MASK) >> _9P_FID_LEAF_SHIFT;
+	uint32_t i, j;
+	struct _9p_fid **leaf;
+
+	if (conn->fids.leaves == NULL)
+		return;
+
+	for (i = 0; i < nleaves; i++) {
+		leaf = conn->fids.leaves[i];
+		if (leaf == NULL)
+			continue;
+
+		for (j = 0; j < _9P_FID_LEAF_SIZE; j++) {
+			if (leaf[j]) {
+				_9p_tools_clunk(leaf[j]);
+				leaf[j] = NULL;	/* poison the entry */
+			}
 		}
+
+		gsh_free(leaf);
 	}
+
+	if (conn->fids.nb_fids != 0 && conn->client != NULL)
+		server_stats_9p_fids(conn->client,
+				     -(int32_t)conn->fids.nb_fids);
+
+	LogDebug(COMPONENT_9P, "Connection used at most %u fids",
+		 conn->fids.hwmark);
+
+	gsh_free(conn->fids.leaves);
+	conn->fids.leaves = NULL;
+	conn->fids.nb_fids = 0;
+	pthread_mutex_destroy(&conn->fids.lock);
 }
@@ -74,11 +74,11 @@ int _9p_read(struct _9p_request_data *req9p, void *worker_data,
 	LogDebug(COMPONENT_9P, "TREAD: tag=%u fid=%u offset=%llu count=%u",
 		 (u32) *msgtag, *fid, (unsigned long long)*offset, *count);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 
 	/* Make sure the requested amount of data respects negotiated msize */
 	if (*count + _9P_ROOM_RREAD > req9p->pconn->msize)
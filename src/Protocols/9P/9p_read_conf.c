@@ -51,6 +51,8 @@ static struct config_item _9p_params[] = {
 	CONF_ITEM_UI16("_9P_RDMA_Outpool_Size", 1, UINT16_MAX,
 		       _9P_RDMA_OUTPOOL_SIZE,
 		       _9p_param, _9p_rdma_outpool_size),
+	CONF_ITEM_UI32("_9P_Max_Fids", _9P_FID_LEAF_SIZE, 1 << 24,
+		       _9P_MAX_FIDS, _9p_param, _9p_max_fids),
 	CONFIG_EOL
 };
 
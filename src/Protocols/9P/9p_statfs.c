@@ -74,11 +74,11 @@ int _9p_statfs(struct _9p_request_data *req9p, void *worker_data,
 
 	LogDebug(COMPONENT_9P, "TSTATFS: tag=%u fid=%u", (u32) *msgtag, *fid);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 	if (pfid == NULL)
 		return _9p_rerror(req9p, worker_data, msgtag, EINVAL, plenout,
 				  preply);
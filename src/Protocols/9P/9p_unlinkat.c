@@ -67,11 +67,11 @@ int _9p_unlinkat(struct _9p_request_data *req9p, void *worker_data,
 	LogDebug(COMPONENT_9P, "TUNLINKAT: tag=%u dfid=%u name=%.*s",
 		 (u32) *msgtag, *dfid, *name_len, name_str);
 
-	if (*dfid >= _9P_FID_PER_CONN)
+	if (*dfid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pdfid = req9p->pconn->fids[*dfid];
+	pdfid = _9p_getfid(req9p->pconn, *dfid);
 
 	/* Check that it is a valid fid */
 	if (pdfid == NULL || pdfid->pentry == NULL) {
@@ -75,15 +75,15 @@ int _9p_walk(struct _9p_request_data *req9p, void *worker_data,
 	LogDebug(COMPONENT_9P, "TWALK: tag=%u fid=%u newfid=%u nwname=%u",
 		 (u32) *msgtag, *fid, *newfid, *nwname);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	if (*newfid >= _9P_FID_PER_CONN)
+	if (*newfid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 	/* Check that it is a valid fid */
 	if (pfid == NULL || pfid->pentry == NULL) {
 		LogDebug(COMPONENT_9P, "request on invalid fid=%u", *fid);
@@ -202,7 +202,12 @@ int _9p_walk(struct _9p_request_data *req9p, void *worker_data,
 	}
 
 	/* keep info on new fid */
-	req9p->pconn->fids[*newfid] = pnewfid;
+	if (_9p_setfid(req9p->pconn, *newfid, pnewfid) != 0) {
+		cache_inode_put(pnewfid->pentry);
+		gsh_free(pnewfid);
+		return _9p_rerror(req9p, worker_data, msgtag, ENOMEM, plenout,
+				  preply);
+	}
 
 	/* As much qid as requested fid */
 	nwqid = nwname;
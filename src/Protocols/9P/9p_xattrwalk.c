@@ -90,15 +90,15 @@ int _9p_xattrwalk(struct _9p_request_data *req9p, void *worker_data,
 			 "TXATTRWALK (component): tag=%u fid=%u attrfid=%u name=%.*s",
 			 (u32) *msgtag, *fid, *attrfid, *name_len, name_str);
 
-	if (*fid >= _9P_FID_PER_CONN)
+	if (*fid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	if (*attrfid >= _9P_FID_PER_CONN)
+	if (*attrfid >= req9p->pconn->fids.max_fids)
 		return _9p_rerror(req9p, worker_data, msgtag, ERANGE, plenout,
 				  preply);
 
-	pfid = req9p->pconn->fids[*fid];
+	pfid = _9p_getfid(req9p->pconn, *fid);
 	/* Check that it is a valid fid */
 	if (pfid == NULL || pfid->pentry == NULL) {
 		LogDebug(COMPONENT_9P, "request on invalid fid=%u", *fid);
@@ -255,7 +255,12 @@ int _9p_xattrwalk(struct _9p_request_data *req9p, void *worker_data,
 		}
 	}
 
-	req9p->pconn->fids[*attrfid] = pxattrfid;
+	if (_9p_setfid(req9p->pconn, *attrfid, pxattrfid) != 0) {
+		gsh_free(pxattrfid->specdata.xattr.xattr_content);
+		gsh_free(pxattrfid);
+		return _9p_rerror(req9p, worker_data, msgtag, ENOMEM, plenout,
+				  preply);
+	}
 
 	/* Increments refcount as we're manually making a new copy */
 	cache_inode_lru_ref(pfid->pentry, LRU_FLAG_NONE);
@@ -47,6 +47,8 @@
 #include "nfs_convert.h"
 #include "server_stats.h"
 #include "export_mgr.h"
+#include "sal_functions.h"
+#include "gsh_bufpool.h"
 
 static void nfs_read_ok(struct svc_req *req,
 			nfs_res_t *res,
@@ -54,7 +56,7 @@ static void nfs_read_ok(struct svc_req *req,
 			int eof)
 {
 	if ((read_size == 0) && (data != NULL)) {
-		gsh_free(data);
+		gsh_buf_free(data);
 		data = NULL;
 	}
 
@@ -168,6 +170,13 @@ int nfs3_read(nfs_arg_t *arg,
 		goto out;
 	}
 
+	/* Recall a conflicting write delegation, the client will retry */
+	if (state_deleg_conflict(entry, false)) {
+		res->res_read3.status = NFS3ERR_JUKEBOX;
+		rc = NFS_REQ_OK;
+		goto out;
+	}
+
 	/* Extract the argument from the request */
 	offset = arg->arg_read3.offset;
 	size = arg->arg_read3.count;
@@ -211,7 +220,7 @@ int nfs3_read(nfs_arg_t *arg,
 		rc = NFS_REQ_OK;
 		goto out;
 	} else {
-		data = gsh_malloc(size);
+		data = gsh_buf_alloc(size);
 		if (data == NULL) {
 			rc = NFS_REQ_DROP;
 			goto out;
@@ -232,7 +241,7 @@ int nfs3_read(nfs_arg_t *arg,
 			rc = NFS_REQ_OK;
 			goto out;
 		}
-		gsh_free(data);
+		gsh_buf_free(data);
 	}
 
 	/* If we are here, there was an error */
@@ -270,6 +279,6 @@ void nfs3_read_free(nfs_res_t *res)
 {
 	if ((res->res_read3.status == NFS3_OK)
 	    && (res->res_read3.READ3res_u.resok.data.data_len != 0)) {
-		gsh_free(res->res_read3.READ3res_u.resok.data.data_val);
+		gsh_buf_free(res->res_read3.READ3res_u.resok.data.data_val);
 	}
 }
@@ -47,6 +47,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_convert.h"
 #include "nfs_proto_tools.h"
+#include "sal_functions.h"
 
 /**
  * @brief The NFSPROC3_SETATTR
@@ -139,6 +140,13 @@ int nfs3_setattr(nfs_arg_t *arg,
 		goto out;
 	}
 
+	/* Recall conflicting delegations, the client will retry */
+	if (setattr.mask != 0 && state_deleg_conflict(entry, true)) {
+		res->res_setattr3.status = NFS3ERR_JUKEBOX;
+		rc = NFS_REQ_OK;
+		goto out;
+	}
+
 	if (setattr.mask != 0) {
 		/* If owner or owner_group are set, and the credential was
 		 * squashed, then we must squash the set owner and owner_group.
@@ -49,6 +49,7 @@
 #include "nfs_proto_tools.h"
 #include "server_stats.h"
 #include "export_mgr.h"
+#include "sal_functions.h"
 
 /**
  *
@@ -172,6 +173,13 @@ int nfs3_write(nfs_arg_t *arg,
 		goto out;
 	}
 
+	/* Recall conflicting delegations, the client will retry */
+	if (state_deleg_conflict(entry, true)) {
+		res->res_write3.status = NFS3ERR_JUKEBOX;
+		rc = NFS_REQ_OK;
+		goto out;
+	}
+
 	offset = arg->arg_write3.offset;
 	size = arg->arg_write3.count;
 
@@ -38,6 +38,7 @@
 #include "server_stats.h"
 #include "export_mgr.h"
 #include "nfs_creds.h"
+#include "fridgethr.h"
 
 struct nfs4_op_desc {
 	char *name;
@@ -45,6 +46,8 @@ struct nfs4_op_desc {
 		      struct nfs_resop4 *);
 	void (*free_res) (nfs_resop4 *);
 	int exp_perm_flags;
+	bool parallel;	/*< Only touches the current filehandle and
+			    may run in a parallel compound segment */
 };
 
 /**
@@ -72,7 +75,8 @@ static const struct nfs4_op_desc optabv4[] = {
 		.name = "OP_ACCESS",
 		.funct = nfs4_op_access,
 		.free_res = nfs4_op_access_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_CLOSE] = {
 		.name = "OP_CLOSE",
 		.funct = nfs4_op_close,
@@ -102,12 +106,14 @@ static const struct nfs4_op_desc optabv4[] = {
 		.name = "OP_GETATTR",
 		.funct = nfs4_op_getattr,
 		.free_res = nfs4_op_getattr_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_GETFH] = {
 		.name = "OP_GETFH",
 		.funct = nfs4_op_getfh,
 		.free_res = nfs4_op_getfh_Free,
-		.exp_perm_flags = 0},
+		.exp_perm_flags = 0,
+		.parallel = true},
 	[NFS4_OP_LINK] = {
 		.name = "OP_LINK",
 		.funct = nfs4_op_link,
@@ -132,17 +138,20 @@ static const struct nfs4_op_desc optabv4[] = {
 		.name = "OP_LOOKUP",
 		.funct = nfs4_op_lookup,
 		.free_res = nfs4_op_lookup_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_LOOKUPP] = {
 		.name = "OP_LOOKUPP",
 		.funct = nfs4_op_lookupp,
 		.free_res = nfs4_op_lookupp_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_NVERIFY] = {
 		.name = "OP_NVERIFY",
 		.funct = nfs4_op_nverify,
 		.free_res = nfs4_op_nverify_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_OPEN] = {
 		.name = "OP_OPEN",
 		.funct = nfs4_op_open,
@@ -167,7 +176,8 @@ static const struct nfs4_op_desc optabv4[] = {
 		.name = "OP_PUTFH",
 		.funct = nfs4_op_putfh,
 		.free_res = nfs4_op_putfh_Free,
-		.exp_perm_flags = 0},
+		.exp_perm_flags = 0,
+		.parallel = true},
 	[NFS4_OP_PUTPUBFH] = {
 		.name = "OP_PUTPUBFH",
 		.funct = nfs4_op_putpubfh,
@@ -182,17 +192,20 @@ static const struct nfs4_op_desc optabv4[] = {
 		.name = "OP_READ",
 		.funct = nfs4_op_read,
 		.free_res = nfs4_op_read_Free,
-		.exp_perm_flags = EXPORT_OPTION_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_READDIR] = {
 		.name = "OP_READDIR",
 		.funct = nfs4_op_readdir,
 		.free_res = nfs4_op_readdir_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_READLINK] = {
 		.name = "OP_READLINK",
 		.funct = nfs4_op_readlink,
 		.free_res = nfs4_op_readlink_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_REMOVE] = {
 		.name = "OP_REMOVE",
 		.funct = nfs4_op_remove,
@@ -242,7 +255,8 @@ static const struct nfs4_op_desc optabv4[] = {
 		.name = "OP_VERIFY",
 		.funct = nfs4_op_verify,
 		.free_res = nfs4_op_verify_Free,
-		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS},
+		.exp_perm_flags = EXPORT_OPTION_MD_READ_ACCESS,
+		.parallel = true},
 	[NFS4_OP_WRITE] = {
 		.name = "OP_WRITE",
 		.funct = nfs4_op_write,
@@ -397,6 +411,548 @@ static const struct nfs4_op_desc optabv4[] = {
 				.exp_perm_flags = 0}
 };
 
+/**
+ * @brief Fridge running parallel compound segments
+ */
+static struct fridgethr *compound_fridge;
+
+/**
+ * @brief Completion tracking for a parallel compound
+ */
+struct compound_parallel {
+	pthread_mutex_t mtx;	/*< Protects outstanding */
+	pthread_cond_t cv;	/*< Signalled when outstanding drops to 0 */
+	uint32_t outstanding;	/*< Segments running on the fridge */
+};
+
+/**
+ * @brief One independent segment of a compound
+ *
+ * A segment starts at a PUTFH and runs up to the next one.  It has
+ * its own compound data and request context so that it can run on a
+ * different thread than the worker.
+ */
+struct compound_segment {
+	struct compound_parallel *par;	/*< Completion tracking */
+	nfs_argop4 *argarray;	/*< Arguments of the whole compound */
+	nfs_resop4 *resarray;	/*< Results of the whole compound */
+	uint32_t first;		/*< Index of the segment's PUTFH */
+	uint32_t count;		/*< Operations in the segment */
+	uint32_t done;		/*< Results filled in */
+	int status;		/*< Status of the last operation run */
+	bool queued;		/*< Handed to the compound fridge */
+	compound_data_t data;	/*< Private compound data */
+	struct req_op_context req_ctx;	/*< Private request context */
+	struct user_cred creds;	/*< Credentials for req_ctx */
+	struct export_perms export_perms;	/*< Export perms for req_ctx */
+};
+
+/**
+ * @brief Map an operation number onto an optabv4 index
+ *
+ * @param[in] minorversion Minor version of the compound
+ * @param[in] argop        Operation number from the request
+ *
+ * @return Index in optabv4, 0 for illegal operations.
+ */
+static inline int nfs4_op_index(uint32_t minorversion, nfs_opnum4 argop)
+{
+	if (minorversion == 0)
+		return argop > NFS4_OP_RELEASE_LOCKOWNER ? 0 : argop;
+
+	/* already range checked for minor version mismatch,
+	 * must be 4.1
+	 */
+	return argop > NFS4_OP_IO_ADVISE ? 0 : argop;
+}
+
+/**
+ * @brief Execute one operation of a compound
+ *
+ * Checks the export permissions of operations using the current
+ * filehandle, then dispatches the operation and records its
+ * statistics.
+ *
+ * @param[in]     argop Operation arguments
+ * @param[in,out] data  Compound data
+ * @param[out]    resop Operation result
+ *
+ * @return Status of the operation.
+ */
+static int nfs4_compound_op(nfs_argop4 *argop, compound_data_t *data,
+			    nfs_resop4 *resop)
+{
+	int status;
+	int opcode = nfs4_op_index(data->minorversion, argop->argop);
+	int perm_flags;
+	nsecs_elapsed_t op_start_time;
+	struct timespec ts;
+
+	/* time each op */
+	now(&ts);
+	op_start_time = timespec_diff(&ServerBootTime, &ts);
+
+	LogDebug(COMPONENT_NFS_V4, "Request %d: opcode %d is %s", data->oppos,
+		 argop->argop, optabv4[opcode].name);
+	perm_flags =
+	    optabv4[opcode].exp_perm_flags & EXPORT_OPTION_ACCESS_TYPE;
+
+	if (perm_flags != 0) {
+		status = nfs4_Is_Fh_Empty(&data->currentFH);
+		if (status != NFS4_OK) {
+			LogDebug(COMPONENT_NFS_V4,
+				 "Status of %s for CurrentFH in position %d = %s",
+				 optabv4[opcode].name,
+				 data->oppos,
+				 nfsstat4_to_str(status));
+			goto bad_op_state;
+		}
+
+		/* Operation uses a CurrentFH, so we can check export
+		 * perms. Perms should even be set reasonably for pseudo
+		 * file system.
+		 */
+		LogMidDebugAlt(COMPONENT_NFS_V4, COMPONENT_EXPORT,
+			       "Check export perms export = %08x req = %08x",
+			       op_ctx->export_perms->options &
+					EXPORT_OPTION_ACCESS_TYPE,
+			       perm_flags);
+		if ((op_ctx->export_perms->options &
+		     perm_flags) != perm_flags) {
+			/* Export doesn't allow requested
+			 * access for this client.
+			 */
+			if ((perm_flags & EXPORT_OPTION_MODIFY_ACCESS)
+			    != 0)
+				status = NFS4ERR_ROFS;
+			else
+				status = NFS4ERR_ACCESS;
+
+			LogDebugAlt(COMPONENT_NFS_V4, COMPONENT_EXPORT,
+				    "Status of %s due to export permissions in position %d = %s",
+				    optabv4[opcode].name, data->oppos,
+				    nfsstat4_to_str(status));
+			goto bad_op_state;
+		}
+	}
+
+	fsal_operation_credentials(op_ctx->fsal_export,
+				   argop->argop == NFS4_OP_WRITE);
+
+	status = (optabv4[opcode].funct) (argop, data, resop);
+
+	LogCompoundFH(data);
+
+	/* All the operation, like NFS4_OP_ACESS, have a first replyied
+	 * field called .status
+	 */
+	resop->nfs_resop4_u.opaccess.status = status;
+
+	server_stats_nfsv4_op_done(opcode, op_start_time, status == NFS4_OK);
+
+	if (status != NFS4_OK) {
+		/* An error occured, the caller will not manage the other
+		 * requests in the COMPOUND, this may be a regular behavior
+		 */
+		LogDebug(COMPONENT_NFS_V4,
+			 "Status of %s in position %d = %s",
+			 optabv4[opcode].name, data->oppos,
+			 nfsstat4_to_str(status));
+	}
+
+	return status;
+
+ bad_op_state:
+	/* All the operation, like NFS4_OP_ACESS, have
+	 * a first replied field called .status
+	 */
+	resop->nfs_resop4_u.opaccess.status = status;
+	resop->resop = argop->argop;
+
+	return status;
+}
+
+/**
+ * @brief Find where a compound may be split into parallel segments
+ *
+ * The tail of the compound can run in parallel if it is made only of
+ * operations that work on the current filehandle alone and it
+ * contains at least two PUTFH.  Each PUTFH then starts a segment that
+ * does not depend on the ones before it.
+ *
+ * @param[in] minorversion Minor version of the compound
+ * @param[in] argarray     Operations of the compound
+ * @param[in] len          Number of operations
+ *
+ * @return Index of the first PUTFH of the tail, or len if there is no
+ *         such tail.
+ */
+static uint32_t nfs4_compound_split(uint32_t minorversion,
+				    nfs_argop4 *argarray, uint32_t len)
+{
+	uint32_t first = len;
+	uint32_t nsegs = 0;
+	uint32_t i;
+
+	if (compound_fridge == NULL)
+		return len;
+
+	for (i = len; i > 0; i--) {
+		nfs_opnum4 argop = argarray[i - 1].argop;
+
+		if (!optabv4[nfs4_op_index(minorversion, argop)].parallel)
+			break;
+
+		if (argop == NFS4_OP_PUTFH) {
+			first = i - 1;
+			nsegs++;
+		}
+	}
+
+	return nsegs > 1 ? first : len;
+}
+
+/**
+ * @brief Check that the export a PUTFH lands on opted in
+ *
+ * @param[in] argop The PUTFH operation
+ *
+ * @return true if the export has Parallel_Compound set.
+ */
+static bool nfs4_compound_segment_allowed(nfs_argop4 *argop)
+{
+	nfs_fh4 *fh = &argop->nfs_argop4_u.opputfh.object;
+	struct file_handle_v4 *v4_handle;
+	struct gsh_export *export;
+	bool allowed;
+
+	if (nfs4_Is_Fh_Invalid(fh) != NFS4_OK)
+		return false;
+
+	v4_handle = (struct file_handle_v4 *)fh->nfs_fh4_val;
+	export = get_gsh_export(v4_handle->exportid);
+	if (export == NULL)
+		return false;
+
+	allowed = (export->options & EXPORT_OPTION_PARALLEL_COMPOUND) != 0;
+	put_gsh_export(export);
+
+	return allowed;
+}
+
+/**
+ * @brief Set up the private context of a segment
+ *
+ * The segment inherits the credentials and session of the compound.
+ * It starts with no current filehandle, its PUTFH takes its own
+ * export reference and recomputes credentials for it.
+ *
+ * @param[in,out] seg  The segment
+ * @param[in]     data Compound data of the compound being split
+ */
+static void nfs4_compound_segment_init(struct compound_segment *seg,
+				       compound_data_t *data)
+{
+	seg->req_ctx = *op_ctx;
+	seg->req_ctx.creds = &seg->creds;
+	seg->req_ctx.export = NULL;
+	seg->req_ctx.fsal_export = NULL;
+	seg->req_ctx.export_perms = &seg->export_perms;
+	seg->req_ctx.caller_gdata = NULL;
+	seg->req_ctx.caller_garray_copy = NULL;
+	seg->req_ctx.managed_garray_copy = NULL;
+	seg->creds = *op_ctx->creds;
+
+	seg->data.minorversion = data->minorversion;
+	seg->data.worker = data->worker;
+	seg->data.req = data->req;
+	seg->data.credential = data->credential;
+	seg->data.session = data->session;
+	seg->data.sequence = data->sequence;
+	seg->data.slot = data->slot;
+	seg->data.current_stateid = data->current_stateid;
+	seg->data.current_stateid_valid = data->current_stateid_valid;
+}
+
+/**
+ * @brief Run the operations of a segment
+ *
+ * Stops at the first failing operation, like a compound does.
+ *
+ * @param[in,out] seg The segment
+ */
+static void nfs4_compound_segment_run(struct compound_segment *seg)
+{
+	struct req_op_context *saved_ctx = op_ctx;
+	uint32_t i;
+
+	op_ctx = &seg->req_ctx;
+
+	for (i = 0; i < seg->count; i++) {
+		seg->data.oppos = seg->first + i;
+		seg->status = nfs4_compound_op(&seg->argarray[seg->first + i],
+					       &seg->data,
+					       &seg->resarray[seg->first + i]);
+		seg->done = i + 1;
+
+		if (seg->status != NFS4_OK)
+			break;
+	}
+
+	op_ctx = saved_ctx;
+}
+
+/**
+ * @brief Compound fridge entry point for a segment
+ *
+ * @param[in] ctx Thread context, ctx->arg is the segment
+ */
+static void nfs4_compound_segment_func(struct fridgethr_context *ctx)
+{
+	struct compound_segment *seg = ctx->arg;
+	struct compound_parallel *par = seg->par;
+
+	nfs4_compound_segment_run(seg);
+
+	PTHREAD_MUTEX_lock(&par->mtx);
+	if (--par->outstanding == 0)
+		pthread_cond_signal(&par->cv);
+	PTHREAD_MUTEX_unlock(&par->mtx);
+}
+
+/**
+ * @brief Release the resources held by a segment
+ *
+ * @param[in,out] seg The segment
+ */
+static void nfs4_compound_segment_release(struct compound_segment *seg)
+{
+	struct req_op_context *saved_ctx = op_ctx;
+
+	op_ctx = &seg->req_ctx;
+
+	/* Release a lease reserved by one of our operations */
+	if (seg->data.preserved_clientid != NULL) {
+		pthread_mutex_lock(&seg->data.preserved_clientid->cid_mutex);
+
+		update_lease(seg->data.preserved_clientid);
+
+		pthread_mutex_unlock(&seg->data.preserved_clientid->cid_mutex);
+	}
+
+	/* The session reference belongs to the compound */
+	seg->data.session = NULL;
+
+	compound_data_Free(&seg->data);
+	clean_credentials();
+
+	op_ctx = saved_ctx;
+}
+
+/**
+ * @brief Run the tail of a compound as parallel segments
+ *
+ * Each segment starting at a PUTFH runs with its own compound data,
+ * the first one on the worker thread and the others on the compound
+ * fridge (or inline when the fridge is full).  The results are then
+ * merged in order: the compound stops at the first failing operation
+ * and the results of segments after it are discarded.
+ *
+ * Nothing is done if any segment lands on an export without
+ * Parallel_Compound set, the caller then carries on sequentially.
+ *
+ * @param[in,out] data     Compound data
+ * @param[in]     argarray Operations of the compound
+ * @param[out]    resarray Results of the compound
+ * @param[in]     first    Index of the first PUTFH of the tail
+ * @param[in]     len      Number of operations in the compound
+ * @param[out]    last     Index of the last operation with a result
+ * @param[out]    status   Status of the compound
+ *
+ * @return true if the tail was executed.
+ */
+static bool nfs4_compound_parallel(compound_data_t *data,
+				   nfs_argop4 *argarray,
+				   nfs_resop4 *resarray,
+				   uint32_t first, uint32_t len,
+				   uint32_t *last, int *status)
+{
+	struct compound_parallel par;
+	struct compound_segment *segs;
+	struct compound_segment *seg = NULL;
+	struct compound_segment *merged = NULL;
+	uint32_t nsegs = 0;
+	uint32_t dispatched = 0;
+	uint32_t i, s;
+
+	/* Let the sequential path report NFS4ERR_TOO_MANY_OPS */
+	if (data->session != NULL &&
+	    data->session->fore_channel_attrs.ca_maxoperations < len)
+		return false;
+
+	for (i = first; i < len; i++) {
+		if (argarray[i].argop != NFS4_OP_PUTFH)
+			continue;
+
+		if (!nfs4_compound_segment_allowed(&argarray[i]))
+			return false;
+
+		nsegs++;
+	}
+
+	segs = gsh_calloc(nsegs, sizeof(struct compound_segment));
+	if (segs == NULL)
+		return false;
+
+	for (i = first, s = 0; i < len; i++) {
+		if (argarray[i].argop == NFS4_OP_PUTFH) {
+			seg = &segs[s++];
+			seg->par = &par;
+			seg->argarray = argarray;
+			seg->resarray = resarray;
+			seg->first = i;
+			nfs4_compound_segment_init(seg, data);
+		}
+		seg->count++;
+	}
+
+	pthread_mutex_init(&par.mtx, NULL);
+	pthread_cond_init(&par.cv, NULL);
+	par.outstanding = 0;
+
+	for (s = 1; s < nsegs; s++) {
+		PTHREAD_MUTEX_lock(&par.mtx);
+		par.outstanding++;
+		PTHREAD_MUTEX_unlock(&par.mtx);
+
+		if (fridgethr_submit(compound_fridge,
+				     nfs4_compound_segment_func,
+				     &segs[s]) == 0) {
+			segs[s].queued = true;
+			dispatched++;
+			continue;
+		}
+
+		PTHREAD_MUTEX_lock(&par.mtx);
+		par.outstanding--;
+		PTHREAD_MUTEX_unlock(&par.mtx);
+	}
+
+	/* The worker runs the first segment and whatever the fridge
+	 * could not take.
+	 */
+	for (s = 0; s < nsegs; s++) {
+		if (!segs[s].queued)
+			nfs4_compound_segment_run(&segs[s]);
+	}
+
+	PTHREAD_MUTEX_lock(&par.mtx);
+	while (par.outstanding != 0)
+		pthread_cond_wait(&par.cv, &par.mtx);
+	PTHREAD_MUTEX_unlock(&par.mtx);
+
+	pthread_cond_destroy(&par.cv);
+	pthread_mutex_destroy(&par.mtx);
+
+	/* Merge in order, results past the first failure are dropped */
+	*status = NFS4_OK;
+	for (s = 0; s < nsegs; s++) {
+		seg = &segs[s];
+
+		if (*status != NFS4_OK) {
+			for (i = 0; i < seg->done; i++)
+				nfs4_Compound_FreeOne(&resarray[seg->first + i]);
+			continue;
+		}
+
+		merged = seg;
+		*last = seg->first + seg->done - 1;
+		*status = seg->status;
+	}
+
+	/* Like the sequential path, leave the compound on the export
+	 * of the last operation so it is accounted there.
+	 */
+	if (op_ctx->export != NULL)
+		put_gsh_export(op_ctx->export);
+	op_ctx->export = merged->req_ctx.export;
+	op_ctx->fsal_export = merged->req_ctx.fsal_export;
+	merged->req_ctx.export = NULL;
+	merged->req_ctx.fsal_export = NULL;
+
+	server_stats_compound_parallel(nsegs, len - first, dispatched);
+
+	LogDebug(COMPONENT_NFS_V4,
+		 "COMPOUND: ran %u segments from position %u, %u dispatched",
+		 nsegs, first, dispatched);
+
+	for (s = 0; s < nsegs; s++)
+		nfs4_compound_segment_release(&segs[s]);
+
+	gsh_free(segs);
+
+	return true;
+}
+
+/**
+ * @brief Start the fridge running parallel compound segments
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+int nfs4_compound_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (nfs_param.nfsv4_param.compound_threads == 0)
+		return 0;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = nfs_param.nfsv4_param.compound_threads;
+	frp.thr_min = 0;
+	frp.thread_delay = 60;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_fail;
+
+	rc = fridgethr_init(&compound_fridge, "Compound", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_NFS_V4,
+			 "Unable to initialize compound fridge, error code %d.",
+			 rc);
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Stop the fridge running parallel compound segments
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+int nfs4_compound_pkgshutdown(void)
+{
+	int rc;
+
+	if (compound_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(compound_fridge,
+				    fridgethr_comm_stop,
+				    120);
+
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_NFS_V4,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(compound_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_NFS_V4,
+			 "Failed shutting down compound fridge: %d", rc);
+	}
+
+	return rc;
+}
+
 /**
  * @brief The NFS PROC4 COMPOUND
  *
@@ -427,14 +983,11 @@ int nfs4_Compound(nfs_arg_t *arg,
 	unsigned int i = 0;
 	int status = NFS4_OK;
 	compound_data_t data;
-	int opcode;
 	const uint32_t compound4_minor = arg->arg_compound4.minorversion;
 	const uint32_t argarray_len = arg->arg_compound4.argarray.argarray_len;
 	nfs_argop4 * const argarray = arg->arg_compound4.argarray.argarray_val;
 	nfs_resop4 *resarray;
-	nsecs_elapsed_t op_start_time;
-	struct timespec ts;
-	int perm_flags;
+	uint32_t par_first;
 	char *tagname = NULL;
 
 	if (compound4_minor > 2) {
@@ -593,112 +1146,45 @@ int nfs4_Compound(nfs_arg_t *arg,
 		}
 	}
 
+	/* Where the compound could switch to parallel segments */
+	par_first = nfs4_compound_split(compound4_minor, argarray,
+					argarray_len);
+
 	for (i = 0; i < argarray_len; i++) {
 		/* Used to check if OP_SEQUENCE is the first operation */
 		data.oppos = i;
 
-		/* time each op */
-		now(&ts);
-		op_start_time = timespec_diff(&ServerBootTime, &ts);
-		opcode = argarray[i].argop;
-		if (compound4_minor == 0) {
-			if (opcode > NFS4_OP_RELEASE_LOCKOWNER)
-				opcode = 0;
-		} else {
-			/* already range checked for minor version mismatch,
-			 * must be 4.1
-			 */
-			if (data.session != NULL) {
-				if (data.session->fore_channel_attrs.
-				    ca_maxoperations == i) {
-					status = NFS4ERR_TOO_MANY_OPS;
-					goto bad_op_state;
-				}
-			}
+		if (compound4_minor > 0 && data.session != NULL &&
+		    data.session->fore_channel_attrs.ca_maxoperations == i) {
+			status = NFS4ERR_TOO_MANY_OPS;
 
-			if (opcode > NFS4_OP_IO_ADVISE)
-				opcode = 0;
-		}
-		LogDebug(COMPONENT_NFS_V4, "Request %d: opcode %d is %s", i,
-			 argarray[i].argop, optabv4[opcode].name);
-		perm_flags =
-		    optabv4[opcode].exp_perm_flags & EXPORT_OPTION_ACCESS_TYPE;
-
-		if (perm_flags != 0) {
-			status = nfs4_Is_Fh_Empty(&data.currentFH);
-			if (status != NFS4_OK) {
-				LogDebug(COMPONENT_NFS_V4,
-					 "Status of %s for CurrentFH in position %d = %s",
-					 optabv4[opcode].name,
-					 i,
-					 nfsstat4_to_str(status));
-				goto bad_op_state;
-			}
+			/* All the operation, like NFS4_OP_ACESS, have
+			 * a first replied field called .status
+			 */
+			resarray[i].nfs_resop4_u.opaccess.status = status;
+			resarray[i].resop = argarray[i].argop;
 
-			/* Operation uses a CurrentFH, so we can check export
-			 * perms. Perms should even be set reasonably for pseudo
-			 * file system.
+			/* Do not manage the other requests in the
+			 * COMPOUND.
 			 */
-			LogMidDebugAlt(COMPONENT_NFS_V4, COMPONENT_EXPORT,
-				       "Check export perms export = %08x req = %08x",
-				       op_ctx->export_perms->options &
-						EXPORT_OPTION_ACCESS_TYPE,
-				       perm_flags);
-			if ((op_ctx->export_perms->options &
-			     perm_flags) != perm_flags) {
-				/* Export doesn't allow requested
-				 * access for this client.
-				 */
-				if ((perm_flags & EXPORT_OPTION_MODIFY_ACCESS)
-				    != 0)
-					status = NFS4ERR_ROFS;
-				else
-					status = NFS4ERR_ACCESS;
-
-				LogDebugAlt(COMPONENT_NFS_V4, COMPONENT_EXPORT,
-					    "Status of %s due to export permissions in position %d = %s",
-					    optabv4[opcode].name, i,
-					    nfsstat4_to_str(status));
- bad_op_state:
-				/* All the operation, like NFS4_OP_ACESS, have
-				 * a first replied field called .status
-				 */
-				resarray[i].nfs_resop4_u.opaccess.status =
-				    status;
-				resarray[i].resop = argarray[i].argop;
-
-				/* Do not manage the other requests in the
-				 * COMPOUND.
-				 */
-				res->res_compound4.resarray.resarray_len =
-					i + 1;
-				break;
-			}
+			res->res_compound4.resarray.resarray_len = i + 1;
+			break;
 		}
 
-		status = (optabv4[opcode].funct) (&argarray[i],
-						  &data,
-						  &resarray[i]);
-
-		LogCompoundFH(&data);
-
-		/* All the operation, like NFS4_OP_ACESS, have a first replyied
-		 * field called .status
-		 */
-		resarray[i].nfs_resop4_u.opaccess.status = status;
+		if (i == par_first &&
+		    nfs4_compound_parallel(&data, argarray, resarray,
+					   par_first, argarray_len,
+					   &i, &status)) {
+			res->res_compound4.resarray.resarray_len = i + 1;
+			break;
+		}
 
-		server_stats_nfsv4_op_done(opcode,
-					   op_start_time, status == NFS4_OK);
+		status = nfs4_compound_op(&argarray[i], &data, &resarray[i]);
 
 		if (status != NFS4_OK) {
 			/* An error occured, we do not manage the other requests
 			 * in the COMPOUND, this may be a regular behavior
 			 */
-			LogDebug(COMPONENT_NFS_V4,
-				 "Status of %s in position %d = %s",
-				 optabv4[opcode].name, i,
-				 nfsstat4_to_str(status));
-
 			res->res_compound4.resarray.resarray_len = i + 1;
 
 			break;
@@ -42,6 +42,118 @@
 #include "nfs_proto_functions.h"
 #include "nfs_proto_tools.h"
 #include "nfs_file_handle.h"
+#include "sal_functions.h"
+
+/* Seconds a CB_GETATTR reply is used to answer GETATTR from other clients */
+#define DELEG_CBGETATTR_VALID 2
+
+/**
+ * @brief Check whether a request comes from a delegation holder
+ *
+ * NFSv4.1 requests name their client through the session.  NFSv4.0
+ * ones don't, so the client is taken from the stateid an earlier
+ * operation of the compound used, and failing that from the address
+ * the client established its clientid from.
+ *
+ * @param[in] data   Compound request's data
+ * @param[in] holder Client holding the delegation
+ *
+ * @return true if the request comes from the holder.
+ */
+static bool nfs4_getattr_from_holder(compound_data_t *data,
+				     nfs_client_id_t *holder)
+{
+	clientid4 clientid;
+
+	if (data->session != NULL)
+		return data->session->clientid_record == holder;
+
+	if (data->current_stateid_valid) {
+		memcpy(&clientid, data->current_stateid.other,
+		       sizeof(clientid));
+		return clientid == holder->cid_clientid;
+	}
+
+	return op_ctx->caller_addr != NULL &&
+	       cmp_sockaddr(op_ctx->caller_addr,
+			    &holder->cid_client_addr, true);
+}
+
+/**
+ * @brief Check GETATTR against a write delegation
+ *
+ * While another client holds a write delegation, the size and change
+ * attribute known to the server may be stale.  Ask the holder with
+ * CB_GETATTR and have the requester retry until the reply is in; the
+ * reply is then returned for the reply to merge.  The holder itself
+ * knows better than the server and is answered right away.
+ *
+ * @param[in]  data   Compound request's data
+ * @param[in]  bitmap Requested attributes
+ * @param[out] merge  Size and change reported by the holder, the mask
+ *                    is left empty if there are none to merge
+ *
+ * @return NFS4_OK or NFS4ERR_DELAY.
+ */
+static nfsstat4 nfs4_getattr_deleg(compound_data_t *data,
+				   struct bitmap4 *bitmap,
+				   struct attrlist *merge)
+{
+	cache_entry_t *entry = data->current_entry;
+	struct file_deleg_heuristics *statistics;
+	struct glist_head *glist;
+	state_lock_entry_t *found_entry;
+	nfsstat4 status = NFS4_OK;
+
+	if (entry->type != REGULAR_FILE)
+		return NFS4_OK;
+
+	if (!attribute_is_set(bitmap, FATTR4_SIZE) &&
+	    !attribute_is_set(bitmap, FATTR4_CHANGE))
+		return NFS4_OK;
+
+	statistics = &entry->object.file.deleg_heuristics;
+
+	/* Unlocked peek, rechecked below */
+	if (statistics->deleg_type != OPEN_DELEGATE_WRITE)
+		return NFS4_OK;
+
+	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
+
+	if (statistics->curr_delegations == 0 ||
+	    statistics->deleg_type != OPEN_DELEGATE_WRITE)
+		goto out;
+
+	glist_for_each(glist, &entry->object.file.deleg_list) {
+		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+		if (found_entry->sle_state != NULL &&
+		    nfs4_getattr_from_holder(data,
+					     found_entry->sle_state->state_data.
+					     deleg.clfile_stats.clientid))
+			goto out;
+	}
+
+	if (statistics->cbgetattr_pending) {
+		status = NFS4ERR_DELAY;
+		goto out;
+	}
+
+	if (statistics->cbgetattr_time != 0 &&
+	    time(NULL) - statistics->cbgetattr_time <= DELEG_CBGETATTR_VALID) {
+		merge->mask = statistics->cbgetattr_mask;
+		merge->filesize = statistics->cbgetattr_size;
+		merge->change = statistics->cbgetattr_change;
+		goto out;
+	}
+
+	/* If the holder can't be asked, fall back on what the server has */
+	if (delegcbgetattr(entry) == STATE_SUCCESS)
+		status = NFS4ERR_DELAY;
+
+ out:
+	PTHREAD_RWLOCK_unlock(&entry->state_lock);
+	return status;
+}
 
 /**
  * @brief Gets attributes for an entry in the FSAL.
@@ -61,6 +173,7 @@ int nfs4_op_getattr(struct nfs_argop4 *op, compound_data_t *data,
 {
 	GETATTR4args * const arg_GETATTR4 = &op->nfs_argop4_u.opgetattr;
 	GETATTR4res * const res_GETATTR4 = &resp->nfs_resop4_u.opgetattr;
+	struct attrlist merge;
 
 	/* This is a NFS4_OP_GETTAR */
 	resp->resop = NFS4_OP_GETATTR;
@@ -88,13 +201,22 @@ int nfs4_op_getattr(struct nfs_argop4 *op, compound_data_t *data,
 
 	nfs4_bitmap4_Remove_Unsupported(&arg_GETATTR4->attr_request);
 
+	memset(&merge, 0, sizeof(merge));
+	res_GETATTR4->status = nfs4_getattr_deleg(data,
+						  &arg_GETATTR4->attr_request,
+						  &merge);
+
+	if (res_GETATTR4->status != NFS4_OK)
+		return res_GETATTR4->status;
+
 	res_GETATTR4->status =
-		   cache_entry_To_Fattr(data->current_entry,
-					&res_GETATTR4->GETATTR4res_u.resok4.
-					obj_attributes,
-					data,
-					&data->currentFH,
-					&arg_GETATTR4->attr_request);
+		   cache_entry_To_Fattr_merge(data->current_entry,
+					      &res_GETATTR4->GETATTR4res_u.
+					      resok4.obj_attributes,
+					      data,
+					      &data->currentFH,
+					      &arg_GETATTR4->attr_request,
+					      merge.mask != 0 ? &merge : NULL);
 
 	return res_GETATTR4->status;
 }				/* nfs4_op_getattr */
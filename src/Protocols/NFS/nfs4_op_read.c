@@ -48,6 +48,7 @@
 #include "fsal_pnfs.h"
 #include "server_stats.h"
 #include "export_mgr.h"
+#include "gsh_bufpool.h"
 
 /**
  * @brief Read on a pNFS pNFS data server
@@ -87,7 +88,7 @@ static int op_dsread(struct nfs_argop4 *op, compound_data_t *data,
 
 	/* Construct the FSAL file handle */
 
-	buffer = gsh_malloc_aligned(4096, arg_READ4->count);
+	buffer = gsh_buf_alloc(arg_READ4->count);
 	if (buffer == NULL) {
 		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate read buffer");
 		res_READ4->status = NFS4ERR_SERVERFAULT;
@@ -107,7 +108,7 @@ static int op_dsread(struct nfs_argop4 *op, compound_data_t *data,
 				&eof);
 
 	if (nfs_status != NFS4_OK) {
-		gsh_free(buffer);
+		gsh_buf_free(buffer);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 	}
 
@@ -164,7 +165,7 @@ static int op_dsread_plus(struct nfs_argop4 *op, compound_data_t *data,
 
 	/* Construct the FSAL file handle */
 
-	buffer = gsh_malloc_aligned(4096, arg_READ4->count);
+	buffer = gsh_buf_alloc(arg_READ4->count);
 	if (buffer == NULL) {
 		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate read buffer");
 		res_RPLUS->rpr_status = NFS4ERR_SERVERFAULT;
@@ -183,7 +184,7 @@ static int op_dsread_plus(struct nfs_argop4 *op, compound_data_t *data,
 
 	res_RPLUS->rpr_status = nfs_status;
 	if (nfs_status != NFS4_OK) {
-		gsh_free(buffer);
+		gsh_buf_free(buffer);
 		return res_RPLUS->rpr_status;
 	}
 
@@ -446,7 +447,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	}
 
 	/* Some work is to be done */
-	bufferdata = gsh_malloc_aligned(4096, size);
+	bufferdata = gsh_buf_alloc(size);
 
 	if (bufferdata == NULL) {
 		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate bufferdata");
@@ -465,7 +466,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 				  bufferdata, &eof_met, &sync, info);
 	if (cache_status != CACHE_INODE_SUCCESS) {
 		res_READ4->status = nfs4_Errno(cache_status);
-		gsh_free(bufferdata);
+		gsh_buf_free(bufferdata);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 		goto done;
 	}
@@ -473,7 +474,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	if (cache_inode_size(entry, &file_size) !=
 	    CACHE_INODE_SUCCESS) {
 		res_READ4->status = nfs4_Errno(cache_status);
-		gsh_free(bufferdata);
+		gsh_buf_free(bufferdata);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 		goto done;
 	}
@@ -543,7 +544,7 @@ void nfs4_op_read_Free(nfs_resop4 *res)
 
 	if (resp->status == NFS4_OK)
 		if (resp->READ4res_u.resok4.data.data_val != NULL)
-			gsh_free(resp->READ4res_u.resok4.data.data_val);
+			gsh_buf_free(resp->READ4res_u.resok4.data.data_val);
 	return;
 }				/* nfs4_op_read_Free */
 
@@ -604,7 +605,7 @@ void nfs4_op_read_plus_Free(nfs_resop4 *res)
 
 	if (resp->rpr_status == NFS4_OK && conp->what == NFS4_CONTENT_DATA)
 		if (conp->data.d_data.data_val != NULL)
-			gsh_free(conp->data.d_data.data_val);
+			gsh_buf_free(conp->data.d_data.data_val);
 
 	if (resp->rpr_status == NFS4_OK &&
 				conp->what == NFS4_CONTENT_APP_DATA_HOLE)
@@ -3063,6 +3063,8 @@ struct Fattr_filler_opaque {
 	compound_data_t *data;	/*< Compound data */
 	nfs_fh4 *objFH;		/*< Object file handle */
 	struct bitmap4 *Bitmap;	/*< Bitmap of entries to fill */
+	const struct attrlist *merge;	/*< Size and change overriding the
+					    cached ones, may be NULL */
 };
 
 /**
@@ -3084,6 +3086,17 @@ static cache_inode_status_t Fattr_filler(void *opaque,
 {
 	struct xdr_attrs_args args;
 	struct Fattr_filler_opaque *f = (struct Fattr_filler_opaque *)opaque;
+	struct attrlist merged;
+
+	if (f->merge != NULL) {
+		merged = *attr;
+		if (FSAL_TEST_MASK(f->merge->mask, ATTR_SIZE))
+			merged.filesize = f->merge->filesize;
+		if (FSAL_TEST_MASK(f->merge->mask, ATTR_CHANGE) &&
+		    f->merge->change > merged.change)
+			merged.change = f->merge->change;
+		attr = &merged;
+	}
 
 	memset(&args, 0, sizeof(args));
 	args.attrs = (struct attrlist *)attr;
@@ -3118,12 +3131,42 @@ static cache_inode_status_t Fattr_filler(void *opaque,
 nfsstat4 cache_entry_To_Fattr(cache_entry_t *entry, fattr4 *Fattr,
 			      compound_data_t *data, nfs_fh4 *objFH,
 			      struct bitmap4 *Bitmap)
+{
+	return cache_entry_To_Fattr_merge(entry, Fattr, data, objFH, Bitmap,
+					  NULL);
+}
+
+/**
+ * @brief Fill NFSv4 Fattr from cache entry and newer size and change
+ *
+ * Used to answer with the size and change attribute a write
+ * delegation holder reported in CB_GETATTR, which the server's own
+ * attributes don't reflect yet.
+ *
+ * @param[in]  entry   Cache entry
+ * @param[out] Fattr   NFSv4 Fattr buffer, to be freed by the caller
+ * @param[in]  data    NFSv4 compoud request's data.
+ * @param[in]  objFH   The NFSv4 filehandle of the object whose
+ *                     attributes are requested
+ * @param[in]  Bitmap  Bitmap of attributes being requested
+ * @param[in]  merge   ATTR_SIZE and ATTR_CHANGE to report instead of
+ *                     the cached ones, the change only if newer; may
+ *                     be NULL
+ *
+ * @retval cache status
+ */
+
+nfsstat4 cache_entry_To_Fattr_merge(cache_entry_t *entry, fattr4 *Fattr,
+				    compound_data_t *data, nfs_fh4 *objFH,
+				    struct bitmap4 *Bitmap,
+				    const struct attrlist *merge)
 {
 	struct Fattr_filler_opaque f = {
 		.Fattr = Fattr,
 		.data = data,
 		.objFH = objFH,
-		.Bitmap = Bitmap
+		.Bitmap = Bitmap,
+		.merge = merge
 	};
 
 	/* Permissiomn check only if ACL is asked for.
@@ -4018,6 +4061,26 @@ int nfs4_Fattr_To_FSAL_attr(struct attrlist *FSAL_attr, fattr4 *Fattr,
 	return Fattr4_To_FSAL_attr(FSAL_attr, Fattr, NULL, NULL, data);
 }
 
+/**
+ * @brief Convert NFSv4 attributes, including the file handle
+ *
+ * As nfs4_Fattr_To_FSAL_attr, also decoding FATTR4_FILEHANDLE.
+ *
+ * @param[out] FSAL_attr FSAL attributes
+ * @param[in]  Fattr     NFSv4 attributes
+ * @param[out] fh        File handle, nfs_fh4_val must point to
+ *                       NFS4_FHSIZE bytes.  Left alone if the
+ *                       attributes carry none.
+ *
+ * @return NFS4_OK if successful, NFS4ERR codes if not.
+ */
+int nfs4_Fattr_To_FSAL_attr_fh(struct attrlist *FSAL_attr, fattr4 *Fattr,
+			       nfs_fh4 *fh)
+{
+	memset(FSAL_attr, 0, sizeof(struct attrlist));
+	return Fattr4_To_FSAL_attr(FSAL_attr, Fattr, fh, NULL, NULL);
+}
+
 /**
  *
  * nfs4_Fattr_To_fsinfo: Decode filesystem info out of NFSv4 attributes.
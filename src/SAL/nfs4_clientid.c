@@ -49,6 +49,7 @@
 #include "cache_inode_lru.h"
 #include "abstract_atomic.h"
 #include "city.h"
+#include "slab_pool.h"
 
 /**
  * @brief Hashtable used to cache NFSv4 clientids
@@ -995,7 +996,7 @@ bool nfs_client_id_expire(nfs_client_id_t *clientid)
 	}
 
 	if (clientid->cid_recov_dir != NULL) {
-		nfs4_rm_clid(clientid->cid_recov_dir, v4_recov_dir, 0);
+		nfs4_rm_clid(clientid->cid_recov_dir);
 		gsh_free(clientid->cid_recov_dir);
 		clientid->cid_recov_dir = NULL;
 	}
@@ -1186,7 +1187,7 @@ int nfs_Init_client_id(void)
 
 	client_id_pool =
 	    pool_init("NFS4 Client ID Pool", sizeof(nfs_client_id_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
+		      pool_slab_substrate, NULL, NULL, NULL);
 
 	if (client_id_pool == NULL) {
 		LogCrit(COMPONENT_INIT,
@@ -1671,4 +1672,42 @@ nfs41_foreach_client_callback(bool(*cb) (nfs_client_id_t *cl, void *state),
 	return;
 }
 
+/**
+ * @brief Call a function on each 4.1 client, in this thread
+ *
+ * Unlike nfs41_foreach_client_callback, the callback runs with the
+ * hash partition locked, so it must be quick and must not take
+ * client locks.  It may take a reference on the client.
+ *
+ * @param cb    [IN] Callback function
+ * @param state [IN] param block to pass
+ */
+
+void nfs41_foreach_client(bool(*cb) (nfs_client_id_t *cl, void *state),
+			  void *state)
+{
+	uint32_t i;
+	hash_table_t *ht = ht_confirmed_client_id;
+	struct rbt_head *head_rbt;
+	struct hash_data *pdata = NULL;
+	struct rbt_node *pn;
+	nfs_client_id_t *pclientid;
+
+	for (i = 0; i < ht->parameter.index_size; i++) {
+		head_rbt = &(ht->partitions[i].rbt);
+
+		PTHREAD_RWLOCK_rdlock(&(ht->partitions[i].lock));
+
+		RBT_LOOP(head_rbt, pn) {
+			pdata = RBT_OPAQ(pn);
+			pclientid = pdata->val.addr;
+			RBT_INCREMENT(pn);
+
+			if (pclientid->cid_minorversion > 0)
+				(void)cb(pclientid, state);
+		}
+		PTHREAD_RWLOCK_unlock(&(ht->partitions[i].lock));
+	}
+}
+
 /** @} */
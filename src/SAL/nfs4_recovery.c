@@ -34,6 +34,7 @@
 #include "nfs_core.h"
 #include "nfs4.h"
 #include "sal_functions.h"
+#include "city.h"
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <ctype.h>
@@ -50,6 +51,11 @@ char v4_old_dir[PATH_MAX + 1];
  */
 static grace_t grace;
 
+/**
+ * @brief Stable storage backend for client records
+ */
+static struct nfs4_recovery_backend *recovery_backend;
+
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp);
 static void nfs_release_nlm_state();
 static void nfs_release_v4_client(char *ip);
@@ -61,7 +67,7 @@ extern struct fridgethr *state_async_fridge;
  */
 void nfs4_init_grace()
 {
-	glist_init(&grace.g_clid_list);
+	clid_table_init(&grace.g_clids);
 	pthread_mutex_init(&grace.g_mutex, NULL);
 }
 
@@ -309,128 +315,206 @@ void nfs4_create_clid_name41(nfs_client_record_t *cl_rec,
 }
 
 /**
- * @brief Create an entry in the recovery directory
+ * @brief Initialize a client name table
  *
- * This entry alows the client to reclaim state after a server
- * reboot/restart.
+ * @param[in] table The table
+ */
+void clid_table_init(struct clid_table *table)
+{
+	glist_init(&table->ct_list);
+	table->ct_hash = NULL;
+	table->ct_hash_size = 0;
+	table->ct_count = 0;
+}
+
+/**
+ * @brief Grow the hash chains of a client name table
  *
- * @param[in] clientid Client record
+ * The table is kept at no more than two entries per chain on
+ * average, if the new chains can't be allocated the old ones are
+ * kept.
+ *
+ * @param[in] table The table
  */
-void nfs4_add_clid(nfs_client_id_t *clientid)
+static void clid_table_grow(struct clid_table *table)
 {
-	int err = 0;
-	char path[PATH_MAX + 1] = {0}, segment[NAME_MAX + 1] = {0};
-	int length, position = 0;
+	struct glist_head *hash;
+	struct glist_head *glist;
+	clid_entry_t *clid_ent;
+	uint32_t size, i;
 
-	if (clientid->cid_minorversion > 0)
-		nfs4_create_clid_name41(clientid->cid_client_record, clientid);
+	size = table->ct_hash_size == 0 ? 64 : table->ct_hash_size * 2;
 
-	if (clientid->cid_recov_dir == NULL) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to create client in recovery dir, no name");
+	hash = gsh_malloc(size * sizeof(*hash));
+	if (hash == NULL)
 		return;
-	}
 
-	/* break clientid down if it is greater than max dir name */
-	/* and create a directory hierachy to represent the clientid. */
-	snprintf(path, sizeof(path), "%s", v4_recov_dir);
-
-	length = strlen(clientid->cid_recov_dir);
-	while (position < length) {
-		/* if the (remaining) clientid is shorter than 255 */
-		/* create the last level of dir and break out */
-		int len = strlen(&clientid->cid_recov_dir[position]);
-		if (len <= NAME_MAX) {
-			strcat(path, "/");
-			strncat(path, &clientid->cid_recov_dir[position], len);
-			err = mkdir(path, 0700);
-			break;
-		}
-		/* if (remaining) clientid is longer than 255, */
-		/* get the next 255 bytes and create a subdir */
-		strncpy(segment, &clientid->cid_recov_dir[position], NAME_MAX);
-		strcat(path, "/");
-		strncat(path, segment, NAME_MAX);
-		err = mkdir(path, 0700);
-		if (err == -1 && errno != EEXIST)
-			break;
-		position += NAME_MAX;
+	for (i = 0; i < size; i++)
+		glist_init(&hash[i]);
+
+	glist_for_each(glist, &table->ct_list) {
+		clid_ent = glist_entry(glist, clid_entry_t, cl_list);
+		glist_add_tail(&hash[clid_ent->cl_hashval & (size - 1)],
+			       &clid_ent->cl_hash);
 	}
 
-	if (err == -1 && errno != EEXIST) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to create client in recovery dir (%s), errno=%d",
-			 path, errno);
-	} else {
-		LogDebug(COMPONENT_CLIENTID, "Created client dir [%s]", path);
+	gsh_free(table->ct_hash);
+	table->ct_hash = hash;
+	table->ct_hash_size = size;
+}
+
+/**
+ * @brief Find a client name in a table
+ *
+ * @param[in] table The table
+ * @param[in] name  The client name
+ *
+ * @return The entry or NULL if the name is not in the table.
+ */
+clid_entry_t *clid_table_lookup(struct clid_table *table, const char *name)
+{
+	struct glist_head *chain;
+	struct glist_head *glist;
+	clid_entry_t *clid_ent;
+	uint64_t hashval;
+
+	if (table->ct_count == 0)
+		return NULL;
+
+	hashval = CityHash64(name, strlen(name));
+	chain = &table->ct_hash[hashval & (table->ct_hash_size - 1)];
+
+	glist_for_each(glist, chain) {
+		clid_ent = glist_entry(glist, clid_entry_t, cl_hash);
+		if (clid_ent->cl_hashval == hashval &&
+		    strcmp(clid_ent->cl_name, name) == 0)
+			return clid_ent;
 	}
+
+	return NULL;
 }
 
 /**
- * @brief Remove a client entry from the recovery directory
+ * @brief Add a client name to a table
  *
- * This function would be called when a client expires.
+ * @param[in] table The table
+ * @param[in] name  The client name
  *
- * @param[in] recov_dir Recovery directory
+ * @return The new or already present entry, NULL on allocation failure.
  */
-void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
+clid_entry_t *clid_table_add(struct clid_table *table, const char *name)
 {
-	int err;
-	char *path;
-	char *segment;
-	int len, segment_len;
-	int total_len;
+	clid_entry_t *clid_ent;
+	size_t len;
 
-	if (recov_dir == NULL)
-		return;
+	clid_ent = clid_table_lookup(table, name);
+	if (clid_ent != NULL)
+		return clid_ent;
 
-	len = strlen(recov_dir);
-	if (position == len)
-		return;
+	if (table->ct_count >= table->ct_hash_size * 2)
+		clid_table_grow(table);
 
-	segment = gsh_malloc(NAME_MAX+1);
-	if (segment == NULL) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to remove client in recovery dir (%s), ENOMEM",
-			  recov_dir);
-		return;
+	if (table->ct_hash_size == 0)
+		return NULL;
+
+	len = strlen(name);
+	clid_ent = gsh_malloc(sizeof(clid_entry_t) + len + 1);
+	if (clid_ent == NULL)
+		return NULL;
+
+	memcpy(clid_ent->cl_name, name, len + 1);
+	clid_ent->cl_hashval = CityHash64(name, len);
+	glist_add_tail(&table->ct_list, &clid_ent->cl_list);
+	glist_add_tail(&table->ct_hash[clid_ent->cl_hashval &
+				       (table->ct_hash_size - 1)],
+		       &clid_ent->cl_hash);
+	table->ct_count++;
+
+	return clid_ent;
+}
+
+/**
+ * @brief Remove and free an entry of a client name table
+ *
+ * @param[in] table    The table
+ * @param[in] clid_ent The entry
+ */
+void clid_table_del(struct clid_table *table, clid_entry_t *clid_ent)
+{
+	glist_del(&clid_ent->cl_list);
+	glist_del(&clid_ent->cl_hash);
+	table->ct_count--;
+	gsh_free(clid_ent);
+}
+
+/**
+ * @brief Empty a client name table and release its hash chains
+ *
+ * @param[in] table The table
+ */
+void clid_table_clear(struct clid_table *table)
+{
+	struct glist_head *glist, *glistn;
+	clid_entry_t *clid_ent;
+
+	glist_for_each_safe(glist, glistn, &table->ct_list) {
+		clid_ent = glist_entry(glist, clid_entry_t, cl_list);
+		clid_table_del(table, clid_ent);
 	}
 
-	memset(segment, 0, NAME_MAX+1);
-	strncpy(segment, &recov_dir[position], NAME_MAX);
-	segment_len = strlen(segment);
+	gsh_free(table->ct_hash);
+	clid_table_init(table);
+}
+
+/**
+ * @brief Add a client to the reclaim list
+ *
+ * Called by the recovery backend with grace.g_mutex held.
+ *
+ * @param[in] name The client name
+ *
+ * @return The entry, NULL on allocation failure.
+ */
+static clid_entry_t *nfs4_add_clid_entry(const char *name)
+{
+	return clid_table_add(&grace.g_clids, name);
+}
+
+/**
+ * @brief Create an entry in the recovery stable storage
+ *
+ * This entry alows the client to reclaim state after a server
+ * reboot/restart.
+ *
+ * @param[in] clientid Client record
+ */
+void nfs4_add_clid(nfs_client_id_t *clientid)
+{
+	if (clientid->cid_minorversion > 0)
+		nfs4_create_clid_name41(clientid->cid_client_record, clientid);
 
-	/* allocate enough memory for the new part of the string */
-	/* which is parent path + '/' + new segment */
-	total_len = strlen(parent_path) + segment_len + 2;
-	path = gsh_malloc(total_len);
-	if (path == NULL) {
+	if (clientid->cid_recov_dir == NULL) {
 		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to remove client in recovery dir (%s), ENOMEM",
-			  recov_dir);
-		gsh_free(segment);
+			 "Failed to create client in recovery dir, no name");
 		return;
 	}
-	memset(path, 0, total_len);
-	(void) snprintf(path, total_len, "%s/%s",
-			parent_path, segment);
-	/* free setment as it has no use now */
-	gsh_free(segment);
-
-	/* recursively remove the directory hirerchy which represent the
-	 *clientid
-	 */
-	nfs4_rm_clid(recov_dir, path, position+segment_len);
 
-	err = rmdir(path);
-	if (err == -1) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to remove client in recovery dir (%s), errno=%d",
-			 path, errno);
-	} else {
-		LogDebug(COMPONENT_CLIENTID, "Removed client dir [%s]", path);
-	}
-	gsh_free(path);
+	recovery_backend->add_clid(clientid);
+}
+
+/**
+ * @brief Remove a client entry from the recovery stable storage
+ *
+ * This function would be called when a client expires.
+ *
+ * @param[in] recov_dir Client name
+ */
+void nfs4_rm_clid(const char *recov_dir)
+{
+	if (recov_dir == NULL)
+		return;
+
+	recovery_backend->rm_clid(recov_dir);
 }
 
 /**
@@ -442,7 +526,6 @@ void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
  */
 void nfs4_chk_clid(nfs_client_id_t *clientid)
 {
-	struct glist_head *node;
 	clid_entry_t *clid_ent;
 
 	LogDebug(COMPONENT_CLIENTID, "chk for %s", clientid->cid_recov_dir);
@@ -455,390 +538,74 @@ void nfs4_chk_clid(nfs_client_id_t *clientid)
 
 	pthread_mutex_lock(&grace.g_mutex);
 
-	/* If there were no clients at time of restart, we're done */
-	if (glist_empty(&grace.g_clid_list)) {
-		pthread_mutex_unlock(&grace.g_mutex);
-		return;
-	}
+	clid_ent = clid_table_lookup(&grace.g_clids, clientid->cid_recov_dir);
+	if (clid_ent != NULL) {
+		if (isDebug(COMPONENT_CLIENTID)) {
+			char str[HASHTABLE_DISPLAY_STRLEN];
 
-	/*
-	 * loop through the list and try to find this client.  if we
-	 * find it, mark it to allow reclaims.  perhaps the client should
-	 * be removed from the list at this point to make the list shorter?
-	 */
-	glist_for_each(node, &grace.g_clid_list) {
-		clid_ent = glist_entry(node, clid_entry_t, cl_list);
-		LogDebug(COMPONENT_CLIENTID, "compare %s to %s",
-			 clid_ent->cl_name, clientid->cid_recov_dir);
-		if (!strncmp(clid_ent->cl_name, clientid->cid_recov_dir, PATH_MAX)) {
-			if (isDebug(COMPONENT_CLIENTID)) {
-				char str[HASHTABLE_DISPLAY_STRLEN];
-
-				display_client_id_rec(clientid, str);
-
-				LogFullDebug(COMPONENT_CLIENTID,
-					     "Allowed to reclaim ClientId %s",
-					     str);
-			}
-			clientid->cid_allow_reclaim = 1;
-			pthread_mutex_unlock(&grace.g_mutex);
-			return;
+			display_client_id_rec(clientid, str);
+
+			LogFullDebug(COMPONENT_CLIENTID,
+				     "Allowed to reclaim ClientId %s",
+				     str);
 		}
+		clientid->cid_allow_reclaim = 1;
 	}
 	pthread_mutex_unlock(&grace.g_mutex);
 }
 
-static void free_heap(char *path, char *new_path, char *build_clid)
-{
-	if (path)
-		gsh_free(path);
-	if (new_path)
-		gsh_free(new_path);
-	if (build_clid)
-		gsh_free(build_clid);
-}
-
 /**
- * @brief Create the client reclaim list
+ * @brief Find the recovery directory of a node we are taking over
  *
- * When not doing a take over, first open the old state dir and read
- * in those entries.  The reason for the two directories is in case of
- * a reboot/restart during grace period.  Next, read in entries from
- * the recovery directory and then move them into the old state
- * directory.  if called due to a take over, nodeid will be nonzero.
- * in this case, add that node's clientids to the existing list.  Then
- * move those entries into the old state directory.
+ * @param[in]  gsp  Grace period start information
+ * @param[out] path Buffer for the directory
+ * @param[in]  size Size of the buffer
  *
- * @param[in] dp       Recovery directory
- * @param[in] srcdir   Path to the source directory on failover
- * @param[in] takeover Whether this is a takeover.
- *
- * @return POSIX error codes.
+ * @retval true if the event names a directory to recover from.
+ * @retval false if not.
  */
-static int nfs4_read_recov_clids(DIR *dp,
-				 const char *parent_path,
-				 char *clid_str,
-				 char *tgtdir,
-				 int takeover)
+bool nfs4_recov_takeover_dir(nfs_grace_start_t *gsp, char *path,
+			     size_t size)
 {
-	struct dirent *dentp;
-	DIR *subdp;
-	clid_entry_t *new_ent;
-	char *path = NULL;
-	char *new_path = NULL;
-	char *build_clid = NULL;
-	int rc = 0;
-	int num = 0;
-	char *ptr, *ptr2;
-	char temp[10];
-	int cid_len, len;
-	int segment_len;
-	int total_len;
-	int total_tgt_len;
-	int total_clid_len;
-
-	dentp = readdir(dp);
-	while (dentp != NULL) {
-		/* don't add '.' and '..', or any '.*' entry */
-		if (dentp->d_name[0] != '.') {
-			num++;
-			new_path = NULL;
-
-			/* construct the path by appending the subdir for the
-			 * next readdir. This recursion keeps reading the
-			 * subdirectory until reaching the end.
-			 */
-			segment_len = strlen(dentp->d_name);
-			total_len = segment_len + 2 + strlen(parent_path);
-			path = gsh_malloc(total_len);
-			/* if failed on this subdirectory, move to next */
-			/* we might be lucky */
-			if (path == NULL) {
-				LogEvent(COMPONENT_CLIENTID,
-					 "malloc faied errno=%d", errno);
-				continue;
-			}
-			memset(path, 0, total_len);
-
-			strcpy(path, parent_path);
-			strcat(path, "/");
-			strncat(path, dentp->d_name, segment_len);
-			/* if tgtdir is not NULL, we need to build
-			 * nfs4old/currentnode
-			 */
-			if (tgtdir) {
-				total_tgt_len = segment_len + 2 +
-						strlen(tgtdir);
-				new_path = gsh_malloc(total_tgt_len);
-				if (new_path == NULL) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "malloc faied errno=%d",
-						 errno);
-					gsh_free(path);
-					continue;
-				}
-				memset(new_path, 0, total_tgt_len);
-				strcpy(new_path, tgtdir);
-				strcat(new_path, "/");
-				strncat(new_path, dentp->d_name, segment_len);
-				rc = mkdir(new_path, 0700);
-				if ((rc == -1) && (errno != EEXIST)) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "mkdir %s faied errno=%d",
-						 new_path, errno);
-				}
-			}
-			/* keep building the clientid str by cursively */
-			/* reading the directory structure */
-			if (clid_str)
-				total_clid_len = segment_len + 1 +
-						 strlen(clid_str);
-			else
-				total_clid_len = segment_len + 1;
-			build_clid = gsh_malloc(total_clid_len);
-			if (build_clid == NULL) {
-				LogEvent(COMPONENT_CLIENTID,
-					 "malloc faied errno=%d", errno);
-				free_heap(path, new_path, NULL);
-				continue;
-			}
-			memset(build_clid, 0, total_clid_len);
-			if (clid_str)
-				strcpy(build_clid, clid_str);
-			strncat(build_clid, dentp->d_name, segment_len);
-			subdp = opendir(path);
-			if (subdp == NULL) {
-				LogEvent(COMPONENT_CLIENTID,
-					 "opendir %s failed errno=%d",
-					 dentp->d_name, errno);
-				free_heap(path, new_path, build_clid);
-				/* this shouldn't happen, but we should skip
-				 * the entry to avoid infinite loops
-				 */
-				dentp = readdir(dp);
-				continue;
-			}
+	if (gsp->event == EVENT_UPDATE_CLIENTS)
+		snprintf(path, size, "%s", v4_recov_dir);
 
-			if (tgtdir)
-				rc = nfs4_read_recov_clids(subdp,
-							   path,
-							   build_clid,
-							   new_path,
-							   takeover);
-			else
-				rc = nfs4_read_recov_clids(subdp,
-							   path,
-							   build_clid,
-							   NULL,
-							   takeover);
-
-			/* close the sub directory */
-			(void)closedir(subdp);
-
-			if (new_path)
-				gsh_free(new_path);
-
-			/* after recursion, if the subdir has no non-hidden
-			 * directory this is the end of this clientid str. Add
-			 * the clientstr to the list.
-			 */
-			if (rc == 0) {
-				/* the clid format is
-				 * <IP>-(clid-len:long-form-clid-in-string-form)
-				 * make sure this reconstructed string is valid
-				 * by comparing clid-len and the actual
-				 * long-form-clid length in the string. This is
-				 * to prevent getting incompleted strings that
-				 * might exist due to program crash.
-				 */
-				if (strlen(build_clid) >= PATH_MAX) {
-					LogEvent(COMPONENT_CLIENTID,
-						"invalid clid format: %s, too long",
-						build_clid);
-					free_heap(path, NULL, build_clid);
-					dentp = readdir(dp);
-					continue;
-				}
-				ptr = strchr(build_clid, '(');
-				if (ptr == NULL) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "invalid clid format: %s",
-						 build_clid);
-					free_heap(path, NULL, build_clid);
-					dentp = readdir(dp);
-					continue;
-				}
-				ptr2 = strchr(ptr, ':');
-				if (ptr2 == NULL) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "invalid clid format: %s",
-						 build_clid);
-					free_heap(path, NULL, build_clid);
-					dentp = readdir(dp);
-					continue;
-				}
-				len = ptr2-ptr-1;
-				if (len >= 9) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "invalid clid format: %s",
-						 build_clid);
-					free_heap(path, NULL, build_clid);
-					dentp = readdir(dp);
-					continue;
-				}
-				strncpy(temp, ptr+1, len);
-				temp[len] = 0;
-				cid_len = atoi(temp);
-				len = strlen(ptr2);
-				if ((len == (cid_len+2)) &&
-				    (ptr2[len-1] == ')')) {
-					new_ent =
-					    gsh_malloc(sizeof(clid_entry_t));
-					if (new_ent == NULL) {
-						LogEvent(COMPONENT_CLIENTID,
-							 "Unable to allocate memory.");
-						free_heap(path,
-							  NULL,
-							  build_clid);
-						continue;
-					}
-					strcpy(new_ent->cl_name, build_clid);
-					glist_add(&grace.g_clid_list,
-						  &new_ent->cl_list);
-					LogDebug(COMPONENT_CLIENTID,
-						 "added %s to clid list",
-						 new_ent->cl_name);
-				}
-			}
-			gsh_free(build_clid);
-			/* If this is not for takeover, remove the directory
-			 * hierarchy  that represent the current clientid
-			 */
-			if (!takeover) {
-				rc = rmdir(path);
-				if (rc == -1) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "Failed to rmdir (%s), errno=%d",
-						 path, errno);
-				}
-			}
-			gsh_free(path);
-		}
-		dentp = readdir(dp);
-	}
+	else if (gsp->event == EVENT_TAKE_IP)
+		snprintf(path, size, "%s/%s/%s",
+			 NFS_V4_RECOV_ROOT, gsp->ipaddr,
+			 NFS_V4_RECOV_DIR);
+
+	else if (gsp->event == EVENT_TAKE_NODEID)
+		snprintf(path, size, "%s/%s/node%d",
+			 NFS_V4_RECOV_ROOT, NFS_V4_RECOV_DIR,
+			 gsp->nodeid);
+
+	else
+		return false;
 
-	return num;
+	return true;
 }
 
 /**
  * @brief Load clients for recovery, with no lock
  *
- * @param[in] nodeid Node, on takeover
+ * When not doing a takeover the reclaim list is rebuilt from scratch,
+ * otherwise the clients of the failed node are added to it.
+ *
+ * @param[in] gsp Grace period start information, NULL if not a takeover
  */
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 {
-	DIR *dp;
-	struct glist_head *node;
-	clid_entry_t *clid_entry;
-	int rc;
-	char path[PATH_MAX + 1];
-
 	LogDebug(COMPONENT_STATE, "Load recovery cli %p", gsp);
 
-	if (gsp == NULL) {
-		/* when not doing a takeover, start with an empty list */
-		if (!glist_empty(&grace.g_clid_list)) {
-			glist_for_each(node, &grace.g_clid_list) {
-				glist_del(node);
-				clid_entry =
-				    glist_entry(node, clid_entry_t, cl_list);
-				gsh_free(clid_entry);
-			}
-		}
+	/* when not doing a takeover, start with an empty list */
+	if (gsp == NULL)
+		clid_table_clear(&grace.g_clids);
 
-		dp = opendir(v4_old_dir);
-		if (dp == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to open v4 recovery dir (%s), errno=%d",
-				 v4_old_dir, errno);
-			return;
-		}
-		rc = nfs4_read_recov_clids(dp, v4_old_dir, NULL, NULL, 0);
-		if (rc == -1) {
-			(void)closedir(dp);
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to read v4 recovery dir (%s)",
-				 v4_old_dir);
-			return;
-		}
-		(void)closedir(dp);
-
-		dp = opendir(v4_recov_dir);
-		if (dp == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to open v4 recovery dir (%s), errno=%d",
-				 v4_recov_dir, errno);
-			return;
-		}
+	recovery_backend->recovery_read_clids(gsp, nfs4_add_clid_entry);
 
-		rc = nfs4_read_recov_clids(dp, v4_recov_dir,
-					   NULL, v4_old_dir, 0);
-		if (rc == -1) {
-			(void)closedir(dp);
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to read v4 recovery dir (%s)",
-				 v4_recov_dir);
-			return;
-		}
-		rc = closedir(dp);
-		if (rc == -1) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to close v4 recovery dir (%s), errno=%d",
-				 v4_recov_dir, errno);
-		}
-
-	} else {
-		if (gsp->event == EVENT_UPDATE_CLIENTS)
-			snprintf(path, sizeof(path), "%s", v4_recov_dir);
-
-		else if (gsp->event == EVENT_TAKE_IP)
-			snprintf(path, sizeof(path), "%s/%s/%s",
-				 NFS_V4_RECOV_ROOT, gsp->ipaddr,
-				 NFS_V4_RECOV_DIR);
-
-		else if (gsp->event == EVENT_TAKE_NODEID)
-			snprintf(path, sizeof(path), "%s/%s/node%d",
-				 NFS_V4_RECOV_ROOT, NFS_V4_RECOV_DIR,
-				 gsp->nodeid);
-
-		else
-			return;
-
-		LogEvent(COMPONENT_CLIENTID, "Recovery for nodeid %d dir (%s)",
-			 gsp->nodeid, path);
-
-		dp = opendir(path);
-		if (dp == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to open v4 recovery dir (%s), errno=%d",
-				 path, errno);
-			return;
-		}
-
-		rc = nfs4_read_recov_clids(dp, path, NULL, v4_old_dir, 1);
-		if (rc == -1) {
-			(void)closedir(dp);
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to read v4 recovery dir (%s)", path);
-			return;
-		}
-		rc = closedir(dp);
-		if (rc == -1) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to close v4 recovery dir (%s), errno=%d",
-				 path, errno);
-		}
-	}
+	LogEvent(COMPONENT_CLIENTID, "%"PRIu32" clients may reclaim state",
+		 grace.g_clids.ct_count);
 }
 
 /**
@@ -856,52 +623,11 @@ void nfs4_load_recov_clids(nfs_grace_start_t *gsp)
 }
 
 /**
- * @brief Clean up recovery directory
+ * @brief Clean up the records of the previous server instance
  */
-void nfs4_clean_old_recov_dir(char *parent_path)
+void nfs4_clean_old_recov_dir(void)
 {
-	DIR *dp;
-	struct dirent *dentp;
-	char *path = NULL;
-	int rc;
-	int segment_len;
-	int total_len;
-
-	dp = opendir(parent_path);
-	if (dp == NULL) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to open old v4 recovery dir (%s), errno=%d",
-			 v4_old_dir, errno);
-		return;
-	}
-
-	for (dentp = readdir(dp); dentp != NULL; dentp = readdir(dp)) {
-		/* don't remove '.' and '..', or any '.*' entry */
-		if (dentp->d_name[0] == '.')
-			continue;
-
-		segment_len = strlen(dentp->d_name);
-		total_len = strlen(parent_path) + 2 + segment_len;
-		path = gsh_malloc(total_len);
-		if (path == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Unable to allocate memory.");
-			continue;
-		}
-		memset(path, 0, total_len);
-
-		snprintf(path, total_len, "%s/%s", parent_path,
-			 dentp->d_name);
-
-		nfs4_clean_old_recov_dir(path);
-		rc = rmdir(path);
-		if (rc == -1) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to remove %s, errno=%d", path, errno);
-		}
-		gsh_free(path);
-	}
-	closedir(dp);
+	recovery_backend->clean_old();
 }
 
 /**
@@ -911,7 +637,7 @@ void nfs4_clean_old_recov_dir(char *parent_path)
  * should only need to be done once (if at all).  Also, the location
  * of the directory could be configurable.
  */
-void nfs4_create_recov_dir(void)
+static void nfs4_create_recov_dir(void)
 {
 	int err;
 
@@ -962,6 +688,33 @@ void nfs4_create_recov_dir(void)
 	}
 }
 
+/**
+ * @brief Set up the recovery stable storage
+ *
+ * Create the recovery directories and start the configured backend.
+ */
+void nfs4_recovery_init(void)
+{
+	nfs4_create_recov_dir();
+
+	if (nfs_param.nfsv4_param.recovery_backend == RECOVERY_BACKEND_LOG)
+		log_backend_init(&recovery_backend);
+	else
+		fs_backend_init(&recovery_backend);
+
+	if (recovery_backend->recovery_init != NULL)
+		recovery_backend->recovery_init();
+}
+
+/**
+ * @brief Release the recovery stable storage
+ */
+void nfs4_recovery_shutdown(void)
+{
+	if (recovery_backend->recovery_shutdown != NULL)
+		recovery_backend->recovery_shutdown();
+}
+
 /**
  * @brief Release NLM state
  */
@@ -0,0 +1,581 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup SAL State abstraction layer
+ * @{
+ */
+
+/**
+ * @file nfs4_recovery_fs.c
+ * @brief NFSv4 recovery records kept as directories
+ *
+ * Each client is represented by a directory hierarchy under the
+ * recovery directory, client names longer than NAME_MAX being split
+ * into several levels.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "nfs_core.h"
+#include "nfs4.h"
+#include "sal_functions.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+
+/**
+ * @brief Create an entry in the recovery directory
+ *
+ * This entry alows the client to reclaim state after a server
+ * reboot/restart.
+ *
+ * @param[in] clientid Client record
+ */
+static void fs_add_clid(nfs_client_id_t *clientid)
+{
+	int err = 0;
+	char path[PATH_MAX + 1] = {0}, segment[NAME_MAX + 1] = {0};
+	int length, position = 0;
+
+	/* break clientid down if it is greater than max dir name */
+	/* and create a directory hierachy to represent the clientid. */
+	snprintf(path, sizeof(path), "%s", v4_recov_dir);
+
+	length = strlen(clientid->cid_recov_dir);
+	while (position < length) {
+		/* if the (remaining) clientid is shorter than 255 */
+		/* create the last level of dir and break out */
+		int len = strlen(&clientid->cid_recov_dir[position]);
+		if (len <= NAME_MAX) {
+			strcat(path, "/");
+			strncat(path, &clientid->cid_recov_dir[position], len);
+			err = mkdir(path, 0700);
+			break;
+		}
+		/* if (remaining) clientid is longer than 255, */
+		/* get the next 255 bytes and create a subdir */
+		strncpy(segment, &clientid->cid_recov_dir[position], NAME_MAX);
+		strcat(path, "/");
+		strncat(path, segment, NAME_MAX);
+		err = mkdir(path, 0700);
+		if (err == -1 && errno != EEXIST)
+			break;
+		position += NAME_MAX;
+	}
+
+	if (err == -1 && errno != EEXIST) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create client in recovery dir (%s), errno=%d",
+			 path, errno);
+	} else {
+		LogDebug(COMPONENT_CLIENTID, "Created client dir [%s]", path);
+	}
+}
+
+/**
+ * @brief Remove a client entry from the recovery directory
+ *
+ * This function would be called when a client expires.
+ *
+ * @param[in] recov_dir   Client name
+ * @param[in] parent_path Directory holding this level of the hierarchy
+ * @param[in] position    Offset in the client name of this level
+ */
+static void fs_rm_clid_impl(const char *recov_dir, char *parent_path,
+			    int position)
+{
+	int err;
+	char *path;
+	char *segment;
+	int len, segment_len;
+	int total_len;
+
+	if (recov_dir == NULL)
+		return;
+
+	len = strlen(recov_dir);
+	if (position == len)
+		return;
+
+	segment = gsh_malloc(NAME_MAX+1);
+	if (segment == NULL) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove client in recovery dir (%s), ENOMEM",
+			  recov_dir);
+		return;
+	}
+
+	memset(segment, 0, NAME_MAX+1);
+	strncpy(segment, &recov_dir[position], NAME_MAX);
+	segment_len = strlen(segment);
+
+	/* allocate enough memory for the new part of the string */
+	/* which is parent path + '/' + new segment */
+	total_len = strlen(parent_path) + segment_len + 2;
+	path = gsh_malloc(total_len);
+	if (path == NULL) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove client in recovery dir (%s), ENOMEM",
+			  recov_dir);
+		gsh_free(segment);
+		return;
+	}
+	memset(path, 0, total_len);
+	(void) snprintf(path, total_len, "%s/%s",
+			parent_path, segment);
+	/* free setment as it has no use now */
+	gsh_free(segment);
+
+	/* recursively remove the directory hirerchy which represent the
+	 *clientid
+	 */
+	fs_rm_clid_impl(recov_dir, path, position+segment_len);
+
+	err = rmdir(path);
+	if (err == -1) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove client in recovery dir (%s), errno=%d",
+			 path, errno);
+	} else {
+		LogDebug(COMPONENT_CLIENTID, "Removed client dir [%s]", path);
+	}
+	gsh_free(path);
+}
+
+/**
+ * @brief Remove a client hierarchy from the recovery directory
+ *
+ * @param[in] recov_dir Client name
+ */
+static void fs_rm_clid(const char *recov_dir)
+{
+	fs_rm_clid_impl(recov_dir, v4_recov_dir, 0);
+}
+
+static void free_heap(char *path, char *new_path, char *build_clid)
+{
+	if (path)
+		gsh_free(path);
+	if (new_path)
+		gsh_free(new_path);
+	if (build_clid)
+		gsh_free(build_clid);
+}
+
+/**
+ * @brief Create the client reclaim list
+ *
+ * When not doing a take over, first open the old state dir and read
+ * in those entries.  The reason for the two directories is in case of
+ * a reboot/restart during grace period.  Next, read in entries from
+ * the recovery directory and then move them into the old state
+ * directory.  if called due to a take over, nodeid will be nonzero.
+ * in this case, add that node's clientids to the existing list.  Then
+ * move those entries into the old state directory.
+ *
+ * @param[in] dp             Recovery directory
+ * @param[in] srcdir         Path to the source directory on failover
+ * @param[in] takeover       Whether this is a takeover.
+ * @param[in] add_clid_entry Function adding a client to the reclaim list
+ *
+ * @return POSIX error codes.
+ */
+static int fs_read_recov_clids(DIR *dp,
+			       const char *parent_path,
+			       char *clid_str,
+			       char *tgtdir,
+			       int takeover,
+			       add_clid_entry_hook add_clid_entry)
+{
+	struct dirent *dentp;
+	DIR *subdp;
+	clid_entry_t *new_ent;
+	char *path = NULL;
+	char *new_path = NULL;
+	char *build_clid = NULL;
+	int rc = 0;
+	int num = 0;
+	char *ptr, *ptr2;
+	char temp[10];
+	int cid_len, len;
+	int segment_len;
+	int total_len;
+	int total_tgt_len;
+	int total_clid_len;
+
+	dentp = readdir(dp);
+	while (dentp != NULL) {
+		/* don't add '.' and '..', or any '.*' entry */
+		if (dentp->d_name[0] != '.') {
+			num++;
+			new_path = NULL;
+
+			/* construct the path by appending the subdir for the
+			 * next readdir. This recursion keeps reading the
+			 * subdirectory until reaching the end.
+			 */
+			segment_len = strlen(dentp->d_name);
+			total_len = segment_len + 2 + strlen(parent_path);
+			path = gsh_malloc(total_len);
+			/* if failed on this subdirectory, move to next */
+			/* we might be lucky */
+			if (path == NULL) {
+				LogEvent(COMPONENT_CLIENTID,
+					 "malloc faied errno=%d", errno);
+				continue;
+			}
+			memset(path, 0, total_len);
+
+			strcpy(path, parent_path);
+			strcat(path, "/");
+			strncat(path, dentp->d_name, segment_len);
+			/* if tgtdir is not NULL, we need to build
+			 * nfs4old/currentnode
+			 */
+			if (tgtdir) {
+				total_tgt_len = segment_len + 2 +
+						strlen(tgtdir);
+				new_path = gsh_malloc(total_tgt_len);
+				if (new_path == NULL) {
+					LogEvent(COMPONENT_CLIENTID,
+						 "malloc faied errno=%d",
+						 errno);
+					gsh_free(path);
+					continue;
+				}
+				memset(new_path, 0, total_tgt_len);
+				strcpy(new_path, tgtdir);
+				strcat(new_path, "/");
+				strncat(new_path, dentp->d_name, segment_len);
+				rc = mkdir(new_path, 0700);
+				if ((rc == -1) && (errno != EEXIST)) {
+					LogEvent(COMPONENT_CLIENTID,
+						 "mkdir %s faied errno=%d",
+						 new_path, errno);
+				}
+			}
+			/* keep building the clientid str by cursively */
+			/* reading the directory structure */
+			if (clid_str)
+				total_clid_len = segment_len + 1 +
+						 strlen(clid_str);
+			else
+				total_clid_len = segment_len + 1;
+			build_clid = gsh_malloc(total_clid_len);
+			if (build_clid == NULL) {
+				LogEvent(COMPONENT_CLIENTID,
+					 "malloc faied errno=%d", errno);
+				free_heap(path, new_path, NULL);
+				continue;
+			}
+			memset(build_clid, 0, total_clid_len);
+			if (clid_str)
+				strcpy(build_clid, clid_str);
+			strncat(build_clid, dentp->d_name, segment_len);
+			subdp = opendir(path);
+			if (subdp == NULL) {
+				LogEvent(COMPONENT_CLIENTID,
+					 "opendir %s failed errno=%d",
+					 dentp->d_name, errno);
+				free_heap(path, new_path, build_clid);
+				/* this shouldn't happen, but we should skip
+				 * the entry to avoid infinite loops
+				 */
+				dentp = readdir(dp);
+				continue;
+			}
+
+			if (tgtdir)
+				rc = fs_read_recov_clids(subdp,
+							 path,
+							 build_clid,
+							 new_path,
+							 takeover,
+							 add_clid_entry);
+			else
+				rc = fs_read_recov_clids(subdp,
+							 path,
+							 build_clid,
+							 NULL,
+							 takeover,
+							 add_clid_entry);
+
+			/* close the sub directory */
+			(void)closedir(subdp);
+
+			if (new_path)
+				gsh_free(new_path);
+
+			/* after recursion, if the subdir has no non-hidden
+			 * directory this is the end of this clientid str. Add
+			 * the clientstr to the list.
+			 */
+			if (rc == 0) {
+				/* the clid format is
+				 * <IP>-(clid-len:long-form-clid-in-string-form)
+				 * make sure this reconstructed string is valid
+				 * by comparing clid-len and the actual
+				 * long-form-clid length in the string. This is
+				 * to prevent getting incompleted strings that
+				 * might exist due to program crash.
+				 */
+				if (strlen(build_clid) >= PATH_MAX) {
+					LogEvent(COMPONENT_CLIENTID,
+						"invalid clid format: %s, too long",
+						build_clid);
+					free_heap(path, NULL, build_clid);
+					dentp = readdir(dp);
+					continue;
+				}
+				ptr = strchr(build_clid, '(');
+				if (ptr == NULL) {
+					LogEvent(COMPONENT_CLIENTID,
+						 "invalid clid format: %s",
+						 build_clid);
+					free_heap(path, NULL, build_clid);
+					dentp = readdir(dp);
+					continue;
+				}
+				ptr2 = strchr(ptr, ':');
+				if (ptr2 == NULL) {
+					LogEvent(COMPONENT_CLIENTID,
+						 "invalid clid format: %s",
+						 build_clid);
+					free_heap(path, NULL, build_clid);
+					dentp = readdir(dp);
+					continue;
+				}
+				len = ptr2-ptr-1;
+				if (len >= 9) {
+					LogEvent(COMPONENT_CLIENTID,
+						 "invalid clid format: %s",
+						 build_clid);
+					free_heap(path, NULL, build_clid);
+					dentp = readdir(dp);
+					continue;
+				}
+				strncpy(temp, ptr+1, len);
+				temp[len] = 0;
+				cid_len = atoi(temp);
+				len = strlen(ptr2);
+				if ((len == (cid_len+2)) &&
+				    (ptr2[len-1] == ')')) {
+					new_ent = add_clid_entry(build_clid);
+					if (new_ent == NULL) {
+						LogEvent(COMPONENT_CLIENTID,
+							 "Unable to allocate memory.");
+						free_heap(path,
+							  NULL,
+							  build_clid);
+						dentp = readdir(dp);
+						continue;
+					}
+					LogDebug(COMPONENT_CLIENTID,
+						 "added %s to clid list",
+						 new_ent->cl_name);
+				}
+			}
+			gsh_free(build_clid);
+			/* If this is not for takeover, remove the directory
+			 * hierarchy  that represent the current clientid
+			 */
+			if (!takeover) {
+				rc = rmdir(path);
+				if (rc == -1) {
+					LogEvent(COMPONENT_CLIENTID,
+						 "Failed to rmdir (%s), errno=%d",
+						 path, errno);
+				}
+			}
+			gsh_free(path);
+		}
+		dentp = readdir(dp);
+	}
+
+	return num;
+}
+
+/**
+ * @brief Read the client directories
+ *
+ * @param[in] gsp            Grace period start information, NULL when
+ *                           not doing a takeover
+ * @param[in] add_clid_entry Function adding a client to the reclaim list
+ */
+static void fs_read_clids(nfs_grace_start_t *gsp,
+			  add_clid_entry_hook add_clid_entry)
+{
+	DIR *dp;
+	int rc;
+	char path[PATH_MAX + 1];
+
+	if (gsp == NULL) {
+		dp = opendir(v4_old_dir);
+		if (dp == NULL) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to open v4 recovery dir (%s), errno=%d",
+				 v4_old_dir, errno);
+			return;
+		}
+		rc = fs_read_recov_clids(dp, v4_old_dir, NULL, NULL, 0,
+					 add_clid_entry);
+		if (rc == -1) {
+			(void)closedir(dp);
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to read v4 recovery dir (%s)",
+				 v4_old_dir);
+			return;
+		}
+		(void)closedir(dp);
+
+		dp = opendir(v4_recov_dir);
+		if (dp == NULL) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to open v4 recovery dir (%s), errno=%d",
+				 v4_recov_dir, errno);
+			return;
+		}
+
+		rc = fs_read_recov_clids(dp, v4_recov_dir,
+					 NULL, v4_old_dir, 0,
+					 add_clid_entry);
+		if (rc == -1) {
+			(void)closedir(dp);
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to read v4 recovery dir (%s)",
+				 v4_recov_dir);
+			return;
+		}
+		rc = closedir(dp);
+		if (rc == -1) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to close v4 recovery dir (%s), errno=%d",
+				 v4_recov_dir, errno);
+		}
+
+	} else {
+		if (!nfs4_recov_takeover_dir(gsp, path, sizeof(path)))
+			return;
+
+		LogEvent(COMPONENT_CLIENTID, "Recovery for nodeid %d dir (%s)",
+			 gsp->nodeid, path);
+
+		dp = opendir(path);
+		if (dp == NULL) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to open v4 recovery dir (%s), errno=%d",
+				 path, errno);
+			return;
+		}
+
+		rc = fs_read_recov_clids(dp, path, NULL, v4_old_dir, 1,
+					 add_clid_entry);
+		if (rc == -1) {
+			(void)closedir(dp);
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to read v4 recovery dir (%s)", path);
+			return;
+		}
+		rc = closedir(dp);
+		if (rc == -1) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to close v4 recovery dir (%s), errno=%d",
+				 path, errno);
+		}
+	}
+}
+
+/**
+ * @brief Clean up recovery directory
+ */
+static void fs_clean_old_recov_dir_impl(char *parent_path)
+{
+	DIR *dp;
+	struct dirent *dentp;
+	char *path = NULL;
+	int rc;
+	int segment_len;
+	int total_len;
+
+	dp = opendir(parent_path);
+	if (dp == NULL) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to open old v4 recovery dir (%s), errno=%d",
+			 v4_old_dir, errno);
+		return;
+	}
+
+	for (dentp = readdir(dp); dentp != NULL; dentp = readdir(dp)) {
+		/* don't remove '.' and '..', or any '.*' entry */
+		if (dentp->d_name[0] == '.')
+			continue;
+
+		segment_len = strlen(dentp->d_name);
+		total_len = strlen(parent_path) + 2 + segment_len;
+		path = gsh_malloc(total_len);
+		if (path == NULL) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Unable to allocate memory.");
+			continue;
+		}
+		memset(path, 0, total_len);
+
+		snprintf(path, total_len, "%s/%s", parent_path,
+			 dentp->d_name);
+
+		fs_clean_old_recov_dir_impl(path);
+		rc = rmdir(path);
+		if (rc == -1) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to remove %s, errno=%d", path, errno);
+		}
+		gsh_free(path);
+	}
+	closedir(dp);
+}
+
+/**
+ * @brief Clean up the old state directory
+ */
+static void fs_clean_old_recov_dir(void)
+{
+	fs_clean_old_recov_dir_impl(v4_old_dir);
+}
+
+static struct nfs4_recovery_backend fs_backend = {
+	.recovery_read_clids = fs_read_clids,
+	.add_clid = fs_add_clid,
+	.rm_clid = fs_rm_clid,
+	.clean_old = fs_clean_old_recov_dir,
+};
+
+/**
+ * @brief Select the directory based recovery backend
+ *
+ * @param[out] backend The backend operations
+ */
+void fs_backend_init(struct nfs4_recovery_backend **backend)
+{
+	*backend = &fs_backend;
+}
+
+/** @} */
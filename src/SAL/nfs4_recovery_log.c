@@ -0,0 +1,735 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup SAL State abstraction layer
+ * @{
+ */
+
+/**
+ * @file nfs4_recovery_log.c
+ * @brief NFSv4 recovery records kept in an append only log
+ *
+ * Every recovery directory holds a single log file.  Each record is
+ * a line made of '+' or '-' followed by the client name, client names
+ * being printable and free of newlines.  Records from concurrent
+ * clients are group committed: the first thread to find no flush in
+ * progress writes out everything queued so far with a single write
+ * and fdatasync while the others wait for their record to be stable.
+ * A batch that can't be made stable is cut off the log again and its
+ * records are reported as failed to their writers.  The set of live
+ * clients is kept in memory so the log can be compacted once it holds
+ * too many dead records.  It is only updated by the flushing thread
+ * once a batch is stable, so a compaction never records a client
+ * whose record might still be lost, and the compaction itself can be
+ * written out without holding the lock.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "nfs_core.h"
+#include "nfs4.h"
+#include "sal_functions.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#define RECOV_LOG_NAME ".recov_log"
+
+/**
+ * @brief Don't compact logs with fewer dead records than this
+ */
+#define RECOV_LOG_COMPACT_MIN 1024
+
+/**
+ * @brief A thread waiting for its record to be written
+ */
+struct recov_log_waiter {
+	struct glist_head list;	/*< On recov_log.waiters, in seq order */
+	uint64_t seq;		/*< The record waited for */
+	char op;		/*< '+' or '-' */
+	const char *name;	/*< Client the record is about */
+	int err;		/*< 0 once stable, errno if the batch failed */
+	bool done;		/*< The batch holding the record is over */
+};
+
+/**
+ * @brief The recovery log of this node
+ */
+static struct recov_log {
+	pthread_mutex_t lock;	/*< Protects everything below */
+	pthread_cond_t cond;	/*< Signaled when a flush completes */
+	int fd;			/*< Log file, opened for append */
+	char path[PATH_MAX + 1];	/*< Path of the log file */
+	char *buf;		/*< Records waiting to be written */
+	size_t buf_len;		/*< Bytes used in buf */
+	size_t buf_size;	/*< Bytes allocated for buf */
+	uint64_t seq_queued;	/*< Last record queued */
+	uint64_t seq_flushed;	/*< Last record taken by a flush */
+	struct glist_head waiters;	/*< Threads waiting on a flush */
+	bool flushing;		/*< A thread is writing the log */
+	uint64_t records;	/*< Records in the log file */
+	struct clid_table live;	/*< Clients recorded in the log, only
+				    changed by the flushing thread */
+	bool live_stale;	/*< live misses a client, don't compact */
+} recov_log = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.fd = -1,
+	.waiters = GLIST_HEAD_INIT(recov_log.waiters),
+};
+
+/**
+ * @brief Build the path of the log in a recovery directory
+ *
+ * @param[out] path Buffer for the path
+ * @param[in]  size Size of the buffer
+ * @param[in]  dir  The recovery directory
+ */
+static void recov_log_path(char *path, size_t size, const char *dir)
+{
+	snprintf(path, size, "%s/%s", dir, RECOV_LOG_NAME);
+}
+
+/**
+ * @brief Replay a log into a client name table
+ *
+ * A trailing record without a newline was torn by a crash and is
+ * ignored.
+ *
+ * @param[in] path  The log file
+ * @param[in] table The table to update
+ *
+ * @return Number of records read, -1 on error.
+ */
+static int64_t recov_log_replay(const char *path, struct clid_table *table)
+{
+	FILE *fp;
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t len;
+	int64_t records = 0;
+	clid_entry_t *clid_ent;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		if (errno == ENOENT)
+			return 0;
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to open recovery log (%s), errno=%d",
+			 path, errno);
+		return -1;
+	}
+
+	while ((len = getline(&line, &line_size, fp)) != -1) {
+		if (len < 2 || line[len - 1] != '\n')
+			continue;
+
+		line[len - 1] = '\0';
+		records++;
+
+		if (line[0] == '+') {
+			if (clid_table_add(table, line + 1) == NULL)
+				LogEvent(COMPONENT_CLIENTID,
+					 "Unable to allocate memory.");
+		} else if (line[0] == '-') {
+			clid_ent = clid_table_lookup(table, line + 1);
+			if (clid_ent != NULL)
+				clid_table_del(table, clid_ent);
+		} else {
+			LogEvent(COMPONENT_CLIENTID,
+				 "invalid record in %s: %s", path, line);
+		}
+	}
+
+	gsh_free(line);
+	(void)fclose(fp);
+
+	return records;
+}
+
+/**
+ * @brief Write all bytes of a buffer
+ *
+ * @return 0 on success, errno otherwise.
+ */
+static int recov_log_write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t rc;
+
+	while (len > 0) {
+		rc = write(fd, buf, len);
+		if (rc == -1) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		buf += rc;
+		len -= rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Atomically replace a log with the contents of a table
+ *
+ * The new log is written to a temporary file which is made stable and
+ * then renamed over the old one.
+ *
+ * @param[in] dir   The recovery directory holding the log
+ * @param[in] table The clients to record
+ *
+ * @return File descriptor of the new log opened for append, -1 on error.
+ */
+static int recov_log_rewrite(const char *dir, struct clid_table *table)
+{
+	char path[PATH_MAX + 1];
+	char tmp[PATH_MAX + 1];
+	char buf[4096];
+	size_t len = 0, name_len;
+	struct glist_head *glist;
+	clid_entry_t *clid_ent;
+	int fd, dfd, err = 0;
+
+	recov_log_path(path, sizeof(path), dir);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+	if (fd == -1) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create recovery log (%s), errno=%d",
+			 tmp, errno);
+		return -1;
+	}
+
+	glist_for_each(glist, &table->ct_list) {
+		clid_ent = glist_entry(glist, clid_entry_t, cl_list);
+		name_len = strlen(clid_ent->cl_name);
+
+		if (len + name_len + 2 > sizeof(buf)) {
+			err = recov_log_write_all(fd, buf, len);
+			if (err != 0)
+				goto out;
+			len = 0;
+		}
+
+		if (name_len + 2 > sizeof(buf)) {
+			/* Too long to batch, write it on its own */
+			err = recov_log_write_all(fd, "+", 1);
+			if (err == 0)
+				err = recov_log_write_all(fd, clid_ent->cl_name,
+							  name_len);
+			if (err == 0)
+				err = recov_log_write_all(fd, "\n", 1);
+			if (err != 0)
+				goto out;
+			continue;
+		}
+
+		buf[len++] = '+';
+		memcpy(buf + len, clid_ent->cl_name, name_len);
+		len += name_len;
+		buf[len++] = '\n';
+	}
+
+	err = recov_log_write_all(fd, buf, len);
+	if (err == 0 && fsync(fd) == -1)
+		err = errno;
+	if (err == 0 && rename(tmp, path) == -1)
+		err = errno;
+
+ out:
+	if (err != 0) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to write recovery log (%s), errno=%d",
+			 tmp, err);
+		(void)close(fd);
+		(void)unlink(tmp);
+		return -1;
+	}
+
+	/* Make the rename stable too */
+	dfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dfd != -1) {
+		(void)fsync(dfd);
+		(void)close(dfd);
+	}
+
+	return fd;
+}
+
+/**
+ * @brief Rewrite the log of this node from the live set
+ *
+ * Called with recov_log.lock held and recov_log.flushing set.  The
+ * lock is dropped while the new log is written: nothing else changes
+ * the live set or writes the log while flushing is set, and records
+ * queued meanwhile go out with the next batch.  Only the swap of the
+ * file descriptor is done under the lock.
+ */
+static void recov_log_compact_locked(void)
+{
+	uint32_t count = recov_log.live.ct_count;
+	int fd;
+
+	pthread_mutex_unlock(&recov_log.lock);
+	fd = recov_log_rewrite(v4_recov_dir, &recov_log.live);
+	pthread_mutex_lock(&recov_log.lock);
+
+	if (fd == -1)
+		return;
+
+	LogDebug(COMPONENT_CLIENTID,
+		 "Compacted recovery log %s from %"PRIu64" to %"PRIu32
+		 " records", recov_log.path, recov_log.records, count);
+
+	(void)close(recov_log.fd);
+	recov_log.fd = fd;
+	recov_log.records = count;
+}
+
+/**
+ * @brief Apply a stable record to the live set
+ *
+ * Called with recov_log.lock held by the flushing thread.
+ *
+ * @param[in] waiter The writer of the record
+ */
+static void recov_log_apply_locked(struct recov_log_waiter *waiter)
+{
+	clid_entry_t *clid_ent;
+
+	if (waiter->op == '-') {
+		clid_ent = clid_table_lookup(&recov_log.live, waiter->name);
+		if (clid_ent != NULL)
+			clid_table_del(&recov_log.live, clid_ent);
+		return;
+	}
+
+	if (clid_table_add(&recov_log.live, waiter->name) == NULL) {
+		/* The log holds the client but a compaction would drop it */
+		LogCrit(COMPONENT_CLIENTID,
+			"Unable to allocate memory, recovery log (%s) won't be compacted",
+			recov_log.path);
+		recov_log.live_stale = true;
+	}
+}
+
+/**
+ * @brief Write out all queued records
+ *
+ * Called with recov_log.lock held and no flush in progress.  The lock
+ * is dropped while writing so more records can be queued for the
+ * next batch.  If the batch can't be made stable, whatever part of it
+ * reached the file is truncated away so the next batch doesn't follow
+ * a torn record, and its waiters are told it failed.
+ */
+static void recov_log_flush_locked(void)
+{
+	char *buf = recov_log.buf;
+	size_t len = recov_log.buf_len;
+	size_t size = recov_log.buf_size;
+	uint64_t seq = recov_log.seq_queued;
+	uint64_t count = seq - recov_log.seq_flushed;
+	struct glist_head *glist, *glistn;
+	struct recov_log_waiter *waiter;
+	off_t end;
+	int err = 0;
+
+	recov_log.buf = NULL;
+	recov_log.buf_len = 0;
+	recov_log.buf_size = 0;
+	recov_log.seq_flushed = seq;
+	recov_log.flushing = true;
+
+	pthread_mutex_unlock(&recov_log.lock);
+
+	end = lseek(recov_log.fd, 0, SEEK_END);
+	if (end == -1)
+		err = errno;
+	if (err == 0)
+		err = recov_log_write_all(recov_log.fd, buf, len);
+	if (err == 0 && fdatasync(recov_log.fd) == -1)
+		err = errno;
+
+	if (err != 0) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Failed to write %"PRIu64" records to recovery log (%s), errno=%d",
+			count, recov_log.path, err);
+		if (end != -1 && ftruncate(recov_log.fd, end) == -1)
+			LogCrit(COMPONENT_CLIENTID,
+				"Failed to truncate recovery log (%s), errno=%d",
+				recov_log.path, errno);
+	}
+
+	pthread_mutex_lock(&recov_log.lock);
+
+	if (err == 0) {
+		LogFullDebug(COMPONENT_CLIENTID,
+			     "Committed %"PRIu64" recovery records in one batch",
+			     count);
+		recov_log.records += count;
+	}
+
+	/* Waiters are queued in seq order, so the batch is at the head */
+	glist_for_each_safe(glist, glistn, &recov_log.waiters) {
+		waiter = glist_entry(glist, struct recov_log_waiter, list);
+		if (waiter->seq > seq)
+			break;
+		if (err == 0)
+			recov_log_apply_locked(waiter);
+		waiter->err = err;
+		waiter->done = true;
+		glist_del(&waiter->list);
+	}
+
+	/* Keep the buffer around for the next batch */
+	if (recov_log.buf == NULL) {
+		recov_log.buf = buf;
+		recov_log.buf_size = size;
+	} else {
+		gsh_free(buf);
+	}
+
+	if (!recov_log.live_stale &&
+	    recov_log.records > RECOV_LOG_COMPACT_MIN &&
+	    recov_log.records > 2 * (uint64_t)recov_log.live.ct_count)
+		recov_log_compact_locked();
+
+	recov_log.flushing = false;
+	pthread_cond_broadcast(&recov_log.cond);
+}
+
+/**
+ * @brief Append a record and wait for it to be stable
+ *
+ * Called with recov_log.lock held.  The live set reflects the record
+ * once this returns 0.
+ *
+ * @param[in] op   '+' to add a client, '-' to remove it
+ * @param[in] name The client name
+ *
+ * @return 0 once the record is stable, errno if it was not written.
+ */
+static int recov_log_append_locked(char op, const char *name)
+{
+	size_t len = strlen(name) + 2;
+	struct recov_log_waiter waiter;
+	char *buf;
+
+	if (recov_log.buf_len + len > recov_log.buf_size) {
+		size_t size = MAX(recov_log.buf_size * 2,
+				  recov_log.buf_len + len);
+
+		buf = gsh_realloc(recov_log.buf, size);
+		if (buf == NULL) {
+			LogCrit(COMPONENT_CLIENTID,
+				"Unable to allocate memory.");
+			return ENOMEM;
+		}
+		recov_log.buf = buf;
+		recov_log.buf_size = size;
+	}
+
+	buf = recov_log.buf + recov_log.buf_len;
+	buf[0] = op;
+	memcpy(buf + 1, name, len - 2);
+	buf[len - 1] = '\n';
+	recov_log.buf_len += len;
+
+	waiter.seq = ++recov_log.seq_queued;
+	waiter.op = op;
+	waiter.name = name;
+	waiter.err = 0;
+	waiter.done = false;
+	glist_add_tail(&recov_log.waiters, &waiter.list);
+
+	while (!waiter.done) {
+		if (recov_log.flushing)
+			pthread_cond_wait(&recov_log.cond, &recov_log.lock);
+		else
+			recov_log_flush_locked();
+	}
+
+	return waiter.err;
+}
+
+/**
+ * @brief Check whether a client is being added to the log
+ *
+ * Called with recov_log.lock held.
+ *
+ * @param[in] name The client name
+ *
+ * @return true if an add of the client is waiting to be stable.
+ */
+static bool recov_log_adding_locked(const char *name)
+{
+	struct glist_head *glist;
+	struct recov_log_waiter *waiter;
+
+	glist_for_each(glist, &recov_log.waiters) {
+		waiter = glist_entry(glist, struct recov_log_waiter, list);
+		if (waiter->op == '+' && strcmp(waiter->name, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Open the log of this node
+ */
+static void log_recovery_init(void)
+{
+	int64_t records;
+
+	recov_log_path(recov_log.path, sizeof(recov_log.path), v4_recov_dir);
+	clid_table_init(&recov_log.live);
+
+	records = recov_log_replay(recov_log.path, &recov_log.live);
+	if (records > 0)
+		recov_log.records = records;
+
+	recov_log.fd = open(recov_log.path,
+			    O_WRONLY | O_CREAT | O_APPEND, 0600);
+	if (recov_log.fd == -1)
+		LogCrit(COMPONENT_CLIENTID,
+			"Failed to open recovery log (%s), errno=%d",
+			recov_log.path, errno);
+}
+
+/**
+ * @brief Close the log of this node
+ */
+static void log_recovery_shutdown(void)
+{
+	pthread_mutex_lock(&recov_log.lock);
+
+	while (recov_log.flushing)
+		pthread_cond_wait(&recov_log.cond, &recov_log.lock);
+
+	if (recov_log.fd != -1) {
+		(void)close(recov_log.fd);
+		recov_log.fd = -1;
+	}
+
+	clid_table_clear(&recov_log.live);
+	gsh_free(recov_log.buf);
+	recov_log.buf = NULL;
+	recov_log.buf_len = 0;
+	recov_log.buf_size = 0;
+
+	pthread_mutex_unlock(&recov_log.lock);
+}
+
+/**
+ * @brief Record a client in the log
+ *
+ * Clients already recorded don't cost any I/O.
+ *
+ * @param[in] clientid Client record
+ */
+static void log_add_clid(nfs_client_id_t *clientid)
+{
+	const char *name = clientid->cid_recov_dir;
+
+	pthread_mutex_lock(&recov_log.lock);
+
+	if (recov_log.fd == -1 ||
+	    clid_table_lookup(&recov_log.live, name) != NULL) {
+		pthread_mutex_unlock(&recov_log.lock);
+		return;
+	}
+
+	if (recov_log_append_locked('+', name) != 0) {
+		/* Not in the live set, the next add tries again */
+		pthread_mutex_unlock(&recov_log.lock);
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to log client [%s]", name);
+		return;
+	}
+
+	pthread_mutex_unlock(&recov_log.lock);
+
+	LogDebug(COMPONENT_CLIENTID, "Logged client [%s]", name);
+}
+
+/**
+ * @brief Record the removal of a client in the log
+ *
+ * @param[in] recov_dir Client name
+ */
+static void log_rm_clid(const char *recov_dir)
+{
+	pthread_mutex_lock(&recov_log.lock);
+
+	if (recov_log.fd == -1 ||
+	    (clid_table_lookup(&recov_log.live, recov_dir) == NULL &&
+	     !recov_log_adding_locked(recov_dir))) {
+		pthread_mutex_unlock(&recov_log.lock);
+		return;
+	}
+
+	if (recov_log_append_locked('-', recov_dir) != 0) {
+		/* Still in the live set, a later removal tries again */
+		pthread_mutex_unlock(&recov_log.lock);
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to log removal of client [%s]", recov_dir);
+		return;
+	}
+
+	pthread_mutex_unlock(&recov_log.lock);
+
+	LogDebug(COMPONENT_CLIENTID, "Logged removal of client [%s]",
+		 recov_dir);
+}
+
+/**
+ * @brief Read the clients that may reclaim
+ *
+ * When not doing a take over, the old log and the log of this node
+ * are read.  The reason for the two logs is in case of a
+ * reboot/restart during grace period.  The clients of this node are
+ * then merged into the old log and the log of this node starts over
+ * empty.  On take over, the log of the failed node is read and merged
+ * into the old log.
+ *
+ * @param[in] gsp            Grace period start information, NULL when
+ *                           not doing a takeover
+ * @param[in] add_clid_entry Function adding a client to the reclaim list
+ */
+static void log_read_clids(nfs_grace_start_t *gsp,
+			   add_clid_entry_hook add_clid_entry)
+{
+	struct clid_table old;
+	struct clid_table src;
+	struct glist_head *glist;
+	clid_entry_t *clid_ent;
+	char dir[PATH_MAX + 1];
+	char path[PATH_MAX + 1];
+	int fd;
+
+	clid_table_init(&old);
+	clid_table_init(&src);
+
+	if (gsp == NULL)
+		snprintf(dir, sizeof(dir), "%s", v4_recov_dir);
+	else if (!nfs4_recov_takeover_dir(gsp, dir, sizeof(dir)))
+		return;
+
+	recov_log_path(path, sizeof(path), v4_old_dir);
+	if (recov_log_replay(path, &old) == -1)
+		goto out;
+
+	if (gsp == NULL) {
+		/* Old clients may reclaim as well */
+		glist_for_each(glist, &old.ct_list) {
+			clid_ent = glist_entry(glist, clid_entry_t, cl_list);
+			if (add_clid_entry(clid_ent->cl_name) == NULL)
+				LogEvent(COMPONENT_CLIENTID,
+					 "Unable to allocate memory.");
+		}
+	} else {
+		LogEvent(COMPONENT_CLIENTID, "Recovery for nodeid %d dir (%s)",
+			 gsp->nodeid, dir);
+	}
+
+	recov_log_path(path, sizeof(path), dir);
+	if (recov_log_replay(path, &src) == -1)
+		goto out;
+
+	glist_for_each(glist, &src.ct_list) {
+		clid_ent = glist_entry(glist, clid_entry_t, cl_list);
+		if (add_clid_entry(clid_ent->cl_name) == NULL ||
+		    clid_table_add(&old, clid_ent->cl_name) == NULL)
+			LogEvent(COMPONENT_CLIENTID,
+				 "Unable to allocate memory.");
+		else
+			LogDebug(COMPONENT_CLIENTID,
+				 "added %s to clid list",
+				 clid_ent->cl_name);
+	}
+
+	/* Move the clients into the old log */
+	fd = recov_log_rewrite(v4_old_dir, &old);
+	if (fd == -1)
+		goto out;
+	(void)close(fd);
+
+	if (gsp == NULL) {
+		/* Start over with an empty log for this node */
+		pthread_mutex_lock(&recov_log.lock);
+
+		while (recov_log.flushing)
+			pthread_cond_wait(&recov_log.cond, &recov_log.lock);
+
+		recov_log.flushing = true;
+		clid_table_clear(&recov_log.live);
+		recov_log.live_stale = false;
+		recov_log_compact_locked();
+		recov_log.flushing = false;
+		pthread_cond_broadcast(&recov_log.cond);
+
+		pthread_mutex_unlock(&recov_log.lock);
+	}
+
+ out:
+	clid_table_clear(&old);
+	clid_table_clear(&src);
+}
+
+/**
+ * @brief Discard the old log
+ */
+static void log_clean_old(void)
+{
+	char path[PATH_MAX + 1];
+
+	recov_log_path(path, sizeof(path), v4_old_dir);
+
+	if (unlink(path) == -1 && errno != ENOENT)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove %s, errno=%d", path, errno);
+}
+
+static struct nfs4_recovery_backend log_backend = {
+	.recovery_init = log_recovery_init,
+	.recovery_shutdown = log_recovery_shutdown,
+	.recovery_read_clids = log_read_clids,
+	.add_clid = log_add_clid,
+	.rm_clid = log_rm_clid,
+	.clean_old = log_clean_old,
+};
+
+/**
+ * @brief Select the log based recovery backend
+ *
+ * @param[out] backend The backend operations
+ */
+void log_backend_init(struct nfs4_recovery_backend **backend)
+{
+	*backend = &log_backend;
+}
+
+/** @} */
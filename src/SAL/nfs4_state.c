@@ -219,7 +219,11 @@ bool state_conflict(state_t *state, state_type_t state_type,
 		 * We are getting a delegation and found a diff share entry.
 		 */
 		if (state->state_type == STATE_TYPE_SHARE) {
-			/* */
+			/* The delegation holder's own opens never conflict */
+			if (state->state_owner->so_owner.so_nfs4_owner.
+			    so_clientid == candidate_data->deleg.clfile_stats.
+			    clientid->cid_clientid)
+				return false;
 			if (candidate_data->deleg.sd_type
 			    == OPEN_DELEGATE_READ
 			    && state->state_data.share.share_access
@@ -798,6 +798,7 @@ nfsstat4 nfs4_check_special_stateid(cache_entry_t *entry, const char *tag,
 	struct glist_head *glist;
 	state_t *state_iterate;
 	int rc = NFS4_OK;
+	bool recall = false;
 
 	/* Acquire lock to enter critical section on this entry */
 	PTHREAD_RWLOCK_rdlock(&entry->state_lock);
@@ -854,9 +855,19 @@ nfsstat4 nfs4_check_special_stateid(cache_entry_t *entry, const char *tag,
 			break;
 
 		case STATE_TYPE_DELEG:
-			/** @todo FSF: should check for conflicting delegations,
-			 *  may need to recall
+			/* Anonymous I/O conflicts with any write delegation
+			 * and with read delegations when modifying the file.
 			 */
+			if (state_iterate->state_data.deleg.sd_type ==
+			    OPEN_DELEGATE_WRITE ||
+			    access != FATTR4_ATTR_READ) {
+				rc = NFS4ERR_DELAY;
+				recall = true;
+				LogDebug(COMPONENT_NFS_V4_LOCK,
+					 "%s conflicts with delegation %p",
+					 tag, state_iterate);
+				goto ssid_out;
+			}
 			break;
 
 		case STATE_TYPE_LAYOUT:
@@ -882,6 +893,10 @@ nfsstat4 nfs4_check_special_stateid(cache_entry_t *entry, const char *tag,
 	/* Use this exit point if the lock was already acquired. */
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
+
+	if (recall)
+		delegrecall(entry, false);
+
 	return rc;
 }
 
@@ -75,6 +75,7 @@ void init_new_deleg_state(state_data_t *deleg_state, state_t *open_state,
 	deleg_state->deleg.sd_open_state = open_state;
 	deleg_state->deleg.sd_type = sd_type;
 	deleg_state->deleg.grant_time = time(NULL);
+	deleg_state->deleg.sd_recall_pending = false;
 
 	clfile_entry->clientid = client;
 	clfile_entry->last_delegation = 0;
@@ -104,9 +105,13 @@ bool update_delegation_stats(cache_entry_t *entry, state_t *state)
 	struct file_deleg_heuristics *statistics =
 		&entry->object.file.deleg_heuristics;
 	statistics->curr_delegations++;
+	statistics->deleg_type = state->state_data.deleg.sd_type;
 	statistics->disabled = false;
 	statistics->delegation_count++;
 	statistics->last_delegation = time(NULL);
+	statistics->cbgetattr_pending = false;
+	statistics->cbgetattr_time = 0;
+	statistics->cbgetattr_mask = 0;
 
 	/* Update delegation stats for client. */
 	clfile_entry->clientid->deleg_heuristics.curr_deleg_grants++;
@@ -139,6 +144,8 @@ bool deleg_heuristics_recall(cache_entry_t *entry, nfs_client_id_t *client)
 	struct file_deleg_heuristics *statistics =
 		&entry->object.file.deleg_heuristics;
 	statistics->curr_delegations--;
+	if (statistics->curr_delegations == 0)
+		statistics->deleg_type = OPEN_DELEGATE_NONE;
 	statistics->disabled = false;
 	statistics->recall_count++;
 
@@ -183,6 +190,9 @@ bool init_deleg_heuristics(cache_entry_t *entry)
 	statistics->avg_hold = 0;
 	statistics->num_opens = 0;
 	statistics->first_open = 0;
+	statistics->cbgetattr_pending = false;
+	statistics->cbgetattr_time = 0;
+	statistics->cbgetattr_mask = 0;
 
 	return true;
 }
@@ -244,17 +254,37 @@ bool should_we_grant_deleg(cache_entry_t *entry, nfs_client_id_t *client,
 		      OPEN4_SHARE_ACCESS_WRITE)) {
 			LogMidDebug(COMPONENT_STATE,
 				    "WRITE delegate requested, but file is not opened for WRITE.");
+			return false;
+		}
+	}
+
+	/* A write delegation must be the only delegation on the file, and
+	 * a file that was just recalled is likely to be shared again soon.
+	 */
+	if (open_state->state_data.share.share_access &
+	    OPEN4_SHARE_ACCESS_WRITE) {
+		if (file_stats->curr_delegations > 0) {
+			LogMidDebug(COMPONENT_STATE,
+				    "WRITE delegate requested, but file is already delegated.");
+			return false;
+		}
+		if (file_stats->last_recall != 0 &&
+		    time(NULL) - file_stats->last_recall <
+		    nfs_param.nfsv4_param.lease_lifetime) {
+			LogDebug(COMPONENT_STATE,
+				 "File was recalled less than a lease ago. Denying WRITE delegation.");
+			return false;
 		}
 	}
 
 	/* Check if this is a misbehaving or unreliable client */
 	if (cl_stats->tot_recalls > 0 &&
-	    ((1.0 - (cl_stats->failed_recalls / cl_stats->tot_recalls))
+	    ((float)cl_stats->failed_recalls / cl_stats->tot_recalls
 	     > ACCEPTABLE_FAILS)) {
 		LogDebug(COMPONENT_STATE,
-			 "Client is %.0f unreliable during recalls. Allowed failure rate is %.0f. Denying delegation.",
-			 1.0 - (cl_stats->failed_recalls
-				/ cl_stats->tot_recalls),
+			 "Client is %.2f unreliable during recalls. Allowed failure rate is %.2f. Denying delegation.",
+			 (float)cl_stats->failed_recalls
+				/ cl_stats->tot_recalls,
 			 ACCEPTABLE_FAILS);
 		return false;
 	}
@@ -298,3 +328,46 @@ void get_deleg_perm(cache_entry_t *entry, nfsace4 *permissions,
 	permissions->who.utf8string_len = 0;
 	permissions->who.utf8string_val = NULL;
 }
+
+/**
+ * @brief Check for a delegation conflicting with a stateless access
+ *
+ * NFSv3 and anonymous NFSv4 I/O carry no state that could be checked
+ * against a delegation.  If the access conflicts with an outstanding
+ * delegation, the delegation is recalled and the caller should ask
+ * the client to retry later.  Retries find the recall pending and
+ * don't send it again.
+ *
+ * @param[in] entry File being accessed
+ * @param[in] write true if the access modifies the file
+ *
+ * @retval true if a conflicting delegation exists and is being recalled.
+ * @retval false if the access may proceed.
+ */
+bool state_deleg_conflict(cache_entry_t *entry, bool write)
+{
+	struct file_deleg_heuristics *statistics;
+	bool conflict = false;
+
+	if (entry->type != REGULAR_FILE)
+		return false;
+
+	statistics = &entry->object.file.deleg_heuristics;
+
+	PTHREAD_RWLOCK_rdlock(&entry->state_lock);
+	if (statistics->curr_delegations > 0 &&
+	    (write || statistics->deleg_type == OPEN_DELEGATE_WRITE))
+		conflict = true;
+	PTHREAD_RWLOCK_unlock(&entry->state_lock);
+
+	if (conflict) {
+		LogDebug(COMPONENT_STATE,
+			 "Access to entry %p conflicts with a %s delegation, recalling",
+			 entry,
+			 statistics->deleg_type == OPEN_DELEGATE_WRITE ?
+				"WRITE" : "READ");
+		delegrecall(entry, false);
+	}
+
+	return conflict;
+}
@@ -51,6 +51,7 @@
 #include "nlm_util.h"
 #include "cache_inode_lru.h"
 #include "export_mgr.h"
+#include "slab_pool.h"
 
 /* Forward declaration */
 static state_status_t do_lock_op(cache_entry_t *entry,
@@ -172,11 +173,11 @@ state_status_t state_lock_init(void)
 
 	state_owner_pool =
 	    pool_init("NFSv4 state owners", sizeof(state_owner_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
+		      pool_slab_substrate, NULL, NULL, NULL);
 
 	state_v4_pool =
 	    pool_init("NFSv4 files states", sizeof(state_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
+		      pool_slab_substrate, NULL, NULL, NULL);
 	return status;
 }
 
@@ -0,0 +1,920 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup cache_inode
+ * @{
+ */
+
+/**
+ * @file    cache_inode_data.c
+ * @brief   File data cache and readahead
+ *
+ * Blocks of regular files are kept in a cache shared by all files and
+ * bounded by Data_Cache_Size.  They get there two ways: READs on
+ * exports with Data_Cache set fill the blocks they miss, and
+ * sequential streams detected on any file have their next blocks read
+ * ahead asynchronously when Readahead is set.  READs the cache fully
+ * covers are served without calling the FSAL.  The block store comes
+ * first below, then the two ways of filling it.
+ *
+ * Eviction keeps two queues, in the spirit of 2Q/ARC: blocks used at
+ * most once, and blocks used again since they were cached.  The first
+ * queue is evicted from while it holds more than half the budget, so
+ * a large scan cannot push out the hot blocks.  A file's blocks go
+ * when cache_inode reclaims its entry.
+ *
+ * For readahead, each file tracks where its next read is expected.
+ * Once a few reads in a row land there, blocks are read ahead.  The
+ * window grows by one each time a block read ahead gets used and
+ * halves each time one is evicted unused.  If the FSAL accepts a
+ * WILLNEED hint through io_advise, it is trusted to read ahead by
+ * itself instead.
+ *
+ * Cached blocks carry the generation of their file, which is bumped
+ * on any write, truncate, invalidation or change id movement, so that
+ * fills racing with those are discarded.
+ *
+ * Each file's blocks and readahead state are under the file's own
+ * mutex, so lookups and fills on different files don't contend.  Only
+ * the eviction queues and byte counts are global, under data_lru_mtx,
+ * which is taken after a file's mutex.  Eviction runs without any file
+ * mutex held and only try-locks the file of each victim.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+#include "fsal.h"
+#include "log.h"
+#include "abstract_atomic.h"
+#include "fridgethr.h"
+#include "cache_inode.h"
+#include "cache_inode_lru.h"
+#include "nfs_exports.h"
+#include "export_mgr.h"
+#include "server_stats.h"
+
+/* Sequential reads needed before reading ahead */
+#define CACHE_INODE_RA_TRIGGER 2
+
+/* Initial window, in blocks */
+#define CACHE_INODE_RA_MIN 2
+
+/* Most blocks a single read is served from */
+#define CACHE_INODE_DATA_SPAN 16
+
+/* Buckets of a file's blocks, by block number */
+#define CACHE_INODE_DATA_BUCKETS 32
+
+/* Victims looked at per eviction before giving up on busy files */
+#define CACHE_INODE_DATA_EVICT_SCAN 16
+
+/**
+ * @brief A cached block of a file
+ */
+struct cache_inode_data_page {
+	struct glist_head file_link;	/*< In the file's blocks */
+	struct glist_head lru_link;	/*< In an eviction queue (lru mtx) */
+	struct cache_inode_data *file;	/*< NULL once dropped */
+	uint64_t index;			/*< Block number in the file */
+	uint32_t refs;			/*< Cache plus readers copying */
+	uint32_t len;			/*< Valid bytes */
+	bool eof;			/*< File ends in this block */
+	bool used;			/*< Served a read */
+	bool frequent;			/*< Used again since cached (lru mtx) */
+	char data[];
+};
+
+/**
+ * @brief Readahead state of a file
+ */
+struct cache_inode_ra_stream {
+	uint64_t next;			/*< Offset the next read should have */
+	uint64_t next_block;		/*< First block not read ahead */
+	uint32_t seq;			/*< Sequential reads in a row */
+	uint32_t window;		/*< Blocks kept ahead */
+	uint32_t inflight;		/*< Readahead fills running */
+	bool advised;			/*< FSAL got the io_advise hint */
+	bool fsal_readahead;		/*< FSAL reads ahead by itself */
+};
+
+/**
+ * @brief Cached data of a file
+ *
+ * The blocks are filled by readahead and by READs on Data_Cache
+ * exports alike.
+ */
+struct cache_inode_data {
+	pthread_mutex_t mtx;		/*< Protects all below and the blocks */
+	struct glist_head pages[CACHE_INODE_DATA_BUCKETS]; /*< Blocks cached */
+	uint64_t gen;			/*< Bumped when they go stale */
+	uint64_t eof_index;		/*< Last block of the file, if known */
+	struct cache_inode_ra_stream ra; /*< Readahead of the file */
+};
+
+/**
+ * @brief A readahead fill handed to the fridge
+ */
+struct cache_inode_ra_job {
+	cache_entry_t *entry;
+	uint64_t index;
+	uint64_t gen;
+	struct req_op_context req_ctx;
+	struct user_cred creds;
+	struct export_perms export_perms;
+};
+
+/* Protects the queues and byte counts, taken after a file's mtx */
+static pthread_mutex_t data_lru_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct glist_head data_recent = GLIST_HEAD_INIT(data_recent);
+static struct glist_head data_frequent = GLIST_HEAD_INIT(data_frequent);
+static uint64_t data_bytes;
+static uint64_t data_recent_bytes;
+
+/* Snapshot of the configuration */
+static uint32_t data_block;
+static uint64_t data_cap;
+static uint32_t ra_max;
+
+static struct fridgethr *ra_fridge;
+
+/**
+ * @brief Set up the data cache and start the readahead fridge
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+int cache_inode_data_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	data_block = cache_param.data_cache_block;
+	data_cap = cache_param.data_cache_size;
+	ra_max = cache_param.readahead_max;
+
+	if (!cache_param.readahead)
+		return 0;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = cache_param.readahead_threads;
+	frp.thr_min = 0;
+	frp.thread_delay = 60;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_fail;
+
+	rc = fridgethr_init(&ra_fridge, "Readahead", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to initialize readahead fridge, error code %d.",
+			 rc);
+		ra_fridge = NULL;
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Stop the readahead fridge
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+int cache_inode_data_pkgshutdown(void)
+{
+	int rc;
+
+	if (ra_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(ra_fridge, fridgethr_comm_stop, 120);
+
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(ra_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Failed shutting down readahead fridge: %d", rc);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Get the data state of a file, creating it
+ *
+ * Readers of the file may race to create it, the first one to
+ * publish its state wins.
+ *
+ * @param[in] entry The file
+ *
+ * @return The state, NULL if out of memory.
+ */
+static struct cache_inode_data *data_get(cache_entry_t *entry)
+{
+	void **slot = (void **)&entry->object.file.data_cache;
+	struct cache_inode_data *file = atomic_fetch_voidptr(slot);
+	int i;
+
+	if (file != NULL)
+		return file;
+
+	file = gsh_calloc(1, sizeof(*file));
+	if (file == NULL)
+		return NULL;
+
+	pthread_mutex_init(&file->mtx, NULL);
+	for (i = 0; i < CACHE_INODE_DATA_BUCKETS; i++)
+		glist_init(&file->pages[i]);
+	file->eof_index = UINT64_MAX;
+
+	if (!atomic_cas_voidptr(slot, NULL, file)) {
+		pthread_mutex_destroy(&file->mtx);
+		gsh_free(file);
+		file = atomic_fetch_voidptr(slot);
+	}
+
+	return file;
+}
+
+static struct cache_inode_data_page *
+data_find(struct cache_inode_data *file, uint64_t index)
+{
+	struct glist_head *glist;
+	struct cache_inode_data_page *page;
+
+	glist_for_each(glist,
+		       &file->pages[index % CACHE_INODE_DATA_BUCKETS]) {
+		page = glist_entry(glist, struct cache_inode_data_page,
+				   file_link);
+		if (page->index == index)
+			return page;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Release a reference on a block
+ *
+ * Called with the mtx of the block's file held.
+ *
+ * @param[in] page The block
+ */
+static void data_page_rele(struct cache_inode_data_page *page)
+{
+	if (--page->refs == 0)
+		gsh_free(page);
+}
+
+/**
+ * @brief Take a block out of the cache
+ *
+ * Called with the file's mtx and data_lru_mtx held.  Readers still
+ * copying from it keep it alive.
+ *
+ * @param[in] page    The block
+ * @param[in] evicted Dropped for space rather than invalidated
+ */
+static void data_page_drop(struct cache_inode_data_page *page, bool evicted)
+{
+	struct cache_inode_data *file = page->file;
+
+	glist_del(&page->file_link);
+	glist_del(&page->lru_link);
+	data_bytes -= data_block;
+	if (!page->frequent)
+		data_recent_bytes -= data_block;
+
+	/* Only readahead caches blocks nobody asked for yet */
+	if (!page->used && evicted && file->ra.window > 1)
+		file->ra.window /= 2;
+
+	server_stats_data_cache_drop(evicted, !page->used);
+
+	page->file = NULL;
+	data_page_rele(page);
+}
+
+/**
+ * @brief Take all blocks of a file out of the cache
+ *
+ * Called with the file's mtx held.
+ *
+ * @param[in] file The file's state
+ */
+static void data_drop_all(struct cache_inode_data *file)
+{
+	struct glist_head *glist, *glistn;
+	int i;
+
+	PTHREAD_MUTEX_lock(&data_lru_mtx);
+
+	for (i = 0; i < CACHE_INODE_DATA_BUCKETS; i++) {
+		glist_for_each_safe(glist, glistn, &file->pages[i]) {
+			data_page_drop(glist_entry(glist,
+						   struct cache_inode_data_page,
+						   file_link),
+				       false);
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&data_lru_mtx);
+}
+
+/**
+ * @brief Cache a block
+ *
+ * Called with the file's mtx held.  The block is not cached if the
+ * file changed since the fill started or someone else cached it
+ * first.  The caller runs data_evict() once it dropped the mtx.
+ *
+ * @param[in] file The file's state
+ * @param[in] page The filled block
+ * @param[in] gen  Generation of the file when the fill started
+ *
+ * @return true if the block was cached.
+ */
+static bool data_insert(struct cache_inode_data *file,
+			struct cache_inode_data_page *page, uint64_t gen)
+{
+	if (gen != file->gen || data_find(file, page->index) != NULL)
+		return false;
+
+	page->file = file;
+	page->refs = 1;
+	page->frequent = false;
+	glist_add(&file->pages[page->index % CACHE_INODE_DATA_BUCKETS],
+		  &page->file_link);
+	if (page->eof && page->index < file->eof_index)
+		file->eof_index = page->index;
+
+	PTHREAD_MUTEX_lock(&data_lru_mtx);
+	glist_add(&data_recent, &page->lru_link);
+	data_bytes += data_block;
+	data_recent_bytes += data_block;
+	PTHREAD_MUTEX_unlock(&data_lru_mtx);
+
+	return true;
+}
+
+/**
+ * @brief Evict blocks until the cache is within its budget
+ *
+ * Called without any file's mtx held.  The queues are locked after
+ * the files, so the file of a victim is only try-locked, and a victim
+ * whose file is busy is passed over for the next one.  If too many
+ * are busy the cache stays over budget until the next fill.
+ */
+static void data_evict(void)
+{
+	struct glist_head *queue, *glist;
+	struct cache_inode_data_page *page, *victim;
+	struct cache_inode_data *file;
+	int scanned;
+
+	PTHREAD_MUTEX_lock(&data_lru_mtx);
+
+	while (data_bytes > data_cap) {
+		if (data_recent_bytes > data_cap / 2 ||
+		    glist_empty(&data_frequent))
+			queue = &data_recent;
+		else
+			queue = &data_frequent;
+
+		/* A block on a queue is in its file, which is alive */
+		victim = NULL;
+		for (glist = queue->prev, scanned = 0;
+		     glist != queue && scanned < CACHE_INODE_DATA_EVICT_SCAN;
+		     glist = glist->prev, scanned++) {
+			page = glist_entry(glist, struct cache_inode_data_page,
+					   lru_link);
+			if (pthread_mutex_trylock(&page->file->mtx) == 0) {
+				victim = page;
+				break;
+			}
+		}
+		if (victim == NULL)
+			break;
+
+		file = victim->file;
+		data_page_drop(victim, true);
+		PTHREAD_MUTEX_unlock(&file->mtx);
+	}
+
+	PTHREAD_MUTEX_unlock(&data_lru_mtx);
+}
+
+/**
+ * @brief Serve a READ from cached blocks
+ *
+ * The read is only served if the cache covers all of it, or all of it
+ * up to the end of the file.
+ *
+ * @param[in]  entry       File read
+ * @param[in]  offset      Position of the read
+ * @param[in]  io_size     Size of the read
+ * @param[out] buffer      Data
+ * @param[out] bytes_moved Bytes read
+ * @param[out] eof         Whether the read reached the end of file
+ * @param[in]  count_miss  Account a miss if not served
+ *
+ * @return true if the read was served.
+ */
+static bool data_lookup(cache_entry_t *entry, uint64_t offset,
+			size_t io_size, void *buffer, size_t *bytes_moved,
+			bool *eof, bool count_miss)
+{
+	struct cache_inode_data_page *pages[CACHE_INODE_DATA_SPAN], *page;
+	struct cache_inode_data *file;
+	uint64_t pos = offset, end = offset + io_size, start;
+	bool at_eof = false;
+	int n = 0, i;
+
+	file = atomic_fetch_voidptr((void **)&entry->object.file.data_cache);
+
+	PTHREAD_MUTEX_lock(&file->mtx);
+
+	while (pos < end && n < CACHE_INODE_DATA_SPAN) {
+		page = data_find(file, pos / data_block);
+		if (page == NULL)
+			break;
+		start = pos - page->index * data_block;
+		if (start >= page->len) {
+			at_eof = page->eof;
+			break;
+		}
+		pages[n++] = page;
+		pos += MIN(page->len - start, end - pos);
+		if (page->len < data_block) {
+			at_eof = page->eof;
+			break;
+		}
+	}
+
+	if (pos < end && !at_eof) {
+		if (count_miss || file->ra.seq >= CACHE_INODE_RA_TRIGGER)
+			server_stats_data_cache_read(false);
+		PTHREAD_MUTEX_unlock(&file->mtx);
+		return false;
+	}
+
+	PTHREAD_MUTEX_lock(&data_lru_mtx);
+
+	for (i = 0; i < n; i++) {
+		page = pages[i];
+		page->refs++;
+		glist_del(&page->lru_link);
+		if (!page->used) {
+			page->used = true;
+			if (file->ra.window < ra_max)
+				file->ra.window++;
+		} else if (!page->frequent) {
+			page->frequent = true;
+			data_recent_bytes -= data_block;
+		}
+		glist_add(page->frequent ? &data_frequent : &data_recent,
+			  &page->lru_link);
+	}
+
+	PTHREAD_MUTEX_unlock(&data_lru_mtx);
+	PTHREAD_MUTEX_unlock(&file->mtx);
+
+	/* Copy without the lock, the references keep the blocks */
+	for (pos = offset, i = 0; i < n; i++) {
+		page = pages[i];
+		start = pos - page->index * data_block;
+		memcpy((char *)buffer + (pos - offset), page->data + start,
+		       MIN(page->len - start, end - pos));
+		pos += MIN(page->len - start, end - pos);
+	}
+
+	if (n > 0 && pages[n - 1]->eof &&
+	    pos - pages[n - 1]->index * data_block >= pages[n - 1]->len)
+		at_eof = true;
+
+	*bytes_moved = pos - offset;
+	*eof = at_eof;
+
+	PTHREAD_MUTEX_lock(&file->mtx);
+	for (i = 0; i < n; i++)
+		data_page_rele(pages[i]);
+	PTHREAD_MUTEX_unlock(&file->mtx);
+
+	server_stats_data_cache_read(true);
+
+	return true;
+}
+
+/**
+ * @brief Forget the cached data of a file
+ *
+ * @param[in] entry The file, whose content changed
+ */
+void cache_inode_data_invalidate(cache_entry_t *entry)
+{
+	struct cache_inode_data *file;
+
+	file = atomic_fetch_voidptr((void **)&entry->object.file.data_cache);
+	if (file == NULL)
+		return;
+
+	PTHREAD_MUTEX_lock(&file->mtx);
+
+	file->gen++;
+	file->ra.next_block = 0;
+	file->eof_index = UINT64_MAX;
+	data_drop_all(file);
+
+	PTHREAD_MUTEX_unlock(&file->mtx);
+}
+
+/**
+ * @brief Free the data state of a file being cleaned
+ *
+ * No read or readahead fill can be running, they hold a reference
+ * on the entry.
+ *
+ * @param[in] entry The file
+ */
+void cache_inode_data_release(cache_entry_t *entry)
+{
+	struct cache_inode_data *file;
+
+	file = entry->object.file.data_cache;
+	if (file == NULL)
+		return;
+
+	/* Once its blocks are off the queues, eviction can't find it */
+	PTHREAD_MUTEX_lock(&file->mtx);
+	data_drop_all(file);
+	entry->object.file.data_cache = NULL;
+	PTHREAD_MUTEX_unlock(&file->mtx);
+
+	pthread_mutex_destroy(&file->mtx);
+	gsh_free(file);
+}
+
+/**
+ * @brief Serve a READ by filling the blocks it covers
+ *
+ * Each block is read whole from the FSAL and cached.  The read gets
+ * what it asked for of them, stopping short at the end of file or at
+ * a short FSAL read.
+ *
+ * @param[in]  entry       File read
+ * @param[in]  offset      Position of the read
+ * @param[in]  io_size     Size of the read
+ * @param[out] buffer      Data
+ * @param[out] bytes_moved Bytes read
+ * @param[out] eof         Whether the read reached the end of file
+ *
+ * @return FSAL status of the first block's read.
+ */
+static fsal_status_t data_fill(cache_entry_t *entry, uint64_t offset,
+			       size_t io_size, void *buffer,
+			       size_t *bytes_moved, bool *eof)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	struct cache_inode_data *file;
+	struct cache_inode_data_page *page;
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+	uint64_t pos = offset, end = offset + io_size, start, gen, idx;
+	size_t read, len;
+	bool fsal_eof, cached;
+
+	file = data_get(entry);
+	if (file != NULL) {
+		PTHREAD_MUTEX_lock(&file->mtx);
+		gen = file->gen;
+		PTHREAD_MUTEX_unlock(&file->mtx);
+	} else {
+		gen = 0;
+	}
+
+	*eof = false;
+
+	for (idx = offset / data_block; pos < end; idx++) {
+		page = gsh_malloc(sizeof(*page) + data_block);
+		if (file == NULL || page == NULL) {
+			gsh_free(page);
+			if (pos > offset)
+				break;
+			return obj_hdl->ops->read(obj_hdl, offset, io_size,
+						  buffer, bytes_moved, eof);
+		}
+
+		read = 0;
+		fsal_eof = false;
+		status = obj_hdl->ops->read(obj_hdl, idx * data_block,
+					    data_block, page->data, &read,
+					    &fsal_eof);
+		if (FSAL_IS_ERROR(status)) {
+			gsh_free(page);
+			if (pos > offset)
+				status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+			break;
+		}
+
+		start = pos - idx * data_block;
+		len = read > start ? MIN(read - start, end - pos) : 0;
+		memcpy((char *)buffer + (pos - offset), page->data + start,
+		       len);
+		pos += len;
+
+		page->index = idx;
+		page->len = read;
+		page->eof = fsal_eof;
+		page->used = true;
+
+		PTHREAD_MUTEX_lock(&file->mtx);
+		cached = data_insert(file, page, gen);
+		PTHREAD_MUTEX_unlock(&file->mtx);
+
+		if (cached) {
+			data_evict();
+			server_stats_data_cache_fill(read, false);
+		} else {
+			gsh_free(page);
+		}
+
+		if (read < data_block) {
+			*eof = fsal_eof && pos >= idx * data_block + read;
+			break;
+		}
+	}
+
+	*bytes_moved = pos - offset;
+
+	return status;
+}
+
+/**
+ * @brief Read through the data cache
+ *
+ * Takes the place of the FSAL read in cache_inode_rdwr(), with the
+ * content lock held.  Reads are served from cached blocks when they
+ * cover them.  On exports with Data_Cache set, other reads fill the
+ * blocks they cover, as long as there are few enough.
+ *
+ * @param[in]  entry       File read
+ * @param[in]  offset      Position of the read
+ * @param[in]  io_size     Size of the read
+ * @param[out] buffer      Data
+ * @param[out] bytes_moved Bytes read
+ * @param[out] eof         Whether the read reached the end of file
+ *
+ * @return FSAL status.
+ */
+fsal_status_t cache_inode_data_read(cache_entry_t *entry, uint64_t offset,
+				    size_t io_size, void *buffer,
+				    size_t *bytes_moved, bool *eof)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	bool cached = (op_ctx->export->options & EXPORT_OPTION_DATA_CACHE) &&
+		      io_size != 0 &&
+		      (offset + io_size - 1) / data_block - offset / data_block <
+		      CACHE_INODE_DATA_SPAN;
+
+	/* Published once by data_get, freed only when the entry is */
+	if (io_size != 0 &&
+	    atomic_fetch_voidptr((void **)&entry->object.file.data_cache) &&
+	    data_lookup(entry, offset, io_size, buffer, bytes_moved, eof,
+			cached))
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	if (cached)
+		return data_fill(entry, offset, io_size, buffer, bytes_moved,
+				 eof);
+
+	return obj_hdl->ops->read(obj_hdl, offset, io_size, buffer,
+				  bytes_moved, eof);
+}
+
+/**
+ * @brief Fill a block in the fridge
+ *
+ * @param[in] ctx Thread context, holding the job
+ */
+static void ra_fill(struct fridgethr_context *ctx)
+{
+	struct cache_inode_ra_job *job = ctx->arg;
+	cache_entry_t *entry = job->entry;
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	struct cache_inode_data *file;
+	struct cache_inode_data_page *page;
+	fsal_status_t status = { ERR_FSAL_NOT_OPENED, 0 };
+	size_t read = 0;
+	bool eof = false, cached = false;
+
+	op_ctx = &job->req_ctx;
+
+	page = gsh_malloc(sizeof(*page) + data_block);
+	if (page != NULL) {
+		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+		/* Never open a file only to read ahead in it */
+		if (is_open(entry))
+			status = obj_hdl->ops->read(obj_hdl,
+						    job->index * data_block,
+						    data_block, page->data,
+						    &read, &eof);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	}
+
+	/* The job was scheduled on the file's state, so it exists */
+	file = atomic_fetch_voidptr((void **)&entry->object.file.data_cache);
+
+	PTHREAD_MUTEX_lock(&file->mtx);
+
+	file->ra.inflight--;
+
+	if (page != NULL && !FSAL_IS_ERROR(status)) {
+		page->index = job->index;
+		page->len = read;
+		page->eof = eof;
+		page->used = false;
+		cached = data_insert(file, page, job->gen);
+	}
+
+	PTHREAD_MUTEX_unlock(&file->mtx);
+
+	if (cached) {
+		data_evict();
+		server_stats_data_cache_fill(read, true);
+	} else {
+		gsh_free(page);
+	}
+
+	op_ctx = NULL;
+	cache_inode_lru_unref(entry, LRU_FLAG_NONE);
+	put_gsh_export(job->req_ctx.export);
+	gsh_free(job);
+}
+
+/**
+ * @brief Account a READ and read ahead if it continues a stream
+ *
+ * Called after every successful READ, with the content lock held.
+ *
+ * @param[in] entry  File read
+ * @param[in] offset Position of the read
+ * @param[in] size   Bytes actually read
+ * @param[in] eof    Whether the read reached the end of file
+ */
+void cache_inode_ra_schedule(cache_entry_t *entry, uint64_t offset,
+			     size_t size, bool eof)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	struct cache_inode_data *file;
+	struct cache_inode_ra_job *job;
+	struct io_hints hints;
+	uint64_t blocks[CACHE_INODE_RA_MAX];
+	uint64_t cur, target, idx, gen;
+	uint32_t window;
+	bool advise = false;
+	int n = 0, i, rc;
+
+	if (ra_fridge == NULL)
+		return;
+
+	file = data_get(entry);
+	if (file == NULL)
+		return;
+
+	PTHREAD_MUTEX_lock(&file->mtx);
+
+	/* Clients issue reads in parallel, allow a block of slack */
+	if (offset <= file->ra.next + data_block &&
+	    offset + data_block >= file->ra.next) {
+		if (file->ra.seq < UINT32_MAX)
+			file->ra.seq++;
+	} else {
+		file->ra.seq = 0;
+		file->ra.window = 0;
+		file->ra.next_block = 0;
+	}
+	file->ra.next = offset + size;
+
+	cur = (offset + size) / data_block;
+	if (eof && cur < file->eof_index)
+		file->eof_index = cur;
+
+	if (file->ra.seq < CACHE_INODE_RA_TRIGGER) {
+		PTHREAD_MUTEX_unlock(&file->mtx);
+		return;
+	}
+
+	if (file->ra.window == 0)
+		file->ra.window = MIN(CACHE_INODE_RA_MIN, ra_max);
+
+	if (!file->ra.advised) {
+		file->ra.advised = true;
+		advise = true;
+	}
+
+	if (!file->ra.fsal_readahead && !advise) {
+		target = cur + file->ra.window;
+		if (file->eof_index != UINT64_MAX &&
+		    target > file->eof_index + 1)
+			target = file->eof_index + 1;
+
+		for (idx = MAX(file->ra.next_block, cur);
+		     idx < target && file->ra.inflight < file->ra.window;
+		     idx++) {
+			if (data_find(file, idx) != NULL)
+				continue;
+			blocks[n++] = idx;
+			file->ra.inflight++;
+		}
+		if (idx > file->ra.next_block)
+			file->ra.next_block = idx;
+	}
+
+	gen = file->gen;
+	window = file->ra.window;
+
+	PTHREAD_MUTEX_unlock(&file->mtx);
+
+	if (advise) {
+		/* Let an FSAL that can read ahead do so itself */
+		memset(&hints, 0, sizeof(hints));
+		hints.offset = offset + size;
+		hints.count = (uint64_t) window * data_block;
+		hints.hints = (1 << IO_ADVISE4_SEQUENTIAL) |
+			      (1 << IO_ADVISE4_WILLNEED);
+		if (!FSAL_IS_ERROR(obj_hdl->ops->io_advise(obj_hdl, &hints)) &&
+		    (hints.hints & (1 << IO_ADVISE4_WILLNEED))) {
+			PTHREAD_MUTEX_lock(&file->mtx);
+			file->ra.fsal_readahead = true;
+			PTHREAD_MUTEX_unlock(&file->mtx);
+		}
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		job = gsh_malloc(sizeof(*job));
+		if (job == NULL)
+			goto fail;
+
+		job->entry = entry;
+		job->index = blocks[i];
+		job->gen = gen;
+		job->req_ctx = *op_ctx;
+		job->creds = *op_ctx->creds;
+		job->creds.caller_glen = 0;
+		job->creds.caller_garray = NULL;
+		job->export_perms = *op_ctx->export_perms;
+		job->req_ctx.creds = &job->creds;
+		job->req_ctx.export_perms = &job->export_perms;
+		job->req_ctx.caller_gdata = NULL;
+		job->req_ctx.caller_garray_copy = NULL;
+		job->req_ctx.managed_garray_copy = NULL;
+		job->req_ctx.caller_addr = NULL;
+		job->req_ctx.client = NULL;
+		job->req_ctx.fsal_private = NULL;
+
+		cache_inode_lru_ref(entry, LRU_FLAG_NONE);
+		get_gsh_export_ref(op_ctx->export);
+
+		rc = fridgethr_submit(ra_fridge, ra_fill, job);
+		if (rc == 0)
+			continue;
+
+		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
+		put_gsh_export(op_ctx->export);
+		gsh_free(job);
+ fail:
+		/* Busy, retry these blocks on a later read */
+		PTHREAD_MUTEX_lock(&file->mtx);
+		file->ra.inflight -= n - i;
+		if (blocks[i] < file->ra.next_block)
+			file->ra.next_block = blocks[i];
+		PTHREAD_MUTEX_unlock(&file->mtx);
+		break;
+	}
+}
+
+/** @} */
@@ -0,0 +1,470 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup cache_inode
+ * @{
+ */
+
+/**
+ * @file    cache_inode_gather.c
+ * @brief   Write gathering
+ *
+ * Concurrent WRITEs to the same file queue up here.  The first one to
+ * find no batch running leads the next one: it takes every queued
+ * write from the same export and caller, coalesces adjacent ranges
+ * into single FSAL writes, issues one commit for all the stable
+ * writers, and later refreshes the attributes once for the batch.
+ * Writes arriving while a batch runs form the next one, so a busy file
+ * gets group commit without any added delay.  Write_Gather_Delay
+ * additionally lets a leader that already sees company wait for
+ * stragglers.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <time.h>
+#include "fsal.h"
+#include "log.h"
+#include "cache_inode.h"
+#include "nfs_exports.h"
+#include "export_mgr.h"
+#include "server_stats.h"
+
+/* Stripes of the table of files with writes in flight */
+#define CACHE_INODE_GATHER_STRIPES 61
+
+/* Most writes taken into one batch */
+#define CACHE_INODE_GATHER_MAX 64
+
+/**
+ * @brief A write waiting to be, or being, gathered
+ */
+struct cache_inode_gather_req {
+	struct glist_head link;		/*< In the file's queue */
+	uint64_t offset;
+	size_t size;
+	void *buffer;
+	size_t written;			/*< Out: bytes written */
+	bool stable;			/*< In: stable requested, out: got */
+	fsal_status_t status;		/*< Out: result */
+	struct gsh_export *export;	/*< Only gathered with writes */
+	uid_t uid;			/*< from the same export */
+	gid_t gid;			/*< and caller */
+	struct cache_inode_gather_batch *batch;	/*< Out: batch run in */
+	bool done;
+};
+
+/**
+ * @brief A file with writes in flight
+ */
+struct cache_inode_gather_file {
+	struct glist_head link;		/*< In the stripe */
+	cache_entry_t *entry;
+	struct glist_head queue;	/*< Writes not yet taken */
+	uint32_t refs;			/*< Writes queued or running */
+	bool leader;			/*< A batch is running */
+};
+
+/**
+ * @brief A batch, kept until every member is done with it
+ */
+struct cache_inode_gather_batch {
+	struct cache_inode_gather_stripe *stripe;
+	uint32_t refs;			/*< Members not done yet */
+	bool done;			/*< Leader finished */
+	bool refreshed;			/*< Leader refreshed attributes */
+};
+
+struct cache_inode_gather_stripe {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	struct glist_head files;
+};
+
+static struct cache_inode_gather_stripe
+	gather_stripes[CACHE_INODE_GATHER_STRIPES];
+
+/**
+ * @brief Initialize the write gathering package
+ */
+void cache_inode_gather_pkginit(void)
+{
+	int i;
+
+	for (i = 0; i < CACHE_INODE_GATHER_STRIPES; i++) {
+		pthread_mutex_init(&gather_stripes[i].mtx, NULL);
+		pthread_cond_init(&gather_stripes[i].cv, NULL);
+		glist_init(&gather_stripes[i].files);
+	}
+}
+
+static inline struct cache_inode_gather_stripe *
+gather_stripe_of(cache_entry_t *entry)
+{
+	return &gather_stripes[((uintptr_t) entry >> 6) %
+			       CACHE_INODE_GATHER_STRIPES];
+}
+
+static int gather_req_cmp(const void *a, const void *b)
+{
+	const struct cache_inode_gather_req *ra =
+	    *(struct cache_inode_gather_req * const *)a;
+	const struct cache_inode_gather_req *rb =
+	    *(struct cache_inode_gather_req * const *)b;
+
+	return ra->offset < rb->offset ? -1 : ra->offset > rb->offset ? 1 : 0;
+}
+
+/**
+ * @brief Perform the writes of a batch
+ *
+ * Writes are sorted by offset unless some overlap, in which case they
+ * keep their arrival order.  Runs of adjacent writes are copied into
+ * one buffer, up to the export's maximum write size, and written at
+ * once.  The stable writers then share one commit.
+ *
+ * @param[in] entry The file
+ * @param[in] reqs  Writes of the batch
+ * @param[in] n     Number of writes
+ */
+static void gather_run(cache_entry_t *entry,
+		       struct cache_inode_gather_req **reqs, int n)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	struct cache_inode_gather_req **order, *req;
+	fsal_status_t status;
+	uint64_t maxwrite, start = UINT64_MAX, end = 0;
+	uint32_t writes = 0, commits = 0;
+	size_t len, pos, written;
+	bool fsal_sync, need_commit = false;
+	char *buf;
+	int i, j, k;
+
+	maxwrite = op_ctx->fsal_export->ops->fs_maxwrite(op_ctx->fsal_export);
+
+	order = gsh_malloc(n * sizeof(*order));
+	if (order != NULL) {
+		memcpy(order, reqs, n * sizeof(*order));
+		qsort(order, n, sizeof(*order), gather_req_cmp);
+		for (i = 1; i < n; i++)
+			if (order[i]->offset <
+			    order[i - 1]->offset + order[i - 1]->size)
+				break;
+		if (i < n)
+			memcpy(order, reqs, n * sizeof(*order));
+	} else {
+		order = reqs;
+	}
+
+	for (i = 0; i < n; i = j) {
+		len = order[i]->size;
+		for (j = i + 1; j < n; j++) {
+			if (order[j]->offset !=
+			    order[j - 1]->offset + order[j - 1]->size ||
+			    len + order[j]->size > maxwrite)
+				break;
+			len += order[j]->size;
+		}
+
+		buf = order[i]->buffer;
+		if (j - i > 1) {
+			buf = gsh_malloc(len);
+			if (buf == NULL) {
+				j = i + 1;
+				len = order[i]->size;
+				buf = order[i]->buffer;
+			} else {
+				for (pos = 0, k = i; k < j; k++) {
+					memcpy(buf + pos, order[k]->buffer,
+					       order[k]->size);
+					pos += order[k]->size;
+				}
+			}
+		}
+
+		/* Stable writers are served by the commit below */
+		fsal_sync = false;
+		written = 0;
+		status = obj_hdl->ops->write(obj_hdl, order[i]->offset, len,
+					     buf, &written, &fsal_sync);
+		writes++;
+
+		if (buf != order[i]->buffer)
+			gsh_free(buf);
+
+		for (pos = 0, k = i; k < j; k++) {
+			req = order[k];
+			req->status = status;
+			if (written > pos)
+				req->written = MIN(written - pos, req->size);
+			else
+				req->written = 0;
+			pos += req->size;
+
+			if (FSAL_IS_ERROR(status) || !req->stable) {
+				req->stable = fsal_sync;
+				continue;
+			}
+			if (fsal_sync)
+				continue;
+			need_commit = true;
+			start = MIN(start, req->offset);
+			end = MAX(end, req->offset + req->size);
+		}
+	}
+
+	if (need_commit && (obj_hdl->ops->status(obj_hdl) & FSAL_O_SYNC))
+		need_commit = false;
+
+	if (need_commit) {
+		status = obj_hdl->ops->commit(obj_hdl, start, end - start);
+		commits++;
+		for (i = 0; i < n; i++) {
+			req = reqs[i];
+			if (!req->stable || FSAL_IS_ERROR(req->status))
+				continue;
+			req->status = status;
+		}
+	}
+
+	if (order != reqs)
+		gsh_free(order);
+
+	server_stats_write_gather(n, writes, commits);
+}
+
+/**
+ * @brief Write through the gathering stage
+ *
+ * Takes the place of the FSAL write and commit in cache_inode_rdwr().
+ * The caller holds the content lock for read.  If the write ran in a
+ * batch with others, @c batch is set: the leader must call
+ * cache_inode_gather_done() once it refreshed the attributes, the
+ * others cache_inode_gather_wait() instead of refreshing them, or
+ * cache_inode_gather_put() if they give up.
+ *
+ * @param[in]     entry       File to write
+ * @param[in]     offset      Position of the write
+ * @param[in]     io_size     Size of the write
+ * @param[out]    bytes_moved Bytes written
+ * @param[in]     buffer      Data
+ * @param[in,out] sync        Stable write requested, and obtained
+ * @param[out]    batch       Batch the write ran in, or NULL
+ * @param[out]    leader      Whether this thread led that batch
+ *
+ * @return The FSAL status of the write.
+ */
+fsal_status_t cache_inode_gather_write(cache_entry_t *entry,
+				       uint64_t offset, size_t io_size,
+				       size_t *bytes_moved, void *buffer,
+				       bool *sync,
+				       struct cache_inode_gather_batch **batch,
+				       bool *leader)
+{
+	struct cache_inode_gather_stripe *stripe = gather_stripe_of(entry);
+	struct cache_inode_gather_req req, *reqs[CACHE_INODE_GATHER_MAX];
+	struct cache_inode_gather_file *gf;
+	struct cache_inode_gather_batch *gb = NULL;
+	struct glist_head *glist, *glistn;
+	uint32_t delay = op_ctx->export->write_gather_delay;
+	struct timespec deadline;
+	int n = 0, i;
+
+	memset(&req, 0, sizeof(req));
+	req.offset = offset;
+	req.size = io_size;
+	req.buffer = buffer;
+	req.stable = *sync;
+	req.export = op_ctx->export;
+	req.uid = op_ctx->creds->caller_uid;
+	req.gid = op_ctx->creds->caller_gid;
+
+	*batch = NULL;
+	*leader = false;
+
+	PTHREAD_MUTEX_lock(&stripe->mtx);
+
+	glist_for_each(glist, &stripe->files) {
+		gf = glist_entry(glist, struct cache_inode_gather_file, link);
+		if (gf->entry == entry)
+			goto found;
+	}
+
+	gf = gsh_calloc(1, sizeof(*gf));
+	if (gf == NULL) {
+		/* Write on our own */
+		PTHREAD_MUTEX_unlock(&stripe->mtx);
+		reqs[0] = &req;
+		gather_run(entry, reqs, 1);
+		goto out;
+	}
+	gf->entry = entry;
+	glist_init(&gf->queue);
+	glist_add_tail(&stripe->files, &gf->link);
+
+ found:
+	glist_add_tail(&gf->queue, &req.link);
+	gf->refs++;
+
+	while (!req.done && gf->leader)
+		pthread_cond_wait(&stripe->cv, &stripe->mtx);
+
+	if (!req.done) {
+		gf->leader = true;
+
+		/* Others are already waiting, give stragglers a moment */
+		if (delay != 0 && gf->queue.next->next != &gf->queue) {
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += (long)delay * 1000;
+			deadline.tv_sec += deadline.tv_nsec / 1000000000;
+			deadline.tv_nsec %= 1000000000;
+			while (pthread_cond_timedwait(&stripe->cv, &stripe->mtx,
+						      &deadline) == 0)
+				;
+		}
+
+		reqs[n++] = &req;
+		glist_del(&req.link);
+		glist_for_each_safe(glist, glistn, &gf->queue) {
+			struct cache_inode_gather_req *other =
+			    glist_entry(glist, struct cache_inode_gather_req,
+					link);
+
+			if (n == CACHE_INODE_GATHER_MAX)
+				break;
+			if (other->export != req.export ||
+			    other->uid != req.uid || other->gid != req.gid)
+				continue;
+			glist_del(&other->link);
+			reqs[n++] = other;
+		}
+
+		if (n > 1) {
+			gb = gsh_calloc(1, sizeof(*gb));
+			if (gb != NULL) {
+				gb->stripe = stripe;
+				gb->refs = n;
+			}
+		}
+
+		PTHREAD_MUTEX_unlock(&stripe->mtx);
+		gather_run(entry, reqs, n);
+		PTHREAD_MUTEX_lock(&stripe->mtx);
+
+		for (i = 0; i < n; i++) {
+			reqs[i]->batch = gb;
+			reqs[i]->done = true;
+		}
+		gf->leader = false;
+		*leader = gb != NULL;
+		pthread_cond_broadcast(&stripe->cv);
+	}
+
+	if (--gf->refs == 0) {
+		glist_del(&gf->link);
+		gsh_free(gf);
+	}
+
+	PTHREAD_MUTEX_unlock(&stripe->mtx);
+
+	*batch = req.batch;
+
+ out:
+	*bytes_moved = req.written;
+	*sync = req.stable;
+	return req.status;
+}
+
+/**
+ * @brief Drop a reference on a batch
+ *
+ * Called with the stripe locked.
+ */
+static void gather_batch_rele(struct cache_inode_gather_batch *batch)
+{
+	if (--batch->refs == 0)
+		gsh_free(batch);
+}
+
+/**
+ * @brief Leader is done with a batch
+ *
+ * @param[in] batch     The batch
+ * @param[in] refreshed Whether attributes were refreshed after it
+ */
+void cache_inode_gather_done(struct cache_inode_gather_batch *batch,
+			     bool refreshed)
+{
+	struct cache_inode_gather_stripe *stripe = batch->stripe;
+
+	PTHREAD_MUTEX_lock(&stripe->mtx);
+	batch->done = true;
+	batch->refreshed = refreshed;
+	pthread_cond_broadcast(&stripe->cv);
+	gather_batch_rele(batch);
+	PTHREAD_MUTEX_unlock(&stripe->mtx);
+}
+
+/**
+ * @brief Wait for the leader of a batch to refresh attributes
+ *
+ * Must be called without the content or attribute locks held.
+ *
+ * @param[in] batch The batch, released on return
+ *
+ * @return true if the leader refreshed the attributes.
+ */
+bool cache_inode_gather_wait(struct cache_inode_gather_batch *batch)
+{
+	struct cache_inode_gather_stripe *stripe = batch->stripe;
+	bool refreshed;
+
+	PTHREAD_MUTEX_lock(&stripe->mtx);
+	while (!batch->done)
+		pthread_cond_wait(&stripe->cv, &stripe->mtx);
+	refreshed = batch->refreshed;
+	gather_batch_rele(batch);
+	PTHREAD_MUTEX_unlock(&stripe->mtx);
+
+	return refreshed;
+}
+
+/**
+ * @brief Leave a batch without waiting for its leader
+ *
+ * @param[in] batch The batch
+ */
+void cache_inode_gather_put(struct cache_inode_gather_batch *batch)
+{
+	struct cache_inode_gather_stripe *stripe = batch->stripe;
+
+	PTHREAD_MUTEX_lock(&stripe->mtx);
+	gather_batch_rele(batch);
+	PTHREAD_MUTEX_unlock(&stripe->mtx);
+}
+
+/** @} */
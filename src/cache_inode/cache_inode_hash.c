@@ -41,6 +41,7 @@
 #include "log.h"
 #include "cache_inode.h"
 #include "cache_inode_hash.h"
+#include "config_parsing.h"
 
 /**
  * @addtogroup cache_inode
@@ -63,6 +64,50 @@
 struct cih_lookup_table cih_fhcache;
 static bool initialized;
 
+/**
+ * @brief Smallest prime not below a value
+ *
+ * @param[in] v The value
+ *
+ * @return The prime.
+ */
+static uint32_t
+cih_next_prime(uint32_t v)
+{
+	if (v <= 2)
+		return 2;
+	v |= 1;
+	while (!is_prime(v))
+		v += 2;
+	return v;
+}
+
+/**
+ * @brief Number of partitions to use
+ *
+ * Unless set with NParts, scale partitions (and so their locks) with
+ * the number of CPUs, and with Entries_HWMark so trees stay shallow.
+ *
+ * @return The number of partitions.
+ */
+static uint32_t
+cih_npart(void)
+{
+	long ncpu;
+	uint32_t npart;
+
+	if (cache_param.nparts != 0)
+		return cache_param.nparts;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1)
+		ncpu = 1;
+
+	npart = MAX(2 * ncpu, cache_param.entries_hwmark / 16384);
+	npart = cih_next_prime(MAX(npart, 7));
+	return MIN(npart, CIH_NPART_MAX);
+}
+
 /**
  * @brief Initialize the package.
  */
@@ -72,7 +117,7 @@ cih_pkginit(void)
 	pthread_rwlockattr_t rwlock_attr;
 	cih_partition_t *cp;
 	uint32_t npart;
-	uint32_t cache_sz = 32767;	/* XXX */
+	uint32_t cache_sz;
 	int ix;
 
 	/* avoid writer starvation */
@@ -82,18 +127,108 @@ cih_pkginit(void)
 		&rwlock_attr,
 		PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
 #endif
-	npart = cache_param.nparts;
+	npart = cih_npart();
 	cih_fhcache.npart = npart;
 	cih_fhcache.partition = gsh_calloc(npart, sizeof(cih_partition_t));
+
+	/* Start each lookup cache at half the partition's share of the
+	 * high water mark; they grow with the trees.
+	 */
+	cache_sz = cache_param.entries_hwmark / npart / 2;
+	cache_sz = cih_next_prime(MIN(MAX(cache_sz, CIH_CACHE_MIN),
+				      CIH_CACHE_MAX));
+
 	for (ix = 0; ix < npart; ++ix) {
 		cp = &cih_fhcache.partition[ix];
 		cp->part_ix = ix;
 		pthread_rwlock_init(&cp->lock, &rwlock_attr);
 		avltree_init(&cp->t, cih_fh_cmpf, 0 /* must be 0 */);
-		cih_fhcache.cache_sz = cache_sz;
+		cp->cache_sz = cache_sz;
 		cp->cache = gsh_calloc(cache_sz, sizeof(struct avltree_node *));
 	}
 	initialized = true;
+
+	LogInfo(COMPONENT_CACHE_INODE,
+		"Handle table has %"PRIu32" partitions, %"PRIu32
+		" lookup cache slots each", npart, cache_sz);
+}
+
+/**
+ * @brief Grow a partition's lookup cache
+ *
+ * Called with the partition write locked once its tree holds more
+ * than twice as many entries as the cache has slots.  The entries of
+ * the old cache are moved over to their slots in the new one, so
+ * lookups keep hitting; other partitions are not affected.  The number
+ * of partitions is set at start up and never changes.
+ *
+ * @param cp [in] The partition
+ */
+void
+cih_cache_resize(cih_partition_t *cp)
+{
+	struct avltree_node **cache;
+	struct avltree_node *node;
+	cache_entry_t *entry;
+	uint32_t cache_sz, ix;
+
+	cache_sz = cih_next_prime(MIN(4 * cp->cache_sz, CIH_CACHE_MAX));
+	cache = gsh_calloc(cache_sz, sizeof(struct avltree_node *));
+	if (cache == NULL) {
+		LogWarn(COMPONENT_CACHE_INODE,
+			"Could not grow lookup cache of partition %"PRIu32,
+			cp->part_ix);
+		return;
+	}
+
+	LogDebug(COMPONENT_CACHE_INODE,
+		 "Partition %"PRIu32" lookup cache %"PRIu32" -> %"PRIu32
+		 " slots for %"PRIu32" entries",
+		 cp->part_ix, cp->cache_sz, cache_sz, cp->nentries);
+
+	for (ix = 0; ix < cp->cache_sz; ++ix) {
+		node = cp->cache[ix];
+		if (node == NULL)
+			continue;
+		entry = avltree_container_of(node, cache_entry_t, fh_hk.node_k);
+		cache[entry->fh_hk.key.hk % cache_sz] = node;
+	}
+
+	gsh_free(cp->cache);
+	cp->cache = cache;
+	cp->cache_sz = cache_sz;
+	cp->stats.resizes++;
+}
+
+/**
+ * @brief Summarize the table
+ *
+ * @param stats [out] The summary
+ */
+void
+cih_get_stats(struct cih_table_stats *stats)
+{
+	cih_partition_t *cp;
+	int ix;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!initialized)
+		return;
+
+	stats->npart = cih_fhcache.npart;
+	for (ix = 0; ix < cih_fhcache.npart; ++ix) {
+		cp = &cih_fhcache.partition[ix];
+		PTHREAD_RWLOCK_rdlock(&cp->lock);
+		stats->entries += cp->nentries;
+		stats->max_entries = MAX(stats->max_entries, cp->nentries);
+		stats->max_depth = MAX(stats->max_depth, cp->t.height);
+		stats->cache_slots += cp->cache_sz;
+		stats->resizes += cp->stats.resizes;
+		PTHREAD_RWLOCK_unlock(&cp->lock);
+		stats->cache_hit += atomic_fetch_uint64_t(&cp->stats.cache_hit);
+		stats->avl_hit += atomic_fetch_uint64_t(&cp->stats.avl_hit);
+		stats->miss += atomic_fetch_uint64_t(&cp->stats.miss);
+	}
 }
 
 /**
@@ -39,6 +39,7 @@
 #include "hashtable.h"
 #include "cache_inode.h"
 #include "cache_inode_hash.h"
+#include "slab_pool.h"
 
 /**
  *
@@ -56,7 +57,7 @@ cache_inode_init(void)
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 
 	cache_inode_entry_pool =
-	    pool_init("Entry Pool", sizeof(cache_entry_t), pool_basic_substrate,
+	    pool_init("Entry Pool", sizeof(cache_entry_t), pool_slab_substrate,
 		      NULL, NULL, NULL);
 	if (!(cache_inode_entry_pool)) {
 		LogCrit(COMPONENT_CACHE_INODE, "Can't init Entry Pool");
@@ -64,6 +65,7 @@ cache_inode_init(void)
 	}
 
 	cih_pkginit();
+	cache_inode_gather_pkginit();
 
 	return status;
 }				/* cache_inode_init */
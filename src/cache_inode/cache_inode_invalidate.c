@@ -90,10 +90,13 @@ cache_inode_invalidate(cache_entry_t *entry, uint32_t flags)
 		atomic_clear_uint32_t_bits(&entry->flags,
 					   CACHE_INODE_TRUST_ATTRS);
 
-	if (flags & CACHE_INODE_INVALIDATE_CONTENT)
+	if (flags & CACHE_INODE_INVALIDATE_CONTENT) {
 		atomic_clear_uint32_t_bits(&entry->flags,
 					   CACHE_INODE_TRUST_CONTENT |
 					   CACHE_INODE_DIR_POPULATED);
+		if (entry->type == REGULAR_FILE)
+			cache_inode_data_invalidate(entry);
+	}
 
 	/* lock order requires that we release entry->attr_lock before
 	 * calling cache_inode_close! */
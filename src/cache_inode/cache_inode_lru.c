@@ -407,6 +407,8 @@ cache_inode_lru_clean(cache_entry_t *entry)
 
 	if (entry->type == DIRECTORY)
 		cache_inode_release_dirents(entry, CACHE_INODE_AVL_BOTH);
+	else if (entry->type == REGULAR_FILE)
+		cache_inode_data_release(entry);
 
 	/* Free FSAL resources */
 	if (entry->obj_handle) {
@@ -343,6 +343,9 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 
 		/* Init statistics used for intelligently granting delegations*/
 		init_deleg_heuristics(nentry);
+
+		/* Stream state comes with the first read */
+		nentry->object.file.data_cache = NULL;
 		break;
 
 	case DIRECTORY:
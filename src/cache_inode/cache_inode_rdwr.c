@@ -93,6 +93,11 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 	bool attributes_locked = false;
 	/* TRUE if we opened a previously closed FD */
 	bool opened = false;
+	/* Batch a gathered write ran in, and whether we led it */
+	struct cache_inode_gather_batch *batch = NULL;
+	bool leader = false;
+	/* True once attributes are refreshed after the write */
+	bool refreshed = false;
 
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 
@@ -157,36 +162,56 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 	/* Call FSAL_read or FSAL_write */
 	if (io_direction == CACHE_INODE_READ) {
 		fsal_status =
-		    obj_hdl->ops->read(obj_hdl, offset, io_size,
-				       buffer, bytes_moved, eof);
+		    cache_inode_data_read(entry, offset, io_size, buffer,
+					  bytes_moved, eof);
+		if (!FSAL_IS_ERROR(fsal_status))
+			cache_inode_ra_schedule(entry, offset, *bytes_moved,
+						*eof);
 	} else if (io_direction == CACHE_INODE_READ_PLUS) {
 		fsal_status =
 		    obj_hdl->ops->read_plus(obj_hdl, offset, io_size,
 					    buffer, bytes_moved, eof, info);
 	} else {
 		bool fsal_sync = *sync;
-		if (io_direction == CACHE_INODE_WRITE)
+		bool gathered = false;
+
+		if (io_direction == CACHE_INODE_WRITE &&
+		    (op_ctx->export->options & EXPORT_OPTION_WRITE_GATHER)) {
+			/* Gathering does the write and any commit */
+			gathered = true;
+			fsal_status =
+			  cache_inode_gather_write(entry, offset, io_size,
+						   bytes_moved, buffer, sync,
+						   &batch, &leader);
+		} else if (io_direction == CACHE_INODE_WRITE) {
 			fsal_status =
 			  obj_hdl->ops->write(obj_hdl, offset,
 					      io_size, buffer, bytes_moved,
 					      &fsal_sync);
-		else
+		} else {
 			fsal_status =
 			  obj_hdl->ops->write_plus(obj_hdl, offset,
 						   io_size, buffer,
 						   bytes_moved, &fsal_sync,
 						   info);
+		}
 		/* Alright, the unstable write is complete. Now if it was
 		   supposed to be a stable write we can sync to the hard
 		   drive. */
 
-		if (*sync && !(obj_hdl->ops->status(obj_hdl) & FSAL_O_SYNC)
-		    && !fsal_sync && !FSAL_IS_ERROR(fsal_status)) {
+		if (gathered) {
+			/* Already committed by the gathering stage */
+		} else if (*sync &&
+			   !(obj_hdl->ops->status(obj_hdl) & FSAL_O_SYNC)
+			   && !fsal_sync && !FSAL_IS_ERROR(fsal_status)) {
 			fsal_status = obj_hdl->ops->commit(obj_hdl,
 							   offset, io_size);
 		} else {
 			*sync = fsal_sync;
 		}
+
+		/* Whatever was read ahead here is stale now */
+		cache_inode_data_invalidate(entry);
 	}
 
 	LogFullDebug(COMPONENT_FSAL,
@@ -264,6 +289,16 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 		content_locked = false;
 	}
 
+	/* The leader of our batch refreshes the attributes for all */
+	if (batch != NULL && !leader) {
+		refreshed = cache_inode_gather_wait(batch);
+		batch = NULL;
+		if (refreshed) {
+			status = CACHE_INODE_SUCCESS;
+			goto out;
+		}
+	}
+
 	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 	attributes_locked = true;
 	if (io_direction == CACHE_INODE_WRITE ||
@@ -271,6 +306,7 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 		status = cache_inode_refresh_attrs(entry);
 		if (status != CACHE_INODE_SUCCESS)
 			goto out;
+		refreshed = true;
 	} else
 		cache_inode_set_time_current(&obj_hdl->attributes.atime);
 	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
@@ -290,6 +326,13 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 		attributes_locked = false;
 	}
 
+	if (batch != NULL) {
+		if (leader)
+			cache_inode_gather_done(batch, refreshed);
+		else
+			cache_inode_gather_put(batch);
+	}
+
 	return status;
 }
 
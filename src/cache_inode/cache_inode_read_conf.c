@@ -38,6 +38,7 @@
 #include "hashtable.h"
 #include "fsal.h"
 #include "cache_inode.h"
+#include "cache_inode_hash.h"
 #include "config_parsing.h"
 
 #include <unistd.h>
@@ -53,7 +54,7 @@
 struct cache_inode_parameter cache_param;
 
 static struct config_item cache_inode_params[] = {
-	CONF_ITEM_UI32("NParts", 1, 20, 7,
+	CONF_ITEM_UI32("NParts", 0, CIH_NPART_MAX, 0,
 		       cache_inode_parameter, nparts),
 	CONF_ITEM_I32("Attr_Expiration_Time", -1, INT32_MAX, 60,
 		       cache_inode_parameter, expire_time_attr),
@@ -81,6 +82,22 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, futility_count),
 	CONF_ITEM_BOOL("Retry_Readdir", false,
 		       cache_inode_parameter, retry_readdir),
+	CONF_ITEM_UI64("Data_Cache_Size", 1024 * 1024, UINT64_MAX,
+		       64 * 1024 * 1024,
+		       cache_inode_parameter, data_cache_size),
+	CONF_ITEM_UI32("Data_Cache_Block_Size", 4096, 16 * 1024 * 1024,
+		       256 * 1024,
+		       cache_inode_parameter, data_cache_block),
+	CONF_ITEM_BOOL("Readahead", false,
+		       cache_inode_parameter, readahead),
+	CONF_ITEM_UI32("Readahead_Max_Blocks", 1, CACHE_INODE_RA_MAX, 16,
+		       cache_inode_parameter, readahead_max),
+	CONF_ITEM_UI32("Readahead_Threads", 1, 256, 8,
+		       cache_inode_parameter, readahead_threads),
+	CONF_ITEM_BOOL("Upcall_Coalesce", true,
+		       cache_inode_parameter, upcall_coalesce),
+	CONF_ITEM_UI32("Upcall_Queue_Depth", 1024, 16 * 1024 * 1024, 65536,
+		       cache_inode_parameter, upcall_queue_depth),
 	CONFIG_EOL
 };
 
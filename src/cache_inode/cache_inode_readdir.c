@@ -361,9 +361,11 @@ struct cache_inode_populate_cb_state {
  * @brief Populate a single dir entry
  *
  * This callback serves to populate a single dir entry from the
- * readdir.
+ * readdir.  If the FSAL supplied a handle for the entry it is used
+ * as is, otherwise the entry is looked up.
  *
  * @param[in]     name      Name of the directory entry
+ * @param[in]     entry_hdl Handle from the FSAL, or NULL
  * @param[in,out] dir_state Callback state
  * @param[in]     cookie    Directory cookie
  *
@@ -372,31 +374,33 @@ struct cache_inode_populate_cb_state {
  */
 
 static bool
-populate_dirent(const char *name, void *dir_state,
-		fsal_cookie_t cookie)
+populate_dirent(const char *name, struct fsal_obj_handle *entry_hdl,
+		void *dir_state, fsal_cookie_t cookie)
 {
 	struct cache_inode_populate_cb_state *state =
 	    (struct cache_inode_populate_cb_state *)dir_state;
-	struct fsal_obj_handle *entry_hdl;
 	cache_inode_dir_entry_t *new_dir_entry = NULL;
 	cache_entry_t *cache_entry = NULL;
 	fsal_status_t fsal_status = { 0, 0 };
 	struct fsal_obj_handle *dir_hdl = state->directory->obj_handle;
 
-	fsal_status = dir_hdl->ops->lookup(dir_hdl, name, &entry_hdl);
-	if (FSAL_IS_ERROR(fsal_status)) {
-		*state->status = cache_inode_error_convert(fsal_status);
-		if (*state->status == CACHE_INODE_FSAL_XDEV) {
-			LogInfo(COMPONENT_NFS_READDIR,
-				"Ignoring XDEV entry %s",
-				name);
-			*state->status = CACHE_INODE_SUCCESS;
-			return true;
+	if (entry_hdl == NULL) {
+		fsal_status = dir_hdl->ops->lookup(dir_hdl, name, &entry_hdl);
+		if (FSAL_IS_ERROR(fsal_status)) {
+			*state->status = cache_inode_error_convert(fsal_status);
+			if (*state->status == CACHE_INODE_FSAL_XDEV) {
+				LogInfo(COMPONENT_NFS_READDIR,
+					"Ignoring XDEV entry %s",
+					name);
+				*state->status = CACHE_INODE_SUCCESS;
+				return true;
+			}
+			LogInfo(COMPONENT_CACHE_INODE,
+				"Lookup failed on %s in dir %p with %s",
+				name, dir_hdl,
+				cache_inode_err_str(*state->status));
+			return !cache_param.retry_readdir;
 		}
-		LogInfo(COMPONENT_CACHE_INODE,
-			"Lookup failed on %s in dir %p with %s",
-			name, dir_hdl, cache_inode_err_str(*state->status));
-		return !cache_param.retry_readdir;
 	}
 
 	LogFullDebug(COMPONENT_NFS_READDIR, "Creating entry for %s", name);
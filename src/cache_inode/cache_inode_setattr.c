@@ -116,6 +116,8 @@ cache_inode_setattr(cache_entry_t *entry,
 		}
 		goto unlock;
 	}
+	if (attr->mask & (ATTR_SIZE | ATTR4_SPACE_RESERVED))
+		cache_inode_data_invalidate(entry);
 	fsal_status = obj_handle->ops->getattrs(obj_handle);
 	*attr = obj_handle->attributes;
 	if (FSAL_IS_ERROR(fsal_status)) {
@@ -1614,6 +1614,96 @@ out:
 	return rc;
 }
 
+/* FNV-1a, good enough to tell two blocks apart */
+#define NODE_HASH_INIT 0xcbf29ce484222325ULL
+#define NODE_HASH_PRIME 0x100000001b3ULL
+
+static uint64_t hash_str(uint64_t hash, const char *str, bool fold)
+{
+	const unsigned char *cp;
+
+	for (cp = (const unsigned char *)str; *cp != '\0'; cp++) {
+		hash ^= fold ? tolower(*cp) : *cp;
+		hash *= NODE_HASH_PRIME;
+	}
+	hash ^= 0xff;	/* terminate so "ab","c" != "a","bc" */
+	return hash * NODE_HASH_PRIME;
+}
+
+static uint64_t hash_node(uint64_t hash, struct config_node *node)
+{
+	struct glist_head *ns;
+
+	hash = hash_str(hash, node->name, true);
+	if (node->type == TYPE_STMT)
+		return hash_str(hash, node->u.varvalue, false);
+	glist_for_each(ns, &node->u.blk.sub_nodes)
+		hash = hash_node(hash, glist_entry(ns, struct config_node,
+						   node));
+	return hash_str(hash, "}", false);
+}
+
+/**
+ * @brief Fingerprint a block of the parse tree
+ *
+ * Parameter and block names are case insensitive, values are not.
+ * Where the block came from (file, line) does not matter, so moving
+ * a block around in the configuration does not change its hash.
+ *
+ * @param tree_node [IN] A CONFIG_BLOCK node in the parse tree
+ * @param sub_block [IN] Only hash this sub-block, NULL for all of it
+ *
+ * @return hash of the block, 0 if sub_block is not found.
+ */
+
+uint64_t config_node_hash(void *tree_node, const char *sub_block)
+{
+	struct config_node *node = (struct config_node *)tree_node;
+	struct config_node *sub_node;
+	struct glist_head *ns;
+
+	if (node->type != TYPE_BLOCK)
+		return 0;
+	if (sub_block == NULL)
+		return hash_node(NODE_HASH_INIT, node);
+	glist_for_each(ns, &node->u.blk.sub_nodes) {
+		sub_node = glist_entry(ns, struct config_node, node);
+		if (sub_node->type == TYPE_BLOCK &&
+		    strcasecmp(sub_node->name, sub_block) == 0)
+			return hash_node(NODE_HASH_INIT, sub_node);
+	}
+	return 0;
+}
+
+/**
+ * @brief Find the value of a parameter in a block
+ *
+ * This does no conversion or validation, it is meant to pick out
+ * identifying parameters without processing the whole block.
+ *
+ * @param tree_node [IN] A CONFIG_BLOCK node in the parse tree
+ * @param name      [IN] Parameter name
+ *
+ * @return the raw value string or NULL if not found.
+ */
+
+const char *config_node_value(void *tree_node, const char *name)
+{
+	struct config_node *node = (struct config_node *)tree_node;
+	struct config_node *sub_node;
+	struct glist_head *ns;
+
+	if (node->type != TYPE_BLOCK)
+		return NULL;
+	glist_for_each(ns, &node->u.blk.sub_nodes) {
+		sub_node = glist_entry(ns, struct config_node, node);
+		if (sub_node->type == TYPE_STMT &&
+		    strcasecmp(sub_node->name, name) == 0)
+			return sub_node->u.varvalue;
+	}
+	return NULL;
+}
+
 /**
  * @brief Fill configuration structure from a parse tree node
  *
@@ -50,6 +50,7 @@
 #include "log.h"
 #include "abstract_atomic.h"
 #include "common_utils.h"
+#include "slab_pool.h"
 #include <assert.h>
 
 /**
@@ -353,14 +354,14 @@ hashtable_init(struct hash_param *hparam)
 	}
 
 	ht->node_pool =
-	    pool_init(NULL, sizeof(rbt_node_t), pool_basic_substrate, NULL,
-		      NULL, NULL);
+	    pool_init(hparam->ht_name, sizeof(rbt_node_t),
+		      pool_slab_substrate, NULL, NULL, NULL);
 	if (!(ht->node_pool))
 		goto deconstruct;
 
 	ht->data_pool =
-	    pool_init(NULL, sizeof(struct hash_data), pool_basic_substrate,
-		      NULL, NULL, NULL);
+	    pool_init(hparam->ht_name, sizeof(struct hash_data),
+		      pool_slab_substrate, NULL, NULL, NULL);
 	if (!(ht->data_pool))
 		goto deconstruct;
 
@@ -35,6 +35,7 @@
 #include <sys/select.h>
 #include "fsal.h"
 #include "cache_inode.h"
+#include "abstract_atomic.h"
 
 #ifdef _USE_9P_RDMA
 #include <infiniband/arch.h>
@@ -53,7 +54,13 @@ typedef uint64_t u64;
 
 #define _9P_LOCK_CLIENT_LEN 64
 
-#define _9P_FID_PER_CONN        1024
+/* Fid tables are two levels deep: a directory sized for the
+ * connection's fid limit, pointing to leaves of consecutive fids that
+ * are only allocated once one of their fids is set.
+ */
+#define _9P_FID_LEAF_SHIFT 8
+#define _9P_FID_LEAF_SIZE  (1 << _9P_FID_LEAF_SHIFT)
+#define _9P_FID_LEAF_MASK  (_9P_FID_LEAF_SIZE - 1)
 
 /* _9P_MSG_SIZE: maximum message size for 9P/TCP */
 #define _9P_MSG_SIZE 70000
@@ -338,6 +345,14 @@ struct _9p_flush_bucket {
 
 #define FLUSH_BUCKETS 32
 
+struct _9p_fid_table {
+	struct _9p_fid ***leaves;	/* Directory of leaves */
+	uint32_t max_fids;	/* Fids must be below this */
+	uint32_t nb_fids;	/* Fids currently set */
+	uint32_t hwmark;	/* Highest nb_fids reached */
+	pthread_mutex_t lock;	/* Serializes setting fids */
+};
+
 struct _9p_conn {
 	union trans_data {
 		long int sockfd;
@@ -350,7 +365,7 @@ struct _9p_conn {
 	struct gsh_client *client;
 	struct timeval birth;	/* This is useful if same sockfd is
 				   reused on socket's close/open */
-	struct _9p_fid *fids[_9P_FID_PER_CONN];
+	struct _9p_fid_table fids;
 	struct _9p_flush_bucket flush_buckets[FLUSH_BUCKETS];
 	unsigned long sequence;
 	pthread_mutex_t sock_lock;
@@ -602,6 +617,11 @@ do {                                                   \
  */
 #define _9P_RDMA_BACKLOG 10
 
+/**
+ * @brief Default limit on fid values for one connection
+ */
+#define _9P_MAX_FIDS 65536
+
 
 /**
  * @brief 9p configuration
@@ -631,6 +651,9 @@ struct _9p_param {
 	    Defaults to _9P_RDMA_OUTPOOL_SIZE,
 	    settable by _9P_RDMA_OutPool_Size */
 	uint16_t _9p_rdma_outpool_size;
+	/** Fids a connection may use are below this.  Defaults to
+	    _9P_MAX_FIDS, settable by _9P_Max_Fids */
+	uint32_t _9p_max_fids;
 
 };
 
@@ -651,8 +674,34 @@ int _9p_tools_get_req_context_by_name(int uname_len, char *uname_str,
 int _9p_tools_errno(cache_inode_status_t cache_status);
 void _9p_openflags2FSAL(u32 *inflags, fsal_openflags_t *outflags);
 int _9p_tools_clunk(struct _9p_fid *pfid);
+int _9p_init_fids(struct _9p_conn *conn, uint32_t max_fids);
+int _9p_setfid(struct _9p_conn *conn, u32 fid, struct _9p_fid *pfid);
 void _9p_cleanup_fids(struct _9p_conn *conn);
 
+/**
+ * @brief Look up a fid in a connection's fid table
+ *
+ * This is the hot path of every request, it takes no lock: leaves
+ * are never freed before the connection goes away.
+ *
+ * @param[in] conn The connection
+ * @param[in] fid  The fid, below conn->fids.max_fids
+ *
+ * @return The fid or NULL if it is not set.
+ */
+static inline struct _9p_fid *_9p_getfid(struct _9p_conn *conn, u32 fid)
+{
+	struct _9p_fid **leaf;
+
+	leaf = atomic_fetch_voidptr(
+		(void **)&conn->fids.leaves[fid >> _9P_FID_LEAF_SHIFT]);
+
+	if (leaf == NULL)
+		return NULL;
+
+	return atomic_fetch_voidptr((void **)&leaf[fid & _9P_FID_LEAF_MASK]);
+}
+
 #ifdef _USE_9P_RDMA
 /* 9P/RDMA callbacks */
 void *_9p_rdma_handle_trans(void *arg);
@@ -16,11 +16,24 @@ fsal_status_t fsal_test_access(struct fsal_obj_handle *obj_hdl,
 			       fsal_accessflags_t *allowed,
 			       fsal_accessflags_t *denied);
 
+/* fsal_test_access_attrs
+ * the same check on bare attributes, for callers without an object
+ * handle such as pNFS data servers.
+ */
+
+fsal_status_t fsal_test_access_attrs(struct user_cred *creds,
+				     struct attrlist *attribs,
+				     fsal_accessflags_t access_type);
+
 int display_fsal_v4mask(struct display_buffer *dspbuf, fsal_aceperm_t v4mask,
 			bool is_dir);
 
+struct fsal_export;
+
 void fsal_set_credentials(const struct user_cred *creds);
 void fsal_save_ganesha_credentials();
 void fsal_restore_ganesha_credentials();
+void fsal_release_credentials(const struct fsal_export *exp);
+void fsal_operation_credentials(const struct fsal_export *exp, bool write);
 
 #endif
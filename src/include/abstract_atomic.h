@@ -34,6 +34,7 @@
 #define _ABSTRACT_ATOMIC_H
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #undef GCC_SYNC_FUNCTIONS
 #undef GCC_ATOMIC_FUNCTIONS
@@ -2386,4 +2387,86 @@ static inline void atomic_store_uint8_t(uint8_t *var, uint8_t val)
 	(void)__sync_lock_test_and_set(var, val);
 }
 #endif
+
+/**
+ * @brief Atomically compare and swap a void *
+ *
+ * This function stores a new value in the variable only if it still
+ * holds the expected one.
+ *
+ * @param[in,out] var      Pointer to the variable to modify
+ * @param[in]     expected The value the variable must hold
+ * @param[in]     val      The value to store
+ *
+ * @return true if the value was stored.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_voidptr(void **var, void *expected, void *val)
+{
+	return __atomic_compare_exchange_n(var, &expected, val, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_voidptr(void **var, void *expected, void *val)
+{
+	return __sync_bool_compare_and_swap(var, expected, val);
+}
+#endif
+
+/**
+ * @brief Atomically compare and swap an int64_t
+ *
+ * This function stores a new value in the variable only if it still
+ * holds the expected one.
+ *
+ * @param[in,out] var      Pointer to the variable to modify
+ * @param[in]     expected The value the variable must hold
+ * @param[in]     val      The value to store
+ *
+ * @return true if the value was stored.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_int64_t(int64_t *var, int64_t expected,
+				      int64_t val)
+{
+	return __atomic_compare_exchange_n(var, &expected, val, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_int64_t(int64_t *var, int64_t expected,
+				      int64_t val)
+{
+	return __sync_bool_compare_and_swap(var, expected, val);
+}
+#endif
+
+/**
+ * @brief Atomically compare and swap a uint64_t
+ *
+ * This function stores a new value in the variable only if it still
+ * holds the expected one.
+ *
+ * @param[in,out] var      Pointer to the variable to modify
+ * @param[in]     expected The value the variable must hold
+ * @param[in]     val      The value to store
+ *
+ * @return true if the value was stored.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_uint64_t(uint64_t *var, uint64_t expected,
+				       uint64_t val)
+{
+	return __atomic_compare_exchange_n(var, &expected, val, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_uint64_t(uint64_t *var, uint64_t expected,
+				       uint64_t val)
+{
+	return __sync_bool_compare_and_swap(var, expected, val);
+}
+#endif
 #endif				/* !_ABSTRACT_ATOMIC_H */
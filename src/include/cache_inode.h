@@ -67,8 +67,8 @@
  */
 
 struct cache_inode_parameter {
-	/** Partitions in the Cache_Inode tree.  Defaults to 7,
-	 * settable with NParts. */
+	/** Partitions in the Cache_Inode tree.  Defaults to 0, which
+	 * scales with CPUs and Entries_HWMark, settable with NParts. */
 	uint32_t nparts;
 	/** Expiration time interval in seconds for attributes.  Settable with
 	    Attr_Expiration_Time. */
@@ -121,8 +121,34 @@ struct cache_inode_parameter {
 	    client a partial reply based on what we have.
 	    Defaults to false, settable with Retry_Readdir */
 	bool retry_readdir;
+	/** Bytes of file data cached for all files.  Defaults to
+	    64MiB, settable with Data_Cache_Size. */
+	uint64_t data_cache_size;
+	/** Size in bytes of the blocks file data is cached in.
+	    Defaults to 256KiB, settable with Data_Cache_Block_Size. */
+	uint32_t data_cache_block;
+	/** Whether to detect sequential READs and read ahead of them.
+	    Defaults to false, settable with Readahead. */
+	bool readahead;
+	/** Most blocks read ahead of a stream.  Defaults to 16,
+	    settable with Readahead_Max_Blocks. */
+	uint32_t readahead_max;
+	/** Threads reading ahead.  Defaults to 8, settable with
+	    Readahead_Threads. */
+	uint32_t readahead_threads;
+	/** Whether to fold asynchronous invalidate and update upcalls
+	    for the same object.  Defaults to true, settable with
+	    Upcall_Coalesce. */
+	bool upcall_coalesce;
+	/** Objects with upcalls pending above which FSAL upcall
+	    threads are slowed down.  Defaults to 65536, settable with
+	    Upcall_Queue_Depth. */
+	uint32_t upcall_queue_depth;
 };
 
+/** Upper bound of Readahead_Max_Blocks */
+#define CACHE_INODE_RA_MAX 256
+
 /** @} */
 
 extern struct config_block cache_inode_param_blk;
@@ -371,6 +397,13 @@ struct file_deleg_heuristics {
 	uint32_t num_opens;               /* total num of opens so far. */
 	time_t first_open;                /* time that we started recording
 					     num_opens */
+	bool cbgetattr_pending;           /* CB_GETATTR sent to the write
+					     delegation holder */
+	time_t cbgetattr_time;            /* time of last CB_GETATTR reply */
+	attrmask_t cbgetattr_mask;        /* ATTR_SIZE and ATTR_CHANGE
+					     reported by the holder */
+	uint64_t cbgetattr_size;          /* size reported by the holder */
+	uint64_t cbgetattr_change;        /* change reported by the holder */
 };
 
 /**
@@ -492,6 +525,8 @@ struct cache_entry_t {
 			cache_inode_share_t share_state;
 			/** Delegation statistics */
 			struct file_deleg_heuristics deleg_heuristics;
+			/** Cached data and sequential stream state */
+			struct cache_inode_data *data_cache;
 		} file;		/*< REGULAR_FILE data */
 
 		struct {
@@ -849,6 +884,30 @@ cache_inode_status_t cache_inode_rdwr_plus(cache_entry_t *entry,
 cache_inode_status_t cache_inode_commit(cache_entry_t *entry, uint64_t offset,
 					size_t count);
 
+struct cache_inode_gather_batch;
+
+void cache_inode_gather_pkginit(void);
+fsal_status_t cache_inode_gather_write(cache_entry_t *entry,
+				       uint64_t offset, size_t io_size,
+				       size_t *bytes_moved, void *buffer,
+				       bool *sync,
+				       struct cache_inode_gather_batch **batch,
+				       bool *leader);
+void cache_inode_gather_done(struct cache_inode_gather_batch *batch,
+			     bool refreshed);
+bool cache_inode_gather_wait(struct cache_inode_gather_batch *batch);
+void cache_inode_gather_put(struct cache_inode_gather_batch *batch);
+
+int cache_inode_data_pkginit(void);
+int cache_inode_data_pkgshutdown(void);
+fsal_status_t cache_inode_data_read(cache_entry_t *entry, uint64_t offset,
+				    size_t io_size, void *buffer,
+				    size_t *bytes_moved, bool *eof);
+void cache_inode_ra_schedule(cache_entry_t *entry, uint64_t offset,
+			     size_t size, bool eof);
+void cache_inode_data_invalidate(cache_entry_t *entry);
+void cache_inode_data_release(cache_entry_t *entry);
+
 cache_inode_status_t cache_inode_readdir(cache_entry_t *directory,
 					 uint64_t cookie, unsigned int *nbfound,
 					 bool *eod_met,
@@ -967,6 +1026,7 @@ cache_inode_refresh_attrs(cache_entry_t *entry)
 {
 	fsal_status_t fsal_status = { ERR_FSAL_NO_ERROR, 0 };
 	cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
+	uint64_t change = entry->obj_handle->attributes.change;
 
 	if (entry->obj_handle->attributes.acl) {
 		fsal_acl_status_t acl_status = 0;
@@ -993,6 +1053,11 @@ cache_inode_refresh_attrs(cache_entry_t *entry)
 
 	cache_inode_fixup_md(entry);
 
+	/* Cached data may predate a change made elsewhere */
+	if (entry->type == REGULAR_FILE &&
+	    entry->obj_handle->attributes.change != change)
+		cache_inode_data_invalidate(entry);
+
  out:
 	return cache_status;
 }
@@ -57,13 +57,22 @@
  * @brief The table partition
  *
  * Each tree is independent, having its own lock, thus reducing thread
- * contention.
+ * contention.  The direct-mapped lookup cache in front of the tree is
+ * sized per partition and grows with the tree, see cih_cache_resize().
  */
 typedef struct cih_partition {
 	uint32_t part_ix;
 	pthread_rwlock_t lock;
 	struct avltree t;
 	struct avltree_node **cache;
+	uint32_t cache_sz;	/*< Slots in cache, a prime */
+	uint32_t nentries;	/*< Entries in t, protected by lock */
+	struct {
+		uint64_t cache_hit;	/*< Found in the lookup cache */
+		uint64_t avl_hit;	/*< Found in the tree */
+		uint64_t miss;		/*< Not found */
+		uint64_t resizes;	/*< Lookup cache resizes */
+	} stats;
 	struct {
 		char *func;
 		uint32_t line;
@@ -80,9 +89,30 @@ struct cih_lookup_table {
 	CACHE_PAD(0);
 	cih_partition_t *partition;
 	uint32_t npart;
-	uint32_t cache_sz;
 };
 
+/**
+ * @brief Summary of the table, for statistics
+ */
+struct cih_table_stats {
+	uint32_t npart;		/*< Partitions */
+	uint64_t entries;	/*< Entries in all trees */
+	uint32_t max_entries;	/*< Entries in the fullest tree */
+	uint32_t max_depth;	/*< Height of the tallest tree */
+	uint64_t cache_slots;	/*< Lookup cache slots in all partitions */
+	uint64_t cache_hit;
+	uint64_t avl_hit;
+	uint64_t miss;
+	uint64_t resizes;
+};
+
+/* Bounds of the per-partition lookup cache */
+#define CIH_CACHE_MIN 1021
+#define CIH_CACHE_MAX 1048573
+
+/* Upper bound of automatically sized partitions */
+#define CIH_NPART_MAX 1021
+
 /* Support inline lookups */
 extern struct cih_lookup_table cih_fhcache;
 
@@ -96,6 +126,9 @@ void cih_pkginit(void);
  */
 void cih_pkgdestroy(void);
 
+void cih_cache_resize(cih_partition_t *cp);
+void cih_get_stats(struct cih_table_stats *stats);
+
 /**
  * @brief Find the correct partition for a pointer
  *
@@ -112,17 +145,18 @@ void cih_pkgdestroy(void);
  * @brief Compute cache slot for an entry
  *
  * This function computes a hash slot, taking an address modulo the
- * number of cache slotes (which should be prime).
+ * number of cache slotes (which should be prime).  The partition must
+ * be locked, as its cache may be resized.
  *
- * @param wt [in] The table
+ * @param cp [in] The partition
  * @param ptr [in] Entry address
  *
  * @return The computed offset.
  */
 static inline uint32_t
-cih_cache_offsetof(struct cih_lookup_table *lt, uint64_t k)
+cih_cache_offsetof(cih_partition_t *cp, uint64_t k)
 {
-	return k % lt->cache_sz;
+	return k % cp->cache_sz;
 }
 
 /**
@@ -302,14 +336,15 @@ cih_get_by_key_latched(cache_inode_key_t *key, cih_latch_t *latch,
 
 	/* check cache */
 	cache_slot = (void **)
-	    &(cp->cache[cih_cache_offsetof(&cih_fhcache, key->hk)]);
+	    &(cp->cache[cih_cache_offsetof(cp, key->hk)]);
 	node = (struct avltree_node *)atomic_fetch_voidptr(cache_slot);
 	if (node) {
 		if (cih_fh_cmpf(&k_entry.fh_hk.node_k, node) == 0) {
 			/* got it in 1 */
+			(void)atomic_inc_uint64_t(&cp->stats.cache_hit);
 			LogDebug(COMPONENT_HASHTABLE_CACHE,
 				 "cih cache hit slot %d",
-				 cih_cache_offsetof(&cih_fhcache, key->hk));
+				 cih_cache_offsetof(cp, key->hk));
 			goto found;
 		}
 	}
@@ -317,6 +352,7 @@ cih_get_by_key_latched(cache_inode_key_t *key, cih_latch_t *latch,
 	/* check AVL */
 	node = cih_fhcache_inline_lookup(&cp->t, &k_entry.fh_hk.node_k);
 	if (!node) {
+		(void)atomic_inc_uint64_t(&cp->stats.miss);
 		if (flags & CIH_GET_UNLOCK_ON_MISS)
 			PTHREAD_RWLOCK_unlock(&cp->lock);
 		LogDebug(COMPONENT_HASHTABLE_CACHE, "fdcache MISS");
@@ -325,9 +361,10 @@ cih_get_by_key_latched(cache_inode_key_t *key, cih_latch_t *latch,
 
 	/* update cache */
 	atomic_store_voidptr(cache_slot, node);
+	(void)atomic_inc_uint64_t(&cp->stats.avl_hit);
 
 	LogDebug(COMPONENT_HASHTABLE_CACHE, "cih AVL hit slot %d",
-		 cih_cache_offsetof(&cih_fhcache, key->hk));
+		 cih_cache_offsetof(cp, key->hk));
 
  found:
 	entry = avltree_container_of(node, cache_entry_t, fh_hk.node_k);
@@ -399,6 +436,11 @@ cih_set_latched(cache_entry_t *entry, cih_latch_t *latch,
 	(void)avltree_insert(&entry->fh_hk.node_k, &cp->t);
 	entry->fh_hk.inavl = true;
 
+	/* Keep the lookup cache in proportion with the tree */
+	if (unlikely(++cp->nentries > 2 * cp->cache_sz &&
+		     cp->cache_sz < CIH_CACHE_MAX))
+		cih_cache_resize(cp);
+
 	if (likely(flags & CIH_SET_UNLOCK))
 		PTHREAD_RWLOCK_unlock(&cp->lock);
 
@@ -426,8 +468,8 @@ cih_remove_checked(cache_entry_t *entry)
 	node = cih_fhcache_inline_lookup(&cp->t, &entry->fh_hk.node_k);
 	if (node) {
 		avltree_remove(node, &cp->t);
-		cp->cache[cih_cache_offsetof(&cih_fhcache,
-					     entry->fh_hk.key.hk)] = NULL;
+		cp->cache[cih_cache_offsetof(cp, entry->fh_hk.key.hk)] = NULL;
+		cp->nentries--;
 		entry->fh_hk.inavl = false;
 		/* return sentinel ref */
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
@@ -457,8 +499,8 @@ cih_remove_latched(cache_entry_t *entry, cih_latch_t *latch, uint32_t flags)
 
 	if (entry->fh_hk.inavl) {
 		avltree_remove(&entry->fh_hk.node_k, &cp->t);
-		cp->cache[cih_cache_offsetof(&cih_fhcache,
-					     entry->fh_hk.key.hk)] = NULL;
+		cp->cache[cih_cache_offsetof(cp, entry->fh_hk.key.hk)] = NULL;
+		cp->nentries--;
 		entry->fh_hk.inavl = false;
 		if (flags & CIH_REMOVE_QLOCKED)
 			lflags |= LRU_UNREF_QLOCKED;
@@ -848,6 +848,12 @@ struct config_node_list {
 int find_config_nodes(config_file_t config, char *expr,
 		     struct config_node_list **node_list);
 
+/* fingerprint a block (or one of its sub-blocks) of the parse tree */
+uint64_t config_node_hash(void *tree_node, const char *sub_block);
+
+/* raw value of a parameter in a block, NULL if absent */
+const char *config_node_value(void *tree_node, const char *name);
+
 /* fill configuration structure from parse tree */
 int load_config_from_node(void *tree_node,
 			  struct config_block *conf_blk,
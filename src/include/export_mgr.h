@@ -42,6 +42,8 @@
 #ifndef EXPORT_MGR_H
 #define EXPORT_MGR_H
 
+struct export_path_node;
+
 typedef enum export_state {
 	EXPORT_INIT = 0,	/*< still being initialized */
 	EXPORT_READY,		/*< searchable, usable */
@@ -59,6 +61,14 @@ struct gsh_export {
 	struct glist_head exp_list;
 	/** gsh_exports are kept in an AVL tree by export_id */
 	struct avltree_node node_k;
+	/** Entry in the export manager's path index */
+	struct glist_head exp_path_entry;
+	/** Entry in the export manager's pseudo path index */
+	struct glist_head exp_pseudo_entry;
+	/** Path index node this export hangs off */
+	struct export_path_node *exp_path_node;
+	/** Pseudo path index node this export hangs off, if any */
+	struct export_path_node *exp_pseudo_node;
 	/** The list of cache inode entries belonging to this export */
 	struct glist_head entry_list;
 	/** List of NFS v4 state belonging to this export */
@@ -126,6 +136,23 @@ struct gsh_export {
 	/** Expiration time interval in seconds for attributes.  Settable with
 	    Attr_Expiration_Time. */
 	int32_t expire_time_attr;
+	/** Microseconds a write gathering leader waits for stragglers.
+	    Settable with Write_Gather_Delay. */
+	uint32_t write_gather_delay;
+	/** Share of request service this export gets against others
+	    when QoS is enabled.  Settable with QoS_Weight. */
+	uint32_t qos_weight;
+	/** Operations per second across all clients, zero for no
+	    limit.  Settable with QoS_Ops_Limit. */
+	uint64_t qos_ops_limit;
+	/** READ and WRITE bytes per second across all clients, zero
+	    for no limit.  Settable with QoS_Bytes_Limit. */
+	uint64_t qos_bytes_limit;
+	/** Fingerprint of the EXPORT block this export was built from,
+	    used by reload to skip unchanged exports */
+	uint64_t config_hash;
+	/** Fingerprint of the FSAL sub-block of that EXPORT block */
+	uint64_t fsal_config_hash;
 	/** Export_Id for this export */
 	uint16_t export_id;
 };
@@ -1181,6 +1181,10 @@ struct fsal_filesystem {
 	struct fsal_module *fsal;	/*< Link back to fsal module */
 	struct glist_head filesystems;	/*< List of file systems */
 	unclaim_filesystem_cb unclaim;  /*< Call back to unclaim this fs */
+	struct fsal_module *pending_fsal; /*< FSAL to claim it on first use */
+	struct fsal_export *pending_export; /*< Export that deferred it */
+	claim_filesystem_cb pending_claim; /*< Its claim call back */
+	unclaim_filesystem_cb pending_unclaim; /*< Its unclaim call back */
 	struct fsal_filesystem *parent;	/*< Parent file system */
 	struct glist_head children;	/*< Child file systems */
 	struct glist_head siblings;	/*< Entry in list of parent's child
@@ -1207,7 +1211,28 @@ struct fsal_filesystem {
 
 typedef uint64_t fsal_cookie_t;
 
-typedef bool(*fsal_readdir_cb) (const char *name, void *dir_state,
+/**
+ * @brief Callback to receive directory entries
+ *
+ * An FSAL that gets handles or attributes along with the names (from
+ * a readdirplus style call, or cheaply from the open directory)
+ * passes a handle for the entry in obj, with its attributes filled
+ * in as lookup would have.  The caller then need not look the entry
+ * up.  Otherwise obj is NULL.
+ *
+ * @param[in] name      Name of the entry
+ * @param[in] obj       Handle for the entry or NULL.  The callback
+ *                      takes ownership of it whatever it returns.
+ * @param[in] dir_state Opaque pointer passed to readdir
+ * @param[in] cookie    Cookie of the entry
+ *
+ * @retval true if more entries are required
+ * @retval false if no more entries are required
+ */
+
+typedef bool(*fsal_readdir_cb) (const char *name,
+				struct fsal_obj_handle *obj,
+				void *dir_state,
 				fsal_cookie_t cookie);
 /**
  * @brief FSAL objectoperations vector
@@ -1264,7 +1289,8 @@ struct fsal_obj_ops {
  * @brief Read a directory
  *
  * This function reads directory entries from the FSAL and supplies
- * them to a callback.
+ * them to a callback.  FSALs that can should supply a handle with
+ * each entry, see fsal_readdir_cb.
  *
  * @param[in]  dir_hdl   Directory to read
  * @param[in]  whence    Point at which to start reading.  NULL to
@@ -331,11 +331,16 @@ typedef struct fsal_ace__ {
 	} who;
 } fsal_ace_t;
 
+struct fsal_acl_compiled;
+
 typedef struct fsal_acl__ {
 	uint32_t naces;
 	fsal_ace_t *aces;
 	pthread_rwlock_t lock;
 	uint32_t ref;
+	struct fsal_acl_compiled *compiled;	/*< Evaluation form, built
+						   by the first access
+						   check */
 } fsal_acl_t;
 
 typedef struct fsal_acl_data__ {
@@ -694,6 +699,7 @@ struct fsal_staticfsinfo_t {
 	bool pnfs_file;		/*< fsal supports file pnfs */
 	bool reopen_method;	/* fsal supports reopen method */
 	bool fsal_trace;	/*< fsal trace supports */
+	bool write_as_user;	/*< become the caller for writes */
 };
 
 /**
@@ -281,6 +281,63 @@ int up_async_delegrecall(struct fridgethr *fr,
 
 /** @} */
 
+/**
+ * @brief Counters of the upcall queue
+ */
+
+struct up_queue_stats {
+	uint64_t depth;		/*< Objects with events pending */
+	uint64_t events;	/*< Events queued */
+	uint64_t merged;	/*< Of which folded into a pending one */
+	uint64_t delivered;	/*< Pending objects handed to the cache */
+	uint64_t batches;	/*< Batches they were handed over in */
+	uint64_t waits;		/*< Times an FSAL thread was held back */
+	uint64_t latency;	/*< Nanoseconds from queueing to delivery */
+	uint64_t max_latency;	/*< Longest of those */
+};
+
+int up_queue_pkginit(void);
+bool up_queue_enabled(void);
+int up_queue_event(struct fridgethr *fr,
+		   const struct fsal_up_vector *up_ops,
+		   struct fsal_module *fsal,
+		   struct gsh_buffdesc *obj, uint32_t inval_flags,
+		   const struct attrlist *attr, uint32_t update_flags);
+void up_queue_get_stats(struct up_queue_stats *stats);
+
+/* Recall latency buckets: under 1ms, 10ms, 100ms, 1s, and longer */
+#define LAYOUTRECALL_LATENCY_BUCKETS 5
+
+/**
+ * @brief Counters of layout recall and device notification fan-out
+ *
+ * Latency runs from the recall being issued to the client accepting
+ * it, answering that it holds no such layout, or the layout being
+ * revoked.
+ */
+
+struct layoutrecall_stats {
+	uint64_t recalls;	/*< Layouts recalled */
+	uint64_t notifies;	/*< Device notifications queued */
+	uint64_t compounds;	/*< CB_COMPOUNDs sent */
+	uint64_t ops;		/*< Operations in them, past CB_SEQUENCE */
+	uint64_t retries;	/*< Recalls sent again after DELAY */
+	uint64_t acked;		/*< Recalls the client accepted */
+	uint64_t nomatching;	/*< Answered NOMATCHING_LAYOUT */
+	uint64_t revoked;	/*< Layouts revoked */
+	uint64_t timeouts;	/*< Compounds unanswered or unsendable */
+	uint64_t waits;		/*< Times a send waited for the window */
+	uint64_t inflight;	/*< Compounds outstanding now */
+	uint64_t max_inflight;	/*< Most ever outstanding */
+	uint64_t latency;	/*< Nanoseconds to completion, summed */
+	uint64_t max_latency;	/*< Longest of those */
+	uint64_t latency_hist[LAYOUTRECALL_LATENCY_BUCKETS];
+};
+
+int layoutrecall_pkginit(void);
+int layoutrecall_pkgshutdown(void);
+void layoutrecall_get_stats(struct layoutrecall_stats *stats);
+
 cache_inode_status_t fsal_invalidate(struct fsal_module *fsal,
 				     struct gsh_buffdesc *handle,
 				     uint32_t flags);
@@ -155,6 +155,8 @@ typedef struct gsh_xprt_private {
 	uint32_t req_cnt; /*< outstanding requests counter */
 	struct drc *drc; /*< TCP DRC */
 	struct glist_head stallq;
+	struct timespec stall_start; /*< when the xprt was stalled */
+	uint32_t evchan; /*< index of the event channel polling it */
 } gsh_xprt_private_t;
 
 static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
@@ -166,11 +168,13 @@ static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
 	xu->flags = XPRT_PRIVATE_FLAG_NONE;
 	xu->req_cnt = 0;
 	xu->drc = NULL;
+	xu->evchan = 0;
 
 	return xu;
 }
 
 void nfs_dupreq_put_drc(SVCXPRT *, struct drc *, uint32_t);
+bool nfs_rpc_unstall_xprt(SVCXPRT *);
 
 #ifndef DRC_FLAG_RELEASE
 #define DRC_FLAG_RELEASE 0x0040
@@ -218,13 +222,17 @@ static inline void gsh_xprt_unref(SVCXPRT *xprt, uint32_t flags,
 {
 	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
 	uint32_t req_cnt;
+	bool unstalled = false;
 
 	if (!(flags & XPRT_PRIVATE_FLAG_LOCKED))
 		pthread_mutex_lock(&xprt->xp_lock);
 
-	if (flags & XPRT_PRIVATE_FLAG_DECREQ)
+	if (flags & XPRT_PRIVATE_FLAG_DECREQ) {
 		req_cnt = --(xu->req_cnt);
-	else
+		/* rearm a stalled xprt as soon as it drains */
+		if (xu->flags & XPRT_PRIVATE_FLAG_STALLED)
+			unstalled = nfs_rpc_unstall_xprt(xprt);
+	} else
 		req_cnt = xu->req_cnt;
 
 	if (flags & XPRT_PRIVATE_FLAG_DECODING)
@@ -245,6 +253,10 @@ static inline void gsh_xprt_unref(SVCXPRT *xprt, uint32_t flags,
 		"xprt %p postrelease req_cnt=%u xp_refcnt=%u tag=%s line=%d",
 		xprt, req_cnt, xprt->xp_refcnt, tag, line);
 
+	/* drop stallq ref */
+	if (unstalled)
+		SVC_RELEASE2(xprt, SVC_RELEASE_FLAG_NONE, tag, line);
+
 	return;
 }
 
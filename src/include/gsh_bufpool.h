@@ -0,0 +1,87 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup bufpool Bulk data buffer pool
+ *
+ * Size-classed pool of page aligned buffers for protocol payloads
+ * (9P/TCP messages, NFS READ replies).  Buffers are carved out of
+ * pre-faulted, optionally huge page backed arenas and recycled through
+ * a small per-thread cache, so the hot path neither calls malloc nor
+ * takes page faults.
+ *
+ * @{
+ */
+
+/**
+ * @file gsh_bufpool.h
+ * @brief Bulk data buffer pool
+ */
+
+#ifndef GSH_BUFPOOL_H
+#define GSH_BUFPOOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Smallest size class is 4KiB */
+#define GSH_BUF_MIN_SHIFT 12
+/** Largest size class is 1MiB, anything bigger goes to malloc */
+#define GSH_BUF_MAX_SHIFT 20
+#define GSH_BUF_CLASSES (GSH_BUF_MAX_SHIFT - GSH_BUF_MIN_SHIFT + 1)
+/** Every buffer returned by gsh_buf_alloc is aligned to this */
+#define GSH_BUF_ALIGN 4096
+
+/**
+ * @brief Occupancy of one size class
+ */
+
+struct gsh_bufpool_class_stats {
+	uint64_t size;		/*< Buffer size of this class */
+	uint64_t arenas;	/*< Arenas carved for this class */
+	uint64_t buffers;	/*< Buffers carved for this class */
+	uint64_t free;		/*< Buffers on the shared free list */
+	uint64_t in_use;	/*< Buffers handed out and not yet freed */
+	uint64_t allocs;	/*< Allocations served by this class */
+	uint64_t cached;	/*< Of which served by a thread cache */
+};
+
+/**
+ * @brief Snapshot of the whole pool
+ */
+
+struct gsh_bufpool_stats {
+	uint64_t limit;		/*< Configured pool size in bytes */
+	uint64_t mapped;	/*< Bytes of arena currently mapped */
+	uint64_t huge;		/*< Arenas backed by hugetlbfs pages */
+	uint64_t oversize;	/*< Requests above the largest class */
+	uint64_t fallback;	/*< Requests that found the pool full */
+	struct gsh_bufpool_class_stats classes[GSH_BUF_CLASSES];
+};
+
+int gsh_bufpool_pkginit(void);
+void *gsh_buf_alloc(size_t size);
+void gsh_buf_free(void *buf);
+void gsh_bufpool_stats(struct gsh_bufpool_stats *stats);
+
+#endif				/* GSH_BUFPOOL_H */
+
+/** @} */
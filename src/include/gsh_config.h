@@ -306,6 +306,13 @@ typedef struct nfs_core_param {
 		/** TIRPC ioq max simultaneous io threads.  Defaults to
 		    200 and settable by RPC_Ioq_ThrdMax. */
 		uint32_t ioq_thrd_max;
+		/** Event channels polling TCP connections, 0 sizes
+		    them to the number of CPUs.  Settable by
+		    RPC_Event_Channels. */
+		uint32_t event_channels;
+		/** Whether busy connections move off overloaded
+		    event channels.  Settable by RPC_Event_Rebalance. */
+		bool event_rebalance;
 	} rpc;
 	/** How long (in seconds) to let unused decoder threads wait before
 	    exiting.  Settable with Decoder_Fridge_Expiration_Delay. */
@@ -334,6 +341,34 @@ typedef struct nfs_core_param {
 	bool enable_RQUOTA;
 	/** Whether to use fast stats.  Defaults to false. */
 	bool enable_FASTSTATS;
+	/** Bytes of memory the bulk data buffer pool may map, zero
+	    disables the pool.  Settable with Buffer_Pool_Size. */
+	uint64_t buffer_pool_size;
+	/** Whether to back the buffer pool with huge pages.  Settable
+	    with Buffer_Pool_Huge_Pages. */
+	bool buffer_pool_hugepages;
+	/** Whether to put slab pool objects (cache entries, states,
+	    hash table nodes) on hugetlbfs pages.  Transparent huge
+	    pages are requested either way.  Settable with
+	    Slab_Huge_Pages. */
+	bool slab_hugepages;
+	/** Threads used to create exports and look up their roots at
+	    startup, 1 does it serially.  Settable with
+	    Export_Init_Threads. */
+	uint32_t export_init_threads;
+	/** Whether NFS requests are scheduled fairly across clients
+	    and exports instead of first come, first served.
+	    Settable with Enable_QoS. */
+	bool enable_qos;
+	/** Cost units credited to a QoS flow per round, per unit of
+	    export weight.  Settable with QoS_Quantum. */
+	uint32_t qos_quantum;
+	/** Operations per second any one client may run, zero for no
+	    limit.  Settable with QoS_Client_Ops_Limit. */
+	uint64_t qos_client_ops_limit;
+	/** READ and WRITE bytes per second any one client may move,
+	    zero for no limit.  Settable with QoS_Client_Bytes_Limit. */
+	uint64_t qos_client_bytes_limit;
 	/** How long the server will trust information it got by
 	    calling getgroups() when "Manage_Gids = TRUE" is
 	    used in a export entry. */
@@ -366,6 +401,14 @@ typedef struct nfs_core_param {
  */
 #define DOMAINNAME_DEFAULT "localdomain"
 
+/**
+ * @brief Stable storage used for NFSv4 client recovery records
+ */
+typedef enum recovery_backend {
+	RECOVERY_BACKEND_FS,	/*< One directory hierarchy per client */
+	RECOVERY_BACKEND_LOG	/*< Append only log with compaction */
+} recovery_backend_t;
+
 typedef struct nfs_version4_parameter {
 	/** Whether to disable the NFSv4 grace period.  Defaults to
 	    false and settable with Graceless. */
@@ -398,6 +441,21 @@ typedef struct nfs_version4_parameter {
 	/** Whether to allow delegations. Defaults to false and settable
 	    with Delegations */
 	bool allow_delegations;
+	/** Where client recovery records are kept.  Defaults to
+	    RECOVERY_BACKEND_FS and settable with RecoveryBackend. */
+	uint32_t recovery_backend;
+	/** Maximum number of threads running segments of compounds
+	    on exports with Parallel_Compound set, 0 disables.
+	    Defaults to 16 and settable with Compound_Threads. */
+	uint32_t compound_threads;
+	/** Most CB_COMPOUNDs carrying layout recalls or device
+	    notifications outstanding at once.  Defaults to 64 and
+	    settable with Layout_Recall_Window. */
+	uint32_t layout_recall_window;
+	/** Most recalls and notifications sent to one client in one
+	    CB_COMPOUND.  Defaults to 8 and settable with
+	    Layout_Recall_Batch. */
+	uint32_t layout_recall_batch;
 } nfs_version4_parameter_t;
 
 /** @} */
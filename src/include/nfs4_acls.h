@@ -38,6 +38,72 @@ typedef int fsal_acl_status_t;
 #define NFS_V4_ACL_INIT_ENTRY_FAILED  6
 #define NFS_V4_ACL_NOT_FOUND  7
 
+/**
+ * @brief Who an evaluation ACE applies to
+ */
+enum fsal_acl_who {
+	FSAL_ACL_WHO_OWNER,	/*< OWNER@ */
+	FSAL_ACL_WHO_GROUP,	/*< GROUP@ */
+	FSAL_ACL_WHO_EVERYONE,	/*< EVERYONE@ */
+	FSAL_ACL_WHO_UID,	/*< A given user */
+	FSAL_ACL_WHO_GID	/*< A given group, by index into gids */
+};
+
+/**
+ * @brief An ALLOW or DENY ACE reduced to what evaluation needs
+ */
+struct fsal_acl_cace {
+	fsal_aceperm_t perm;
+	uint8_t who;		/*< enum fsal_acl_who */
+	bool allow;
+	uint32_t id;		/*< uid, or index into gids */
+};
+
+/**
+ * @brief Remembered decision for one caller
+ */
+struct fsal_acl_decision {
+	uid_t uid;
+	gid_t gid;
+	int glen;
+	uint64_t ghash;		/*< Hash of the caller's group list */
+	uint32_t flags;		/*< FSAL_ACL_DECISION_* */
+	fsal_aceperm_t allowed;	/*< Permissions first decided by an ALLOW */
+};
+
+#define FSAL_ACL_DECISION_VALID 0x01
+#define FSAL_ACL_DECISION_DIR   0x02
+#define FSAL_ACL_DECISION_OWNER 0x04
+#define FSAL_ACL_DECISION_GROUP 0x08
+
+/* Larger ACLs are evaluated by walking the ACEs */
+#define FSAL_ACL_COMPILED_MAX_GIDS 256
+#define FSAL_ACL_DECISIONS 8
+
+/**
+ * @brief Compiled form of an ACL
+ *
+ * The ACEs that can apply to files and to directories are kept in two
+ * separate lists, without AUDIT, ALARM or INHERIT_ONLY entries, each
+ * tagged with the bucket (owner, group, everyone, user, group id) of
+ * its who.  Group ids are indexed into a sorted table so the caller's
+ * groups are matched once per evaluation instead of once per ACE.
+ *
+ * Since ACL entries are shared and never modified, a small table of
+ * decisions for recent callers lives here too; changing an object's
+ * ACL points it to another entry.
+ */
+struct fsal_acl_compiled {
+	struct fsal_acl_cace *aces[2];	/*< File, directory ACEs */
+	uint32_t naces[2];
+	fsal_aceperm_t perms[2];	/*< Union of the perms in each list */
+	gid_t *gids;			/*< Sorted group ids referenced */
+	uint32_t ngids;
+	pthread_rwlock_t lock;		/*< Protects the decisions */
+	uint32_t next;			/*< Next decision to replace */
+	struct fsal_acl_decision decisions[FSAL_ACL_DECISIONS];
+};
+
 fsal_ace_t *nfs4_ace_alloc(int nace);
 
 void nfs4_ace_free(fsal_ace_t *pace);
@@ -49,6 +115,8 @@ fsal_acl_t *nfs4_acl_new_entry(fsal_acl_data_t *pacldata,
 
 void nfs4_acl_release_entry(fsal_acl_t *pacl, fsal_acl_status_t *pstatus);
 
+struct fsal_acl_compiled *nfs4_acl_compiled(fsal_acl_t *pacl);
+
 int nfs4_acls_init();
 
 #endif				/* _NFS4_ACLS_H */
@@ -151,6 +151,7 @@ typedef struct request_data {
 	struct timespec time_queued;	/*< The time at which a request was
 					 *  added to the worker thread queue.
 					 */
+	uint64_t qos_bytes;	/*< READ and WRITE payload, set by QoS */
 } request_data_t;
 
 /**
@@ -266,6 +267,22 @@ int nfs_Init_worker_data(nfs_worker_data_t *pdata);
 int nfs_Init_request_data(nfs_request_data_t *pdata);
 void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr);
 void nfs_rpc_dispatch_stop(void);
+
+/**
+ * @brief Activity of one RPC event channel
+ */
+struct nfs_rpc_evchan_stats {
+	uint32_t id;		/*< Index of the channel */
+	const char *kind;	/*< "udp", "rendezvous" or "tcp" */
+	uint64_t xprts;		/*< Transports registered on it */
+	uint64_t events;	/*< Events handled */
+	uint64_t busy;		/*< Nanoseconds spent handling them */
+	uint64_t elapsed;	/*< Nanoseconds since the channel started */
+};
+
+void nfs_rpc_evchan_foreach(void (*cb)(const struct nfs_rpc_evchan_stats *,
+				       void *),
+			    void *arg);
 void Clean_RPC(void);
 
 /* Config parsing routines */
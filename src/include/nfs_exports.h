@@ -114,6 +114,9 @@ typedef struct exportlist_client_entry__ {
 #define EXPORT_OPTION_FSID_SET 0x00000001 /* Set if Filesystem_id is set */
 #define EXPORT_OPTION_USE_COOKIE_VERIFIER 0x00000002 /* Use cookie verifier */
 #define EXPORT_OPTION_EXPIRE_SET 0x00000004	/*< Inode expire was set */
+#define EXPORT_OPTION_PARALLEL_COMPOUND 0x00000008 /*< Parallel compounds */
+#define EXPORT_OPTION_WRITE_GATHER 0x00000010 /*< Gather concurrent writes */
+#define EXPORT_OPTION_DATA_CACHE 0x00000020 /*< Cache file data */
 
 /* Constants for export permissions masks */
 #define EXPORT_OPTION_ROOT 0x00000001	/*< Allow root access as root uid */
@@ -315,6 +318,7 @@ void LogClientListEntry(log_components_t component,
 			exportlist_client_entry_t *entry);
 
 bool init_export_root(struct gsh_export *exp);
+void release_export_root(struct gsh_export *exp);
 
 cache_inode_status_t nfs_export_get_root_entry(struct gsh_export *exp,
 					       cache_entry_t **entry);
@@ -323,6 +327,8 @@ void kill_export_root_entry(cache_entry_t *entry);
 void kill_export_junction_entry(cache_entry_t *entry);
 
 int ReadExports(config_file_t in_config);
+int ReloadExports(config_file_t in_config,
+		  struct config_error_type *err_type);
 void free_export_resources(struct gsh_export *export);
 void exports_pkginit(void);
 
@@ -351,6 +351,8 @@ int nfs3_mknod(nfs_arg_t *,
 
 int nfs4_Compound(nfs_arg_t *,
 		  nfs_worker_data_t *, struct svc_req *, nfs_res_t *);
+int nfs4_compound_pkginit(void);
+int nfs4_compound_pkgshutdown(void);
 
 typedef int (*nfs4_op_function_t) (struct nfs_argop4 *, compound_data_t *,
 				   struct nfs_resop4 *);
@@ -265,6 +265,10 @@ void handle_recalls(struct fsal_layoutreturn_arg *arg, state_t *state,
 nfsstat4 cache_entry_To_Fattr(cache_entry_t *, fattr4 *,
 			      compound_data_t *, nfs_fh4 *,
 			      struct bitmap4 *);
+nfsstat4 cache_entry_To_Fattr_merge(cache_entry_t *, fattr4 *,
+				    compound_data_t *, nfs_fh4 *,
+				    struct bitmap4 *,
+				    const struct attrlist *);
 
 bool nfs4_Fattr_Check_Access(fattr4 *, int);
 bool nfs4_Fattr_Check_Access_Bitmap(struct bitmap4 *, int);
@@ -281,6 +285,8 @@ bool nfs3_Sattr_To_FSALattr(struct attrlist *, sattr3 *);
 
 int nfs4_Fattr_To_FSAL_attr(struct attrlist *, fattr4 *, compound_data_t *);
 
+int nfs4_Fattr_To_FSAL_attr_fh(struct attrlist *, fattr4 *, nfs_fh4 *);
+
 int nfs4_Fattr_To_fsinfo(fsal_dynamicfsinfo_t *, fattr4 *);
 
 int nfs4_Fattr_Fill_Error(fattr4 *, nfsstat4);
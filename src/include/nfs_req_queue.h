@@ -87,7 +87,6 @@ struct nfs_req_st {
 		pthread_mutex_t mtx;
 		struct glist_head q;
 		uint32_t stalled;
-		bool active;
 	} stallq;
 };
 
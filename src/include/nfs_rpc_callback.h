@@ -143,6 +143,11 @@ int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 					     void *arg, uint32_t flags),
 		       void *completion_arg,
 		       void (*free_op)(nfs_cb_argop4 *op));
+int nfs_rpc_v41_multi(nfs_client_id_t *clientid, nfs_cb_argop4 *ops,
+		      uint32_t *n_ops, struct state_refer **refers,
+		      int32_t(*completion) (rpc_call_t *, rpc_call_hook,
+					    void *arg, uint32_t flags),
+		      void *completion_arg);
 void nfs41_complete_single(rpc_call_t *call, rpc_call_hook hook, void *arg,
 			   uint32_t flags);
 enum clnt_stat nfs_test_cb_chan(nfs_client_id_t *);
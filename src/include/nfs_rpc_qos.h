@@ -0,0 +1,62 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs_rpc_qos.h
+ * @brief Fair scheduling of NFS requests across clients and exports
+ *
+ * When Enable_QoS is set, NFS requests bypass the low and high
+ * latency queues and are queued per (client, export) flow instead.
+ * Workers pick flows by deficit round robin, weighted by the export's
+ * QoS_Weight, and skip flows whose client or export has used up its
+ * operation or byte rate for the moment.
+ */
+
+#ifndef NFS_RPC_QOS_H
+#define NFS_RPC_QOS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nfs_core.h"
+
+/**
+ * @brief Counters for one QoS tenant, a client or an export
+ */
+
+struct nfs_rpc_qos_stats {
+	uint64_t depth;		/*< Requests queued now */
+	uint64_t enqueued;	/*< Requests queued in total */
+	uint64_t dequeued;	/*< Requests handed to workers */
+	uint64_t throttled;	/*< Times a request was held back by a limit */
+	uint64_t wait_total;	/*< Nanoseconds queued, summed */
+	uint64_t wait_max;	/*< Longest time a request was queued */
+};
+
+void nfs_rpc_qos_init(void);
+bool nfs_rpc_qos_enqueue(request_data_t *req);
+request_data_t *nfs_rpc_qos_dequeue(void);
+nsecs_elapsed_t nfs_rpc_qos_delay(void);
+void nfs_rpc_qos_foreach(void (*cb)(const char *kind, const char *name,
+				    const struct nfs_rpc_qos_stats *stats,
+				    void *arg),
+			 void *arg);
+
+#endif				/* NFS_RPC_QOS_H */
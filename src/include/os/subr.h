@@ -54,5 +54,7 @@ bool to_vfs_dirent(char *buf, int bpos, struct vfs_dirent *vd, off_t base);
 uid_t setuser(uid_t uid);
 gid_t setgroup(gid_t gid);
 int set_threadgroups(size_t size, const gid_t *list);
+bool setuser_fast(uid_t uid, uid_t installed);
+bool setgroup_fast(gid_t gid, gid_t installed);
 
 #endif/* SUBR_OS_H */
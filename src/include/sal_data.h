@@ -198,21 +198,33 @@ struct state_refer {
  * grace period is started for every failover.  for now keep it
  * simple, just a global used by all clients.
  */
-typedef struct grace {
-	pthread_mutex_t g_mutex;	/*< Mutex */
-	time_t g_start;		/*< Start of grace period */
-	time_t g_duration;	/*< Duration of grace period */
-	struct glist_head g_clid_list;	/*< Clients */
-} grace_t;
-
 /**
  * @brief A client entry
  */
 typedef struct clid_entry {
 	struct glist_head cl_list;	/*< Link in the list */
-	char cl_name[PATH_MAX];	/*< Client name */
+	struct glist_head cl_hash;	/*< Link in the hash chain */
+	uint64_t cl_hashval;	/*< Hash of the client name */
+	char cl_name[];		/*< Client name */
 } clid_entry_t;
 
+/**
+ * @brief A set of client names with constant time lookup
+ */
+struct clid_table {
+	struct glist_head ct_list;	/*< All entries */
+	struct glist_head *ct_hash;	/*< Hash chains */
+	uint32_t ct_hash_size;	/*< Number of hash chains */
+	uint32_t ct_count;	/*< Number of entries */
+};
+
+typedef struct grace {
+	pthread_mutex_t g_mutex;	/*< Mutex */
+	time_t g_start;		/*< Start of grace period */
+	time_t g_duration;	/*< Duration of grace period */
+	struct clid_table g_clids;	/*< Clients allowed to reclaim */
+} grace_t;
+
 extern char v4_old_dir[PATH_MAX+1];
 extern char v4_recov_dir[PATH_MAX + 1];
 
@@ -296,6 +308,7 @@ typedef struct state_deleg__ {
 	state_t *sd_open_state;          /*  */
 	struct glist_head sd_deleg_list; /*  */
 	time_t grant_time;               /* time of successful delegation */
+	bool sd_recall_pending;          /* CB_RECALL sent, awaiting return */
 	struct clientfile_deleg_heuristics clfile_stats;  /* client specific */
 } state_deleg_t;
 
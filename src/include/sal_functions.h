@@ -243,6 +243,9 @@ void
 nfs41_foreach_client_callback(bool(*cb) (nfs_client_id_t *cl, void *state),
 			      void *state);
 
+void nfs41_foreach_client(bool(*cb) (nfs_client_id_t *cl, void *state),
+			  void *state);
+
 bool client_id_has_nfs41_sessions(nfs_client_id_t *clientid);
 
 bool client_id_has_state(nfs_client_id_t *clientid);
@@ -581,6 +584,8 @@ void get_deleg_perm(cache_entry_t *entry, nfsace4 *permissions,
 		    open_delegation_type4 type);
 bool update_delegation_stats(cache_entry_t *entry, state_t *state);
 state_status_t delegrecall(cache_entry_t *entry, bool rwlocked);
+state_status_t delegcbgetattr(cache_entry_t *entry);
+bool state_deleg_conflict(cache_entry_t *entry, bool write);
 
 #ifdef DEBUG_SAL
 void dump_all_states(void);
@@ -675,6 +680,43 @@ void process_blocked_lock_upcall(state_block_data_t *block_data);
  *
  ******************************************************************************/
 
+/**
+ * @brief Callback used by recovery backends to report a client that
+ *        may reclaim state.
+ */
+typedef clid_entry_t *(*add_clid_entry_hook)(const char *);
+
+/**
+ * @brief Stable storage backend for NFSv4 client recovery records
+ */
+struct nfs4_recovery_backend {
+	/** Prepare stable storage */
+	void (*recovery_init)(void);
+	/** Release resources held by the backend */
+	void (*recovery_shutdown)(void);
+	/** Read in the clients that may reclaim, on grace or takeover */
+	void (*recovery_read_clids)(nfs_grace_start_t *gsp,
+				    add_clid_entry_hook add_clid_entry);
+	/** Record a client */
+	void (*add_clid)(nfs_client_id_t *);
+	/** Remove a client record */
+	void (*rm_clid)(const char *);
+	/** Discard the records of the previous server instance */
+	void (*clean_old)(void);
+};
+
+void fs_backend_init(struct nfs4_recovery_backend **);
+void log_backend_init(struct nfs4_recovery_backend **);
+
+void clid_table_init(struct clid_table *);
+clid_entry_t *clid_table_lookup(struct clid_table *, const char *);
+clid_entry_t *clid_table_add(struct clid_table *, const char *);
+void clid_table_del(struct clid_table *, clid_entry_t *);
+void clid_table_clear(struct clid_table *);
+
+bool nfs4_recov_takeover_dir(nfs_grace_start_t *gsp, char *path,
+			     size_t size);
+
 void nfs4_init_grace(void);
 void nfs4_start_grace(nfs_grace_start_t *gsp);
 int nfs_in_grace(void);
@@ -682,11 +724,12 @@ int fsal_grace(void);
 void nfs4_create_clid_name(nfs_client_record_t *, nfs_client_id_t *,
 			   struct svc_req *);
 void nfs4_add_clid(nfs_client_id_t *);
-void nfs4_rm_clid(const char *, char *, int);
+void nfs4_rm_clid(const char *);
 void nfs4_chk_clid(nfs_client_id_t *);
 void nfs4_load_recov_clids(nfs_grace_start_t *gsp);
-void nfs4_clean_old_recov_dir(char *);
-void nfs4_create_recov_dir(void);
+void nfs4_clean_old_recov_dir(void);
+void nfs4_recovery_init(void);
+void nfs4_recovery_shutdown(void);
 
 #endif				/* SAL_FUNCTIONS_H */
 
@@ -46,12 +46,25 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup);
 void server_stats_io_done(size_t requested,
 			  size_t transferred, bool success, bool is_write);
 void server_stats_compound_done(int num_ops, int status);
+void server_stats_compound_parallel(uint32_t segments, uint32_t ops,
+				    uint32_t dispatched);
+void server_stats_creds_switch(bool restore, uint32_t syscalls);
+void server_stats_write_gather(uint32_t requests, uint32_t writes,
+				uint32_t commits);
+void server_stats_data_cache_read(bool hit);
+void server_stats_data_cache_fill(size_t bytes, bool readahead);
+void server_stats_data_cache_drop(bool evicted, bool unused);
 void server_stats_nfsv4_op_done(int proto_op,
 				nsecs_elapsed_t start_time, int status);
 void server_stats_transport_done(struct gsh_client *client,
 				uint64_t rx_bytes, uint64_t rx_pkt,
 				uint64_t rx_err, uint64_t tx_bytes,
 				uint64_t tx_pkt, uint64_t tx_err);
+void server_stats_9p_fids(struct gsh_client *client, int32_t delta);
+void server_stats_xprt_stall(struct gsh_client *client,
+			     nsecs_elapsed_t stalled);
+void server_stats_ds_io(bool is_write, uint32_t stripes, size_t bytes,
+			nsecs_elapsed_t latency);
 
 
 #endif				/* !SERVER_STATS_H */
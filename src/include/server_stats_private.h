@@ -58,6 +58,42 @@ struct nfsv41_stats;
 struct nfsv42_stats;
 struct _9p_stats;
 
+/** Transport stall histogram buckets, stalls under 1ms, 10ms,
+    100ms, 1s, 10s and longer */
+#define XPRT_STALL_BUCKETS 6
+
+/**
+ * @brief Transports stalled for having too many requests in flight
+ */
+
+struct xprt_stall_stats {
+	uint64_t stalls;	/*< Stalls ended */
+	uint64_t stall_time;	/*< Nanoseconds stalled, summed */
+	uint64_t hist[XPRT_STALL_BUCKETS];	/*< Stalls by duration */
+};
+
+/** pNFS DS request fan-out buckets, requests split into 1, 2, 3-4,
+    5-8 and more stripe units */
+#define DS_IO_FANOUT_BUCKETS 5
+
+/**
+ * @brief pNFS DS reads or writes that the FSAL split into stripe units
+ */
+
+struct ds_io_op {
+	uint64_t ops;		/*< Requests served */
+	uint64_t bytes;		/*< Bytes moved */
+	uint64_t stripes;	/*< Stripe unit I/Os issued */
+	uint64_t latency;	/*< Nanoseconds spent, summed */
+	uint64_t max_latency;	/*< Slowest request */
+	uint64_t fanout[DS_IO_FANOUT_BUCKETS];	/*< Requests by stripe units */
+};
+
+struct ds_io_stats {
+	struct ds_io_op read;
+	struct ds_io_op write;
+};
+
 struct gsh_stats {
 	struct nfsv3_stats *nfsv3;
 	struct mnt_stats *mnt;
@@ -67,6 +103,8 @@ struct gsh_stats {
 	struct nfsv41_stats *nfsv41;
 	struct nfsv41_stats *nfsv42;
 	struct _9p_stats *_9p;
+	struct xprt_stall_stats *stall;
+	struct ds_io_stats *ds_io;
 };
 
 /**
@@ -131,6 +169,13 @@ struct export_stats {
 	.direction = "out" \
 }
 
+#define FIDS_REPLY         \
+{                          \
+	.name = "fids",    \
+	.type = "(tt)",    \
+	.direction = "out" \
+}
+
 #define TRANSPORT_REPLY    \
 {                          \
 	.name = "rx_bytes",\
@@ -170,6 +215,58 @@ struct export_stats {
 	.direction = "out"   \
 }
 
+#define BUFPOOL_REPLY			\
+{					\
+	.name = "pool",			\
+	.type = "a(st)",		\
+	.direction = "out"		\
+},					\
+{					\
+	.name = "classes",		\
+	.type = "a(ttttttt)",		\
+	.direction = "out"		\
+}
+
+#define SLAB_POOLS_REPLY		\
+{					\
+	.name = "pools",		\
+	.type = "a(stttttt)",		\
+	.direction = "out"		\
+}
+
+#define XPRT_STALLS_REPLY		\
+{					\
+	.name = "stalls",		\
+	.type = "(ttat)",		\
+	.direction = "out"		\
+}
+
+#define DS_IO_REPLY			\
+{					\
+	.name = "read",			\
+	.type = "(tttttat)",		\
+	.direction = "out"		\
+},					\
+{					\
+	.name = "write",		\
+	.type = "(tttttat)",		\
+	.direction = "out"		\
+}
+
+#define EVCHANS_REPLY			\
+{					\
+	.name = "channels",		\
+	.type = "a(ustttd)",		\
+	.direction = "out"		\
+}
+
+#define QOS_REPLY			\
+{					\
+	.name = "tenants",		\
+	.type = "a(sstttttt)",		\
+	.direction = "out"		\
+}
+
 #define LAYOUTS_REPLY		\
 {				\
 	.name = "getdevinfo",	\
@@ -209,9 +306,25 @@ void server_dbus_total_ops(struct export_stats *export_st,
 void global_dbus_total_ops(DBusMessageIter *iter);
 void server_dbus_fast_ops(DBusMessageIter *iter);
 void cache_inode_dbus_show(DBusMessageIter *iter);
+void cache_inode_dbus_show_hash(DBusMessageIter *iter);
+void compound_dbus_show_parallel(DBusMessageIter *iter);
+void fsal_dbus_show_creds(DBusMessageIter *iter);
+void cache_inode_dbus_show_gather(DBusMessageIter *iter);
+void fsal_up_dbus_show_queue(DBusMessageIter *iter);
+void fsal_up_dbus_show_recalls(DBusMessageIter *iter);
+void cache_inode_dbus_show_data(DBusMessageIter *iter);
+void server_dbus_bufpool(DBusMessageIter *iter);
+void server_dbus_slab_pools(DBusMessageIter *iter);
+void server_dbus_qos(DBusMessageIter *iter);
+void server_dbus_evchans(DBusMessageIter *iter);
+void server_dbus_xprt_stalls(struct xprt_stall_stats *st,
+			     DBusMessageIter *iter);
+void global_dbus_xprt_stalls(DBusMessageIter *iter);
+void server_dbus_ds_io(struct ds_io_stats *st, DBusMessageIter *iter);
 
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter);
 void server_dbus_9p_transstats(struct _9p_stats *_9pp, DBusMessageIter *iter);
+void server_dbus_9p_fidstats(struct _9p_stats *_9pp, DBusMessageIter *iter);
 void server_dbus_9p_tcpstats(struct _9p_stats *_9pp, DBusMessageIter *iter);
 void server_dbus_9p_rdmastats(struct _9p_stats *_9pp, DBusMessageIter *iter);
 #endif				/* USE_DBUS */
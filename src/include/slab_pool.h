@@ -0,0 +1,78 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file slab_pool.h
+ * @brief Slab pool substrate
+ *
+ * @page SlabPoolSubstrate The Slab Pool Substrate
+ *
+ * A pool substrate for small, numerous objects (cache entries,
+ * states, hash table nodes).  Objects are carved from 2MiB slabs that
+ * are huge page backed where the system allows it and are filled by
+ * a thread running on the NUMA node that will use them.  Each thread
+ * keeps a magazine of free objects per pool so that pool_alloc and
+ * pool_free normally touch no shared state.
+ *
+ * Use it by passing pool_slab_substrate to pool_init.  It takes no
+ * parameters.  As with the basic substrate, objects from a pool with
+ * no constructor are returned zeroed.
+ */
+
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <stdint.h>
+#include "abstract_mem.h"
+
+pool_t *pool_slab_initializer(size_t size, void *param);
+void pool_slab_destroy(pool_t *pool);
+void *pool_slab_alloc(pool_t *pool);
+void pool_slab_free(pool_t *pool, void *object);
+
+static const struct pool_substrate_vector pool_slab_substrate[] = {
+	{
+		.initializer = pool_slab_initializer,
+		.destroyer = pool_slab_destroy,
+		.allocator = pool_slab_alloc,
+		.freer = pool_slab_free
+	}
+};
+
+/**
+ * @brief Usage of one slab pool
+ */
+
+struct pool_slab_stats {
+	const char *name;	/*< Pool name, may be NULL */
+	uint64_t object_size;	/*< Bytes per object, after rounding */
+	uint64_t slabs;		/*< Slabs currently mapped */
+	uint64_t huge_slabs;	/*< Of which on hugetlbfs pages */
+	uint64_t objects;	/*< Object capacity of those slabs */
+	uint64_t free;		/*< Objects free in the slabs */
+	uint64_t cached;	/*< Objects held in thread magazines */
+};
+
+void pool_slab_foreach(void (*cb)(const struct pool_slab_stats *stats,
+				  void *arg),
+		       void *arg);
+
+#endif				/* SLAB_POOL_H */
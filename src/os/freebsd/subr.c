@@ -149,3 +149,13 @@ int set_threadgroups(size_t size, const gid_t *list)
 {
 	return syscall(SYS_setgroups, size, list);
 }
+
+bool setuser_fast(uid_t uid, uid_t installed)
+{
+	return syscall(SYS_seteuid, uid) == 0;
+}
+
+bool setgroup_fast(gid_t gid, gid_t installed)
+{
+	return syscall(SYS_setegid, gid) == 0;
+}
@@ -128,3 +128,35 @@ int set_threadgroups(size_t size, const gid_t *list)
 {
 	return syscall(__NR_setgroups, size, list);
 }
+
+/**
+ * @brief Switch the filesystem user id in a single syscall
+ *
+ * Only meant for a privileged caller that knows which id is currently
+ * installed: setfsuid returns the previous id, which then serves as the
+ * check instead of the second call setuser() has to make.
+ *
+ * @param[in] uid       User id to install
+ * @param[in] installed User id believed to be installed
+ *
+ * @return true if the previous id matched @c installed.
+ */
+bool setuser_fast(uid_t uid, uid_t installed)
+{
+	return setfsuid(uid) == installed;
+}
+
+/**
+ * @brief Switch the filesystem group id in a single syscall
+ *
+ * @see setuser_fast
+ *
+ * @param[in] gid       Group id to install
+ * @param[in] installed Group id believed to be installed
+ *
+ * @return true if the previous id matched @c installed.
+ */
+bool setgroup_fast(gid_t gid, gid_t installed)
+{
+	return setfsgid(gid) == installed;
+}
@@ -0,0 +1,82 @@
+#!/usr/bin/python
+
+# Call every server wide statistics method of org.ganesha.nfsd.exportstats
+# and print its reply.  Each reply must carry an OK status and a
+# timestamp, and the counter structs must hold (name, value) pairs.
+# Exits non-zero if any method fails those checks.
+
+import sys
+import dbus
+
+bus = dbus.SystemBus()
+
+# Create an object that will proxy for a particular remote object.
+try:
+	admin = bus.get_object("org.ganesha.nfsd",
+			       "/org/ganesha/nfsd/ExportMgr")
+except: # catch *all* exceptions
+	print("Error: Can't talk to ganesha service on d-bus. Looks like Ganesha is down")
+	sys.exit(1)
+
+# (method, arguments, whether the stats are a struct of named counters)
+METHODS = [
+	("GetGlobalOPS", (0,), False),
+	("GetFastOPS", (0,), False),
+	("ShowCacheInode", (0,), True),
+	("ShowCacheInodeHash", (), True),
+	("ShowParallelCompound", (), True),
+	("ShowCredentialSwitch", (), True),
+	("ShowWriteGather", (), True),
+	("ShowDataCache", (), True),
+	("ShowBufferPool", (), True),
+	("ShowSlabPools", (), False),
+	("ShowQoS", (), False),
+	("ShowXprtStalls", (), False),
+	("ShowEventChannels", (), False),
+	("ShowUpcallQueue", (), True),
+	("ShowLayoutRecalls", (), True),
+]
+
+def check(name, reply, counters):
+	if len(reply) < 4:
+		return "short reply"
+	if not reply[0] or reply[1] != "OK":
+		return "status %s" % reply[1]
+	if len(reply[2]) != 2:
+		return "no timestamp"
+	if counters:
+		stats = reply[3]
+		if len(stats) % 2 != 0:
+			return "odd number of counter fields"
+		for i in range(0, len(stats), 2):
+			if not isinstance(stats[i], dbus.String):
+				return "field %d is not a counter name" % i
+			if not isinstance(stats[i + 1], dbus.UInt64):
+				return "counter %s is not a uint64" % stats[i]
+	return None
+
+failed = 0
+for name, args, counters in METHODS:
+	method = admin.get_dbus_method(name, 'org.ganesha.nfsd.exportstats')
+	try:
+		reply = method(*args)
+	except dbus.exceptions.DBusException as e:
+		print("FAIL %s: %s" % (name, e))
+		failed += 1
+		continue
+
+	error = check(name, reply, counters)
+	if error is not None:
+		print("FAIL %s: %s" % (name, error))
+		failed += 1
+		continue
+
+	print("%s:" % name)
+	for stats in reply[3:]:
+		print("  %s" % (stats,))
+
+if failed:
+	print("%d of %d methods failed" % (failed, len(METHODS)))
+	sys.exit(1)
+
+sys.exit(0)
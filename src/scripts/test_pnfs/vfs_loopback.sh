@@ -0,0 +1,212 @@
+#!/bin/bash
+#
+# Run pNFS file layouts over FSAL_VFS on a single host: one MDS and
+# several data servers, all Ganesha instances exporting the same local
+# directory, talking to the local client over loopback.
+#
+# usage: vfs_loopback.sh [-n num_ds] [-u stripe_unit] [-p base_port]
+#                        [-b ganesha.nfsd] [-P plugins_dir] [-k]
+#                        <directory> <mountpoint>
+#
+#   -n  number of data servers (default 3)
+#   -u  Stripe_Unit in bytes (default 65536)
+#   -p  MDS port, data servers take the following ones (default 20490)
+#   -b  ganesha binary (default ganesha.nfsd from PATH)
+#   -P  Plugins_Dir holding libfsalvfs.so
+#   -k  leave the servers running and the mount in place
+#
+# Must be run as root.  Every instance keeps its config, log and pid
+# file under a work directory, which is printed.
+#
+# All instances report the hostname as server owner, so the client
+# only tells them apart by client ID.  Each gets its own epoch (-E) so
+# that the client IDs they hand out never collide.  The RQUOTA socket
+# is bound even when disabled, so each instance also takes its own
+# Rquota_Port, 100 above its NFS port.  Their rpcbind and DBus
+# registrations replace each other, which NFSv4.1 does not need.
+#
+# After mounting, a file of several stripes per data server is written
+# and read back through the mount and compared.  The test fails if the
+# client did not use a layout, and warns if data went to the MDS.
+
+NUM_DS=3
+STRIPE_UNIT=65536
+BASE_PORT=20490
+GANESHA=ganesha.nfsd
+PLUGINS_DIR=
+KEEP=0
+EXPORT_ID=77
+PSEUDO=/pnfs
+
+while getopts "n:u:p:b:P:k" opt; do
+	case $opt in
+	n) NUM_DS=$OPTARG ;;
+	u) STRIPE_UNIT=$OPTARG ;;
+	p) BASE_PORT=$OPTARG ;;
+	b) GANESHA=$OPTARG ;;
+	P) PLUGINS_DIR=$OPTARG ;;
+	k) KEEP=1 ;;
+	*) sed -n '7,16p' $0; exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 2 ]; then
+	sed -n '7,16p' $0
+	exit 1
+fi
+
+DIR=$(readlink -f $1)
+MNT=$2
+
+if [ ! -d "$DIR" ] || [ ! -d "$MNT" ]; then
+	echo "$1 and $2 must be directories"
+	exit 1
+fi
+
+WORK=$(mktemp -d /tmp/vfs_pnfs.XXXXXX)
+echo "Work directory $WORK"
+
+# write_config <name> <port> <is_mds>
+write_config()
+{
+	local conf=$WORK/$1.conf
+	local i
+
+	cat > $conf <<CONF
+NFS_CORE_PARAM
+{
+	Bind_Addr = 127.0.0.1;
+	NFS_Port = $2;
+	NFS_Protocols = 4;
+	Enable_NLM = false;
+	Enable_RQUOTA = false;
+	Rquota_Port = $(($2 + 100));
+CONF
+	if [ -n "$PLUGINS_DIR" ]; then
+		echo "	Plugins_Dir = \"$PLUGINS_DIR\";" >> $conf
+	fi
+	cat >> $conf <<CONF
+}
+
+NFSV4
+{
+	Graceless = true;
+}
+
+VFS
+{
+CONF
+	if [ $3 -eq 1 ]; then
+		echo "	PNFS {" >> $conf
+		echo "		Stripe_Unit = $STRIPE_UNIT;" >> $conf
+		for i in $(seq 1 $NUM_DS); do
+			echo "		DataServer {" >> $conf
+			echo "			DS_Addr = 127.0.0.1;" >> $conf
+			echo "			DS_Port = $((BASE_PORT + i));" >> $conf
+			echo "		}" >> $conf
+		done
+		echo "	}" >> $conf
+	fi
+	cat >> $conf <<CONF
+}
+
+EXPORT
+{
+	Export_Id = $EXPORT_ID;
+	Path = "$DIR";
+	Pseudo = $PSEUDO;
+	Access_Type = RW;
+	Squash = No_Root_Squash;
+	Protocols = 4;
+	FSAL {
+		Name = VFS;
+		pnfs_file = true;
+	}
+}
+CONF
+}
+
+# start <name> <port> <is_mds> <epoch>
+start()
+{
+	write_config $1 $2 $3
+	$GANESHA -d -f $WORK/$1.conf -L $WORK/$1.log -p $WORK/$1.pid \
+		 -N NIV_EVENT -E $4 || exit 1
+}
+
+stop_all()
+{
+	local pid
+
+	for pid in $WORK/*.pid; do
+		[ -f $pid ] && kill $(cat $pid) 2>/dev/null
+	done
+}
+
+cleanup()
+{
+	if [ $KEEP -eq 0 ]; then
+		umount $MNT 2>/dev/null
+		stop_all
+	fi
+}
+trap cleanup EXIT
+
+EPOCH=$(date +%s)
+
+for i in $(seq 1 $NUM_DS); do
+	start ds$i $((BASE_PORT + i)) 0 $((EPOCH + i))
+done
+start mds $BASE_PORT 1 $EPOCH
+
+# Wait for every instance to accept connections
+for i in $(seq 0 $NUM_DS); do
+	port=$((BASE_PORT + i))
+	for try in $(seq 1 30); do
+		(exec 3<>/dev/tcp/127.0.0.1/$port) 2>/dev/null && break
+		sleep 1
+	done
+done
+
+mount -t nfs -o vers=4.1,port=$BASE_PORT 127.0.0.1:$PSEUDO $MNT || exit 1
+
+SIZE=$((STRIPE_UNIT * NUM_DS * 4 + STRIPE_UNIT / 2))
+SRC=$WORK/source
+dd if=/dev/urandom of=$SRC bs=$SIZE count=1 2>/dev/null
+
+echo "Writing $SIZE bytes over $NUM_DS data servers..."
+cp $SRC $MNT/pnfs_test || exit 1
+sync
+
+# Compare the backing file, then what reads through pNFS return
+cmp $SRC $DIR/pnfs_test || exit 1
+echo 3 > /proc/sys/vm/drop_caches
+cmp $SRC $MNT/pnfs_test || exit 1
+
+# Operation counts of the MDS mount: DS I/O is counted elsewhere
+opcount()
+{
+	awk -v mnt=" $(readlink -f $MNT) " -v op="$1:" '
+		/^device / { inmnt = index($0, mnt) > 0 }
+		inmnt && $1 == op { print $2; exit }' /proc/self/mountstats
+}
+
+LAYOUTGETS=$(opcount LAYOUTGET)
+MDS_WRITES=$(opcount WRITE)
+MDS_READS=$(opcount READ)
+echo "LAYOUTGET $LAYOUTGETS, GETDEVICEINFO $(opcount GETDEVICEINFO)," \
+     "WRITE to MDS $MDS_WRITES, READ from MDS $MDS_READS"
+
+rm -f $MNT/pnfs_test
+
+if [ "${LAYOUTGETS:-0}" -eq 0 ]; then
+	echo "FAILED: the client did not get a layout"
+	exit 1
+fi
+if [ "${MDS_WRITES:-0}" -ne 0 ] || [ "${MDS_READS:-0}" -ne 0 ]; then
+	echo "WARNING: some I/O went through the MDS, see $WORK/*.log"
+fi
+
+echo "PASSED"
+exit 0
@@ -0,0 +1,548 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup bufpool
+ * @{
+ */
+
+/**
+ * @file bufpool.c
+ * @brief Bulk data buffer pool
+ *
+ * Each size class owns a set of 4MiB arenas.  An arena is mapped at a
+ * 4MiB aligned address, touched once so that every page is resident,
+ * and cut into equal buffers that are threaded onto the class free
+ * list.  Arenas are never unmapped.
+ *
+ * Because arenas are aligned on their own size, the arena holding a
+ * buffer is found by masking the buffer address; a small open
+ * addressing table of arena bases, filled under a mutex and read
+ * without one, tells pooled buffers from malloc'd ones.  That lets
+ * gsh_buf_free accept any buffer gsh_buf_alloc returned, including the
+ * malloc fallbacks, and lets code that swaps in a buffer from
+ * elsewhere keep working.
+ *
+ * Every thread keeps a handful of buffers per class.  Frees push to
+ * the calling thread's cache and spill half of it back to the shared
+ * list when it fills; allocations that miss the cache pull a batch.
+ * Caches are returned to the shared lists when their thread exits.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "log.h"
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "common_utils.h"
+#include "nfs_core.h"
+#include "gsh_bufpool.h"
+
+#define BUFPOOL_ARENA_SHIFT 22
+#define BUFPOOL_ARENA_SIZE (1UL << BUFPOOL_ARENA_SHIFT)
+#define BUFPOOL_ARENA_MASK (BUFPOOL_ARENA_SIZE - 1)
+
+/** Upper bound on buffers a thread keeps per class */
+#define BUFPOOL_TCACHE_MAX 16
+
+/** Upper bound on bytes a thread keeps per class */
+#define BUFPOOL_TCACHE_BYTES (2 * 1024 * 1024)
+
+/**
+ * @brief A free buffer, linked through its first word
+ */
+
+struct bufpool_free {
+	struct bufpool_free *next;
+};
+
+/**
+ * @brief One size class
+ */
+
+struct bufpool_class {
+	pthread_mutex_t mtx;	/*< Protects free, nfree, arenas, buffers */
+	struct bufpool_free *free;	/*< Shared free list */
+	uint64_t nfree;		/*< Length of free */
+	uint64_t arenas;	/*< Arenas carved for this class */
+	uint64_t buffers;	/*< Buffers carved for this class */
+	size_t size;		/*< Buffer size */
+	uint32_t tcache_max;	/*< Per-thread cache depth */
+	uint64_t allocs;	/*< Pooled allocations (atomic) */
+	uint64_t frees;		/*< Pooled frees (atomic) */
+	uint64_t cached;	/*< Allocations served by a thread cache */
+};
+
+/**
+ * @brief Per-thread cache
+ */
+
+struct bufpool_tcache {
+	bool registered;	/*< Thread exit destructor is armed */
+	uint32_t count[GSH_BUF_CLASSES];
+	struct bufpool_free *head[GSH_BUF_CLASSES];
+};
+
+static struct bufpool_class bufpool_classes[GSH_BUF_CLASSES];
+
+static bool bufpool_enabled;
+static bool bufpool_huge;
+static uint64_t bufpool_limit;
+
+/** Arena registry: base | (class + 1), zero for an empty slot */
+static uint64_t *arena_table;
+static uint32_t arena_table_mask;
+static uint64_t arena_count;
+static uint64_t arena_max;
+static uint64_t arena_huge;
+static pthread_mutex_t arena_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t bufpool_oversize;
+static uint64_t bufpool_fallback;
+
+static pthread_key_t bufpool_key;
+static __thread struct bufpool_tcache bufpool_tcache;
+
+static inline uint32_t arena_hash(uintptr_t base)
+{
+	return (uint32_t) ((base >> BUFPOOL_ARENA_SHIFT) * 2654435761U);
+}
+
+/**
+ * @brief Find the size class of a pooled buffer
+ *
+ * @param[in] buf Buffer
+ *
+ * @return Class index, or -1 if buf was not carved from an arena.
+ */
+
+static int arena_lookup(void *buf)
+{
+	uintptr_t base = (uintptr_t) buf & ~BUFPOOL_ARENA_MASK;
+	uint32_t slot;
+	uint64_t ent;
+
+	if (arena_table == NULL)
+		return -1;
+
+	for (slot = arena_hash(base) & arena_table_mask;;
+	     slot = (slot + 1) & arena_table_mask) {
+		ent = atomic_fetch_uint64_t(&arena_table[slot]);
+		if (ent == 0)
+			return -1;
+		if ((ent & ~(uint64_t) BUFPOOL_ARENA_MASK) == base)
+			return (int)(ent & BUFPOOL_ARENA_MASK) - 1;
+	}
+}
+
+/**
+ * @brief Map one arena
+ *
+ * Map twice the arena size and trim it down to an aligned arena, try
+ * hugetlbfs first if asked to and fall back to transparent huge pages.
+ *
+ * @param[out] huge Set if the arena is backed by hugetlbfs
+ *
+ * @return The arena, or NULL.
+ */
+
+static void *arena_map(bool *huge)
+{
+	const size_t len = 2 * BUFPOOL_ARENA_SIZE;
+	char *raw = MAP_FAILED;
+	char *base;
+	size_t off;
+
+	*huge = false;
+#ifdef MAP_HUGETLB
+	if (bufpool_huge) {
+		raw = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		*huge = raw != MAP_FAILED;
+	}
+#endif
+	if (raw == MAP_FAILED)
+		raw = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		return NULL;
+
+	base = (char *)(((uintptr_t) raw + BUFPOOL_ARENA_MASK) &
+			~BUFPOOL_ARENA_MASK);
+	if (base != raw)
+		munmap(raw, base - raw);
+	if (base + BUFPOOL_ARENA_SIZE != raw + len)
+		munmap(base + BUFPOOL_ARENA_SIZE,
+		       raw + len - (base + BUFPOOL_ARENA_SIZE));
+
+#ifdef MADV_HUGEPAGE
+	if (bufpool_huge && !*huge)
+		(void)madvise(base, BUFPOOL_ARENA_SIZE, MADV_HUGEPAGE);
+#endif
+
+	/* Fault everything in now rather than on the I/O path */
+	for (off = 0; off < BUFPOOL_ARENA_SIZE; off += GSH_BUF_ALIGN)
+		((volatile char *)base)[off] = 0;
+
+	return base;
+}
+
+/**
+ * @brief Carve a new arena for a class
+ *
+ * @note The class mutex must be held.
+ *
+ * @param[in] cls Class index
+ *
+ * @return true if buffers were added to the class free list.
+ */
+
+static bool arena_grow(int cls)
+{
+	struct bufpool_class *bc = &bufpool_classes[cls];
+	struct bufpool_free *fb;
+	char *base;
+	bool huge;
+	uint32_t slot;
+	size_t off;
+
+	PTHREAD_MUTEX_lock(&arena_mtx);
+	if (arena_count >= arena_max) {
+		PTHREAD_MUTEX_unlock(&arena_mtx);
+		return false;
+	}
+
+	base = arena_map(&huge);
+	if (base == NULL) {
+		PTHREAD_MUTEX_unlock(&arena_mtx);
+		LogMajor(COMPONENT_INIT,
+			 "Unable to map a %lu byte buffer pool arena: %d",
+			 BUFPOOL_ARENA_SIZE, errno);
+		return false;
+	}
+
+	for (slot = arena_hash((uintptr_t) base) & arena_table_mask;
+	     arena_table[slot] != 0;
+	     slot = (slot + 1) & arena_table_mask)
+		;
+	atomic_store_uint64_t(&arena_table[slot],
+			      (uint64_t) (uintptr_t) base | (cls + 1));
+	arena_count++;
+	if (huge)
+		arena_huge++;
+	PTHREAD_MUTEX_unlock(&arena_mtx);
+
+	for (off = 0; off + bc->size <= BUFPOOL_ARENA_SIZE;
+	     off += bc->size) {
+		fb = (struct bufpool_free *)(base + off);
+		fb->next = bc->free;
+		bc->free = fb;
+		bc->nfree++;
+		bc->buffers++;
+	}
+	bc->arenas++;
+
+	LogDebug(COMPONENT_INIT,
+		 "Buffer pool arena %p for %zu byte buffers%s", base,
+		 bc->size, huge ? " (huge pages)" : "");
+	return true;
+}
+
+/**
+ * @brief Give back cached buffers when a thread exits
+ *
+ * @param[in] arg The thread's cache
+ */
+
+static void bufpool_tcache_destroy(void *arg)
+{
+	struct bufpool_tcache *tc = arg;
+	struct bufpool_class *bc;
+	struct bufpool_free *fb;
+	int cls;
+
+	for (cls = 0; cls < GSH_BUF_CLASSES; cls++) {
+		if (tc->head[cls] == NULL)
+			continue;
+		bc = &bufpool_classes[cls];
+		PTHREAD_MUTEX_lock(&bc->mtx);
+		while (tc->head[cls] != NULL) {
+			fb = tc->head[cls];
+			tc->head[cls] = fb->next;
+			fb->next = bc->free;
+			bc->free = fb;
+			bc->nfree++;
+		}
+		PTHREAD_MUTEX_unlock(&bc->mtx);
+		tc->count[cls] = 0;
+	}
+	tc->registered = false;
+}
+
+static inline struct bufpool_tcache *bufpool_tcache_get(void)
+{
+	struct bufpool_tcache *tc = &bufpool_tcache;
+
+	if (unlikely(!tc->registered)) {
+		(void)pthread_setspecific(bufpool_key, tc);
+		tc->registered = true;
+	}
+	return tc;
+}
+
+/**
+ * @brief Map a request size to a class
+ *
+ * @param[in] size Requested size
+ *
+ * @return Class index, or -1 if size is above the largest class.
+ */
+
+static inline int bufpool_class(size_t size)
+{
+	int cls = 0;
+
+	if (size > (1UL << GSH_BUF_MAX_SHIFT))
+		return -1;
+	while (size > (1UL << (GSH_BUF_MIN_SHIFT + cls)))
+		cls++;
+	return cls;
+}
+
+/**
+ * @brief Initialize the buffer pool
+ *
+ * Reads Buffer_Pool_Size and Buffer_Pool_Huge_Pages from
+ * NFS_CORE_PARAM.  A size of zero leaves the pool disabled and every
+ * buffer is simply malloc'd.
+ *
+ * @return 0 on success, an errno otherwise.
+ */
+
+int gsh_bufpool_pkginit(void)
+{
+	struct bufpool_class *bc;
+	uint32_t slots;
+	int cls;
+	int rc;
+
+	bufpool_limit = nfs_param.core_param.buffer_pool_size;
+	bufpool_huge = nfs_param.core_param.buffer_pool_hugepages;
+	arena_max = bufpool_limit / BUFPOOL_ARENA_SIZE;
+	if (arena_max == 0) {
+		LogInfo(COMPONENT_INIT, "Buffer pool disabled");
+		return 0;
+	}
+
+	rc = pthread_key_create(&bufpool_key, bufpool_tcache_destroy);
+	if (rc != 0)
+		return rc;
+
+	for (slots = 16; slots < 2 * arena_max; slots <<= 1)
+		;
+	arena_table = gsh_calloc(slots, sizeof(*arena_table));
+	if (arena_table == NULL)
+		return ENOMEM;
+	arena_table_mask = slots - 1;
+
+	for (cls = 0; cls < GSH_BUF_CLASSES; cls++) {
+		bc = &bufpool_classes[cls];
+		pthread_mutex_init(&bc->mtx, NULL);
+		bc->size = 1UL << (GSH_BUF_MIN_SHIFT + cls);
+		bc->tcache_max = BUFPOOL_TCACHE_BYTES / bc->size;
+		if (bc->tcache_max > BUFPOOL_TCACHE_MAX)
+			bc->tcache_max = BUFPOOL_TCACHE_MAX;
+		if (bc->tcache_max < 2)
+			bc->tcache_max = 2;
+	}
+
+	bufpool_enabled = true;
+	LogInfo(COMPONENT_INIT,
+		"Buffer pool of %" PRIu64 " arenas of %lu bytes%s",
+		arena_max, BUFPOOL_ARENA_SIZE,
+		bufpool_huge ? ", huge pages requested" : "");
+	return 0;
+}
+
+/**
+ * @brief Allocate a bulk data buffer
+ *
+ * The buffer is aligned to GSH_BUF_ALIGN and must be released with
+ * gsh_buf_free.  Sizes above the largest class, or that find the pool
+ * exhausted, are served by malloc.
+ *
+ * @param[in] size Bytes needed
+ *
+ * @return The buffer, or NULL.
+ */
+
+void *gsh_buf_alloc(size_t size)
+{
+	struct bufpool_tcache *tc;
+	struct bufpool_class *bc;
+	struct bufpool_free *fb;
+	uint32_t batch;
+	int cls;
+
+	if (!bufpool_enabled)
+		return gsh_malloc_aligned(GSH_BUF_ALIGN, size);
+
+	cls = bufpool_class(size);
+	if (cls < 0) {
+		(void)atomic_inc_uint64_t(&bufpool_oversize);
+		return gsh_malloc_aligned(GSH_BUF_ALIGN, size);
+	}
+
+	bc = &bufpool_classes[cls];
+	tc = bufpool_tcache_get();
+	fb = tc->head[cls];
+	if (likely(fb != NULL)) {
+		tc->head[cls] = fb->next;
+		tc->count[cls]--;
+		(void)atomic_inc_uint64_t(&bc->cached);
+		(void)atomic_inc_uint64_t(&bc->allocs);
+		return fb;
+	}
+
+	PTHREAD_MUTEX_lock(&bc->mtx);
+	if (bc->free == NULL && !arena_grow(cls)) {
+		PTHREAD_MUTEX_unlock(&bc->mtx);
+		(void)atomic_inc_uint64_t(&bufpool_fallback);
+		return gsh_malloc_aligned(GSH_BUF_ALIGN, size);
+	}
+	fb = bc->free;
+	bc->free = fb->next;
+	bc->nfree--;
+
+	/* Take a few more so the next allocations stay local */
+	for (batch = bc->tcache_max / 2; batch > 0 && bc->free != NULL;
+	     batch--) {
+		struct bufpool_free *next = bc->free;
+
+		bc->free = next->next;
+		bc->nfree--;
+		next->next = tc->head[cls];
+		tc->head[cls] = next;
+		tc->count[cls]++;
+	}
+	PTHREAD_MUTEX_unlock(&bc->mtx);
+
+	(void)atomic_inc_uint64_t(&bc->allocs);
+	return fb;
+}
+
+/**
+ * @brief Release a buffer from gsh_buf_alloc
+ *
+ * Buffers that did not come from an arena are handed to free, so it
+ * is safe to call this on the malloc fallbacks.
+ *
+ * @param[in] buf The buffer, may be NULL
+ */
+
+void gsh_buf_free(void *buf)
+{
+	struct bufpool_tcache *tc;
+	struct bufpool_class *bc;
+	struct bufpool_free *fb = buf;
+	struct bufpool_free *spill;
+	uint32_t n;
+	int cls;
+
+	if (buf == NULL)
+		return;
+
+	cls = arena_lookup(buf);
+	if (cls < 0) {
+		gsh_free(buf);
+		return;
+	}
+
+	bc = &bufpool_classes[cls];
+	(void)atomic_inc_uint64_t(&bc->frees);
+	tc = bufpool_tcache_get();
+
+	if (tc->count[cls] >= bc->tcache_max) {
+		/* Spill half the cache back to the shared list */
+		PTHREAD_MUTEX_lock(&bc->mtx);
+		for (n = bc->tcache_max / 2; n > 0; n--) {
+			spill = tc->head[cls];
+			tc->head[cls] = spill->next;
+			tc->count[cls]--;
+			spill->next = bc->free;
+			bc->free = spill;
+			bc->nfree++;
+		}
+		PTHREAD_MUTEX_unlock(&bc->mtx);
+	}
+
+	fb->next = tc->head[cls];
+	tc->head[cls] = fb;
+	tc->count[cls]++;
+}
+
+/**
+ * @brief Take a snapshot of pool occupancy
+ *
+ * @param[out] stats Filled in
+ */
+
+void gsh_bufpool_stats(struct gsh_bufpool_stats *stats)
+{
+	struct bufpool_class *bc;
+	struct gsh_bufpool_class_stats *cs;
+	uint64_t frees;
+	int cls;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->limit = bufpool_limit;
+	stats->oversize = atomic_fetch_uint64_t(&bufpool_oversize);
+	stats->fallback = atomic_fetch_uint64_t(&bufpool_fallback);
+
+	PTHREAD_MUTEX_lock(&arena_mtx);
+	stats->mapped = arena_count * BUFPOOL_ARENA_SIZE;
+	stats->huge = arena_huge;
+	PTHREAD_MUTEX_unlock(&arena_mtx);
+
+	for (cls = 0; cls < GSH_BUF_CLASSES; cls++) {
+		bc = &bufpool_classes[cls];
+		cs = &stats->classes[cls];
+		cs->size = 1UL << (GSH_BUF_MIN_SHIFT + cls);
+		if (!bufpool_enabled)
+			continue;
+		PTHREAD_MUTEX_lock(&bc->mtx);
+		cs->arenas = bc->arenas;
+		cs->buffers = bc->buffers;
+		cs->free = bc->nfree;
+		PTHREAD_MUTEX_unlock(&bc->mtx);
+		cs->allocs = atomic_fetch_uint64_t(&bc->allocs);
+		cs->cached = atomic_fetch_uint64_t(&bc->cached);
+		frees = atomic_fetch_uint64_t(&bc->frees);
+		cs->in_use = cs->allocs > frees ? cs->allocs - frees : 0;
+	}
+}
+
+/** @} */
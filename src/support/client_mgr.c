@@ -827,6 +827,100 @@ static struct gsh_dbus_method cltmgr_show_9p_trans = {
 };
 
 
+/**
+ * DBUS method to report 9p fid statistics
+ *
+ */
+
+static bool get_9p_stats_fids(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	struct server_stats *server_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	client = lookup_client(args, &errormsg);
+	if (client == NULL) {
+		success = false;
+		if (errormsg == NULL)
+			errormsg = "Client IP address not found";
+	} else {
+		server_st = container_of(client, struct server_stats, client);
+		if (server_st->st._9p == NULL) {
+			success = false;
+			errormsg = "Client does not have any 9p activity";
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		server_dbus_9p_fidstats(server_st->st._9p, &iter);
+
+	if (client != NULL)
+		put_gsh_client(client);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_9p_fids = {
+	.name = "Get9pFids",
+	.method = get_9p_stats_fids,
+	.args = {IPADDR_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 FIDS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report transport stalls
+ *
+ */
+
+static bool get_xprt_stalls(DBusMessageIter *args,
+			    DBusMessage *reply,
+			    DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	struct server_stats *server_st = NULL;
+	bool success = true;
+	char *errormsg = NULL;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	client = lookup_client(args, &errormsg);
+	if (client == NULL) {
+		success = false;
+		if (errormsg == NULL)
+			errormsg = "Client IP address not found";
+	} else {
+		server_st = container_of(client, struct server_stats, client);
+		if (server_st->st.stall == NULL) {
+			success = false;
+			errormsg = "Client transports have not stalled";
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		server_dbus_xprt_stalls(server_st->st.stall, &iter);
+
+	if (client != NULL)
+		put_gsh_client(client);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_xprt_stalls = {
+	.name = "GetXprtStalls",
+	.method = get_xprt_stalls,
+	.args = {IPADDR_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 XPRT_STALLS_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v3_io,
 	&cltmgr_show_v40_io,
@@ -834,6 +928,8 @@ static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v41_layouts,
 	&cltmgr_show_9p_io,
 	&cltmgr_show_9p_trans,
+	&cltmgr_show_9p_fids,
+	&cltmgr_show_xprt_stalls,
 	NULL
 };
 
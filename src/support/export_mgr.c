@@ -177,6 +177,297 @@ static int export_id_cmpf(const struct avltree_node *lhs,
 		return 0;
 }
 
+/**
+ * @brief Exports are also indexed by path and by pseudo path.
+ *
+ * Each index is a tree of path components.  Every node carries the
+ * list of exports whose path ends at that node and an AVL tree of its
+ * children keyed by component name.  A longest prefix lookup simply
+ * walks the components of the path, so its cost depends on the depth
+ * of the path rather than the number of exports.
+ */
+struct export_path_node {
+	/** Node in the parent's tree of children */
+	struct avltree_node node_k;
+	/** Children of this node, keyed by component name */
+	struct avltree children;
+	/** Parent of this node, NULL for the root */
+	struct export_path_node *parent;
+	/** Exports whose path ends at this node */
+	struct glist_head exports;
+	/** Length of the component name */
+	size_t len;
+	/** Component name, not NUL terminated in lookup keys */
+	const char *name;
+};
+
+/** Index of exports by fullpath,
+  * protected by export_by_id.lock
+  */
+static struct export_path_node export_by_path;
+
+/** Index of exports by pseudopath,
+  * protected by export_by_id.lock
+  */
+static struct export_path_node export_by_pseudo;
+
+/**
+ * @brief Path component comparator for AVL tree walk
+ *
+ */
+static int export_path_cmpf(const struct avltree_node *lhs,
+			    const struct avltree_node *rhs)
+{
+	struct export_path_node *lk, *rk;
+	int rc;
+
+	lk = avltree_container_of(lhs, struct export_path_node, node_k);
+	rk = avltree_container_of(rhs, struct export_path_node, node_k);
+
+	rc = memcmp(lk->name, rk->name, MIN(lk->len, rk->len));
+	if (rc != 0)
+		return rc;
+	if (lk->len != rk->len)
+		return (lk->len < rk->len) ? -1 : 1;
+	return 0;
+}
+
+/**
+ * @brief Initialize a path index node
+ *
+ * @param node   [IN] the node to initialize
+ * @param parent [IN] the parent node, NULL for a root
+ * @param name   [IN] the component name (already allocated)
+ * @param len    [IN] length of the component name
+ */
+
+static void export_path_node_init(struct export_path_node *node,
+				  struct export_path_node *parent,
+				  const char *name, size_t len)
+{
+	avltree_init(&node->children, export_path_cmpf, 0);
+	glist_init(&node->exports);
+	node->parent = parent;
+	node->name = name;
+	node->len = len;
+}
+
+/**
+ * @brief Find the next component of a path
+ *
+ * Leading and repeated '/' are skipped.
+ *
+ * @param path [IN]  where to start scanning
+ * @param len  [OUT] length of the component found
+ *
+ * @return start of the component, NULL if there are no more components.
+ */
+
+static const char *export_path_next(const char *path, size_t *len)
+{
+	const char *end;
+
+	while (*path == '/')
+		path++;
+
+	if (*path == '\0')
+		return NULL;
+
+	for (end = path; *end != '/' && *end != '\0'; end++)
+		;
+
+	*len = end - path;
+	return path;
+}
+
+/**
+ * @brief Find a child of a path index node
+ *
+ * @param node [IN] the parent node
+ * @param name [IN] the component name
+ * @param len  [IN] length of the component name
+ *
+ * @return the child node or NULL if there is none.
+ */
+
+static struct export_path_node *export_path_child(struct export_path_node *node,
+						  const char *name,
+						  size_t len)
+{
+	struct export_path_node key;
+	struct avltree_node *child;
+
+	key.name = name;
+	key.len = len;
+
+	child = avltree_lookup(&key.node_k, &node->children);
+	if (child == NULL)
+		return NULL;
+
+	return avltree_container_of(child, struct export_path_node, node_k);
+}
+
+/**
+ * @brief Remove empty nodes from a path index
+ *
+ * Walk from a node towards the root, freeing every node that has
+ * neither exports nor children.  Assumes export_by_id.lock is held
+ * for write.
+ *
+ * @param node [IN] the node to start at
+ */
+
+static void export_path_prune(struct export_path_node *node)
+{
+	struct export_path_node *parent;
+
+	while (node->parent != NULL &&
+	       glist_empty(&node->exports) &&
+	       avltree_first(&node->children) == NULL) {
+		parent = node->parent;
+		avltree_remove(&node->node_k, &parent->children);
+		gsh_free(node);
+		node = parent;
+	}
+}
+
+/**
+ * @brief Add an export to a path index
+ *
+ * Assumes export_by_id.lock is held for write.
+ *
+ * @param root  [IN] the index to add to
+ * @param path  [IN] the path of the export
+ * @param entry [IN] the export's list entry for this index
+ *
+ * @return the node the export was added to, NULL on allocation failure.
+ */
+
+static struct export_path_node *export_path_insert(struct export_path_node
+						   *root,
+						   const char *path,
+						   struct glist_head *entry)
+{
+	struct export_path_node *node = root;
+	struct export_path_node *child;
+	const char *name;
+	size_t len;
+
+	while ((name = export_path_next(path, &len)) != NULL) {
+		path = name + len;
+		child = export_path_child(node, name, len);
+		if (child == NULL) {
+			/* The name is stored right behind the node */
+			child = gsh_malloc(sizeof(*child) + len + 1);
+			if (child == NULL) {
+				export_path_prune(node);
+				return NULL;
+			}
+			memcpy((char *)(child + 1), name, len);
+			((char *)(child + 1))[len] = '\0';
+			export_path_node_init(child, node,
+					      (char *)(child + 1), len);
+			avltree_insert(&child->node_k, &node->children);
+		}
+		node = child;
+	}
+
+	glist_add_tail(&node->exports, entry);
+	return node;
+}
+
+/**
+ * @brief Remove an export from a path index
+ *
+ * Assumes export_by_id.lock is held for write.
+ *
+ * @param node  [IN] the node the export was added to
+ * @param entry [IN] the export's list entry for this index
+ */
+
+static void export_path_remove(struct export_path_node *node,
+			       struct glist_head *entry)
+{
+	if (node == NULL)
+		return;
+
+	glist_del(entry);
+	export_path_prune(node);
+}
+
+/**
+ * @brief Find the first usable export attached to a path index node
+ *
+ * @param node   [IN] the node to check
+ * @param pseudo [IN] the node is in the pseudo path index
+ *
+ * @return the export or NULL if none is ready.
+ */
+
+static struct gsh_export *export_path_ready(struct export_path_node *node,
+					    bool pseudo)
+{
+	struct glist_head *glist;
+	struct gsh_export *export;
+
+	glist_for_each(glist, &node->exports) {
+		if (pseudo)
+			export = glist_entry(glist, struct gsh_export,
+					     exp_pseudo_entry);
+		else
+			export = glist_entry(glist, struct gsh_export,
+					     exp_path_entry);
+		if (export->state == EXPORT_READY)
+			return export;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Longest prefix lookup in a path index
+ *
+ * Assumes export_by_id.lock is held.
+ *
+ * @param root        [IN] the index to search
+ * @param pseudo      [IN] the index is the pseudo path index
+ * @param path        [IN] the path to look up
+ * @param exact_match [IN] the path must match exactly
+ *
+ * @return the export found (no reference taken) or NULL.
+ */
+
+static struct gsh_export *export_path_lookup(struct export_path_node *root,
+					     bool pseudo, const char *path,
+					     bool exact_match)
+{
+	struct export_path_node *node = root;
+	struct gsh_export *ret_exp = NULL;
+	struct gsh_export *export;
+	const char *name;
+	size_t len;
+
+	if (!exact_match)
+		ret_exp = export_path_ready(node, pseudo);
+
+	while ((name = export_path_next(path, &len)) != NULL) {
+		path = name + len;
+		node = export_path_child(node, name, len);
+		if (node == NULL)
+			return exact_match ? NULL : ret_exp;
+		if (!exact_match) {
+			export = export_path_ready(node, pseudo);
+			if (export != NULL)
+				ret_exp = export;
+		}
+	}
+
+	if (exact_match)
+		ret_exp = export_path_ready(node, pseudo);
+
+	return ret_exp;
+}
+
 /**
  * @brief Allocate a gsh_export entry.
  *
@@ -239,6 +530,24 @@ bool insert_gsh_export(struct gsh_export *export)
 		PTHREAD_RWLOCK_unlock(&export_by_id.lock);
 		return false;	/* somebody beat us to it */
 	}
+	/* index by path and pseudo path */
+	export->exp_path_node = export_path_insert(&export_by_path,
+						   export->fullpath,
+						   &export->exp_path_entry);
+	if (export->exp_path_node == NULL)
+		goto err_index;
+	if (export->pseudopath != NULL) {
+		export->exp_pseudo_node =
+		    export_path_insert(&export_by_pseudo,
+				       export->pseudopath,
+				       &export->exp_pseudo_entry);
+		if (export->exp_pseudo_node == NULL) {
+			export_path_remove(export->exp_path_node,
+					   &export->exp_path_entry);
+			export->exp_path_node = NULL;
+			goto err_index;
+		}
+	}
 	pthread_rwlock_init(&export->lock, NULL);
 	/* update cache */
 	cache_slot = (void **)
@@ -250,6 +559,14 @@ bool insert_gsh_export(struct gsh_export *export)
 	glist_init(&export->entry_list);
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
 	return true;
+
+ err_index:
+	avltree_remove(&export->node_k, &export_by_id.t);
+	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
+	LogCrit(COMPONENT_EXPORT,
+		"Could not index export id %d, out of memory",
+		export->export_id);
+	return false;
 }
 
 /**
@@ -344,9 +661,9 @@ void set_gsh_export_state(struct gsh_export *export, export_state_t state)
 /**
  * @brief Lookup the export manager struct by export path
  *
- * Gets an export entry from its path using a substring match and
- * linear search of the export list, assumes being called with
- * export manager lock held (such as from within foreach_gsh_export.
+ * Gets an export entry from its path using a longest prefix match
+ * in the path index, assumes being called with export manager lock
+ * held (such as from within foreach_gsh_export.
  * If path has a trailing '/', ignore it.
  *
  * @param path        [IN] the path for the entry to be found.
@@ -358,62 +675,10 @@ void set_gsh_export_state(struct gsh_export *export, export_state_t state)
 struct gsh_export *get_gsh_export_by_path_locked(char *path,
 						 bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
-
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
-
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		if (export->state != EXPORT_READY)
-			continue;
-
-		len_export = strlen(export->fullpath);
+	struct gsh_export *ret_exp;
 
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
-
-		/* if the char in fullpath just after the end of path is not '/'
-		 * it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
-
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->fullpath, path, len_export) == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
+	ret_exp = export_path_lookup(&export_by_path, false, path,
+				     exact_match);
 
 	if (ret_exp != NULL)
 		get_gsh_export_ref(ret_exp);
@@ -450,9 +715,9 @@ struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 /**
  * @brief Lookup the export manager struct by export pseudo path
  *
- * Gets an export entry from its pseudo (if it exists), assumes
- * being called with export manager lock held (such as from within
- * foreach_gsh_export.
+ * Gets an export entry from its pseudo (if it exists) using a longest
+ * prefix match in the pseudo path index, assumes being called with
+ * export manager lock held (such as from within foreach_gsh_export.
  *
  * @param path        [IN] the path for the entry to be found.
  * @param exact_match [IN] the path must match exactly
@@ -463,72 +728,14 @@ struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 struct gsh_export *get_gsh_export_by_pseudo_locked(char *path,
 						   bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
+	struct gsh_export *ret_exp;
 
-	/* Ignore trailing slash in path */
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
-
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		if (export->state != EXPORT_READY)
-			continue;
-
-		if (export->pseudopath == NULL)
-			continue;
-
-		len_export = strlen(export->pseudopath);
-
-		LogFullDebug(COMPONENT_EXPORT,
-			     "Comparing %s %d to %s %d",
-			     path, len_path,
-			     export->pseudopath, len_export);
-
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for Pseudo root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
-
-		/* if the char in pseudopath just after the end of path is not
-		 * '/' it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
+	ret_exp = export_path_lookup(&export_by_pseudo, true, path,
+				     exact_match);
 
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->pseudopath, path, len_export)
-		    == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
+	LogFullDebug(COMPONENT_EXPORT,
+		     "Pseudo path %s matched export id %d",
+		     path, ret_exp != NULL ? ret_exp->export_id : -1);
 
 	if (ret_exp != NULL)
 		get_gsh_export_ref(ret_exp);
@@ -687,6 +894,14 @@ void remove_gsh_export(uint16_t export_id)
 			atomic_store_voidptr(cache_slot, NULL);
 		avltree_remove(node, &export_by_id.t);
 
+		/* Remove the export from the path indexes */
+		export_path_remove(export->exp_path_node,
+				   &export->exp_path_entry);
+		export->exp_path_node = NULL;
+		export_path_remove(export->exp_pseudo_node,
+				   &export->exp_pseudo_entry);
+		export->exp_pseudo_node = NULL;
+
 		/* Remove the export from the export list */
 		glist_del(&export->exp_list);
 	}
@@ -1340,6 +1555,51 @@ static bool get_nfsv41_export_layouts(DBusMessageIter *args,
 	return true;
 }
 
+/**
+ * DBUS method to report pNFS DS I/O statistics
+ *
+ */
+
+static bool show_ds_export_io(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	struct export_stats *export_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		success = false;
+	} else {
+		export_st = container_of(export, struct export_stats, export);
+		if (export_st->st.ds_io == NULL) {
+			success = false;
+			errormsg = "Export does not have any DS I/O";
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		server_dbus_ds_io(export_st->st.ds_io, &iter);
+
+	if (export != NULL)
+		put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_show_ds_io = {
+	.name = "ShowDSIO",
+	.method = show_ds_export_io,
+	.args = {EXPORT_ID_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 DS_IO_REPLY,
+		 END_ARG_LIST}
+};
+
 /**
  * DBUS method to report total ops statistics
  *
@@ -1370,52 +1630,134 @@ static bool get_nfsv_export_total_ops(DBusMessageIter *args,
 	return true;
 }
 
-static bool get_nfsv_global_total_ops(DBusMessageIter *args,
-				      DBusMessage *reply,
-				      DBusError *error)
+/**
+ * @brief Reply to a stats method that reports server wide counters
+ *
+ * These methods take no arguments and can't fail, so the reply is an
+ * OK status followed by what @a show appends, a timestamp first.
+ *
+ * @param reply [IN] the reply message
+ * @param show  [IN] appends the timestamp and the stats
+ *
+ * @return true.
+ */
+
+static bool dbus_show_stats(DBusMessage *reply,
+			    void (*show)(DBusMessageIter *iter))
 {
-	bool success = true;
-	char *errormsg = "OK";
 	DBusMessageIter iter;
 
 	dbus_message_iter_init_append(reply, &iter);
-	dbus_status_reply(&iter, success, errormsg);
+	dbus_status_reply(&iter, true, "OK");
 
-	global_dbus_total_ops(&iter);
+	show(&iter);
 
 	return true;
 }
 
+static bool get_nfsv_global_total_ops(DBusMessageIter *args,
+				      DBusMessage *reply,
+				      DBusError *error)
+{
+	return dbus_show_stats(reply, global_dbus_total_ops);
+}
+
 static bool get_nfsv_global_fast_ops(DBusMessageIter *args,
 				     DBusMessage *reply,
 				     DBusError *error)
 {
-	bool success = true;
-	char *errormsg = "OK";
-	DBusMessageIter iter;
-
-	dbus_message_iter_init_append(reply, &iter);
-	dbus_status_reply(&iter, success, errormsg);
-
-	server_dbus_fast_ops(&iter);
-
-	return true;
+	return dbus_show_stats(reply, server_dbus_fast_ops);
 }
 
 static bool show_cache_inode_stats(DBusMessageIter *args,
 				   DBusMessage *reply,
 				   DBusError *error)
 {
-	bool success = true;
-	char *errormsg = "OK";
-	DBusMessageIter iter;
+	return dbus_show_stats(reply, cache_inode_dbus_show);
+}
 
-	dbus_message_iter_init_append(reply, &iter);
-	dbus_status_reply(&iter, success, errormsg);
+static bool show_cache_inode_hash_stats(DBusMessageIter *args,
+					DBusMessage *reply,
+					DBusError *error)
+{
+	return dbus_show_stats(reply, cache_inode_dbus_show_hash);
+}
 
-	cache_inode_dbus_show(&iter);
+static bool show_parallel_compound_stats(DBusMessageIter *args,
+					 DBusMessage *reply,
+					 DBusError *error)
+{
+	return dbus_show_stats(reply, compound_dbus_show_parallel);
+}
 
-	return true;
+static bool show_creds_switch_stats(DBusMessageIter *args,
+				    DBusMessage *reply,
+				    DBusError *error)
+{
+	return dbus_show_stats(reply, fsal_dbus_show_creds);
+}
+
+static bool show_write_gather_stats(DBusMessageIter *args,
+				    DBusMessage *reply,
+				    DBusError *error)
+{
+	return dbus_show_stats(reply, cache_inode_dbus_show_gather);
+}
+
+static bool show_up_queue_stats(DBusMessageIter *args,
+				DBusMessage *reply,
+				DBusError *error)
+{
+	return dbus_show_stats(reply, fsal_up_dbus_show_queue);
+}
+
+static bool show_layout_recalls(DBusMessageIter *args,
+				DBusMessage *reply,
+				DBusError *error)
+{
+	return dbus_show_stats(reply, fsal_up_dbus_show_recalls);
+}
+
+static bool show_data_cache_stats(DBusMessageIter *args,
+				  DBusMessage *reply,
+				  DBusError *error)
+{
+	return dbus_show_stats(reply, cache_inode_dbus_show_data);
+}
+
+static bool show_bufpool_stats(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	return dbus_show_stats(reply, server_dbus_bufpool);
+}
+
+static bool show_slab_pools(DBusMessageIter *args,
+			    DBusMessage *reply,
+			    DBusError *error)
+{
+	return dbus_show_stats(reply, server_dbus_slab_pools);
+}
+
+static bool show_xprt_stalls(DBusMessageIter *args,
+			     DBusMessage *reply,
+			     DBusError *error)
+{
+	return dbus_show_stats(reply, global_dbus_xprt_stalls);
+}
+
+static bool show_evchans(DBusMessageIter *args,
+			 DBusMessage *reply,
+			 DBusError *error)
+{
+	return dbus_show_stats(reply, server_dbus_evchans);
+}
+
+static bool show_qos(DBusMessageIter *args,
+		     DBusMessage *reply,
+		     DBusError *error)
+{
+	return dbus_show_stats(reply, server_dbus_qos);
 }
 
 static struct gsh_dbus_method export_show_v41_layouts = {
@@ -1512,16 +1854,137 @@ static struct gsh_dbus_method cache_inode_show = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method cache_inode_hash_show = {
+	.name = "ShowCacheInodeHash",
+	.method = show_cache_inode_hash_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method parallel_compound_show = {
+	.name = "ShowParallelCompound",
+	.method = show_parallel_compound_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method creds_switch_show = {
+	.name = "ShowCredentialSwitch",
+	.method = show_creds_switch_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method write_gather_show = {
+	.name = "ShowWriteGather",
+	.method = show_write_gather_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method data_cache_show = {
+	.name = "ShowDataCache",
+	.method = show_data_cache_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method bufpool_show = {
+	.name = "ShowBufferPool",
+	.method = show_bufpool_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 BUFPOOL_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method slab_pools_show = {
+	.name = "ShowSlabPools",
+	.method = show_slab_pools,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 SLAB_POOLS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method xprt_stalls_show = {
+	.name = "ShowXprtStalls",
+	.method = show_xprt_stalls,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 XPRT_STALLS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method evchans_show = {
+	.name = "ShowEventChannels",
+	.method = show_evchans,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 EVCHANS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method qos_show = {
+	.name = "ShowQoS",
+	.method = show_qos,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 QOS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method up_queue_show = {
+	.name = "ShowUpcallQueue",
+	.method = show_up_queue_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method layout_recalls_show = {
+	.name = "ShowLayoutRecalls",
+	.method = show_layout_recalls,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *export_stats_methods[] = {
 	&export_show_v3_io,
 	&export_show_v40_io,
 	&export_show_v41_io,
 	&export_show_v41_layouts,
+	&export_show_ds_io,
 	&export_show_total_ops,
 	&export_show_9p_io,
 	&global_show_total_ops,
 	&global_show_fast_ops,
 	&cache_inode_show,
+	&cache_inode_hash_show,
+	&parallel_compound_show,
+	&creds_switch_show,
+	&write_gather_show,
+	&data_cache_show,
+	&bufpool_show,
+	&slab_pools_show,
+	&qos_show,
+	&xprt_stalls_show,
+	&evchans_show,
+	&up_queue_show,
+	&layout_recalls_show,
 	NULL
 };
 
@@ -1564,6 +2027,8 @@ void export_pkginit(void)
 	export_by_id.cache_sz = 255;
 	export_by_id.cache =
 	    gsh_calloc(export_by_id.cache_sz, sizeof(struct avltree_node *));
+	export_path_node_init(&export_by_path, NULL, "", 0);
+	export_path_node_init(&export_by_pseudo, NULL, "", 0);
 	glist_init(&exportlist);
 	glist_init(&mount_work);
 	glist_init(&unexport_work);
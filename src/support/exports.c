@@ -45,6 +45,7 @@
 #include "common_utils.h"
 #include "nodelist.h"
 #include <stdlib.h>
+#include <errno.h>
 #include <fnmatch.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -54,6 +55,7 @@
 #include <ctype.h>
 #include "export_mgr.h"
 #include "fsal_up.h"
+#include "fridgethr.h"
 
 struct global_export_perms export_opt = {
 	.def.anonymous_uid = ANON_UID,
@@ -71,6 +73,9 @@ struct global_export_perms export_opt = {
 	.def.set = UINT32_MAX
 };
 
+/** Protects export_opt.conf against a reload of EXPORT_DEFAULTS */
+static pthread_rwlock_t export_opt_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 static void StrExportOptions(struct export_perms *p_perms, char *buffer)
 {
 	char *buf = buffer;
@@ -546,6 +551,9 @@ static void *fsal_init(void *link_mem, void *self_struct)
 	}
 }
 
+/** Serializes FSAL loading in fsal_commit */
+static pthread_mutex_t fsal_load_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * @brief Commit a FSAL sub-block
  *
@@ -585,6 +593,10 @@ static int fsal_commit(void *node, void *link_mem, void *self_struct,
 	init_root_op_context(&root_op_context, export, NULL, 0, 0,
 			     UNKNOWN_REQUEST);
 
+	/* Exports may be created in parallel at startup, only one of
+	 * them gets to load and initialize a given FSAL.
+	 */
+	PTHREAD_MUTEX_lock(&fsal_load_mutex);
 	fsal = lookup_fsal(fp->name);
 	if (fsal == NULL) {
 		int retval;
@@ -592,6 +604,7 @@ static int fsal_commit(void *node, void *link_mem, void *self_struct,
 
 		retval = load_fsal(fp->name, &fsal);
 		if (retval != 0) {
+			PTHREAD_MUTEX_unlock(&fsal_load_mutex);
 			LogCrit(COMPONENT_CONFIG,
 				"Failed to load FSAL (%s)"
 				" because: %s", fp->name,
@@ -603,6 +616,7 @@ static int fsal_commit(void *node, void *link_mem, void *self_struct,
 		myconfig = get_parse_root(node);
 		status = fsal->ops->init_config(fsal, myconfig);
 		if (FSAL_IS_ERROR(status)) {
+			PTHREAD_MUTEX_unlock(&fsal_load_mutex);
 			LogCrit(COMPONENT_CONFIG,
 				"Failed to initialize FSAL (%s)",
 				fp->name);
@@ -612,6 +626,7 @@ static int fsal_commit(void *node, void *link_mem, void *self_struct,
 			goto err;
 		}
 	}
+	PTHREAD_MUTEX_unlock(&fsal_load_mutex);
 
 	/* Some admins stuff a '/' at  the end for some reason.
 	 * chomp it so we have a /dir/path/basename to work
@@ -671,6 +686,20 @@ err:
 	return errcnt;
 }
 
+/**
+ * @brief Commit a FSAL sub-block of an export being updated in place
+ *
+ * The FSAL sub-block is unchanged from the live export (the caller
+ * checked its fingerprint) so there is no FSAL export to create.
+ */
+
+static int fsal_update_commit(void *node, void *link_mem, void *self_struct,
+			      struct config_error_type *err_type)
+{
+	(void)fsal_init(link_mem, self_struct);
+	return 0;
+}
+
 /**
  * @brief EXPORT block handlers
  */
@@ -703,20 +732,15 @@ static void *export_init(void *link_mem, void *self_struct)
 }
 
 /**
- * @brief Commit an export block
+ * @brief Validate the export level parameters of an export block
  *
- * Validate the export level parameters.  fsal and client
- * parameters are already done.
+ * @return the number of errors found.
  */
 
-static int export_commit(void *node, void *link_mem, void *self_struct,
-			 struct config_error_type *err_type)
+static int validate_export(struct gsh_export *export,
+			   struct config_error_type *err_type)
 {
-	struct gsh_export *export, *probe_exp;
 	int errcnt = 0;
-	char perms[1024];
-
-	export = self_struct;
 
 	/* validate the export now */
 	if (export->export_perms.options & EXPORT_OPTION_NFSV4) {
@@ -763,51 +787,112 @@ static int export_commit(void *node, void *link_mem, void *self_struct,
 			errcnt++;
 		}
 	}
-	if (errcnt)
-		goto err_out;  /* have basic errors. don't even try more... */
+
+err_out:
+	return errcnt;
+}
+
+/** Serializes the duplicate checks and insert in export_commit */
+static pthread_mutex_t export_commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Check a new export against the live ones
+ *
+ * Called with export_commit_mutex held.
+ *
+ * @param[in]  export    The new export
+ * @param[in]  replacing Live export the new one replaces, or NULL.
+ *                       Its id, tag and paths don't count as
+ *                       duplicates.
+ * @param[out] err_type  Errors found
+ *
+ * @return the number of errors found.
+ */
+
+static int check_export_duplicates(struct gsh_export *export,
+				   struct gsh_export *replacing,
+				   struct config_error_type *err_type)
+{
+	struct gsh_export *probe_exp;
+	int errcnt = 0;
+
 	probe_exp = get_gsh_export(export->export_id);
 	if (probe_exp != NULL) {
-		LogDebug(COMPONENT_CONFIG,
-			 "Export %d already exists", export->export_id);
+		if (probe_exp != replacing) {
+			LogDebug(COMPONENT_CONFIG,
+				 "Export %d already exists",
+				 export->export_id);
+			err_type->exists = true;
+			errcnt++;
+		}
 		put_gsh_export(probe_exp);
-		err_type->exists = true;
-		errcnt++;
 	}
 	if (export->FS_tag != NULL) {
 		probe_exp = get_gsh_export_by_tag(export->FS_tag);
 		if (probe_exp != NULL) {
+			if (probe_exp != replacing) {
+				LogCrit(COMPONENT_CONFIG,
+					"Tag (%s) is a duplicate",
+					export->FS_tag);
+				if (!err_type->exists)
+					err_type->invalid = true;
+				errcnt++;
+			}
 			put_gsh_export(probe_exp);
-			LogCrit(COMPONENT_CONFIG,
-				"Tag (%s) is a duplicate",
-				export->FS_tag);
-			if (!err_type->exists)
-				err_type->invalid = true;
-			errcnt++;
 		}
 	}
 	if (export->pseudopath != NULL) {
 		probe_exp = get_gsh_export_by_pseudo(export->pseudopath, true);
 		if (probe_exp != NULL) {
-			LogCrit(COMPONENT_CONFIG,
-				"Pseudo path (%s) is a duplicate",
-				export->pseudopath);
-			if (!err_type->exists)
-				err_type->invalid = true;
-			errcnt++;
+			if (probe_exp != replacing) {
+				LogCrit(COMPONENT_CONFIG,
+					"Pseudo path (%s) is a duplicate",
+					export->pseudopath);
+				if (!err_type->exists)
+					err_type->invalid = true;
+				errcnt++;
+			}
 			put_gsh_export(probe_exp);
 		}
 	}
 	probe_exp = get_gsh_export_by_path(export->fullpath, true);
-	if (probe_exp != NULL &&
-	    export->pseudopath == NULL &&
-	    export->FS_tag == NULL) {
-		LogCrit(COMPONENT_CONFIG,
-			"Duplicate path (%s) without unique tag or Pseudo path",
-			export->fullpath);
-		err_type->invalid = true;
-		errcnt++;
+	if (probe_exp != NULL) {
+		if (probe_exp != replacing &&
+		    export->pseudopath == NULL &&
+		    export->FS_tag == NULL) {
+			LogCrit(COMPONENT_CONFIG,
+				"Duplicate path (%s) without unique tag or Pseudo path",
+				export->fullpath);
+			err_type->invalid = true;
+			errcnt++;
+		}
 		put_gsh_export(probe_exp);
 	}
+
+	return errcnt;
+}
+
+/**
+ * @brief Commit an export block
+ *
+ * Validate the export level parameters.  fsal and client
+ * parameters are already done.
+ */
+
+static int export_commit(void *node, void *link_mem, void *self_struct,
+			 struct config_error_type *err_type)
+{
+	struct gsh_export *export;
+	int errcnt = 0;
+	char perms[1024];
+
+	export = self_struct;
+
+	errcnt = validate_export(export, err_type);
+	if (errcnt)
+		goto err_out;  /* have basic errors. don't even try more... */
+	PTHREAD_MUTEX_lock(&export_commit_mutex);
+	errcnt = check_export_duplicates(export, NULL, err_type);
 	if (errcnt) {
 		if (err_type->exists && !err_type->invalid)
 			LogDebug(COMPONENT_CONFIG,
@@ -817,6 +902,7 @@ static int export_commit(void *node, void *link_mem, void *self_struct,
 			LogCrit(COMPONENT_CONFIG,
 				 "Duplicate export id = %d",
 				 export->export_id);
+		PTHREAD_MUTEX_unlock(&export_commit_mutex);
 		goto err_out;  /* have errors. don't init or load a fsal */
 	}
 	glist_init(&export->exp_state_list);
@@ -824,9 +910,14 @@ static int export_commit(void *node, void *link_mem, void *self_struct,
 	glist_init(&export->exp_nlm_share_list);
 	glist_init(&export->mounted_exports_list);
 
+	/* Remember what the block looked like for reload */
+	export->config_hash = config_node_hash(node, NULL);
+	export->fsal_config_hash = config_node_hash(node, "FSAL");
+
 	/* now probe the fsal and init it */
 	/* pass along the block that is/was the FS_Specific */
 	if (!insert_gsh_export(export)) {
+		PTHREAD_MUTEX_unlock(&export_commit_mutex);
 		LogCrit(COMPONENT_CONFIG,
 			"Export id %d already in use.",
 			export->export_id);
@@ -834,6 +925,7 @@ static int export_commit(void *node, void *link_mem, void *self_struct,
 		errcnt++;
 		goto err_out;
 	}
+	PTHREAD_MUTEX_unlock(&export_commit_mutex);
 
 	/* This export must be mounted to the PseudoFS if NFS v4 */
 	if (export->export_perms.options & EXPORT_OPTION_NFSV4)
@@ -905,6 +997,184 @@ err_out:
 	return errcnt;
 }
 
+/**
+ * @brief Commit an export block replacing a live export
+ *
+ * Used by reload when the path, pseudo path, tag or FSAL sub-block of
+ * an export changed.  By the time we get here the block has parsed
+ * and its FSAL export exists.  The new root is looked up as well
+ * before the live export is unexported, so a block that can't be
+ * built leaves the live export alone.
+ */
+
+static int replace_export_commit(void *node, void *link_mem,
+				 void *self_struct,
+				 struct config_error_type *err_type)
+{
+	struct gsh_export *export = self_struct;
+	struct gsh_export *live;
+	int errcnt;
+	char perms[1024];
+
+	errcnt = validate_export(export, err_type);
+	if (errcnt)
+		return errcnt;
+
+	PTHREAD_MUTEX_lock(&export_commit_mutex);
+
+	live = get_gsh_export(export->export_id);
+	if (live == NULL) {
+		PTHREAD_MUTEX_unlock(&export_commit_mutex);
+		LogCrit(COMPONENT_CONFIG,
+			"Export %d went away while being replaced",
+			export->export_id);
+		err_type->invalid = true;
+		return 1;
+	}
+
+	errcnt = check_export_duplicates(export, live, err_type);
+	if (errcnt)
+		goto err_live;
+
+	glist_init(&export->exp_state_list);
+	glist_init(&export->exp_lock_list);
+	glist_init(&export->exp_nlm_share_list);
+	glist_init(&export->mounted_exports_list);
+
+	export->config_hash = config_node_hash(node, NULL);
+	export->fsal_config_hash = config_node_hash(node, "FSAL");
+
+	if (!init_export_root(export)) {
+		err_type->resource = true;
+		errcnt++;
+		goto err_live;
+	}
+
+	/* Everything that can fail on a bad block is behind us */
+	unexport(live);
+	put_gsh_export(live);
+
+	if (!insert_gsh_export(export)) {
+		PTHREAD_MUTEX_unlock(&export_commit_mutex);
+		LogCrit(COMPONENT_CONFIG,
+			"Export id %d already in use.",
+			export->export_id);
+		release_export_root(export);
+		err_type->exists = true;
+		return 1;
+	}
+	PTHREAD_MUTEX_unlock(&export_commit_mutex);
+
+	if (export->export_perms.options & EXPORT_OPTION_NFSV4)
+		export_add_to_mount_work(export);
+
+	if (!mount_gsh_export(export)) {
+		err_type->resource = true;
+		errcnt++;
+	}
+
+	StrExportOptions(&export->export_perms, perms);
+
+	LogEvent(COMPONENT_CONFIG,
+		 "Export %d replaced at pseudo (%s) with path (%s) and tag (%s) perms (%s)",
+		 export->export_id, export->pseudopath,
+		 export->fullpath, export->FS_tag, perms);
+	set_gsh_export_state(export, EXPORT_READY);
+	put_gsh_export(export);
+	return errcnt;
+
+err_live:
+	PTHREAD_MUTEX_unlock(&export_commit_mutex);
+	LogCrit(COMPONENT_CONFIG,
+		"Export %d not replaced, keeping the live one",
+		export->export_id);
+	put_gsh_export(live);
+	return errcnt;
+}
+
+/**
+ * @brief Commit an export block over a live export
+ *
+ * Used by reload when the path, pseudo path, tag and FSAL sub-block
+ * of an export are unchanged.  The new options and client list are
+ * swapped into the live export under its lock, so requests in flight
+ * see either the old or the new set, and the old ones are released
+ * along with the parsed block.
+ */
+
+static int update_export_commit(void *node, void *link_mem,
+				void *self_struct,
+				struct config_error_type *err_type)
+{
+	struct gsh_export *export = self_struct;
+	struct gsh_export *live;
+	struct glist_head old_clients;
+	uint64_t MaxRead, MaxWrite;
+	int errcnt;
+	char perms[1024];
+
+	errcnt = validate_export(export, err_type);
+	if (errcnt)
+		return errcnt;
+
+	live = get_gsh_export(export->export_id);
+	if (live == NULL) {
+		LogCrit(COMPONENT_CONFIG,
+			"Export %d went away while being updated",
+			export->export_id);
+		err_type->invalid = true;
+		return 1;
+	}
+
+	/* Same limits as fsal_commit applies to a new export */
+	MaxRead = live->fsal_export->ops->fs_maxread(live->fsal_export);
+	MaxWrite = live->fsal_export->ops->fs_maxwrite(live->fsal_export);
+	if (export->MaxRead > MaxRead && MaxRead != 0)
+		export->MaxRead = MaxRead;
+	if (export->MaxWrite > MaxWrite && MaxWrite != 0)
+		export->MaxWrite = MaxWrite;
+	if ((export->options_set & EXPORT_OPTION_EXPIRE_SET) == 0)
+		export->expire_time_attr = cache_param.expire_time_attr;
+
+	PTHREAD_RWLOCK_wrlock(&live->lock);
+
+	glist_init(&old_clients);
+	glist_splice_tail(&old_clients, &live->clients);
+	glist_splice_tail(&live->clients, &export->clients);
+	glist_splice_tail(&export->clients, &old_clients);
+
+	live->export_perms = export->export_perms;
+	live->MaxRead = export->MaxRead;
+	live->MaxWrite = export->MaxWrite;
+	live->PrefRead = export->PrefRead;
+	live->PrefWrite = export->PrefWrite;
+	live->PrefReaddir = export->PrefReaddir;
+	live->MaxOffsetWrite = export->MaxOffsetWrite;
+	live->MaxOffsetRead = export->MaxOffsetRead;
+	live->filesystem_id = export->filesystem_id;
+	live->options = export->options;
+	live->options_set = export->options_set;
+	live->expire_time_attr = export->expire_time_attr;
+	live->write_gather_delay = export->write_gather_delay;
+	live->qos_weight = export->qos_weight;
+	live->qos_ops_limit = export->qos_ops_limit;
+	live->qos_bytes_limit = export->qos_bytes_limit;
+	live->config_hash = config_node_hash(node, NULL);
+
+	PTHREAD_RWLOCK_unlock(&live->lock);
+
+	StrExportOptions(&live->export_perms, perms);
+
+	LogEvent(COMPONENT_CONFIG,
+		 "Export %d updated at pseudo (%s) with path (%s) and tag (%s) perms (%s)",
+		 live->export_id, live->pseudopath,
+		 live->fullpath, live->FS_tag, perms);
+
+	put_gsh_export(live);
+	free_export(export);
+	return 0;
+}
+
 /**
  * @brief Initialize an EXPORT_DEFAULTS block
  *
@@ -912,8 +1182,13 @@ err_out:
 
 static void *export_defaults_init(void *link_mem, void *self_struct)
 {
-	if (self_struct == NULL)
-		return &export_opt;
+	/* The block is parsed into the caller's copy of the defaults,
+	 * passed to load_config_from_parse, see load_export_defaults.
+	 */
+	if (link_mem == NULL)
+		return self_struct;
+	else if (self_struct == NULL)
+		return link_mem;
 	else
 		return NULL;
 }
@@ -1132,48 +1407,83 @@ static struct config_item fsal_params[] = {
  * are processed.
  */
 
+#define CONF_EXPORT_PARAMS						\
+	CONF_MAND_UI16("Export_id", 0, UINT16_MAX, 1,			\
+		       gsh_export, export_id),				\
+	CONF_MAND_PATH("Path", 1, MAXPATHLEN, NULL,			\
+		       gsh_export, fullpath), /* must chomp '/' */	\
+	CONF_UNIQ_PATH("Pseudo", 1, MAXPATHLEN, NULL,			\
+		       gsh_export, pseudopath),				\
+	CONF_ITEM_UI64("MaxRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,	\
+		       gsh_export, MaxRead),				\
+	CONF_ITEM_UI64("MaxWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,	\
+		       gsh_export, MaxWrite),				\
+	CONF_ITEM_UI64("PrefRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,	\
+		       gsh_export, PrefRead),				\
+	CONF_ITEM_UI64("PrefWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,\
+		       gsh_export, PrefWrite),				\
+	CONF_ITEM_UI64("PrefReaddir", 512, FSAL_MAXIOSIZE, 16384,	\
+		       gsh_export, PrefReaddir),			\
+	CONF_ITEM_FSID_SET("Filesystem_id", 666, 666,			\
+		       gsh_export, filesystem_id, /* major.minor */	\
+		       EXPORT_OPTION_FSID_SET, options_set),		\
+	CONF_ITEM_STR("Tag", 1, MAXPATHLEN, NULL,			\
+		      gsh_export, FS_tag),				\
+	CONF_ITEM_UI64("MaxOffsetWrite", 512, UINT64_MAX, UINT64_MAX,	\
+		       gsh_export, MaxOffsetWrite),			\
+	CONF_ITEM_UI64("MaxOffsetRead", 512, UINT64_MAX, UINT64_MAX,	\
+		       gsh_export, MaxOffsetRead),			\
+	CONF_ITEM_BOOLBIT_SET("UseCookieVerifier",			\
+		true, EXPORT_OPTION_USE_COOKIE_VERIFIER,		\
+		gsh_export, options, options_set),			\
+	CONF_ITEM_BOOLBIT_SET("Parallel_Compound",			\
+		false, EXPORT_OPTION_PARALLEL_COMPOUND,			\
+		gsh_export, options, options_set),			\
+	CONF_ITEM_BOOLBIT_SET("Write_Gather",				\
+		false, EXPORT_OPTION_WRITE_GATHER,			\
+		gsh_export, options, options_set),			\
+	CONF_ITEM_UI32("Write_Gather_Delay", 0, 100000, 0,		\
+		       gsh_export, write_gather_delay),			\
+	CONF_ITEM_UI32("QoS_Weight", 1, 1000, 1,			\
+		       gsh_export, qos_weight),				\
+	CONF_ITEM_UI64("QoS_Ops_Limit", 0, UINT32_MAX, 0,		\
+		       gsh_export, qos_ops_limit),			\
+	CONF_ITEM_UI64("QoS_Bytes_Limit", 0, UINT64_MAX, 0,		\
+		       gsh_export, qos_bytes_limit),			\
+	CONF_ITEM_BOOLBIT_SET("Data_Cache",				\
+		false, EXPORT_OPTION_DATA_CACHE,			\
+		gsh_export, options, options_set),			\
+	CONF_EXPORT_PERMS(gsh_export, export_perms),			\
+	CONF_ITEM_I32_SET("Attr_Expiration_Time", -1, INT32_MAX, 60,	\
+		       gsh_export, expire_time_attr,			\
+		       EXPORT_OPTION_EXPIRE_SET,  options_set),		\
+	CONF_ITEM_BLOCK("Client", client_params,			\
+			client_init, client_commit,			\
+			gsh_export, clients)
+
 static struct config_item export_params[] = {
-	CONF_MAND_UI16("Export_id", 0, UINT16_MAX, 1,
-		       gsh_export, export_id),
-	CONF_MAND_PATH("Path", 1, MAXPATHLEN, NULL,
-		       gsh_export, fullpath), /* must chomp '/' */
-	CONF_UNIQ_PATH("Pseudo", 1, MAXPATHLEN, NULL,
-		       gsh_export, pseudopath),
-	CONF_ITEM_UI64("MaxRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, MaxRead),
-	CONF_ITEM_UI64("MaxWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, MaxWrite),
-	CONF_ITEM_UI64("PrefRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, PrefRead),
-	CONF_ITEM_UI64("PrefWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, PrefWrite),
-	CONF_ITEM_UI64("PrefReaddir", 512, FSAL_MAXIOSIZE, 16384,
-		       gsh_export, PrefReaddir),
-	CONF_ITEM_FSID_SET("Filesystem_id", 666, 666,
-		       gsh_export, filesystem_id, /* major.minor */
-		       EXPORT_OPTION_FSID_SET, options_set),
-	CONF_ITEM_STR("Tag", 1, MAXPATHLEN, NULL,
-		      gsh_export, FS_tag),
-	CONF_ITEM_UI64("MaxOffsetWrite", 512, UINT64_MAX, UINT64_MAX,
-		       gsh_export, MaxOffsetWrite),
-	CONF_ITEM_UI64("MaxOffsetRead", 512, UINT64_MAX, UINT64_MAX,
-		       gsh_export, MaxOffsetRead),
-	CONF_ITEM_BOOLBIT_SET("UseCookieVerifier",
-		true, EXPORT_OPTION_USE_COOKIE_VERIFIER,
-		gsh_export, options, options_set),
-	CONF_EXPORT_PERMS(gsh_export, export_perms),
-	CONF_ITEM_BLOCK("Client", client_params,
-			client_init, client_commit,
-			gsh_export, clients),
-	CONF_ITEM_I32_SET("Attr_Expiration_Time", -1, INT32_MAX, 60,
-		       gsh_export, expire_time_attr,
-		       EXPORT_OPTION_EXPIRE_SET,  options_set),
+	CONF_EXPORT_PARAMS,
 	CONF_RELAX_BLOCK("FSAL", fsal_params,
 			 fsal_init, fsal_commit,
 			 gsh_export, fsal_export),
 	CONFIG_EOL
 };
 
+/**
+ * @brief Table of EXPORT block parameters for an in place update
+ *
+ * The FSAL sub-block is only checked, the live export keeps its
+ * FSAL export.
+ */
+
+static struct config_item update_export_params[] = {
+	CONF_EXPORT_PARAMS,
+	CONF_RELAX_BLOCK("FSAL", fsal_params,
+			 fsal_init, fsal_update_commit,
+			 gsh_export, fsal_export),
+	CONFIG_EOL
+};
+
 /**
  * @brief Top level definition for an EXPORT block
  */
@@ -1202,6 +1512,35 @@ struct config_block add_export_param = {
 	.blk_desc.u.blk.display = export_display
 };
 
+/**
+ * @brief Top level definition for an EXPORT block replaced by reload
+ */
+
+static struct config_block replace_export_param = {
+	.dbus_interface_name = "org.ganesha.nfsd.config.%d",
+	.blk_desc.name = "EXPORT",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.u.blk.init = export_init,
+	.blk_desc.u.blk.params = export_params,
+	.blk_desc.u.blk.commit = replace_export_commit,
+	.blk_desc.u.blk.display = export_display
+};
+
+/**
+ * @brief Top level definition for an EXPORT block updated by reload
+ *
+ * There is no display, the block is released by the commit.
+ */
+
+static struct config_block update_export_param = {
+	.dbus_interface_name = "org.ganesha.nfsd.config.%d",
+	.blk_desc.name = "EXPORT",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.u.blk.init = export_init,
+	.blk_desc.u.blk.params = update_export_params,
+	.blk_desc.u.blk.commit = update_export_commit
+};
+
 
 /**
  * @brief Top level definition for an EXPORT_DEFAULTS block
@@ -1276,6 +1615,7 @@ static int build_default_root(void)
 	export->PrefWrite = FSAL_MAXIOSIZE;
 	export->PrefRead = FSAL_MAXIOSIZE;
 	export->PrefReaddir = 16384;
+	export->qos_weight = 1;
 	glist_init(&export->exp_state_list);
 	glist_init(&export->exp_lock_list);
 	glist_init(&export->exp_nlm_share_list);
@@ -1364,9 +1704,265 @@ err_out:
 	return -1;
 }
 
+/**
+ * @brief A batch of export setup jobs run at startup
+ *
+ * Creating exports and looking up their roots is mostly waiting on
+ * the FSALs (mounting a cluster filesystem, walking a path on a slow
+ * server), so with many exports the jobs are spread over a transient
+ * fridge instead of being done one after the other.
+ */
+
+struct export_init_batch {
+	const char *what;	/*< Name of the step, for the logs */
+	bool (*fn)(void *item, struct config_error_type *err_type,
+		   int *export_id);	/*< Does one job */
+	pthread_mutex_t mtx;	/*< Protects the fields below */
+	pthread_cond_t cv;	/*< Signalled when pending drops to 0 */
+	int pending;		/*< Jobs submitted and not done */
+	int done;		/*< Jobs that succeeded */
+	nsecs_elapsed_t slowest;	/*< Longest single job */
+	int slowest_id;		/*< Export_Id of that job */
+	struct config_error_type err_type;	/*< Errors of all jobs */
+};
+
+/**
+ * @brief One job of a batch
+ */
+
+struct export_init_job {
+	struct export_init_batch *batch;
+	void *item;
+};
+
+/**
+ * @brief Run and time one job, accounting for it in the batch
+ */
+
+static void export_init_one(struct export_init_batch *batch, void *item)
+{
+	struct config_error_type err_type;
+	struct timespec start, end;
+	nsecs_elapsed_t elapsed;
+	int export_id = -1;
+	bool ok;
+
+	clear_error_type(&err_type);
+	now(&start);
+	ok = batch->fn(item, &err_type, &export_id);
+	now(&end);
+	elapsed = timespec_diff(&start, &end);
+
+	LogDebug(COMPONENT_CONFIG,
+		 "%s for export %d took %" PRIu64 " us%s",
+		 batch->what, export_id, elapsed / NS_PER_USEC,
+		 ok ? "" : " and failed");
+
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	if (ok)
+		batch->done++;
+	if (elapsed > batch->slowest) {
+		batch->slowest = elapsed;
+		batch->slowest_id = export_id;
+	}
+	config_error_comb_errors(&batch->err_type, &err_type);
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+}
+
+/**
+ * @brief Fridge side of export_init_run
+ *
+ * @param[in] ctx Thread context, holding the job
+ */
+
+static void export_init_func(struct fridgethr_context *ctx)
+{
+	struct export_init_job *job = ctx->arg;
+	struct export_init_batch *batch = job->batch;
+
+	export_init_one(batch, job->item);
+
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	if (--batch->pending == 0)
+		pthread_cond_signal(&batch->cv);
+	PTHREAD_MUTEX_unlock(&batch->mtx);
+}
+
+/**
+ * @brief Run a step of export setup over a set of items
+ *
+ * Uses up to Export_Init_Threads threads, or the calling thread
+ * alone when that is 1 or there is a single item.
+ *
+ * @param[in]  what     Name of the step, for the logs
+ * @param[in]  fn       Does the step for one item
+ * @param[in]  items    The items
+ * @param[in]  count    Number of items
+ * @param[out] err_type Errors of all the items, may be NULL
+ *
+ * @return Number of items for which fn succeeded.
+ */
+
+static int export_init_run(const char *what,
+			   bool (*fn)(void *item,
+				      struct config_error_type *err_type,
+				      int *export_id),
+			   void **items, int count,
+			   struct config_error_type *err_type)
+{
+	struct export_init_batch batch;
+	struct export_init_job *jobs = NULL;
+	struct fridgethr *fr = NULL;
+	struct fridgethr_params frp;
+	struct timespec start, end;
+	int threads = nfs_param.core_param.export_init_threads;
+	int i, rc;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.what = what;
+	batch.fn = fn;
+	batch.slowest_id = -1;
+	pthread_mutex_init(&batch.mtx, NULL);
+	pthread_cond_init(&batch.cv, NULL);
+
+	now(&start);
+	if (threads > count)
+		threads = count;
+	if (threads > 1)
+		jobs = gsh_calloc(count, sizeof(struct export_init_job));
+	if (jobs != NULL) {
+		memset(&frp, 0, sizeof(struct fridgethr_params));
+		frp.thr_max = threads;
+		frp.thr_min = 0;
+		frp.thread_delay = 60;
+		frp.flavor = fridgethr_flavor_worker;
+		frp.deferment = fridgethr_defer_queue;
+
+		rc = fridgethr_init(&fr, "Export Init", &frp);
+		if (rc != 0) {
+			LogMajor(COMPONENT_CONFIG,
+				 "Unable to initialize export init fridge, error code %d, going serial.",
+				 rc);
+			fr = NULL;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (fr != NULL) {
+			jobs[i].batch = &batch;
+			jobs[i].item = items[i];
+
+			PTHREAD_MUTEX_lock(&batch.mtx);
+			batch.pending++;
+			PTHREAD_MUTEX_unlock(&batch.mtx);
+
+			if (fridgethr_submit(fr, export_init_func,
+					     &jobs[i]) == 0)
+				continue;
+
+			PTHREAD_MUTEX_lock(&batch.mtx);
+			batch.pending--;
+			PTHREAD_MUTEX_unlock(&batch.mtx);
+		}
+		export_init_one(&batch, items[i]);
+	}
+
+	if (fr != NULL) {
+		PTHREAD_MUTEX_lock(&batch.mtx);
+		while (batch.pending != 0)
+			pthread_cond_wait(&batch.cv, &batch.mtx);
+		PTHREAD_MUTEX_unlock(&batch.mtx);
+
+		rc = fridgethr_sync_command(fr, fridgethr_comm_stop, 120);
+		if (rc == ETIMEDOUT) {
+			LogMajor(COMPONENT_CONFIG,
+				 "Shutdown timed out, cancelling threads.");
+			fridgethr_cancel(fr);
+		} else if (rc != 0) {
+			LogMajor(COMPONENT_CONFIG,
+				 "Failed shutting down export init fridge: %d",
+				 rc);
+		}
+	}
+	now(&end);
+
+	LogEvent(COMPONENT_CONFIG,
+		 "%s: %d of %d exports in %" PRIu64
+		 " ms using %d threads, slowest was export %d at %" PRIu64
+		 " ms",
+		 what, batch.done, count,
+		 timespec_diff(&start, &end) / NS_PER_MSEC,
+		 fr != NULL ? threads : 1,
+		 batch.slowest_id, batch.slowest / NS_PER_MSEC);
+
+	if (err_type != NULL)
+		config_error_comb_errors(err_type, &batch.err_type);
+	if (jobs != NULL)
+		gsh_free(jobs);
+	pthread_cond_destroy(&batch.cv);
+	pthread_mutex_destroy(&batch.mtx);
+	return batch.done;
+}
+
+/**
+ * @brief Create the export of one EXPORT block
+ */
+
+static bool export_create_one(void *item, struct config_error_type *err_type,
+			      int *export_id)
+{
+	const char *id_str = config_node_value(item, "Export_Id");
+
+	if (id_str != NULL)
+		*export_id = strtol(id_str, NULL, 0);
+
+	(void) load_config_from_node(item,
+				     &export_param,
+				     NULL,
+				     false,
+				     err_type);
+	return config_error_is_harmless(err_type);
+}
+
+/**
+ * @brief Load the EXPORT_DEFAULTS block
+ *
+ * The block is parsed into a copy which replaces the live defaults
+ * only if it is good.  export_check_access reads them at any time, a
+ * reload must not let it see a half parsed block.
+ *
+ * @param[in]  in_config The parsed configuration
+ * @param[out] err_type  Errors found
+ */
+
+static void load_export_defaults(config_file_t in_config,
+				 struct config_error_type *err_type)
+{
+	struct global_export_perms defaults;
+
+	memset(&defaults, 0, sizeof(defaults));
+
+	(void) load_config_from_parse(in_config,
+				      &export_defaults_param,
+				      &defaults,
+				      false,
+				      err_type);
+	if (!config_error_is_harmless(err_type))
+		return;
+
+	PTHREAD_RWLOCK_wrlock(&export_opt_lock);
+	export_opt.conf = defaults.conf;
+	PTHREAD_RWLOCK_unlock(&export_opt_lock);
+}
+
 /**
  * @brief Read the export entries from the parsed configuration file.
  *
+ * EXPORT blocks are created in parallel, see export_init_run.  A
+ * block repeating the Export_Id of an earlier block is held back
+ * until the others are done, so that as with serial processing the
+ * first one in the file wins.
+ *
  * @param[in]  in_config    The file that contains the export list
  *
  * @return A negative value on error,
@@ -1375,24 +1971,81 @@ err_out:
 
 int ReadExports(config_file_t in_config)
 {
+	struct config_node_list *config_list = NULL, *lp, *lp_next;
 	struct config_error_type err_type;
-	int rc, ret = 0;
+	void **nodes = NULL;
+	const char **ids = NULL;
+	int count = 0, first = 0, late;
+	int i, j, rc, ret = 0;
 
-	rc = load_config_from_parse(in_config,
-				    &export_defaults_param,
-				    NULL,
-				    false,
-				    &err_type);
+	load_export_defaults(in_config, &err_type);
 	if (!config_error_is_harmless(&err_type))
 		return -1;
 
-	rc = load_config_from_parse(in_config,
-				    &export_param,
-				    NULL,
-				    false,
-				    &err_type);
+	rc = find_config_nodes(in_config, "EXPORT", &config_list);
+	if (rc == 0) {
+		for (lp = config_list; lp != NULL; lp = lp->next)
+			count++;
+		nodes = gsh_calloc(count, sizeof(void *));
+		ids = gsh_calloc(count, sizeof(char *));
+	}
+
+	if (nodes == NULL || ids == NULL ||
+	    count < 2 || nfs_param.core_param.export_init_threads < 2) {
+		rc = load_config_from_parse(in_config,
+					    &export_param,
+					    NULL,
+					    false,
+					    &err_type);
+	} else {
+		/* Unique ids first, in file order, then the repeats */
+		late = count;
+		for (lp = config_list; lp != NULL; lp = lp->next) {
+			const char *id = config_node_value(lp->tree_node,
+							   "Export_Id");
+
+			for (j = 0; id != NULL && j < first; j++)
+				if (ids[j] != NULL && strcmp(ids[j], id) == 0)
+					break;
+			if (id != NULL && j < first) {
+				nodes[--late] = lp->tree_node;
+				continue;
+			}
+			ids[first] = id;
+			nodes[first++] = lp->tree_node;
+		}
+		/* The repeats were filled from the end, restore order */
+		for (i = late, j = count - 1; i < j; i++, j--) {
+			void *tmp = nodes[i];
+
+			nodes[i] = nodes[j];
+			nodes[j] = tmp;
+		}
+
+		clear_error_type(&err_type);
+		rc = export_init_run("Export creation", export_create_one,
+				     nodes, first, &err_type);
+		for (i = late; i < count; i++) {
+			struct config_error_type blk_err;
+			int export_id;
+
+			if (export_create_one(nodes[i], &blk_err, &export_id))
+				rc++;
+			config_error_comb_errors(&err_type, &blk_err);
+		}
+	}
+
+	for (lp = config_list; lp != NULL; lp = lp_next) {
+		lp_next = lp->next;
+		gsh_free(lp);
+	}
+	if (nodes != NULL)
+		gsh_free(nodes);
+	if (ids != NULL)
+		gsh_free(ids);
 	if (!config_error_is_harmless(&err_type))
 		return -1;
+
 	ret = build_default_root();
 	if (ret < 0) {
 		LogCrit(COMPONENT_CONFIG,
@@ -1402,6 +2055,305 @@ int ReadExports(config_file_t in_config)
 	return rc + ret;
 }
 
+/**
+ * @brief An EXPORT block of the configuration being reloaded
+ */
+
+struct reload_node {
+	uint16_t export_id;	/*< Export_Id of the block */
+	void *tree_node;	/*< The block in the parse tree */
+};
+
+/**
+ * @brief Reload state, live exports missing from the new configuration
+ */
+
+struct reload_state {
+	struct reload_node *nodes;	/*< New blocks, sorted by id */
+	int node_count;
+	uint16_t *removed;		/*< Ids of exports to remove */
+	int removed_count;
+	int removed_size;		/*< Ids allocated in removed */
+	bool nomem;			/*< removed could not grow */
+};
+
+static int reload_node_cmpf(const void *a, const void *b)
+{
+	const struct reload_node *lk = a;
+	const struct reload_node *rk = b;
+
+	return (int)lk->export_id - (int)rk->export_id;
+}
+
+/**
+ * @brief Collect the live exports that are not in the new configuration
+ *
+ * Export 0 is left alone, it may be the default pseudo root.  The id
+ * array grows as needed since exports may be added over DBus at any
+ * time.
+ */
+
+static bool reload_removed_cb(struct gsh_export *export, void *state)
+{
+	struct reload_state *rs = state;
+	struct reload_node key;
+	uint16_t *removed;
+	int size;
+
+	key.export_id = export->export_id;
+	if (export->export_id == 0 ||
+	    bsearch(&key, rs->nodes, rs->node_count,
+		    sizeof(struct reload_node), reload_node_cmpf) != NULL)
+		return true;
+
+	if (rs->removed_count == rs->removed_size) {
+		size = rs->removed_size == 0 ? 16 : rs->removed_size * 2;
+		removed = gsh_realloc(rs->removed, size * sizeof(uint16_t));
+		if (removed == NULL) {
+			rs->nomem = true;
+			return false;
+		}
+		rs->removed = removed;
+		rs->removed_size = size;
+	}
+
+	rs->removed[rs->removed_count++] = export->export_id;
+	return true;
+}
+
+/**
+ * @brief Compare a string parameter of a block with a live value
+ */
+
+static bool reload_same_str(void *tree_node, const char *name,
+			    const char *value, bool is_path)
+{
+	const char *new_value = config_node_value(tree_node, name);
+	size_t len;
+
+	if (new_value == NULL || value == NULL)
+		return new_value == value;
+
+	/* fsal_commit chomps trailing '/' off the Path */
+	len = strlen(new_value);
+	if (is_path && new_value[0] == '/')
+		while (len > 1 && new_value[len - 1] == '/')
+			len--;
+	return strlen(value) == len && strncmp(value, new_value, len) == 0;
+}
+
+/**
+ * @brief Reload one EXPORT block against the live export with its id
+ *
+ * @return -1 on error, 0 if unchanged, 1 if updated in place,
+ *         2 if the export was added or replaced.
+ */
+
+static int reload_one_export(struct reload_node *rn,
+			     struct config_error_type *err_type)
+{
+	struct gsh_export *live;
+	bool in_place;
+	int rc;
+
+	live = get_gsh_export(rn->export_id);
+	if (live == NULL)
+		goto add;
+
+	if (live->config_hash == config_node_hash(rn->tree_node, NULL)) {
+		put_gsh_export(live);
+		return 0;
+	}
+
+	in_place = live->fsal_config_hash ==
+			config_node_hash(rn->tree_node, "FSAL") &&
+		reload_same_str(rn->tree_node, "Path", live->fullpath, true) &&
+		reload_same_str(rn->tree_node, "Pseudo", live->pseudopath,
+				false) &&
+		reload_same_str(rn->tree_node, "Tag", live->FS_tag, false);
+
+	if (in_place) {
+		put_gsh_export(live);
+		rc = load_config_from_node(rn->tree_node,
+					   &update_export_param,
+					   NULL,
+					   false,
+					   err_type);
+		return rc == 0 ? 1 : -1;
+	}
+
+	if (rn->export_id == 0) {
+		LogWarn(COMPONENT_CONFIG,
+			"Export 0 (the pseudo root) can only have its options and clients changed by reload");
+		put_gsh_export(live);
+		return -1;
+	}
+
+	LogInfo(COMPONENT_CONFIG,
+		"Export %d changed path, pseudo path, tag or FSAL, replacing",
+		rn->export_id);
+	put_gsh_export(live);
+
+	rc = load_config_from_node(rn->tree_node,
+				   &replace_export_param,
+				   NULL,
+				   false,
+				   err_type);
+	return rc == 0 ? 2 : -1;
+
+add:
+	rc = load_config_from_node(rn->tree_node,
+				   &add_export_param,
+				   NULL,
+				   false,
+				   err_type);
+	return rc == 0 ? 2 : -1;
+}
+
+/**
+ * @brief Apply a new configuration to the live export set
+ *
+ * The EXPORT blocks of the parsed configuration are indexed by
+ * Export_Id and compared with the live exports.  Exports that are no
+ * longer configured are removed, new ones are added, and changed ones
+ * are updated.  Exports whose block did not change at all are not
+ * touched, so only a fingerprint of their block is computed.
+ *
+ * An export whose path, pseudo path, tag and FSAL sub-block are
+ * unchanged is updated in place (options and client list), keeping
+ * its state and cache.  Otherwise a new export is built from the
+ * block and replaces the live one once it is complete; if it can't
+ * be built, the live export stays.
+ *
+ * @param[in]  in_config The parsed configuration
+ * @param[out] err_type  Accumulated errors
+ *
+ * @return -1 on error, number of exports added, updated or removed
+ *         otherwise.
+ */
+
+int ReloadExports(config_file_t in_config, struct config_error_type *err_type)
+{
+	struct config_node_list *config_list = NULL, *lp, *lp_next;
+	struct config_error_type blk_err;
+	struct reload_state rs;
+	struct gsh_export *export;
+	const char *id_str;
+	char *endptr;
+	unsigned long id;
+	int i, rc;
+	int unchanged = 0, updated = 0, added = 0, failed = 0;
+
+	memset(&rs, 0, sizeof(rs));
+	clear_error_type(err_type);
+
+	load_export_defaults(in_config, &blk_err);
+	if (!config_error_is_harmless(&blk_err)) {
+		config_error_comb_errors(err_type, &blk_err);
+		return -1;
+	}
+
+	/* Index the new EXPORT blocks by Export_Id */
+	rc = find_config_nodes(in_config, "EXPORT", &config_list);
+	if (rc != 0 && rc != ENOENT) {
+		err_type->invalid = true;
+		return -1;
+	}
+	for (lp = config_list; lp != NULL; lp = lp->next)
+		rs.node_count++;
+	if (rs.node_count != 0) {
+		rs.nodes = gsh_calloc(rs.node_count, sizeof(*rs.nodes));
+		if (rs.nodes == NULL) {
+			err_type->resource = true;
+			rc = -1;
+			goto out;
+		}
+	}
+	for (i = 0, lp = config_list; lp != NULL; lp = lp->next) {
+		id_str = config_node_value(lp->tree_node, "Export_Id");
+		if (id_str == NULL)
+			goto bad_id;
+		errno = 0;
+		id = strtoul(id_str, &endptr, 0);
+		if (errno != 0 || *endptr != '\0' || id > UINT16_MAX)
+			goto bad_id;
+		rs.nodes[i].export_id = id;
+		rs.nodes[i].tree_node = lp->tree_node;
+		i++;
+		continue;
+bad_id:
+		LogCrit(COMPONENT_CONFIG,
+			"EXPORT block without a valid Export_Id, skipped");
+		err_type->invalid = true;
+		failed++;
+	}
+	rs.node_count = i;
+	qsort(rs.nodes, rs.node_count, sizeof(*rs.nodes), reload_node_cmpf);
+	for (i = 1; i < rs.node_count; i++) {
+		if (rs.nodes[i].export_id == rs.nodes[i - 1].export_id) {
+			LogCrit(COMPONENT_CONFIG,
+				"Duplicate export id = %d, nothing reloaded",
+				rs.nodes[i].export_id);
+			err_type->exists = true;
+			rc = -1;
+			goto out;
+		}
+	}
+
+	/* Removals first so their paths and tags are free for the rest */
+	(void) foreach_gsh_export(reload_removed_cb, &rs);
+	if (rs.nomem) {
+		err_type->resource = true;
+		rc = -1;
+		goto out;
+	}
+	for (i = 0; i < rs.removed_count; i++) {
+		export = get_gsh_export(rs.removed[i]);
+		if (export == NULL)
+			continue;
+		LogEvent(COMPONENT_CONFIG,
+			 "Export %d is no longer configured, removing",
+			 export->export_id);
+		unexport(export);
+		put_gsh_export(export);
+	}
+
+	for (i = 0; i < rs.node_count; i++) {
+		rc = reload_one_export(&rs.nodes[i], &blk_err);
+		config_error_comb_errors(err_type, &blk_err);
+		switch (rc) {
+		case 0:
+			unchanged++;
+			break;
+		case 1:
+			updated++;
+			break;
+		case 2:
+			added++;
+			break;
+		default:
+			failed++;
+			break;
+		}
+	}
+
+	LogEvent(COMPONENT_CONFIG,
+		 "Exports reloaded: %d unchanged, %d updated, %d added or replaced, %d removed, %d failed",
+		 unchanged, updated, added, rs.removed_count, failed);
+	rc = updated + added + rs.removed_count;
+
+out:
+	for (lp = config_list; lp != NULL; lp = lp_next) {
+		lp_next = lp->next;
+		gsh_free(lp);
+	}
+	if (rs.nodes != NULL)
+		gsh_free(rs.nodes);
+	if (rs.removed != NULL)
+		gsh_free(rs.removed);
+	return rc;
+}
+
 static void FreeClientList(struct glist_head *clients)
 {
 	struct glist_head *glist;
@@ -1452,23 +2404,88 @@ void free_export_resources(struct gsh_export *export)
 }
 
 /**
- * @brief pkginit callback to initialize exports from nfs_init
+ * @brief Root lookups of exports_pkginit
+ */
+
+struct export_root_list {
+	struct gsh_export **exports;
+	int count;
+	int size;
+};
+
+/**
+ * @brief pkginit callback to collect the exports to initialize
  *
  * Assumes being called with the export_by_id.lock held.
  */
 
 static bool init_export_cb(struct gsh_export *exp, void *state)
 {
-	return init_export_root(exp);
+	struct export_root_list *roots = state;
+
+	if (roots->count == roots->size)
+		return false;
+	get_gsh_export_ref(exp);
+	roots->exports[roots->count++] = exp;
+	return true;
+}
+
+/**
+ * @brief Count the exports
+ */
+
+static bool count_export_cb(struct gsh_export *exp, void *state)
+{
+	int *count = state;
+
+	(*count)++;
+	return true;
+}
+
+/**
+ * @brief Look up the root of one export
+ */
+
+static bool export_root_one(void *item, struct config_error_type *err_type,
+			    int *export_id)
+{
+	struct gsh_export *export = item;
+
+	*export_id = export->export_id;
+	return init_export_root(export);
 }
 
 /**
  * @brief Initialize exports over a live cache inode and fsal layer
+ *
+ * The root lookups are done in parallel outside the export_by_id
+ * lock, every export is attempted even if an earlier one failed.
  */
 
 void exports_pkginit(void)
 {
-	foreach_gsh_export(init_export_cb, NULL);
+	struct export_root_list roots;
+	int i;
+
+	memset(&roots, 0, sizeof(roots));
+	(void) foreach_gsh_export(count_export_cb, &roots.size);
+	if (roots.size == 0)
+		return;
+
+	roots.exports = gsh_calloc(roots.size, sizeof(struct gsh_export *));
+	if (roots.exports == NULL) {
+		LogCrit(COMPONENT_INIT,
+			"Could not allocate the export list, no export roots.");
+		return;
+	}
+	(void) foreach_gsh_export(init_export_cb, &roots);
+
+	(void) export_init_run("Export root lookup", export_root_one,
+			       (void **)roots.exports, roots.count, NULL);
+
+	for (i = 0; i < roots.count; i++)
+		put_gsh_export(roots.exports[i]);
+	gsh_free(roots.exports);
 }
 
 /**
@@ -2210,6 +3227,9 @@ void export_check_access(void)
 			    op_ctx->export->fullpath);
 	}
 
+	/* The client list and export perms may be swapped by a reload */
+	PTHREAD_RWLOCK_rdlock(&op_ctx->export->lock);
+
 	/* Does the client match anyone on the client list? */
 	client = client_match_any(hostaddr, op_ctx->export);
 	if (client != NULL) {
@@ -2251,6 +3271,8 @@ void export_check_access(void)
 	/* Any options not set by the client or export, take from the
 	 *  EXPORT_DEFAULTS block.
 	 */
+	PTHREAD_RWLOCK_rdlock(&export_opt_lock);
+
 	op_ctx->export_perms->options |= export_opt.conf.options &
 					  export_opt.conf.set &
 					  ~op_ctx->export_perms->set;
@@ -2306,4 +3328,7 @@ void export_check_access(void)
 			    "Final options   (%s)",
 			    perms);
 	}
+
+	PTHREAD_RWLOCK_unlock(&export_opt_lock);
+	PTHREAD_RWLOCK_unlock(&op_ctx->export->lock);
 }				/* nfs_export_check_access */
@@ -6,6 +6,7 @@
 #include "nfs4_acls.h"
 #include <pthread.h>
 #include "city.h"
+#include "abstract_atomic.h"
 
 pool_t *fsal_acl_pool;
 
@@ -82,11 +83,22 @@ void nfs4_ace_free(fsal_ace_t *ace)
 	gsh_free(ace);
 }
 
+static void nfs4_acl_compiled_free(struct fsal_acl_compiled *cacl)
+{
+	pthread_rwlock_destroy(&cacl->lock);
+	gsh_free(cacl->aces[0]);
+	gsh_free(cacl->gids);
+	gsh_free(cacl);
+}
+
 static void nfs4_acl_free(fsal_acl_t *acl)
 {
 	if (!acl)
 		return;
 
+	if (acl->compiled)
+		nfs4_acl_compiled_free(acl->compiled);
+
 	if (acl->aces)
 		nfs4_ace_free(acl->aces);
 
@@ -164,6 +176,7 @@ fsal_acl_t *nfs4_acl_new_entry(fsal_acl_data_t *acldata,
 	acl->naces = acldata->naces;
 	acl->aces = acldata->aces;
 	acl->ref = 1;		/* We give out one reference */
+	acl->compiled = NULL;
 
 	/* Build the value */
 	value.addr = acl;
@@ -256,6 +269,152 @@ void nfs4_acl_release_entry(fsal_acl_t *acl, fsal_acl_status_t *status)
 	nfs4_acl_free(acl);
 }
 
+static int nfs4_acl_gid_cmp(const void *a, const void *b)
+{
+	gid_t ga = *(const gid_t *)a;
+	gid_t gb = *(const gid_t *)b;
+
+	return ga < gb ? -1 : ga > gb ? 1 : 0;
+}
+
+/**
+ * @brief Build the compiled form of an ACL
+ *
+ * @param[in] acl The ACL
+ *
+ * @return The compiled ACL, NULL if it can't or shouldn't be compiled.
+ */
+static struct fsal_acl_compiled *nfs4_acl_compile(fsal_acl_t *acl)
+{
+	struct fsal_acl_compiled *cacl;
+	struct fsal_acl_cace *cace;
+	fsal_ace_t *pace;
+	gid_t *gid;
+	uint32_t ngids = 0;
+	int i;
+
+	for (pace = acl->aces; pace < acl->aces + acl->naces; pace++)
+		if (!IS_FSAL_ACE_SPECIAL_ID(*pace) &&
+		    IS_FSAL_ACE_GROUP_ID(*pace))
+			ngids++;
+
+	if (ngids > FSAL_ACL_COMPILED_MAX_GIDS)
+		return NULL;
+
+	cacl = gsh_calloc(1, sizeof(*cacl));
+	if (cacl == NULL)
+		return NULL;
+
+	/* One allocation holds both lists */
+	cacl->aces[0] = gsh_calloc(2 * acl->naces + 1, sizeof(*cace));
+	if (ngids != 0)
+		cacl->gids = gsh_malloc(ngids * sizeof(gid_t));
+	if (cacl->aces[0] == NULL || (ngids != 0 && cacl->gids == NULL)) {
+		gsh_free(cacl->aces[0]);
+		gsh_free(cacl->gids);
+		gsh_free(cacl);
+		return NULL;
+	}
+	cacl->aces[1] = cacl->aces[0] + acl->naces;
+
+	/* Sorted, distinct group ids */
+	for (pace = acl->aces; pace < acl->aces + acl->naces; pace++)
+		if (!IS_FSAL_ACE_SPECIAL_ID(*pace) &&
+		    IS_FSAL_ACE_GROUP_ID(*pace))
+			cacl->gids[cacl->ngids++] = pace->who.gid;
+	if (cacl->ngids != 0) {
+		qsort(cacl->gids, cacl->ngids, sizeof(gid_t),
+		      nfs4_acl_gid_cmp);
+		for (ngids = 1, i = 1; i < cacl->ngids; i++)
+			if (cacl->gids[i] != cacl->gids[ngids - 1])
+				cacl->gids[ngids++] = cacl->gids[i];
+		cacl->ngids = ngids;
+	}
+
+	for (pace = acl->aces; pace < acl->aces + acl->naces; pace++) {
+		struct fsal_acl_cace reduced;
+
+		if (!IS_FSAL_ACE_ALLOW(*pace) && !IS_FSAL_ACE_DENY(*pace))
+			continue;
+		if (IS_FSAL_ACE_INHERIT_ONLY(*pace))
+			continue;
+
+		reduced.perm = pace->perm;
+		reduced.allow = IS_FSAL_ACE_ALLOW(*pace);
+		reduced.id = 0;
+
+		if (IS_FSAL_ACE_SPECIAL_ID(*pace)) {
+			switch (pace->who.uid) {
+			case FSAL_ACE_SPECIAL_OWNER:
+				reduced.who = FSAL_ACL_WHO_OWNER;
+				break;
+			case FSAL_ACE_SPECIAL_GROUP:
+				reduced.who = FSAL_ACL_WHO_GROUP;
+				break;
+			case FSAL_ACE_SPECIAL_EVERYONE:
+				reduced.who = FSAL_ACL_WHO_EVERYONE;
+				break;
+			default:
+				/* Never matches anyone */
+				continue;
+			}
+		} else if (IS_FSAL_ACE_GROUP_ID(*pace)) {
+			reduced.who = FSAL_ACL_WHO_GID;
+			gid = bsearch(&pace->who.gid, cacl->gids, cacl->ngids,
+				      sizeof(gid_t), nfs4_acl_gid_cmp);
+			reduced.id = gid - cacl->gids;
+		} else {
+			reduced.who = FSAL_ACL_WHO_UID;
+			reduced.id = pace->who.uid;
+		}
+
+		for (i = 0; i < 2; i++) {
+			if (i == 0 ? !IS_FSAL_FILE_APPLICABLE(*pace)
+				   : !IS_FSAL_DIR_APPLICABLE(*pace))
+				continue;
+			cace = &cacl->aces[i][cacl->naces[i]++];
+			*cace = reduced;
+			cacl->perms[i] |= reduced.perm;
+		}
+	}
+
+	if (pthread_rwlock_init(&cacl->lock, NULL) != 0) {
+		gsh_free(cacl->aces[0]);
+		gsh_free(cacl->gids);
+		gsh_free(cacl);
+		return NULL;
+	}
+
+	return cacl;
+}
+
+/**
+ * @brief Get the compiled form of an ACL, building it if needed
+ *
+ * @param[in] acl The ACL
+ *
+ * @return The compiled ACL, NULL if the ACEs have to be walked.
+ */
+struct fsal_acl_compiled *nfs4_acl_compiled(fsal_acl_t *acl)
+{
+	struct fsal_acl_compiled *cacl;
+
+	cacl = atomic_fetch_voidptr((void **)&acl->compiled);
+	if (cacl != NULL)
+		return cacl;
+
+	PTHREAD_RWLOCK_wrlock(&acl->lock);
+	if (acl->compiled == NULL) {
+		cacl = nfs4_acl_compile(acl);
+		if (cacl != NULL)
+			atomic_store_voidptr((void **)&acl->compiled, cacl);
+	} else
+		cacl = acl->compiled;
+	PTHREAD_RWLOCK_unlock(&acl->lock);
+
+	return cacl;
+}
+
 static void nfs4_acls_test()
 {
 	int i = 0;
@@ -135,6 +135,10 @@ static struct config_item core_params[] = {
 		       nfs_core_param, rpc.max_recv_buffer_size),
 	CONF_ITEM_UI32("RPC_Ioq_ThrdMax", 1, 1024*128, 200,
 		       nfs_core_param, rpc.ioq_thrd_max),
+	CONF_ITEM_UI32("RPC_Event_Channels", 0, 256, 0,
+		       nfs_core_param, rpc.event_channels),
+	CONF_ITEM_BOOL("RPC_Event_Rebalance", false,
+		       nfs_core_param, rpc.event_rebalance),
 	CONF_ITEM_I64("Decoder_Fridge_Expiration_Delay", 0, 7200, 600,
 		      nfs_core_param, decoder_fridge_expiration_delay),
 	CONF_ITEM_I64("Decoder_Fridge_Block_Timeout", 0, 7200, 600,
@@ -151,6 +155,23 @@ static struct config_item core_params[] = {
 		       nfs_core_param, enable_RQUOTA),
 	CONF_ITEM_BOOL("Enable_Fast_Stats", false,
 		       nfs_core_param, enable_FASTSTATS),
+	CONF_ITEM_UI64("Buffer_Pool_Size", 0, 64LL*1024*1024*1024,
+		       256*1024*1024,
+		       nfs_core_param, buffer_pool_size),
+	CONF_ITEM_BOOL("Buffer_Pool_Huge_Pages", false,
+		       nfs_core_param, buffer_pool_hugepages),
+	CONF_ITEM_BOOL("Slab_Huge_Pages", false,
+		       nfs_core_param, slab_hugepages),
+	CONF_ITEM_UI32("Export_Init_Threads", 1, 256, 8,
+		       nfs_core_param, export_init_threads),
+	CONF_ITEM_BOOL("Enable_QoS", false,
+		       nfs_core_param, enable_qos),
+	CONF_ITEM_UI32("QoS_Quantum", 1, 1024, 4,
+		       nfs_core_param, qos_quantum),
+	CONF_ITEM_UI64("QoS_Client_Ops_Limit", 0, UINT32_MAX, 0,
+		       nfs_core_param, qos_client_ops_limit),
+	CONF_ITEM_UI64("QoS_Client_Bytes_Limit", 0, UINT64_MAX, 0,
+		       nfs_core_param, qos_client_bytes_limit),
 	CONF_ITEM_I64("Manage_Gids_Expiration", 0, 7*24*60*60, 30*60,
 			nfs_core_param, manage_gids_expiration),
 	CONF_ITEM_PATH("Plugins_Dir", 1, MAXPATHLEN, FSAL_MODULE_LOC,
@@ -202,6 +223,16 @@ struct config_block krb5_param = {
 #define GETPWNAMDEF true
 #endif
 
+/**
+ * @brief NFSv4 recovery backends
+ */
+
+static struct config_item_list recovery_backends[] = {
+	CONFIG_LIST_TOK("fs", RECOVERY_BACKEND_FS),
+	CONFIG_LIST_TOK("log", RECOVERY_BACKEND_LOG),
+	CONFIG_LIST_EOL
+};
+
 /**
  * @brief NFSv4 specific parameters
  */
@@ -225,6 +256,15 @@ static struct config_item version4_params[] = {
 		       nfs_version4_parameter, allow_numeric_owners),
 	CONF_ITEM_BOOL("Delegations", false,
 		       nfs_version4_parameter, allow_delegations),
+	CONF_ITEM_ENUM("RecoveryBackend", RECOVERY_BACKEND_FS,
+		       recovery_backends,
+		       nfs_version4_parameter, recovery_backend),
+	CONF_ITEM_UI32("Compound_Threads", 0, 1024, 16,
+		       nfs_version4_parameter, compound_threads),
+	CONF_ITEM_UI32("Layout_Recall_Window", 1, 4096, 64,
+		       nfs_version4_parameter, layout_recall_window),
+	CONF_ITEM_UI32("Layout_Recall_Batch", 1, 16, 8,
+		       nfs_version4_parameter, layout_recall_batch),
 	CONFIG_EOL
 };
 
@@ -58,6 +58,11 @@
 #include "client_mgr.h"
 #include "export_mgr.h"
 #include "server_stats.h"
+#include "cache_inode_hash.h"
+#include "gsh_bufpool.h"
+#include "slab_pool.h"
+#include "nfs_rpc_qos.h"
+#include "fsal_up.h"
 #include <abstract_atomic.h>
 
 #define NFS_V3_NB_COMMAND (NFSPROC3_COMMIT + 1)
@@ -386,6 +391,10 @@ struct _9p_stats {
 		uint64_t tx_pkt;
 		uint64_t tx_err;
 	} trans;
+	struct fid_stats {
+		uint64_t fids;		/* Fids currently set */
+		uint64_t hwmark;	/* Most fids set at once */
+	} fids;
 };
 
 struct global_stats {
@@ -408,6 +417,52 @@ static struct global_stats global_st;
 struct cache_stats cache_st;
 struct cache_stats *cache_stp = &cache_st;
 
+/**
+ * @brief Parallel compound statistics
+ */
+struct compound_par_stats {
+	uint64_t compounds;	/*< Compounds split into segments */
+	uint64_t segments;	/*< Segments executed */
+	uint64_t ops;		/*< Operations executed in segments */
+	uint64_t dispatched;	/*< Segments run on a compound thread */
+};
+
+static struct compound_par_stats compound_par_st;
+
+/**
+ * @brief FSAL credential switch statistics
+ */
+struct creds_switch_stats {
+	uint64_t switches;	/*< Switches to a caller's identity */
+	uint64_t restores;	/*< Switches back to the server's identity */
+	uint64_t syscalls;	/*< Identity syscalls actually issued */
+};
+
+static struct creds_switch_stats creds_switch_st;
+
+struct write_gather_stats {
+	uint64_t batches;	/*< Batches run by a gathering leader */
+	uint64_t requests;	/*< Writes run in those batches */
+	uint64_t writes;	/*< FSAL writes they were coalesced into */
+	uint64_t commits;	/*< FSAL commits issued for them */
+};
+
+static struct write_gather_stats write_gather_st;
+
+static struct xprt_stall_stats xprt_stall_st;
+
+struct data_cache_stats {
+	uint64_t hits;		/*< READs served from cached blocks */
+	uint64_t misses;	/*< Cacheable READs that were not */
+	uint64_t fills;		/*< Blocks cached for READs */
+	uint64_t readahead;	/*< Blocks cached ahead of READs */
+	uint64_t bytes;		/*< Bytes cached */
+	uint64_t evicted;	/*< Blocks dropped for space */
+	uint64_t wasted;	/*< Blocks read ahead never used */
+};
+
+static struct data_cache_stats data_cache_st;
+
 /* include the top level server_stats struct definition
  */
 #include "server_stats_private.h"
@@ -528,6 +583,32 @@ static struct _9p_stats *get_9p(struct gsh_stats *stats, pthread_rwlock_t *lock)
 }
 #endif
 
+static struct xprt_stall_stats *get_stall(struct gsh_stats *stats,
+					  pthread_rwlock_t *lock)
+{
+	if (unlikely(stats->stall == NULL)) {
+		PTHREAD_RWLOCK_wrlock(lock);
+		if (stats->stall == NULL)
+			stats->stall =
+			    gsh_calloc(sizeof(struct xprt_stall_stats), 1);
+		PTHREAD_RWLOCK_unlock(lock);
+	}
+	return stats->stall;
+}
+
+static struct ds_io_stats *get_ds_io(struct gsh_stats *stats,
+				     pthread_rwlock_t *lock)
+{
+	if (unlikely(stats->ds_io == NULL)) {
+		PTHREAD_RWLOCK_wrlock(lock);
+		if (stats->ds_io == NULL)
+			stats->ds_io =
+			    gsh_calloc(sizeof(struct ds_io_stats), 1);
+		PTHREAD_RWLOCK_unlock(lock);
+	}
+	return stats->ds_io;
+}
+
 /* Functions for recording statistics
  */
 
@@ -969,6 +1050,26 @@ void server_stats_transport_done(struct gsh_client *client,
 		record_transport_stats(&sp->trans, rx_bytes, rx_pkt, rx_err,
 				       tx_bytes, tx_pkt, tx_err);
 }
+
+/**
+ * @brief record 9P fids set or cleared by a client
+ *
+ * Called from the 9P fid table when a fid is set or cleared
+ */
+void server_stats_9p_fids(struct gsh_client *client, int32_t delta)
+{
+	struct server_stats *server_st =
+		container_of(client, struct server_stats, client);
+	struct _9p_stats *sp = get_9p(&server_st->st, &client->lock);
+	uint64_t fids;
+
+	if (sp == NULL)
+		return;
+
+	fids = atomic_add_uint64_t(&sp->fids.fids, delta);
+	if (fids > atomic_fetch_uint64_t(&sp->fids.hwmark))
+		atomic_store_uint64_t(&sp->fids.hwmark, fids);
+}
 #endif
 
 /**
@@ -1115,6 +1216,195 @@ void server_stats_compound_done(int num_ops, int status)
 	return;
 }
 
+/**
+ * @brief Record the parallelism achieved by a split compound
+ *
+ * @param[in] segments   Number of segments the compound was split into
+ * @param[in] ops        Number of operations in those segments
+ * @param[in] dispatched Segments that ran on another thread than the
+ *                       worker's
+ */
+
+void server_stats_compound_parallel(uint32_t segments, uint32_t ops,
+				    uint32_t dispatched)
+{
+	(void)atomic_inc_uint64_t(&compound_par_st.compounds);
+	(void)atomic_add_uint64_t(&compound_par_st.segments, segments);
+	(void)atomic_add_uint64_t(&compound_par_st.ops, ops);
+	(void)atomic_add_uint64_t(&compound_par_st.dispatched, dispatched);
+}
+
+/**
+ * @brief Record an FSAL credential switch
+ *
+ * @param[in] restore  true when switching back to the server's identity
+ * @param[in] syscalls Identity syscalls the switch needed
+ */
+
+void server_stats_creds_switch(bool restore, uint32_t syscalls)
+{
+	if (restore)
+		(void)atomic_inc_uint64_t(&creds_switch_st.restores);
+	else
+		(void)atomic_inc_uint64_t(&creds_switch_st.switches);
+	if (syscalls != 0)
+		(void)atomic_add_uint64_t(&creds_switch_st.syscalls, syscalls);
+}
+
+static void record_xprt_stall(struct xprt_stall_stats *st,
+			      nsecs_elapsed_t stalled)
+{
+	nsecs_elapsed_t bound = NS_PER_MSEC;
+	int ix;
+
+	for (ix = 0; ix < XPRT_STALL_BUCKETS - 1; ix++) {
+		if (stalled < bound)
+			break;
+		bound *= 10;
+	}
+
+	(void)atomic_inc_uint64_t(&st->stalls);
+	(void)atomic_add_uint64_t(&st->stall_time, stalled);
+	(void)atomic_inc_uint64_t(&st->hist[ix]);
+}
+
+/**
+ * @brief Record the end of a transport stall
+ *
+ * @param[in] client  Client the transport belongs to, may be NULL
+ * @param[in] stalled Nanoseconds the transport was stalled
+ */
+
+void server_stats_xprt_stall(struct gsh_client *client,
+			     nsecs_elapsed_t stalled)
+{
+	struct server_stats *server_st;
+	struct xprt_stall_stats *sp;
+
+	record_xprt_stall(&xprt_stall_st, stalled);
+
+	if (client == NULL)
+		return;
+
+	server_st = container_of(client, struct server_stats, client);
+	sp = get_stall(&server_st->st, &client->lock);
+	if (sp != NULL)
+		record_xprt_stall(sp, stalled);
+}
+
+static void record_ds_io(struct ds_io_op *op, uint32_t stripes,
+			 size_t bytes, nsecs_elapsed_t latency)
+{
+	uint64_t max;
+	int ix = 0;
+
+	while ((1U << ix) < stripes && ix < DS_IO_FANOUT_BUCKETS - 1)
+		ix++;
+
+	(void)atomic_inc_uint64_t(&op->ops);
+	(void)atomic_add_uint64_t(&op->bytes, bytes);
+	(void)atomic_add_uint64_t(&op->stripes, stripes);
+	(void)atomic_add_uint64_t(&op->latency, latency);
+	(void)atomic_inc_uint64_t(&op->fanout[ix]);
+
+	max = atomic_fetch_uint64_t(&op->max_latency);
+	while (latency > max &&
+	       !atomic_cas_uint64_t(&op->max_latency, max, latency))
+		max = atomic_fetch_uint64_t(&op->max_latency);
+}
+
+/**
+ * @brief Record a pNFS DS read or write split into stripe units
+ *
+ * Accounted to the export of the current operation.
+ *
+ * @param[in] is_write Whether it was a write
+ * @param[in] stripes  Stripe units the request was split into
+ * @param[in] bytes    Bytes moved
+ * @param[in] latency  Nanoseconds the request took
+ */
+
+void server_stats_ds_io(bool is_write, uint32_t stripes, size_t bytes,
+			nsecs_elapsed_t latency)
+{
+	struct export_stats *exp_st;
+	struct ds_io_stats *sp;
+
+	if (op_ctx == NULL || op_ctx->export == NULL)
+		return;
+
+	exp_st = container_of(op_ctx->export, struct export_stats, export);
+	sp = get_ds_io(&exp_st->st, &op_ctx->export->lock);
+	if (sp == NULL)
+		return;
+
+	record_ds_io(is_write ? &sp->write : &sp->read, stripes, bytes,
+		     latency);
+}
+
+/**
+ * @brief Record a batch of gathered writes
+ *
+ * @param[in] requests Writes in the batch
+ * @param[in] writes   FSAL writes they were coalesced into
+ * @param[in] commits  FSAL commits issued for the batch
+ */
+
+void server_stats_write_gather(uint32_t requests, uint32_t writes,
+			       uint32_t commits)
+{
+	(void)atomic_inc_uint64_t(&write_gather_st.batches);
+	(void)atomic_add_uint64_t(&write_gather_st.requests, requests);
+	(void)atomic_add_uint64_t(&write_gather_st.writes, writes);
+	if (commits != 0)
+		(void)atomic_add_uint64_t(&write_gather_st.commits, commits);
+}
+
+/**
+ * @brief Record a READ looked up in the data cache
+ *
+ * @param[in] hit Whether the READ was served from it
+ */
+
+void server_stats_data_cache_read(bool hit)
+{
+	if (hit)
+		(void)atomic_inc_uint64_t(&data_cache_st.hits);
+	else
+		(void)atomic_inc_uint64_t(&data_cache_st.misses);
+}
+
+/**
+ * @brief Record a block cached
+ *
+ * @param[in] bytes     Bytes cached
+ * @param[in] readahead Whether it was read ahead rather than asked for
+ */
+
+void server_stats_data_cache_fill(size_t bytes, bool readahead)
+{
+	if (readahead)
+		(void)atomic_inc_uint64_t(&data_cache_st.readahead);
+	else
+		(void)atomic_inc_uint64_t(&data_cache_st.fills);
+	(void)atomic_add_uint64_t(&data_cache_st.bytes, bytes);
+}
+
+/**
+ * @brief Record a block dropped from the data cache
+ *
+ * @param[in] evicted Dropped for space rather than invalidated
+ * @param[in] unused  Read ahead and never used
+ */
+
+void server_stats_data_cache_drop(bool evicted, bool unused)
+{
+	if (evicted)
+		(void)atomic_inc_uint64_t(&data_cache_st.evicted);
+	if (unused)
+		(void)atomic_inc_uint64_t(&data_cache_st.wasted);
+}
+
 /**
  * @brief Record I/O stats for protocol read/write
  *
@@ -1150,6 +1440,61 @@ void server_stats_io_done(size_t requested,
 /* Functions for marshalling statistics to DBUS
  */
 
+/**
+ * @brief A named counter, see dbus_append_counters
+ */
+struct dbus_counter {
+	char *name;
+	uint64_t *value;
+};
+
+/**
+ * @brief Append the current time
+ *
+ * @param iter [IN] the iterator to append to
+ */
+
+static void dbus_append_now(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+}
+
+/**
+ * @brief Append the current time and a struct of named counters
+ *
+ * The struct holds a (name, value) pair per counter.
+ *
+ * @param iter     [IN] the iterator to append to
+ * @param counters [IN] the counters
+ * @param count    [IN] number of counters
+ */
+
+static void dbus_append_counters(DBusMessageIter *iter,
+				 const struct dbus_counter *counters,
+				 int count)
+{
+	DBusMessageIter struct_iter;
+	int i;
+
+	dbus_append_now(iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	for (i = 0; i < count; i++) {
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+					       &counters[i].name);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       counters[i].value);
+	}
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+/* The arguments dbus_append_counters takes for an array of counters */
+#define COUNTERS(c) (c), (sizeof(c) / sizeof((c)[0]))
+
 /**
  * @brief Report Stats availability as members of a struct
  *
@@ -1503,43 +1848,449 @@ void global_dbus_total_ops(DBusMessageIter *iter)
 
 void cache_inode_dbus_show(DBusMessageIter *iter)
 {
-	struct timespec timestamp;
+	struct dbus_counter counters[] = {
+		{"cache_req", &cache_st.inode_req},
+		{"cache_hit", &cache_st.inode_hit},
+		{"cache_miss", &cache_st.inode_miss},
+		{"cache_conf", &cache_st.inode_conf},
+		{"cache_added", &cache_st.inode_added},
+		{"cache_mapping", &cache_st.inode_mapping},
+	};
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+void cache_inode_dbus_show_hash(DBusMessageIter *iter)
+{
+	struct cih_table_stats stats;
+	uint64_t npart, max_entries, max_depth;
+	struct dbus_counter counters[] = {
+		{"partitions", &npart},
+		{"entries", &stats.entries},
+		{"max_partition_entries", &max_entries},
+		{"max_depth", &max_depth},
+		{"cache_slots", &stats.cache_slots},
+		{"cache_hit", &stats.cache_hit},
+		{"avl_hit", &stats.avl_hit},
+		{"miss", &stats.miss},
+		{"resizes", &stats.resizes},
+	};
+
+	cih_get_stats(&stats);
+	npart = stats.npart;
+	max_entries = stats.max_entries;
+	max_depth = stats.max_depth;
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+void compound_dbus_show_parallel(DBusMessageIter *iter)
+{
+	struct dbus_counter counters[] = {
+		{"compounds", &compound_par_st.compounds},
+		{"segments", &compound_par_st.segments},
+		{"ops", &compound_par_st.ops},
+		{"dispatched", &compound_par_st.dispatched},
+	};
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+void fsal_dbus_show_creds(DBusMessageIter *iter)
+{
+	struct dbus_counter counters[] = {
+		{"switches", &creds_switch_st.switches},
+		{"restores", &creds_switch_st.restores},
+		{"syscalls", &creds_switch_st.syscalls},
+	};
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+/**
+ * @brief Report the upcall queue
+ *
+ * The merge ratio is merged / events, the mean latency from queueing
+ * to delivery latency / delivered, both in nanoseconds.
+ *
+ * @param iter [IN] the iterator to append to
+ */
+
+void fsal_up_dbus_show_queue(DBusMessageIter *iter)
+{
+	struct up_queue_stats st;
+	struct dbus_counter counters[] = {
+		{"depth", &st.depth},
+		{"events", &st.events},
+		{"merged", &st.merged},
+		{"delivered", &st.delivered},
+		{"batches", &st.batches},
+		{"waits", &st.waits},
+		{"latency", &st.latency},
+		{"max_latency", &st.max_latency},
+	};
+
+	up_queue_get_stats(&st);
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+/**
+ * @brief Report layout recall fan-out
+ *
+ * The mean latency is latency / (acked + returned + revoked), in
+ * nanoseconds.  lt_1ms through ge_1s count recalls by how long they
+ * took to complete.
+ *
+ * @param iter [IN] the iterator to append to
+ */
+
+#define RECALL_COUNTERS 14
+
+void fsal_up_dbus_show_recalls(DBusMessageIter *iter)
+{
+	struct layoutrecall_stats st;
+	static char * const hist_names[LAYOUTRECALL_LATENCY_BUCKETS] = {
+		"lt_1ms", "lt_10ms", "lt_100ms", "lt_1s", "ge_1s"
+	};
+	struct dbus_counter counters[RECALL_COUNTERS +
+				    LAYOUTRECALL_LATENCY_BUCKETS] = {
+		{"recalls", &st.recalls},
+		{"notifies", &st.notifies},
+		{"compounds", &st.compounds},
+		{"ops", &st.ops},
+		{"retries", &st.retries},
+		{"acked", &st.acked},
+		{"nomatching", &st.nomatching},
+		{"revoked", &st.revoked},
+		{"timeouts", &st.timeouts},
+		{"waits", &st.waits},
+		{"inflight", &st.inflight},
+		{"max_inflight", &st.max_inflight},
+		{"latency", &st.latency},
+		{"max_latency", &st.max_latency},
+	};
+	int i;
+
+	layoutrecall_get_stats(&st);
+
+	for (i = 0; i < LAYOUTRECALL_LATENCY_BUCKETS; i++) {
+		counters[RECALL_COUNTERS + i].name = hist_names[i];
+		counters[RECALL_COUNTERS + i].value = &st.latency_hist[i];
+	}
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+void cache_inode_dbus_show_gather(DBusMessageIter *iter)
+{
+	struct dbus_counter counters[] = {
+		{"batches", &write_gather_st.batches},
+		{"requests", &write_gather_st.requests},
+		{"fsal_writes", &write_gather_st.writes},
+		{"commits", &write_gather_st.commits},
+	};
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+void cache_inode_dbus_show_data(DBusMessageIter *iter)
+{
+	struct dbus_counter counters[] = {
+		{"hits", &data_cache_st.hits},
+		{"misses", &data_cache_st.misses},
+		{"fills", &data_cache_st.fills},
+		{"readahead", &data_cache_st.readahead},
+		{"bytes", &data_cache_st.bytes},
+		{"evicted", &data_cache_st.evicted},
+		{"wasted", &data_cache_st.wasted},
+	};
+
+	dbus_append_counters(iter, COUNTERS(counters));
+}
+
+/**
+ * @brief Report bulk data buffer pool occupancy
+ *
+ * Pool wide counters as name/value pairs, then one
+ * (size, arenas, buffers, free, in_use, allocs, cached) row per size
+ * class.
+ *
+ * @param iter [IN] the iterator to append to
+ */
+
+void server_dbus_bufpool(DBusMessageIter *iter)
+{
+	struct gsh_bufpool_stats st;
+	struct gsh_bufpool_class_stats *cs;
+	struct dbus_counter counters[] = {
+		{"limit", &st.limit},
+		{"mapped", &st.mapped},
+		{"huge_arenas", &st.huge},
+		{"oversize", &st.oversize},
+		{"fallback", &st.fallback},
+	};
+	DBusMessageIter struct_iter, array_iter;
+	int cls;
+
+	gsh_bufpool_stats(&st);
+	dbus_append_counters(iter, COUNTERS(counters));
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 "(ttttttt)", &array_iter);
+	for (cls = 0; cls < GSH_BUF_CLASSES; cls++) {
+		cs = &st.classes[cls];
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+						&cs->size);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+						&cs->arenas);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+						&cs->buffers);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+						&cs->free);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+						&cs->in_use);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+						&cs->allocs);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+						&cs->cached);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+static void server_dbus_slab_pool(const struct pool_slab_stats *stats,
+				  void *arg)
+{
+	DBusMessageIter *array_iter = arg;
 	DBusMessageIter struct_iter;
-	char *type;
+	const char *name = stats->name ? stats->name : "";
 
-	now(&timestamp);
-	dbus_append_timestamp(iter, &timestamp);
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->object_size);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->slabs);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->huge_slabs);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->objects);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->free);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->cached);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
 
-	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+/**
+ * @brief Report slab pool usage
+ *
+ * One (name, object_size, slabs, huge_slabs, objects, free, cached)
+ * row per pool.  Objects in use are objects - free - cached.
+ *
+ * @param iter [IN] the iterator to append to
+ */
+
+void server_dbus_slab_pools(DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter;
+
+	dbus_append_now(iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 "(stttttt)", &array_iter);
+	pool_slab_foreach(server_dbus_slab_pool, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+static void server_dbus_qos_tenant(const char *kind, const char *name,
+				   const struct nfs_rpc_qos_stats *stats,
+				   void *arg)
+{
+	DBusMessageIter *array_iter = arg;
+	DBusMessageIter struct_iter;
+	uint64_t wait_avg = stats->dequeued != 0
+		? stats->wait_total / stats->dequeued : 0;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
 					 &struct_iter);
-	type = "cache_req";
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &kind);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->depth);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->enqueued);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&cache_st.inode_req);
-	type = "cache_hit";
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+					&stats->dequeued);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&cache_st.inode_hit);
-	type = "cache_miss";
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+					&stats->throttled);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&cache_st.inode_miss);
-	type = "cache_conf";
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+					&wait_avg);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&cache_st.inode_conf);
-	type = "cache_added";
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+					&stats->wait_max);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report QoS scheduling per client and per export
+ *
+ * One (kind, name, depth, enqueued, dequeued, throttled, wait_avg,
+ * wait_max) row per tenant, kind being "client" or "export" and the
+ * waits in nanoseconds.  Empty unless Enable_QoS is set.
+ *
+ * @param iter [IN] the iterator to append to
+ */
+
+void server_dbus_qos(DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter;
+
+	dbus_append_now(iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 "(sstttttt)", &array_iter);
+	nfs_rpc_qos_foreach(server_dbus_qos_tenant, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+static void server_dbus_evchan(const struct nfs_rpc_evchan_stats *stats,
+			       void *arg)
+{
+	DBusMessageIter *array_iter = arg;
+	DBusMessageIter struct_iter;
+	double utilization = stats->elapsed != 0
+		? (double)stats->busy / stats->elapsed : 0.0;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+					&stats->id);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+					&stats->kind);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&stats->xprts);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&cache_st.inode_added);
-	type = "cache_mapping";
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+					&stats->events);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&cache_st.inode_mapping);
+					&stats->busy);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_DOUBLE,
+					&utilization);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
 
+/**
+ * @brief Report RPC event channel activity
+ *
+ * One (id, kind, xprts, events, busy, utilization) row per channel.
+ * busy is the nanoseconds the channel thread spent handling events,
+ * utilization the fraction of its lifetime that represents.
+ *
+ * @param iter [IN] the iterator to append to
+ */
+
+void server_dbus_evchans(DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter;
+
+	dbus_append_now(iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 "(ustttd)", &array_iter);
+	nfs_rpc_evchan_foreach(server_dbus_evchan, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report transport stalls
+ *
+ * A (stalls, stall_time, histogram) struct, stall_time in
+ * nanoseconds and the histogram counting stalls under 1ms, 10ms,
+ * 100ms, 1s, 10s and longer.
+ *
+ * @param st   [IN] the stats to report
+ * @param iter [IN] the iterator to append to
+ */
+
+void server_dbus_xprt_stalls(struct xprt_stall_stats *st,
+			     DBusMessageIter *iter)
+{
+	DBusMessageIter struct_iter;
+	DBusMessageIter array_iter;
+	int ix;
+
+	dbus_append_now(iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st->stalls);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&st->stall_time);
+	dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY,
+					 DBUS_TYPE_UINT64_AS_STRING,
+					 &array_iter);
+	for (ix = 0; ix < XPRT_STALL_BUCKETS; ix++)
+		dbus_message_iter_append_basic(&array_iter, DBUS_TYPE_UINT64,
+						&st->hist[ix]);
+	dbus_message_iter_close_container(&struct_iter, &array_iter);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+void global_dbus_xprt_stalls(DBusMessageIter *iter)
+{
+	server_dbus_xprt_stalls(&xprt_stall_st, iter);
+}
+
+static void server_dbus_ds_io_op(struct ds_io_op *op, DBusMessageIter *iter)
+{
+	DBusMessageIter struct_iter;
+	DBusMessageIter array_iter;
+	int ix;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&op->ops);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&op->bytes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&op->stripes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&op->latency);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&op->max_latency);
+	dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY,
+					 DBUS_TYPE_UINT64_AS_STRING,
+					 &array_iter);
+	for (ix = 0; ix < DS_IO_FANOUT_BUCKETS; ix++)
+		dbus_message_iter_append_basic(&array_iter, DBUS_TYPE_UINT64,
+						&op->fanout[ix]);
+	dbus_message_iter_close_container(&struct_iter, &array_iter);
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
+/**
+ * @brief Report pNFS DS I/O of an export
+ *
+ * For reads, then writes: requests, bytes, stripe unit I/Os, total
+ * and maximum nanoseconds, and requests by stripe units split into,
+ * 1, 2, 3-4, 5-8 and more.
+ *
+ * @param st   [IN] the stats to report
+ * @param iter [IN] the iterator to append to
+ */
+
+void server_dbus_ds_io(struct ds_io_stats *st, DBusMessageIter *iter)
+{
+	dbus_append_now(iter);
+	server_dbus_ds_io_op(&st->read, iter);
+	server_dbus_ds_io_op(&st->write, iter);
+}
+
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
@@ -1559,6 +2310,22 @@ void server_dbus_9p_transstats(struct _9p_stats *_9pp, DBusMessageIter *iter)
 	server_dbus_transportstats(&_9pp->trans, iter);
 }
 
+void server_dbus_9p_fidstats(struct _9p_stats *_9pp, DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &_9pp->fids.fids);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &_9pp->fids.hwmark);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
 /**
  * @brief Report layout statistics as a struct
  *
@@ -1658,6 +2425,14 @@ void server_stats_free(struct gsh_stats *statsp)
 		gsh_free(statsp->_9p);
 		statsp->_9p = NULL;
 	}
+	if (statsp->stall != NULL) {
+		gsh_free(statsp->stall);
+		statsp->stall = NULL;
+	}
+	if (statsp->ds_io != NULL) {
+		gsh_free(statsp->ds_io);
+		statsp->ds_io = NULL;
+	}
 }
 
 /** @} */
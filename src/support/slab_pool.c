@@ -0,0 +1,636 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file slab_pool.c
+ * @brief Slab pool substrate
+ *
+ * A slab is a 2MiB mapping aligned on its size, so the slab holding
+ * an object is found by masking the object's address.  The slab
+ * header sits at the start of the mapping and the objects follow it.
+ * Each pool keeps, per NUMA node, a list of slabs with free objects
+ * and a list of full ones, protected by a per-node mutex.  A slab is
+ * carved by the thread that needs it; carving writes every object, so
+ * under the default first touch policy its pages land on that
+ * thread's node.
+ *
+ * Every thread has a magazine per pool.  pool_alloc pops from it and
+ * pool_free pushes to it; an empty magazine is refilled with half a
+ * magazine from the local node and a full one returns half of its
+ * objects to their slabs.  Magazines are linked on their pool so
+ * pool_destroy can drain them, and are drained when their thread
+ * exits.  The slab mutex protects the pool registry and those links.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "log.h"
+#include "abstract_mem.h"
+#include "ganesha_list.h"
+#include "common_utils.h"
+#include "nfs_core.h"
+#include "slab_pool.h"
+
+#define SLAB_SHIFT 21
+#define SLAB_SIZE (1UL << SLAB_SHIFT)
+#define SLAB_MASK (SLAB_SIZE - 1)
+
+/** Objects above this size are not worth slabbing */
+#define SLAB_MAX_OBJECT (SLAB_SIZE / 16)
+
+/** Objects are aligned like malloc aligns them */
+#define SLAB_ALIGN 16
+
+/** NUMA nodes we keep separate slab lists for */
+#define SLAB_MAX_NODES 8
+
+/** Pools that get per-thread magazines */
+#define SLAB_MAX_POOLS 256
+
+/** Objects per magazine */
+#define SLAB_MAG_SIZE 32
+
+struct slab_pool;
+
+/**
+ * @brief Header of a slab
+ */
+
+struct slab {
+	struct glist_head link;	/*< On the node's partial or full list */
+	struct slab_pool *sp;	/*< Owning pool */
+	void *free;		/*< Free objects, linked through first word */
+	uint32_t nfree;		/*< Length of free */
+	uint32_t nobj;		/*< Objects carved in this slab */
+	uint32_t node;		/*< Node list this slab is on */
+	bool huge;		/*< Backed by hugetlbfs */
+};
+
+#define SLAB_HDR ((sizeof(struct slab) + 63) & ~63UL)
+
+/**
+ * @brief Slabs of one pool on one node
+ */
+
+struct slab_node {
+	pthread_mutex_t mtx;	/*< Protects everything below */
+	struct glist_head partial;	/*< Slabs with free objects */
+	struct glist_head full;	/*< Slabs without */
+	uint32_t empty;		/*< Slabs with every object free */
+};
+
+/**
+ * @brief Per-thread magazine
+ */
+
+struct slab_magazine {
+	struct glist_head link;	/*< On the pool's magazine list */
+	struct slab_pool *sp;	/*< Owning pool, NULL once destroyed */
+	uint32_t count;		/*< Objects in objs */
+	void *objs[SLAB_MAG_SIZE];
+};
+
+/**
+ * @brief Substrate data of a slab pool
+ */
+
+struct slab_pool {
+	struct glist_head pools;	/*< On the pool registry */
+	pool_t *pool;		/*< Back pointer for the name */
+	uint32_t id;		/*< Index in thread magazine arrays */
+	size_t size;		/*< Object size, rounded */
+	uint32_t per_slab;	/*< Objects per slab */
+	bool large;		/*< Objects too large, use malloc */
+	struct glist_head mags;	/*< Thread magazines of this pool */
+	struct slab_node nodes[SLAB_MAX_NODES];
+};
+
+static pthread_mutex_t slab_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct glist_head slab_pools = GLIST_HEAD_INIT(slab_pools);
+static uint32_t slab_next_id;
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_key;
+static __thread struct slab_magazine **slab_mags;
+
+static inline struct slab_pool *slab_pool_of(pool_t *pool)
+{
+	return (struct slab_pool *)pool->substrate_data;
+}
+
+static inline struct slab *slab_of(void *object)
+{
+	return (struct slab *)((uintptr_t) object & ~SLAB_MASK);
+}
+
+/**
+ * @brief NUMA node of the calling thread
+ */
+
+static inline uint32_t slab_local_node(void)
+{
+#ifdef SYS_getcpu
+	unsigned cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+		return node % SLAB_MAX_NODES;
+#endif
+	return 0;
+}
+
+/**
+ * @brief Map a slab
+ *
+ * With Slab_Huge_Pages try hugetlbfs first; otherwise, or when no
+ * huge pages are reserved, ask for transparent huge pages.
+ *
+ * @param[out] huge Set if the slab is on hugetlbfs
+ *
+ * @return The slab, or NULL.
+ */
+
+static struct slab *slab_map(bool *huge)
+{
+	const size_t len = 2 * SLAB_SIZE;
+	char *raw = MAP_FAILED;
+	char *base;
+
+	*huge = false;
+#ifdef MAP_HUGETLB
+	if (nfs_param.core_param.slab_hugepages) {
+		/* Huge page mappings come back aligned on the page size */
+		raw = mmap(NULL, SLAB_SIZE, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (raw != MAP_FAILED && ((uintptr_t) raw & SLAB_MASK) == 0) {
+			*huge = true;
+			return (struct slab *)raw;
+		}
+		if (raw != MAP_FAILED)
+			munmap(raw, SLAB_SIZE);
+	}
+#endif
+	raw = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		return NULL;
+
+	base = (char *)(((uintptr_t) raw + SLAB_MASK) & ~SLAB_MASK);
+	if (base != raw)
+		munmap(raw, base - raw);
+	if (base + SLAB_SIZE != raw + len)
+		munmap(base + SLAB_SIZE, raw + len - (base + SLAB_SIZE));
+#ifdef MADV_HUGEPAGE
+	(void)madvise(base, SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+	return (struct slab *)base;
+}
+
+/**
+ * @brief Carve a new slab onto a node
+ *
+ * @note The node mutex must be held.
+ */
+
+static struct slab *slab_new(struct slab_pool *sp, uint32_t node)
+{
+	struct slab *slab;
+	char *obj;
+	bool huge;
+	uint32_t i;
+
+	slab = slab_map(&huge);
+	if (slab == NULL)
+		return NULL;
+
+	slab->sp = sp;
+	slab->node = node;
+	slab->huge = huge;
+	slab->nobj = sp->per_slab;
+	slab->nfree = sp->per_slab;
+	slab->free = NULL;
+
+	/* Link back to front so objects are handed out in address order */
+	obj = (char *)slab + SLAB_HDR + (size_t) sp->per_slab * sp->size;
+	for (i = 0; i < sp->per_slab; i++) {
+		obj -= sp->size;
+		*(void **)obj = slab->free;
+		slab->free = obj;
+	}
+
+	glist_add(&sp->nodes[node].partial, &slab->link);
+	sp->nodes[node].empty++;
+	return slab;
+}
+
+/**
+ * @brief Take objects from a node's slabs
+ *
+ * @note The node mutex must be held.
+ *
+ * @return Number of objects stored in objs.
+ */
+
+static uint32_t slab_take(struct slab_pool *sp, uint32_t node, void **objs,
+			  uint32_t want)
+{
+	struct slab_node *sn = &sp->nodes[node];
+	struct slab *slab;
+	uint32_t got = 0;
+
+	while (got < want) {
+		slab = glist_first_entry(&sn->partial, struct slab, link);
+		if (slab == NULL)
+			break;
+		if (slab->nfree == slab->nobj)
+			sn->empty--;
+		while (got < want && slab->free != NULL) {
+			objs[got++] = slab->free;
+			slab->free = *(void **)slab->free;
+			slab->nfree--;
+		}
+		if (slab->free == NULL) {
+			glist_del(&slab->link);
+			glist_add(&sn->full, &slab->link);
+		}
+	}
+	return got;
+}
+
+/**
+ * @brief Fill objs from the local node, growing it if need be
+ *
+ * @return Number of objects stored in objs.
+ */
+
+static uint32_t slab_get(struct slab_pool *sp, void **objs, uint32_t want)
+{
+	uint32_t local = slab_local_node();
+	uint32_t node, got;
+
+	PTHREAD_MUTEX_lock(&sp->nodes[local].mtx);
+	got = slab_take(sp, local, objs, want);
+	if (got == 0 && slab_new(sp, local) != NULL)
+		got = slab_take(sp, local, objs, want);
+	PTHREAD_MUTEX_unlock(&sp->nodes[local].mtx);
+	if (got != 0)
+		return got;
+
+	/* Out of memory locally, borrow from the other nodes */
+	for (node = 0; node < SLAB_MAX_NODES && got == 0; node++) {
+		if (node == local)
+			continue;
+		PTHREAD_MUTEX_lock(&sp->nodes[node].mtx);
+		got = slab_take(sp, node, objs, want);
+		PTHREAD_MUTEX_unlock(&sp->nodes[node].mtx);
+	}
+	return got;
+}
+
+/**
+ * @brief Return objects to their slabs
+ *
+ * A slab that becomes entirely free is unmapped if its node already
+ * has an empty slab in reserve.
+ */
+
+static void slab_put(struct slab_pool *sp, void **objs, uint32_t count)
+{
+	struct slab_node *sn = NULL;
+	struct slab *slab;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		slab = slab_of(objs[i]);
+		if (sn != &sp->nodes[slab->node]) {
+			if (sn != NULL)
+				PTHREAD_MUTEX_unlock(&sn->mtx);
+			sn = &sp->nodes[slab->node];
+			PTHREAD_MUTEX_lock(&sn->mtx);
+		}
+
+		if (slab->free == NULL) {
+			glist_del(&slab->link);
+			glist_add(&sn->partial, &slab->link);
+		}
+		*(void **)objs[i] = slab->free;
+		slab->free = objs[i];
+		slab->nfree++;
+
+		if (slab->nfree == slab->nobj) {
+			if (sn->empty != 0) {
+				glist_del(&slab->link);
+				munmap(slab, SLAB_SIZE);
+			} else {
+				sn->empty++;
+			}
+		}
+	}
+	if (sn != NULL)
+		PTHREAD_MUTEX_unlock(&sn->mtx);
+}
+
+/**
+ * @brief Drain the calling thread's magazines when it exits
+ */
+
+static void slab_thread_exit(void *arg)
+{
+	struct slab_magazine **mags = arg;
+	struct slab_magazine *mag;
+	uint32_t id;
+
+	PTHREAD_MUTEX_lock(&slab_mtx);
+	for (id = 0; id < SLAB_MAX_POOLS; id++) {
+		mag = mags[id];
+		if (mag == NULL)
+			continue;
+		if (mag->sp != NULL) {
+			slab_put(mag->sp, mag->objs, mag->count);
+			glist_del(&mag->link);
+		}
+		gsh_free(mag);
+	}
+	PTHREAD_MUTEX_unlock(&slab_mtx);
+	gsh_free(mags);
+	slab_mags = NULL;
+}
+
+static void slab_key_init(void)
+{
+	if (pthread_key_create(&slab_key, slab_thread_exit) != 0)
+		LogCrit(COMPONENT_INIT,
+			"Unable to create slab magazine key, per-thread caching disabled");
+}
+
+/**
+ * @brief The calling thread's magazine for a pool
+ *
+ * @return The magazine, or NULL if the pool has none.
+ */
+
+static inline struct slab_magazine *slab_magazine(struct slab_pool *sp)
+{
+	struct slab_magazine *mag;
+
+	if (unlikely(sp->id >= SLAB_MAX_POOLS))
+		return NULL;
+
+	if (likely(slab_mags != NULL && slab_mags[sp->id] != NULL))
+		return slab_mags[sp->id];
+
+	if (slab_mags == NULL) {
+		slab_mags = gsh_calloc(SLAB_MAX_POOLS, sizeof(*slab_mags));
+		if (slab_mags == NULL)
+			return NULL;
+		if (pthread_setspecific(slab_key, slab_mags) != 0) {
+			gsh_free(slab_mags);
+			slab_mags = NULL;
+			return NULL;
+		}
+	}
+
+	mag = gsh_calloc(1, sizeof(*mag));
+	if (mag == NULL)
+		return NULL;
+	mag->sp = sp;
+
+	PTHREAD_MUTEX_lock(&slab_mtx);
+	glist_add_tail(&sp->mags, &mag->link);
+	PTHREAD_MUTEX_unlock(&slab_mtx);
+
+	slab_mags[sp->id] = mag;
+	return mag;
+}
+
+/**
+ * @brief Initialize a slab pool
+ *
+ * @param[in] size  Size of the objects
+ * @param[in] param Parameters (there are no parameters, must be
+ *                  NULL.)
+ *
+ * @return the allocated pool_t structure, or NULL.
+ */
+
+pool_t *pool_slab_initializer(size_t size, void *param)
+{
+	struct slab_pool *sp;
+	pool_t *pool;
+	uint32_t node;
+
+	assert(param == NULL);	/* We take no parameters */
+	(void)pthread_once(&slab_once, slab_key_init);
+
+	pool = gsh_calloc(1, sizeof(pool_t) + sizeof(struct slab_pool));
+	if (pool == NULL)
+		return NULL;
+
+	sp = slab_pool_of(pool);
+	sp->pool = pool;
+	sp->size = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+	if (sp->size < sizeof(void *))
+		sp->size = sizeof(void *);
+	sp->large = sp->size > SLAB_MAX_OBJECT;
+	sp->per_slab = (SLAB_SIZE - SLAB_HDR) / sp->size;
+	glist_init(&sp->mags);
+	for (node = 0; node < SLAB_MAX_NODES; node++) {
+		pthread_mutex_init(&sp->nodes[node].mtx, NULL);
+		glist_init(&sp->nodes[node].partial);
+		glist_init(&sp->nodes[node].full);
+	}
+
+	PTHREAD_MUTEX_lock(&slab_mtx);
+	sp->id = slab_next_id++;
+	glist_add_tail(&slab_pools, &sp->pools);
+	PTHREAD_MUTEX_unlock(&slab_mtx);
+
+	return pool;
+}
+
+/**
+ * @brief Destroy a slab pool
+ *
+ * Empties every thread's magazine for the pool and unmaps its slabs.
+ *
+ * @param[in] pool The pool to destroy
+ */
+
+void pool_slab_destroy(pool_t *pool)
+{
+	struct slab_pool *sp = slab_pool_of(pool);
+	struct slab_magazine *mag;
+	struct glist_head *glist, *glistn;
+	struct slab *slab;
+	uint32_t node;
+
+	PTHREAD_MUTEX_lock(&slab_mtx);
+	glist_del(&sp->pools);
+	glist_for_each_safe(glist, glistn, &sp->mags) {
+		mag = glist_entry(glist, struct slab_magazine, link);
+		glist_del(&mag->link);
+		/* The owning thread frees the magazine on exit */
+		mag->sp = NULL;
+		mag->count = 0;
+	}
+	PTHREAD_MUTEX_unlock(&slab_mtx);
+
+	for (node = 0; node < SLAB_MAX_NODES; node++) {
+		glist_for_each_safe(glist, glistn, &sp->nodes[node].partial) {
+			slab = glist_entry(glist, struct slab, link);
+			glist_del(&slab->link);
+			munmap(slab, SLAB_SIZE);
+		}
+		glist_for_each_safe(glist, glistn, &sp->nodes[node].full) {
+			slab = glist_entry(glist, struct slab, link);
+			glist_del(&slab->link);
+			munmap(slab, SLAB_SIZE);
+		}
+		pthread_mutex_destroy(&sp->nodes[node].mtx);
+	}
+
+	gsh_free(pool->name);
+	gsh_free(pool);
+}
+
+/**
+ * @brief Allocate an object from a slab pool
+ *
+ * @param[in] pool The pool from which to allocate.
+ *
+ * @return the allocated object or NULL.
+ */
+
+void *pool_slab_alloc(pool_t *pool)
+{
+	struct slab_pool *sp = slab_pool_of(pool);
+	struct slab_magazine *mag;
+	void *object = NULL;
+
+	if (unlikely(sp->large))
+		return pool_basic_alloc(pool);
+
+	mag = slab_magazine(sp);
+	if (likely(mag != NULL)) {
+		if (mag->count == 0)
+			mag->count = slab_get(sp, mag->objs, SLAB_MAG_SIZE / 2);
+		if (mag->count != 0)
+			object = mag->objs[--mag->count];
+	} else if (slab_get(sp, &object, 1) == 0) {
+		object = NULL;
+	}
+
+	if (object != NULL && pool->constructor == NULL)
+		memset(object, 0, pool->object_size);
+	return object;
+}
+
+/**
+ * @brief Free an object in a slab pool
+ *
+ * @param[in] pool   The pool to which to return the object
+ * @param[in] object The object to free
+ */
+
+void pool_slab_free(pool_t *pool, void *object)
+{
+	struct slab_pool *sp = slab_pool_of(pool);
+	struct slab_magazine *mag;
+
+	if (unlikely(sp->large)) {
+		pool_basic_free(pool, object);
+		return;
+	}
+
+	mag = slab_magazine(sp);
+	if (unlikely(mag == NULL)) {
+		slab_put(sp, &object, 1);
+		return;
+	}
+
+	if (mag->count == SLAB_MAG_SIZE) {
+		/* Return the older half, keep the recently freed ones */
+		slab_put(sp, mag->objs, SLAB_MAG_SIZE / 2);
+		memmove(mag->objs, mag->objs + SLAB_MAG_SIZE / 2,
+			(SLAB_MAG_SIZE / 2) * sizeof(void *));
+		mag->count -= SLAB_MAG_SIZE / 2;
+	}
+	mag->objs[mag->count++] = object;
+}
+
+/**
+ * @brief Report usage of every slab pool
+ *
+ * @param[in] cb  Called once per pool, with the slab mutex held
+ * @param[in] arg Passed to cb
+ */
+
+void pool_slab_foreach(void (*cb)(const struct pool_slab_stats *stats,
+				  void *arg),
+		       void *arg)
+{
+	struct pool_slab_stats stats;
+	struct slab_pool *sp;
+	struct slab_magazine *mag;
+	struct glist_head *glist, *gl;
+	struct slab *slab;
+	uint32_t node;
+
+	PTHREAD_MUTEX_lock(&slab_mtx);
+	glist_for_each(glist, &slab_pools) {
+		sp = glist_entry(glist, struct slab_pool, pools);
+		memset(&stats, 0, sizeof(stats));
+		stats.name = sp->pool->name;
+		stats.object_size = sp->size;
+
+		for (node = 0; node < SLAB_MAX_NODES; node++) {
+			PTHREAD_MUTEX_lock(&sp->nodes[node].mtx);
+			glist_for_each(gl, &sp->nodes[node].partial) {
+				slab = glist_entry(gl, struct slab, link);
+				stats.slabs++;
+				stats.huge_slabs += slab->huge;
+				stats.objects += slab->nobj;
+				stats.free += slab->nfree;
+			}
+			glist_for_each(gl, &sp->nodes[node].full) {
+				slab = glist_entry(gl, struct slab, link);
+				stats.slabs++;
+				stats.huge_slabs += slab->huge;
+				stats.objects += slab->nobj;
+			}
+			PTHREAD_MUTEX_unlock(&sp->nodes[node].mtx);
+		}
+
+		/* Racy read of other threads' counts, good enough here */
+		glist_for_each(gl, &sp->mags) {
+			mag = glist_entry(gl, struct slab_magazine, link);
+			stats.cached += mag->count;
+		}
+
+		cb(&stats, arg);
+	}
+	PTHREAD_MUTEX_unlock(&slab_mtx);
+}
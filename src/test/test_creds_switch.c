@@ -0,0 +1,208 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file test_creds_switch.c
+ * @brief Credentials in effect after each FSAL identity switch
+ *
+ * Drives fsal_set_credentials(), fsal_release_credentials(),
+ * fsal_operation_credentials() and fsal_restore_ganesha_credentials()
+ * the way the FSALs and protocol layers do, and after every step reads
+ * back the filesystem uid, gid and supplementary groups the kernel
+ * actually has for the thread.
+ *
+ * Must run as root, as the server does.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/fsuid.h>
+#include "log.h"
+#include "fsal_types.h"
+#include "FSAL/access_check.h"
+
+/* What the server's logging and statistics would provide */
+
+static log_levels_t test_log_levels[COMPONENT_COUNT];
+log_levels_t *component_log_level = test_log_levels;
+
+void DisplayLogComponentLevel(log_components_t component, char *file,
+			      int line, char *function, log_levels_t level,
+			      char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+
+	if (level == NIV_FATAL)
+		exit(1);
+}
+
+void server_stats_creds_switch(bool restore, uint32_t syscalls)
+{
+}
+
+/* Only compared by address */
+static char export_a, export_b;
+#define EXPORT_A ((const struct fsal_export *)&export_a)
+#define EXPORT_B ((const struct fsal_export *)&export_b)
+
+static int failures;
+
+/**
+ * @brief Check the identity the kernel has for this thread
+ *
+ * setfsuid() and setfsgid() return the id in effect and leave it
+ * alone when given an invalid one.
+ *
+ * @param[in] step    What was just done
+ * @param[in] uid     Expected filesystem uid
+ * @param[in] gid     Expected filesystem gid
+ * @param[in] ngroups Expected number of supplementary groups, or -1 not
+ *                    to check them
+ * @param[in] groups  Expected supplementary groups
+ */
+static void expect(const char *step, uid_t uid, gid_t gid, int ngroups,
+		   const gid_t *groups)
+{
+	gid_t actual[NGROUPS_MAX];
+	uid_t fsuid = setfsuid(-1);
+	gid_t fsgid = setfsgid(-1);
+	int n;
+
+	if (fsuid != uid || fsgid != gid) {
+		printf("FAIL %s: fsuid %d fsgid %d, expected %d %d\n", step,
+		       (int)fsuid, (int)fsgid, (int)uid, (int)gid);
+		failures++;
+		return;
+	}
+
+	if (ngroups >= 0) {
+		n = getgroups(NGROUPS_MAX, actual);
+		if (n != ngroups ||
+		    memcmp(actual, groups, n * sizeof(gid_t)) != 0) {
+			printf("FAIL %s: %d groups, expected %d\n", step, n,
+			       ngroups);
+			failures++;
+			return;
+		}
+	}
+
+	printf("ok   %s\n", step);
+}
+
+int main(int argc, char **argv)
+{
+	gid_t groups_a[] = { 100, 1001, 1002 };
+	gid_t groups_b[] = { 100, 2001 };
+	struct user_cred user_a = { 1000, 1000, 3, groups_a };
+	struct user_cred user_b = { 2000, 2000, 2, groups_b };
+	uid_t root_uid;
+	gid_t root_gid;
+	int i;
+
+	if (geteuid() != 0) {
+		fprintf(stderr, "%s must run as root\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < COMPONENT_COUNT; i++)
+		test_log_levels[i] = NIV_CRIT;
+
+	fsal_save_ganesha_credentials();
+	root_uid = setfsuid(-1);
+	root_gid = setfsgid(-1);
+
+	fsal_set_credentials(&user_a);
+	expect("set a", 1000, 1000, 3, groups_a);
+
+	fsal_restore_ganesha_credentials();
+	expect("restore", root_uid, root_gid, -1, NULL);
+
+	fsal_set_credentials(&user_b);
+	expect("set b", 2000, 2000, 2, groups_b);
+
+	fsal_set_credentials(&user_a);
+	expect("set a over b", 1000, 1000, 3, groups_a);
+
+	fsal_release_credentials(EXPORT_A);
+	expect("release keeps a", 1000, 1000, 3, groups_a);
+
+	fsal_operation_credentials(EXPORT_A, true);
+	expect("write on the same export keeps a", 1000, 1000, 3, groups_a);
+
+	fsal_set_credentials(&user_a);
+	expect("set a again", 1000, 1000, 3, groups_a);
+
+	fsal_release_credentials(EXPORT_A);
+	fsal_operation_credentials(EXPORT_A, false);
+	expect("other op on the same export restores", root_uid, root_gid,
+	       -1, NULL);
+
+	fsal_set_credentials(&user_b);
+	fsal_release_credentials(EXPORT_A);
+	fsal_operation_credentials(EXPORT_B, true);
+	expect("write on another export restores", root_uid, root_gid, -1,
+	       NULL);
+
+	fsal_set_credentials(&user_b);
+	fsal_release_credentials(EXPORT_A);
+	fsal_operation_credentials(NULL, true);
+	expect("write without an export restores", root_uid, root_gid, -1,
+	       NULL);
+
+	fsal_set_credentials(&user_a);
+	fsal_operation_credentials(EXPORT_A, true);
+	expect("unreleased identity restores", root_uid, root_gid, -1, NULL);
+
+	fsal_set_credentials(&user_b);
+	fsal_release_credentials(NULL);
+	expect("release without an export restores", root_uid, root_gid, -1,
+	       NULL);
+
+	fsal_set_credentials(&user_b);
+	fsal_release_credentials(EXPORT_A);
+	fsal_restore_ganesha_credentials();
+	expect("restore after release", root_uid, root_gid, -1, NULL);
+
+	fsal_restore_ganesha_credentials();
+	expect("restore twice", root_uid, root_gid, -1, NULL);
+
+	fsal_set_credentials(&user_b);
+	expect("set b after restore", 2000, 2000, 2, groups_b);
+	fsal_restore_ganesha_credentials();
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+
+	return 0;
+}